@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORRELATIVESCANMATCHER_H_
+#define CORRELATIVESCANMATCHER_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Transform.h>
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace rtabmap {
+
+/**
+ * Coarse 2D scan matcher searching exhaustively (x, y, yaw) in a window around a guess,
+ * without local minima, which makes it usable before ICP when the initial error is large.
+ *
+ * The reference scan is rasterized in a smoothed hit grid (CV_8UC1, 255=hit). Lower
+ * resolution grids are precomputed, where each cell of level h is the maximum of the
+ * 2^h x 2^h cells of the full resolution grid starting at the same cell. The score
+ * of a scan at level h is then an upper bound of the scores of all translations
+ * covered by the 2^h x 2^h block, so a branch-and-bound search over the levels finds
+ * the best full resolution translation for each rotation while scoring only a small
+ * part of the candidates. The angular step is set so that the farthest point
+ * of the scan moves by about one cell.
+ */
+class RTABMAP_EXP CorrelativeScanMatcher
+{
+public:
+	/**
+	 * @param resolution cell size (m)
+	 * @param linearWindow search window (+/- m) on x and y around the guess
+	 * @param angularWindow search window (+/- rad) on yaw around the guess
+	 */
+	CorrelativeScanMatcher(
+			float resolution = 0.05f,
+			float linearWindow = 2.0f,
+			float angularWindow = 0.52f);
+	virtual ~CorrelativeScanMatcher() {}
+
+	/**
+	 * Set the reference scan and precompute the multi-resolution grids.
+	 * @param scan CV_32FC2 or CV_32FC3 points (only x and y are used)
+	 */
+	void setReference(const cv::Mat & scan);
+
+	/**
+	 * @param scan CV_32FC2 or CV_32FC3 points (only x and y are used)
+	 * @param guess transform of the scan in the reference frame (z, roll and pitch are kept)
+	 * @param minScore minimum score [0-1] of the returned transform
+	 * @param score the score of the best transform (mean of the full resolution grid values under the scan points, [0-1])
+	 * @return the transform of the scan in the reference frame, null if no transform has a score over minScore
+	 */
+	Transform match(const cv::Mat & scan, const Transform & guess, float minScore = 0.0f, float * score = 0);
+
+	float getResolution() const {return resolution_;}
+	int getDepth() const {return (int)grids_.size();}
+
+	// statistics of the last match()
+	int getLastAngles() const {return lastAngles_;}
+	int getLastCandidatesScored() const {return lastCandidatesScored_;}
+	double getLastMatchTime() const {return lastMatchTime_;}
+
+private:
+	struct Candidate
+	{
+		Candidate(int a=0, int x=0, int y=0, float s=0.0f) : angle(a), ox(x), oy(y), score(s) {}
+		// sorted by decreasing score
+		bool operator<(const Candidate & c) const {return score > c.score;}
+		int angle;
+		int ox;
+		int oy;
+		float score;
+	};
+	float computeScore(const std::vector<cv::Point2i> & cells, int level, int ox, int oy) const;
+	void branchAndBound(std::vector<Candidate> & candidates, int level, Candidate & best);
+
+private:
+	float resolution_;
+	float linearWindow_;
+	float angularWindow_;
+	int levels_;
+
+	std::vector<cv::Mat> grids_; // CV_8UC1, one per level, 0 = full resolution
+	cv::Point2i origin_; // cell coordinates of grids_[i](0,0)
+
+	// current match()
+	int window_;
+	std::vector<std::vector<cv::Point2i> > rotatedCells_; // one per angle
+
+	int lastAngles_;
+	int lastCandidatesScored_;
+	double lastMatchTime_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* CORRELATIVESCANMATCHER_H_ */
@@ -0,0 +1,170 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEADLINESCHEDULER_H_
+#define DEADLINESCHEDULER_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+namespace rtabmap {
+
+/**
+ * Time budget of the stages of Rtabmap::process() for a frame deadline
+ * (Rtabmap/TimeThr). The cost of each stage is learned from its past
+ * durations (exponential moving average) and the time left in the frame
+ * is shared between the remaining stages in proportion to their expected
+ * cost. A stage taking more than its share is counted as an overrun.
+ *
+ * Optional work in a stage (proximity candidates, reactivated locations...)
+ * is done by units, which have their own cost model: affordableUnits()
+ * tells how many units can be done now without eating the time expected
+ * for the following stages. Without deadline, all units are affordable.
+ * A stage doing different kinds of units learns a cost model per kind
+ * (see UnitModel).
+ * Example:
+ * @code
+ *      scheduler.beginFrame(0.7); // 700 ms
+ *      scheduler.beginStage(DeadlineScheduler::kProximityBySpace);
+ *      for(...)
+ *      {
+ *          if(!scheduler.affordable()) {scheduler.skip(); continue;}
+ *          UTimer timer;
+ *          ... // one unit of optional work
+ *          scheduler.addUnitCost(timer.ticks());
+ *      }
+ *      scheduler.beginStage(DeadlineScheduler::kMapOptimization);
+ *      ...
+ *      scheduler.endFrame();
+ * @endcode
+ */
+class RTABMAP_EXP DeadlineScheduler
+{
+public:
+	// in the order of Rtabmap::process()
+	enum Stage {
+		kMemoryUpdate,
+		kProximityByTime,
+		kLikelihood,
+		kRetrieval,
+		kAddLoopClosureLink,
+		kProximityBySpace,
+		kMapOptimization,
+		kStatistics,
+		kMemoryCleanup,
+		kTransfer,
+		kStageCount};
+	static const char * stageName(Stage stage);
+
+	// cost models of the units of a stage
+	enum UnitModel {
+		kUnitDefault = 0,
+		// proximity by space candidates: visual or scan registration, one by one
+		// or in a parallel batch (cost of the batch divided by its candidates)
+		kUnitVisual = 0,
+		kUnitVisualParallel,
+		kUnitScan,
+		kUnitScanParallel,
+		kUnitModelCount};
+
+public:
+	DeadlineScheduler(float smoothing = 0.2f);
+	virtual ~DeadlineScheduler() {}
+
+	float getSmoothing() const {return smoothing_;}
+	void setSmoothing(float smoothing); // weight of the last sample in the cost model ]0,1]
+	void reset(); // clear the cost model and the counters
+
+	/**
+	 * Start a frame with a deadline (s) from now, 0 means no deadline
+	 * (costs are still learned).
+	 */
+	void beginFrame(double deadline);
+	/**
+	 * End the current stage (if any) and start the next one.
+	 */
+	void beginStage(Stage stage);
+	void endFrame(); // end the current stage
+
+	bool hasDeadline() const {return deadline_ > 0.0;}
+	double getDeadline() const {return deadline_;}
+	double elapsed() const; // since beginFrame() (s)
+	double remaining() const; // before the deadline (s), can be negative
+
+	/**
+	 * Time allotted to the current stage when it began (s), 0 without deadline.
+	 */
+	double budget() const {return budget_;}
+	double expectedCost(Stage stage) const {return expected_[stage];}
+	double expectedUnitCost(Stage stage, UnitModel model = kUnitDefault) const {return unitExpected_[stage][model];}
+
+	/**
+	 * Maximum number of units (up to "units") of optional work of
+	 * the current stage that can be done now.
+	 */
+	int affordableUnits(int units, UnitModel model = kUnitDefault) const;
+	bool affordable(UnitModel model = kUnitDefault) const {return affordableUnits(1, model) == 1;}
+	void addUnitCost(double time, int units = 1, UnitModel model = kUnitDefault); // time (s) taken by "units" of the current stage
+	void skip(int units = 1); // units not done in the current stage
+
+	// statistics
+	// for the last frame
+	int getFrameOverruns() const {return frameOverruns_;}
+	int getFrameSkipped(Stage stage) const {return frameSkipped_[stage];}
+	// accumulated since the last reset()
+	int getOverruns(Stage stage) const {return overruns_[stage];}
+	int getSkipped(Stage stage) const {return skipped_[stage];}
+	int getFrames() const {return frames_;}
+	int getLateFrames() const {return lateFrames_;}
+
+private:
+	double reserve(Stage stage) const; // expected cost of the stages after "stage"
+	void update(double & expected, int & samples, double value) const;
+
+private:
+	float smoothing_;
+	double deadline_;
+	double frameStart_;
+	double stageStart_;
+	int stage_; // -1 when no stage is started
+	double budget_;
+
+	double expected_[kStageCount];
+	int samples_[kStageCount];
+	double unitExpected_[kStageCount][kUnitModelCount];
+	int unitSamples_[kStageCount][kUnitModelCount];
+
+	int frameOverruns_;
+	int frameSkipped_[kStageCount];
+	int overruns_[kStageCount];
+	int skipped_[kStageCount];
+	int frames_;
+	int lateFrames_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* DEADLINESCHEDULER_H_ */
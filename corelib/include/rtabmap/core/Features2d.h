@@ -164,6 +164,12 @@ protected:
 private:
 	virtual std::vector<cv::KeyPoint> generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi, const cv::Mat & mask = cv::Mat()) const = 0;
 	virtual cv::Mat generateDescriptorsImpl(const cv::Mat & image, std::vector<cv::KeyPoint> & keypoints) const = 0;
+	// If generateKeypointsImpl() can be called concurrently on different cells of the
+	// same image. OpenCV doesn't guarantee it, so only detectors known to be stateless opt in.
+	virtual bool isDetectionThreadSafe() const {return false;}
+	// Distance (pixels) from the ROI edges in which generateKeypointsImpl() cannot
+	// find keypoints. Grid cells are extended by this border so that their inner edges are not lost.
+	virtual int detectionBorder() const {return 0;}
 
 private:
 	ParametersMap parameters_;
@@ -174,6 +180,8 @@ private:
 	int _subPixWinSize;
 	int _subPixIterations;
 	double _subPixEps;
+	int _gridRows;
+	int _gridCols;
 	// Stereo stuff
 	Stereo * _stereo;
 };
@@ -191,6 +199,7 @@ public:
 private:
 	virtual std::vector<cv::KeyPoint> generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi, const cv::Mat & mask = cv::Mat()) const;
 	virtual cv::Mat generateDescriptorsImpl(const cv::Mat & image, std::vector<cv::KeyPoint> & keypoints) const;
+	virtual int detectionBorder() const;
 
 private:
 	double hessianThreshold_;
@@ -218,6 +227,7 @@ public:
 private:
 	virtual std::vector<cv::KeyPoint> generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi, const cv::Mat & mask = cv::Mat()) const;
 	virtual cv::Mat generateDescriptorsImpl(const cv::Mat & image, std::vector<cv::KeyPoint> & keypoints) const;
+	virtual int detectionBorder() const;
 
 private:
 	int nOctaveLayers_;
@@ -241,6 +251,8 @@ public:
 private:
 	virtual std::vector<cv::KeyPoint> generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi, const cv::Mat & mask = cv::Mat()) const;
 	virtual cv::Mat generateDescriptorsImpl(const cv::Mat & image, std::vector<cv::KeyPoint> & keypoints) const;
+	virtual bool isDetectionThreadSafe() const;
+	virtual int detectionBorder() const {return edgeThreshold_;}
 
 private:
 	float scaleFactor_;
@@ -272,6 +284,8 @@ public:
 private:
 	virtual std::vector<cv::KeyPoint> generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi, const cv::Mat & mask = cv::Mat()) const;
 	virtual cv::Mat generateDescriptorsImpl(const cv::Mat & image, std::vector<cv::KeyPoint> & keypoints) const {return cv::Mat();}
+	virtual bool isDetectionThreadSafe() const;
+	virtual int detectionBorder() const {return 3;} // radius of the FAST circle
 
 private:
 	int threshold_;
@@ -339,6 +353,7 @@ public:
 
 private:
 	virtual std::vector<cv::KeyPoint> generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi, const cv::Mat & mask = cv::Mat()) const;
+	virtual int detectionBorder() const {return _blockSize/2 + 1;} // block and Sobel aperture
 
 private:
 	double _qualityLevel;
@@ -421,6 +436,7 @@ public:
 private:
 	virtual std::vector<cv::KeyPoint> generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi, const cv::Mat & mask = cv::Mat()) const;
 	virtual cv::Mat generateDescriptorsImpl(const cv::Mat & image, std::vector<cv::KeyPoint> & keypoints) const;
+	virtual int detectionBorder() const;
 
 private:
 	int thresh_;
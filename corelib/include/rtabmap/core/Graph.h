@@ -32,10 +32,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <map>
 #include <list>
+#include <set>
 #include <rtabmap/core/Link.h>
 
 namespace rtabmap {
 class Memory;
+class PoseSpatialIndex;
 
 namespace graph {
 
@@ -137,6 +139,23 @@ std::list<std::pair<int, Transform> > RTABMAP_EXP computePath(
 			int to,
 			bool updateNewCosts = false);
 
+/**
+ * Same as A* computePath() above but faster on large graphs: bidirectional
+ * A* on a compact (CSR) adjacency array with dense node indices and binary
+ * heaps with decrease-key. Costs are always kept up-to-date, so the returned
+ * path is the shortest one (ties may be broken differently than computePath()).
+ * @param poses The graph's poses
+ * @param links The graph's links (from node id -> to node id)
+ * @param from initial node
+ * @param to final node
+ * @return the path ids from id "from" to id "to" including initial and final nodes.
+ */
+std::list<std::pair<int, Transform> > RTABMAP_EXP computePathBidirectional(
+			const std::map<int, rtabmap::Transform> & poses,
+			const std::multimap<int, int> & links,
+			int from,
+			int to);
+
 /**
  * Perform Dijkstra path planning in the graph.
  * @param poses The graph's poses
@@ -193,6 +212,21 @@ std::map<int, Transform> RTABMAP_EXP getPosesInRadius(
 		float radius,
 		float angle = 0.0f);
 
+// Same as above but using a persistent spatial index (nodeId should be in the index)
+int RTABMAP_EXP findNearestNode(
+		const PoseSpatialIndex & index,
+		const rtabmap::Transform & targetPose,
+		const std::set<int> & ignoredIds = std::set<int>());
+std::map<int, float> RTABMAP_EXP getNodesInRadius(
+		int nodeId,
+		const PoseSpatialIndex & index,
+		float radius);
+std::map<int, Transform> RTABMAP_EXP getPosesInRadius(
+		int nodeId,
+		const PoseSpatialIndex & index,
+		float radius,
+		float angle = 0.0f);
+
 float RTABMAP_EXP computePathLength(
 		const std::vector<std::pair<int, Transform> > & path,
 		unsigned int fromIndex = 0,
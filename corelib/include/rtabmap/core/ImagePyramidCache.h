@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMAGEPYRAMIDCACHE_H_
+#define IMAGEPYRAMIDCACHE_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/utilite/UMutex.h>
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace rtabmap {
+
+/**
+ * Optical flow pyramid (see cv::buildOpticalFlowPyramid(), with derivatives)
+ * of an image, built on first request and kept until the image changes. The
+ * returned pyramid can be given directly to cv::calcOpticalFlowPyrLK() and
+ * util2d::calcOpticalFlowPyrLKStereo(), as previous or next image, with a window
+ * not larger than the one used to build it.
+ *
+ * Level buffers are taken from a process-wide pool and given back on destruction,
+ * so that consecutive frames of the same size don't reallocate them.
+ */
+class RTABMAP_EXP ImagePyramidCache
+{
+public:
+	static void getStatistics(
+			unsigned long & builds,
+			unsigned long & hits,
+			unsigned long & allocations);
+	static void resetStatistics();
+	static void clearPool();
+
+public:
+	ImagePyramidCache();
+	virtual ~ImagePyramidCache();
+
+	// Image is converted to gray if needed. Returned levels are shared with the cache, don't modify them.
+	std::vector<cv::Mat> get(const cv::Mat & image, const cv::Size & winSize, int maxLevel);
+
+private:
+	ImagePyramidCache(const ImagePyramidCache &);
+	ImagePyramidCache & operator=(const ImagePyramidCache &);
+
+private:
+	UMutex mutex_;
+	cv::Mat image_; // source image, to detect changes
+	cv::Size winSize_;
+	int maxLevel_;
+	std::vector<cv::Mat> pyramid_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* IMAGEPYRAMIDCACHE_H_ */
@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef LOGODDSGRID_H_
+#define LOGODDSGRID_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Transform.h>
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace rtabmap {
+
+/**
+ * Probabilistic 2D occupancy grid: unlike util3d::create2DMap(), which overwrites
+ * cells with hard free/occupied labels, each laser scan added with update()
+ * accumulates hits and misses in log-odds, clamped to [probClampingMin, probClampingMax].
+ * Cells are saturating fixed-point integers (CV_16SC1, or CV_8SC1 for a smaller
+ * memory footprint with coarser probabilities).
+ *
+ * Rays of a scan are traced in parallel (DDA, one bit mask per thread, so that
+ * rays never write in the same buffer), then the masks are merged and applied
+ * to the grid in a single vectorized pass: each cell is updated at most once
+ * per scan, with hits having priority over misses.
+ * The grid grows automatically to include new scans.
+ */
+class RTABMAP_EXP LogOddsGrid
+{
+public:
+	LogOddsGrid(
+			float cellSize = 0.05f,
+			int cellType = CV_16SC1,
+			float probHit = 0.7f,
+			float probMiss = 0.4f,
+			float probClampingMin = 0.1192f,
+			float probClampingMax = 0.971f);
+	virtual ~LogOddsGrid() {}
+
+	void clear();
+
+	/**
+	 * Add a laser scan.
+	 * @param scan CV_32FC2 or CV_32FC3 points in the scan frame
+	 * @param pose pose of the scan frame in the map (only x, y and yaw are used)
+	 * @param maxRange if > 0, longer rays are truncated and only cleared (no hit)
+	 * @return the number of rays traced
+	 */
+	int update(const cv::Mat & scan, const Transform & pose, float maxRange = 0.0f);
+
+	/**
+	 * Same format as util3d::create2DMap(): CV_8S, -1=unknown, 0=empty, 100=obstacle,
+	 * xMin and yMin are the position of the corner of the first cell.
+	 */
+	cv::Mat getMap(float & xMin, float & yMin, float occupancyThr = 0.5f) const;
+	// Raw fixed-point log-odds, see getLogOddsScale(). Unknown cells are set to the minimum value of the type.
+	const cv::Mat & getLogOdds(float & xMin, float & yMin) const;
+	float getLogOddsScale() const {return scale_;}
+	float getCellSize() const {return cellSize_;}
+
+	// statistics of the last update()
+	int getLastRays() const {return lastRays_;}
+	int getLastCellsUpdated() const {return lastCellsUpdated_;}
+	double getLastUpdateTime() const {return lastUpdateTime_;}
+
+private:
+	void reserve(const cv::Point2i & minCell, const cv::Point2i & maxCell);
+	template<typename T> void applyMask(const cv::Rect & roi, const unsigned char * mask);
+
+private:
+	float cellSize_;
+	int cellType_;
+	float scale_;
+	int hit_;
+	int miss_;
+	int clampingMin_;
+	int clampingMax_;
+
+	cv::Mat grid_;
+	cv::Point2i origin_; // cell coordinates of grid_(0,0)
+	std::vector<std::vector<unsigned char> > masks_; // one per thread, reused between updates
+
+	int lastRays_;
+	int lastCellsUpdated_;
+	double lastUpdateTime_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* LOGODDSGRID_H_ */
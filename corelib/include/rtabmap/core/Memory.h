@@ -189,7 +189,31 @@ public:
 			const std::map<int, Transform> & poses,
 			RegistrationInfo * info = 0);
 
+	// Same as computeTransform() and computeIcpTransformMulti() (with null guess) but for
+	// multiple candidates, registered in parallel with independent registration instances.
+	// Results are returned in the same order than the candidates.
+	std::vector<Transform> computeTransforms(
+			int fromId,
+			const std::vector<int> & toIds,
+			std::vector<RegistrationInfo> * infos = 0);
+	std::vector<Transform> computeIcpTransformsMulti(
+			int fromId,
+			const std::vector<std::pair<int, std::map<int, Transform> > > & toIds, // <toId, poses>
+			std::vector<RegistrationInfo> * infos = 0);
+
 private:
+	void loadDataForRegistration(Signature * s);
+	Transform computeTransform(
+			const Signature & fromS,
+			const Signature & toS,
+			Transform guess,
+			RegistrationInfo * info,
+			const Registration & registration) const;
+	bool assembleScans(
+			int fromId,
+			int toId,
+			const std::map<int, Transform> & poses,
+			SensorData & assembledData);
 	void preUpdate();
 	void addSignatureToStm(Signature * signature, const cv::Mat & covariance);
 	void clear();
@@ -268,6 +292,8 @@ private:
 
 	Registration * _registrationPipeline;
 	RegistrationIcp * _registrationIcp;
+	std::vector<Registration *> _parallelRegistrations; // one per thread
+	std::vector<RegistrationIcp *> _parallelRegistrationsIcp; // one per thread
 };
 
 } // namespace rtabmap
@@ -0,0 +1,141 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OCCUPANCYGRIDASSEMBLER_H_
+#define OCCUPANCYGRIDASSEMBLER_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Transform.h>
+#include <opencv2/core/core.hpp>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace rtabmap {
+
+/**
+ * Incremental version of util3d::create2DMapFromOccupancyLocalMaps(). Local maps
+ * (<ground, obstacles>, CV_32FC2) are projected once in a persistent grid of
+ * cell counters. On update(), only new nodes, removed nodes and nodes that moved
+ * more than the update thresholds (e.g., after a loop closure) are projected again,
+ * so the cost is proportional to the size of the local maps changed, not to the
+ * size of the whole map.
+ *
+ * The grid is stored by tiles: bounds grow without reallocating the cells
+ * already set, and tiles emptied by removed or moved nodes are freed. Obstacle
+ * cells have priority over empty cells, whatever the order in which the nodes
+ * are added. The assembled (and filtered) map is kept between calls of getMap():
+ * only the tiles changed since the last call are assembled and filtered again.
+ */
+class RTABMAP_EXP OccupancyGridAssembler
+{
+public:
+	// angularUpdate in rad
+	OccupancyGridAssembler(float cellSize = 0.05f, float linearUpdate = 0.05f, float angularUpdate = 0.01f);
+	virtual ~OccupancyGridAssembler() {}
+
+	float getCellSize() const {return cellSize_;}
+	void setCellSize(float cellSize); // the grid is cleared if the size changes
+	void setUpdateThresholds(float linearUpdate, float angularUpdate);
+	void clear();
+
+	/**
+	 * Add local maps of new nodes, remove nodes not in poses anymore and project
+	 * again nodes that moved more than the update thresholds. Local maps
+	 * are expected to not change for the same node id (call clear() otherwise).
+	 * @return the number of nodes projected
+	 */
+	int update(
+			const std::map<int, Transform> & poses,
+			const std::map<int, std::pair<cv::Mat, cv::Mat> > & occupancy);
+
+	/**
+	 * Same format as util3d::create2DMapFromOccupancyLocalMaps(): CV_8S,
+	 * -1=unknown, 0=empty, 100=obstacle. Returns an empty map if nothing is projected.
+	 * The returned map shares the buffer of the assembler, it is valid until the
+	 * next call of update() or getMap() (clone it to keep it).
+	 */
+	cv::Mat getMap(float & xMin, float & yMin, bool erode = false);
+
+	int getNodes() const {return (int)nodes_.size();}
+	int getTiles() const {return (int)tiles_.size();}
+	// statistics of the last update()
+	int getLastAdded() const {return lastAdded_;}
+	int getLastMoved() const {return lastMoved_;}
+	int getLastRemoved() const {return lastRemoved_;}
+	double getLastUpdateTime() const {return lastUpdateTime_;}
+
+private:
+	struct Node
+	{
+		float x, y, yaw; // 2D pose used for the projection
+		cv::Point2i cell; // of the pose
+		std::vector<cv::Point2i> emptyCells;
+		std::vector<cv::Point2i> obstacleCells;
+	};
+	struct Tile
+	{
+		Tile();
+		std::vector<int> empty;
+		std::vector<int> obstacles;
+		int cells; // counters > 0
+	};
+
+	void project(Node & node, const cv::Mat & localMap, std::vector<cv::Point2i> & cells, bool obstacle);
+	void addCells(const std::vector<cv::Point2i> & cells, bool obstacle, int increment);
+	void includeCell(const cv::Point2i & cell);
+	void computeBounds();
+	void allocateBuffer(const cv::Rect & area);
+
+private:
+	float cellSize_;
+	float linearUpdate_;
+	float angularUpdate_;
+	std::map<int, Node> nodes_;
+	std::map<std::pair<int, int>, Tile> tiles_;
+	bool hasBounds_;
+	bool boundsChanged_; // cells were removed, bounds may shrink
+	cv::Point2i minCell_;
+	cv::Point2i maxCell_;
+
+	// assembled map, in cells, covering the bounds with some slack
+	std::set<std::pair<int, int> > dirtyTiles_;
+	cv::Rect bufferRect_;
+	cv::Mat raw_;
+	cv::Mat filtered_;
+	bool erode_;
+
+	int lastAdded_;
+	int lastMoved_;
+	int lastRemoved_;
+	double lastUpdateTime_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* OCCUPANCYGRIDASSEMBLER_H_ */
@@ -97,6 +97,34 @@ public:
 			const std::multimap<int, Link> & links,
 			const std::map<int, Signature> & signatures);
 
+	// Incremental optimization: the problem is kept alive between calls and
+	// only new poses/constraints are added. If a previously added pose or
+	// constraint is removed or modified, or if the optimizer doesn't support
+	// it, a batch optimization is done instead (incrementalDone=false).
+	virtual bool isIncrementalAvailable() const {return false;}
+	virtual std::map<int, Transform> optimizeIncremental(
+			int rootId,
+			const std::map<int, Transform> & poses,
+			const std::multimap<int, Link> & constraints,
+			double * finalError = 0,
+			int * iterationsDone = 0,
+			bool * incrementalDone = 0);
+	virtual void resetIncremental() {}
+
+	// Two-level optimization for large (e.g., multi-session) graphs: neighbor chains
+	// are condensed into a skeleton of keyframes (nodes with loop closures, chain ends
+	// and one node every maxSegmentSize nodes) linked by composed constraints. The
+	// skeleton is optimized with optimize(), then the poses of the other nodes are
+	// recovered by distributing the correction along their chain segment.
+	std::map<int, Transform> optimizeHierarchical(
+			int rootId,
+			const std::map<int, Transform> & poses,
+			const std::multimap<int, Link> & constraints,
+			int maxSegmentSize = 50,
+			double * finalError = 0,
+			int * iterationsDone = 0,
+			int * skeletonSize = 0);
+
 	virtual void parseParameters(const ParametersMap & parameters);
 
 protected:
@@ -31,6 +31,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
 
 #include <rtabmap/core/Optimizer.h>
+#include <set>
+
+namespace gtsam {
+class ISAM2;
+}
 
 namespace rtabmap {
 
@@ -46,11 +51,17 @@ public:
 			bool covarianceIgnored = Parameters::defaultOptimizerVarianceIgnored(),
 			double epsilon         = Parameters::defaultOptimizerEpsilon(),
 			bool robust            = Parameters::defaultOptimizerRobust()) :
-		Optimizer(iterations, slam2d, covarianceIgnored, epsilon, robust) {}
+		Optimizer(iterations, slam2d, covarianceIgnored, epsilon, robust),
+		isam_(0),
+		isamRootId_(0),
+		isamSlam2d_(false) {}
 
 	OptimizerGTSAM(const ParametersMap & parameters) :
-		Optimizer(parameters) {}
-	virtual ~OptimizerGTSAM() {}
+		Optimizer(parameters),
+		isam_(0),
+		isamRootId_(0),
+		isamSlam2d_(false) {}
+	virtual ~OptimizerGTSAM();
 
 	virtual Type type() const {return kTypeGTSAM;}
 
@@ -61,6 +72,32 @@ public:
 			std::list<std::map<int, Transform> > * intermediateGraphes = 0,
 			double * finalError = 0,
 			int * iterationsDone = 0);
+
+	// iSAM2, robust optimization (Vertigo) is not supported in incremental mode
+	virtual bool isIncrementalAvailable() const {return available() && !isRobust();}
+	virtual std::map<int, Transform> optimizeIncremental(
+			int rootId,
+			const std::map<int, Transform> & poses,
+			const std::multimap<int, Link> & edgeConstraints,
+			double * finalError = 0,
+			int * iterationsDone = 0,
+			bool * incrementalDone = 0);
+	virtual void resetIncremental();
+
+private:
+	// isam_ is owned, copies are not allowed (not implemented)
+	OptimizerGTSAM(const OptimizerGTSAM &);
+	OptimizerGTSAM & operator=(const OptimizerGTSAM &);
+
+	typedef std::pair<std::pair<int, int>, int> IsamLinkKey;
+	static IsamLinkKey isamLinkKey(const Link & link);
+
+private:
+	gtsam::ISAM2 * isam_;
+	int isamRootId_;
+	bool isamSlam2d_;
+	std::set<int> isamPoses_;
+	std::map<IsamLinkKey, Link> isamLinks_;
 };
 
 } /* namespace rtabmap */
@@ -172,6 +172,8 @@ class RTABMAP_EXP Parameters
 	RTABMAP_PARAM(Rtabmap, PublishLastSignature, 	     bool, true, "Publishing last signature.");
 	RTABMAP_PARAM(Rtabmap, PublishPdf, 	                 bool, true, "Publishing pdf.");
 	RTABMAP_PARAM(Rtabmap, PublishLikelihood, 	         bool, true, "Publishing likelihood.");
+	RTABMAP_PARAM(Rtabmap, PublishStatsDelta, 	         bool, false, "Publish only poses, links and nodes information that changed since the last publication, with a full graph every Rtabmap/PublishStatsKeyFrame publications. Use StatisticsAccumulator on the receiver side to reconstruct the graph.");
+	RTABMAP_PARAM(Rtabmap, PublishStatsKeyFrame, 	     int, 30,    "When Rtabmap/PublishStatsDelta is true, a full graph is published every X publications (0 means only the first one).");
 	RTABMAP_PARAM(Rtabmap, TimeThr, 		             float, 0.0, "Maximum time allowed for the detector (ms) (0 means infinity).");
 	RTABMAP_PARAM(Rtabmap, MemoryThr, 		             int, 0, 	 "Maximum signatures in the Working Memory (ms) (0 means infinity).");
 	RTABMAP_PARAM(Rtabmap, DetectionRate,                float, 1.0, "Detection rate. RTAB-Map will filter input images to satisfy this rate.");
@@ -182,6 +184,10 @@ class RTABMAP_EXP Parameters
 	RTABMAP_PARAM(Rtabmap, StatisticLogsBufferedInRAM,   bool, true, "Statistic logs buffered in RAM instead of written to hard drive after each iteration.");
 	RTABMAP_PARAM(Rtabmap, StatisticLogged,   	         bool, false, "Logging enabled.");
 	RTABMAP_PARAM(Rtabmap, StatisticLoggedHeaders,   	 bool, true, "Add column header description to log files.");
+	RTABMAP_PARAM(Rtabmap, StatisticLogBinary,   	     bool, false, "Log all statistics of Statistics::defaultData() (published with Rtabmap/PublishStats) in the binary columnar file \"LogStats.bin\" instead of the text files LogF.txt and LogI.txt. It can be opened in the Database Viewer.");
+	RTABMAP_PARAM(Rtabmap, Profiling,   	             bool, false, "Record the timing tree of each processed node (Memory, VWDictionary, database and registration scopes), available in the statistics.");
+	RTABMAP_PARAM(Rtabmap, ProfilingTrace,   	         bool, false, "When Rtabmap/Profiling is true, append the timing trees to \"trace.json\" in the working directory (Chrome trace event format, open it in chrome://tracing).");
+	RTABMAP_PARAM(Rtabmap, DeadlineScheduling, 	         bool, false, "When Rtabmap/TimeThr is set, share the time of each frame between the stages of the process (likelihood, retrieval, proximity detection, graph optimization, cleanup...) from a running average of their cost. Optional work (proximity detection candidates, retrieval of the loop closure neighbors) is skipped when the frame is at risk of exceeding the threshold. Stage overruns and skipped work are reported in the statistics.");
 	RTABMAP_PARAM(Rtabmap, StartNewMapOnLoopClosure,     bool, false, "Start a new map only if there is a global loop closure with a previous map.");
 
 	// Hypotheses selection
@@ -232,6 +238,8 @@ class RTABMAP_EXP Parameters
     RTABMAP_PARAM(Kp, SubPixWinSize,            int, 3,        "See cv::cornerSubPix().");
 	RTABMAP_PARAM(Kp, SubPixIterations,         int, 0,        "See cv::cornerSubPix(). 0 disables sub pixel refining.");
 	RTABMAP_PARAM(Kp, SubPixEps,                double, 0.02,  "See cv::cornerSubPix().");
+	RTABMAP_PARAM(Kp, GridRows,                 int, 1,        "Number of rows of the grid used to extract uniformly the features from an image. With more than one cell, features are detected independently (in parallel when the detector allows it) in each cell, with at most Kp/MaxFeatures/(rows*cols) features per cell.");
+	RTABMAP_PARAM(Kp, GridCols,                 int, 1,        "Number of columns of the grid used to extract uniformly the features from an image. See Kp/GridRows.");
 
 	//Database
 	RTABMAP_PARAM(DbSqlite3, InMemory, 	   bool, false, 		"Using database in the memory instead of a file on the hard disk.");
@@ -306,6 +314,9 @@ class RTABMAP_EXP Parameters
 	RTABMAP_PARAM(RGBD, AngularUpdate,            float, 0.1,  "Minimum angular displacement to update the map. Rehearsal is done prior to this, so weights are still updated.");
 	RTABMAP_PARAM(RGBD, NewMapOdomChangeDistance, float, 0,    "A new map is created if a change of odometry translation greater than X m is detected (0 m = disabled).");
 	RTABMAP_PARAM(RGBD, OptimizeFromGraphEnd,     bool, false, "Optimize graph from the newest node. If false, the graph is optimized from the oldest node of the current graph (this adds an overhead computation to detect to oldest mode of the current graph, but it can be useful to preserve the map referential from the oldest node). Warning when set to false: when some nodes are transferred, the first referential of the local map may change, resulting in momentary changes in robot/map position (which are annoying in teleoperation).");
+	RTABMAP_PARAM(RGBD, OptimizeIncremental,      bool, false, "Keep the graph optimization problem between updates and only add new nodes and links to it (iSAM2, only with GTSAM optimizer and \"Optimizer/Robust\" disabled). The optimization falls back to a batch optimization when nodes or links already in the problem are removed or modified (e.g., nodes transferred to LTM, rejected loop closures, graph reduction).");
+	RTABMAP_PARAM(RGBD, OptimizeHierarchical,     bool, false, "Two-level graph optimization for large (e.g., multi-session) graphs: the neighbor chains of each map are condensed into a skeleton (nodes with loop closures, chain ends and one node every \"RGBD/OptimizeHierarchicalSegment\" nodes) linked by composed constraints. The skeleton is optimized, then the other poses are recovered in parallel by distributing the correction along their chain. Not used when an incremental optimization is done (\"RGBD/OptimizeIncremental\").");
+	RTABMAP_PARAM(RGBD, OptimizeHierarchicalSegment, int, 50,  "Maximum number of consecutive neighbor links condensed in a single skeleton link (see \"RGBD/OptimizeHierarchical\").");
 	RTABMAP_PARAM(RGBD, OptimizeMaxError,         float, 1.0,  "Reject loop closures if optimization error is greater than this value (0=disabled). This will help to detect when a wrong loop closure is added to the graph. Not compatible with \"Optimizer/Robust\" if enabled.");
 	RTABMAP_PARAM(RGBD, GoalReachedRadius,        float, 0.5,  "Goal reached radius (m).");
 	RTABMAP_PARAM(RGBD, PlanStuckIterations,      int, 0,      "Mark the current goal node on the path as unreachable if it is not updated after X iterations (0=disabled). If all upcoming nodes on the path are unreachabled, the plan fails.");
@@ -327,6 +338,7 @@ class RTABMAP_EXP Parameters
 	RTABMAP_PARAM(RGBD, ProximityPathFilteringRadius, float, 0.5,   "Path filtering radius.");
 	RTABMAP_PARAM(RGBD, ProximityPathRawPosesUsed,    bool, true,   "When comparing to a local path, merge the scan using the odometry poses (with neighbor link optimizations) instead of the ones in the optimized local graph.");
 	RTABMAP_PARAM(RGBD, ProximityAngle,               float, 45.0,  "Maximum angle (degrees) for visual proximity detection.");
+	RTABMAP_PARAM(RGBD, ProximityParallel,            bool, false,  "Register the proximity detection candidates (the nearest node of each nearby path) in parallel, each thread with its own registration instance. Links are added in the same order than the serial version. In localization mode, all candidates are registered even if only the first accepted one is kept.");
 
 	// Graph optimization
 #ifdef RTABMAP_GTSAM
@@ -422,6 +434,12 @@ class RTABMAP_EXP Parameters
 	RTABMAP_PARAM(Icp, CorrespondenceRatio,       float, 0.2,   "Ratio of matching correspondences to accept the transform.");
 	RTABMAP_PARAM(Icp, PointToPlane,              bool, false, 	"Use point to plane ICP.");
 	RTABMAP_PARAM(Icp, PointToPlaneNormalNeighbors, int, 20,    "Number of neighbors to compute normals for point to plane.");
+	RTABMAP_PARAM(Icp, CacheSize,                 int, 10,      "Number of preprocessed laser scans (filtered clouds, normals and search trees) kept between registrations, to avoid preprocessing again a scan registered multiple times (e.g., odometry reference scan, proximity detection). 0=disabled.");
+	RTABMAP_PARAM(Icp, Correlative,               bool, false,  "Coarse correlative scan matching (branch-and-bound on multi-resolution grids) around the guess before ICP, for 2D laser scans with a large initial error. The ICP is then done from the coarse transform.");
+	RTABMAP_PARAM(Icp, CorrelativeResolution,     float, 0.05,  "Cell size (m) of the finest correlative scan matching grid.");
+	RTABMAP_PARAM(Icp, CorrelativeLinearWindow,   float, 2.0,   "Correlative scan matching search window (+/- m) around the guess.");
+	RTABMAP_PARAM(Icp, CorrelativeAngularWindow,  float, 0.52,  "Correlative scan matching search window (+/- rad) around the guess.");
+	RTABMAP_PARAM(Icp, CorrelativeMinScore,       float, 0.4,   "Minimum correlative scan matching score [0-1]. Under it, ICP is done from the original guess.");
 
 	// Stereo disparity
 	RTABMAP_PARAM(Stereo, WinWidth,              int, 15,       "Window width.");
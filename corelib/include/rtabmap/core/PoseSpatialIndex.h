@@ -0,0 +1,134 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef POSESPATIALINDEX_H_
+#define POSESPATIALINDEX_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Transform.h>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace rtabmap {
+
+/**
+ * Persistent spatial index of node poses (uniform grid hash keyed by node id),
+ * to avoid building a new kd-tree of all the poses on each proximity, nearest
+ * node or radius query. update() synchronizes the index with a set of poses
+ * (e.g., the optimized poses after each graph optimization): only added,
+ * removed and moved nodes are touched.
+ *
+ * For best performance, the cell size should be close to the radius
+ * of the most frequent radius queries.
+ */
+class RTABMAP_EXP PoseSpatialIndex
+{
+public:
+	PoseSpatialIndex(float cellSize = 1.0f);
+	virtual ~PoseSpatialIndex() {}
+
+	float getCellSize() const {return cellSize_;}
+	void setCellSize(float cellSize); // the index is rebuilt if the size changes
+	void clear();
+
+	/**
+	 * Add new nodes, remove nodes not in poses anymore and
+	 * update nodes with a different pose.
+	 * @return the number of nodes added, removed or moved
+	 */
+	int update(const std::map<int, Transform> & poses);
+	void add(int id, const Transform & pose);
+	void remove(int id);
+
+	bool empty() const {return nodes_.empty();}
+	int size() const {return (int)nodes_.size();}
+	bool contains(int id) const {return nodes_.find(id) != nodes_.end();}
+	const Transform & getPose(int id) const; // id should be in the index
+
+	/**
+	 * Nearest node (0 if none). Nodes in ignoredIds are not returned.
+	 */
+	int nearest(const Transform & pose, const std::set<int> & ignoredIds = std::set<int>()) const;
+
+	/**
+	 * Nodes in the radius of the pose, with their squared distance to it.
+	 */
+	std::map<int, float> radiusSearch(const Transform & pose, float radius) const;
+
+	// statistics
+	int getCells() const {return (int)cells_.size();}
+	int getLastAdded() const {return lastAdded_;}
+	int getLastMoved() const {return lastMoved_;}
+	int getLastRemoved() const {return lastRemoved_;}
+	double getLastUpdateTime() const {return lastUpdateTime_;}
+	// accumulated since the last resetStatistics() (s)
+	double getUpdatesTime() const {return updatesTime_;}
+	int getQueries() const {return queries_;}
+	double getQueriesTime() const {return queriesTime_;}
+	void resetStatistics();
+
+private:
+	struct Cell
+	{
+		Cell(int cx = 0, int cy = 0, int cz = 0) : x(cx), y(cy), z(cz) {}
+		bool operator<(const Cell & c) const {return x<c.x || (x==c.x && (y<c.y || (y==c.y && z<c.z)));}
+		bool operator==(const Cell & c) const {return x==c.x && y==c.y && z==c.z;}
+		int x, y, z;
+	};
+	struct Node
+	{
+		Transform pose;
+		Cell cell;
+	};
+
+	Cell cellOf(float x, float y, float z) const;
+	void insertInCell(int id, const Cell & cell);
+	void removeFromCell(int id, const Cell & cell);
+	int bruteForceNearest(float x, float y, float z, const std::set<int> & ignoredIds) const;
+
+private:
+	float cellSize_;
+	std::map<int, Node> nodes_;
+	std::map<Cell, std::vector<int> > cells_;
+	bool hasBounds_;
+	Cell minCell_; // bounds never shrink until clear()
+	Cell maxCell_;
+
+	int lastAdded_;
+	int lastMoved_;
+	int lastRemoved_;
+	double lastUpdateTime_;
+	double updatesTime_;
+	mutable int queries_;
+	mutable double queriesTime_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* POSESPATIALINDEX_H_ */
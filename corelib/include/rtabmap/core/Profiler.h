@@ -0,0 +1,157 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <string>
+#include <vector>
+
+namespace rtabmap {
+
+/**
+ * A node of the timing tree recorded by Profiler. Nodes are stored
+ * in a flat vector in the order they were first entered (a parent
+ * is always before its children). Repeated calls of the same scope
+ * under the same parent are merged in the same node.
+ */
+class RTABMAP_EXP ProfileNode
+{
+public:
+	ProfileNode() :
+		parent(-1),
+		depth(0),
+		start(0.0),
+		time(0.0),
+		calls(0)
+	{}
+
+	std::string name;
+	int parent; // index of the parent node, -1 for root nodes
+	int depth;
+	double start; // time of the first call (s, see UTimer::now())
+	double time;  // total time of all calls (s)
+	int calls;
+};
+
+/**
+ * Hierarchical scoped timers. Profiling is done per thread: timers
+ * are recorded only on a thread between beginFrame() and endFrame(),
+ * otherwise a scoped timer costs a thread-local check. Example:
+ * @code
+ *      Profiler::beginFrame();
+ *      {
+ *          UPROFILE("Memory::update");
+ *          ...
+ *      }
+ *      std::vector<ProfileNode> tree = Profiler::endFrame();
+ * @endcode
+ */
+class RTABMAP_EXP Profiler
+{
+public:
+	/**
+	 * Start recording a new tree on the calling thread. An
+	 * unfinished tree on this thread is discarded.
+	 */
+	static void beginFrame();
+
+	/**
+	 * Stop recording on the calling thread and return the tree. Scopes
+	 * still opened are closed at the current time.
+	 */
+	static std::vector<ProfileNode> endFrame();
+
+	static bool isRecording();
+
+	/**
+	 * Use ScopedTimer (or UPROFILE) instead. The name should be
+	 * a string literal (it is compared by address first).
+	 * @return true if the scope is recorded, then pop() should be called.
+	 */
+	static bool push(const char * name);
+	static void pop();
+
+	/**
+	 * Convert the tree to Chrome trace events ("X" complete events, comma-terminated,
+	 * one per line). Merged calls are laid out one after the other inside
+	 * their parent, so their position in the trace is approximate.
+	 */
+	static std::string chromeTraceEvents(const std::vector<ProfileNode> & tree, int pid = 0, int tid = 0);
+
+	/**
+	 * Append the tree to a Chrome trace file (JSON array format, which doesn't need the
+	 * closing bracket). Open it with chrome://tracing or ui.perfetto.dev.
+	 */
+	static bool appendChromeTrace(const std::string & path, const std::vector<ProfileNode> & tree, int pid = 0, int tid = 0);
+};
+
+class ScopedTimer
+{
+public:
+	ScopedTimer(const char * name) : recorded_(Profiler::push(name)) {}
+	~ScopedTimer() {stop();}
+
+	void stop() {if(recorded_) {Profiler::pop(); recorded_ = false;}}
+	// Stop and start a new scope at the same level, for consecutive stages of a function.
+	void next(const char * name) {stop(); recorded_ = Profiler::push(name);}
+
+private:
+	bool recorded_;
+};
+
+// Record a frame for the current scope: the frame is ended when
+// leaving the scope if end() has not been called (e.g., early returns).
+class ScopedFrame
+{
+public:
+	ScopedFrame(bool enabled = true) : recording_(enabled) {if(recording_) Profiler::beginFrame();}
+	~ScopedFrame() {if(recording_) Profiler::endFrame();}
+
+	std::vector<ProfileNode> end()
+	{
+		if(recording_)
+		{
+			recording_ = false;
+			return Profiler::endFrame();
+		}
+		return std::vector<ProfileNode>();
+	}
+
+private:
+	bool recording_;
+};
+
+} /* namespace rtabmap */
+
+#define UPROFILE_CAT_(a, b) a ## b
+#define UPROFILE_CAT(a, b) UPROFILE_CAT_(a, b)
+#define UPROFILE(name) rtabmap::ScopedTimer UPROFILE_CAT(uprofileScope, __LINE__)(name)
+
+#endif /* PROFILER_H_ */
@@ -32,10 +32,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <rtabmap/core/Registration.h>
 #include <rtabmap/core/Signature.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/kdtree.h>
+#include <list>
+#include <map>
 
 namespace rtabmap {
 
 // Geometrical registration
+// Preprocessed scans (filtered clouds, normals and search trees) are kept in
+// a LRU cache (Icp/CacheSize), so an instance should not be shared between threads.
 class RTABMAP_EXP RegistrationIcp : public Registration
 {
 public:
@@ -45,6 +52,13 @@ public:
 
 	virtual void parseParameters(const ParametersMap & parameters);
 
+	void clearCache();
+	int getCacheSize() const {return (int)_cache.size();}
+	// cumulative statistics since the last clearCache()
+	int getCacheHits() const {return _cacheHits;}
+	int getCacheMisses() const {return _cacheMisses;}
+	double getCacheTimeSaved() const {return _cacheTimeSaved;}
+
 protected:
 	virtual Transform computeTransformationImpl(
 			Signature & from,
@@ -54,6 +68,29 @@ protected:
 	virtual bool isScanRequiredImpl() const {return true;}
 	virtual float getMinGeometryCorrespondencesRatioImpl() const {return _correspondenceRatio;}
 
+private:
+	// A laser scan preprocessed in its own frame
+	class PreprocessedScan
+	{
+	public:
+		PreprocessedScan() : time(0.0) {}
+		// trees are built on first use
+		const pcl::search::KdTree<pcl::PointXYZ>::Ptr & getTree();
+		const pcl::search::KdTree<pcl::PointXYZ>::Ptr & getFilteredTree();
+		const pcl::search::KdTree<pcl::PointNormal>::Ptr & getNormalsTree();
+
+		cv::Mat scan; // raw scan, keeps the data referenced so its address cannot be reused by another scan
+		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud; // downsampled
+		pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFiltered; // voxelized (same as cloud if Icp/VoxelSize=0)
+		pcl::PointCloud<pcl::PointNormal>::Ptr normals; // finite normals of cloudFiltered, only for point to plane
+		double time; // time used to preprocess the scan and to build the trees (s)
+	private:
+		pcl::search::KdTree<pcl::PointXYZ>::Ptr tree_;
+		pcl::search::KdTree<pcl::PointXYZ>::Ptr filteredTree_;
+		pcl::search::KdTree<pcl::PointNormal>::Ptr normalsTree_;
+	};
+	boost::shared_ptr<PreprocessedScan> preprocessScan(const cv::Mat & rawScan, const cv::Mat & scan, RegistrationInfo & info) const;
+
 private:
 	float _maxTranslation;
 	float _maxRotation;
@@ -65,6 +102,19 @@ private:
 	float _correspondenceRatio;
 	bool _pointToPlane;
 	int _pointToPlaneNormalNeighbors;
+	bool _correlative;
+	float _correlativeResolution;
+	float _correlativeLinearWindow;
+	float _correlativeAngularWindow;
+	float _correlativeMinScore;
+	int _cacheSize;
+
+	// LRU cache of preprocessed scans, most recently used first, indexed by raw scan data address
+	mutable std::list<boost::shared_ptr<PreprocessedScan> > _cache;
+	mutable std::map<const unsigned char *, std::list<boost::shared_ptr<PreprocessedScan> >::iterator> _cacheIndex;
+	mutable int _cacheHits;
+	mutable int _cacheMisses;
+	mutable double _cacheTimeSaved;
 };
 
 }
@@ -16,14 +16,19 @@ class RegistrationInfo
 public:
 	RegistrationInfo() :
 		variance(0),
+		totalTime(0),
 		inliers(0),
 		matches(0),
-		icpInliersRatio(0)
+		icpInliersRatio(0),
+		icpCacheHits(0),
+		icpCacheMisses(0),
+		icpCacheTimeSaved(0)
 	{
 	}
 
 	float variance;
 	std::string rejectedMsg;
+	double totalTime; // seconds (set by batch registrations, see Memory::computeTransforms())
 
 	// RegistrationVis
 	int inliers;
@@ -33,6 +38,9 @@ public:
 
 	// RegistrationIcp
 	float icpInliersRatio;
+	int icpCacheHits; // preprocessed scans found in the cache (0 to 2)
+	int icpCacheMisses;
+	double icpCacheTimeSaved; // preprocessing time of the scans found in the cache (s)
 };
 
 }
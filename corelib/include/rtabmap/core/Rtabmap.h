@@ -34,6 +34,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/SensorData.h"
 #include "rtabmap/core/Statistics.h"
 #include "rtabmap/core/Link.h"
+#include "rtabmap/core/PoseSpatialIndex.h"
+#include "rtabmap/core/DeadlineScheduler.h"
 
 #include <opencv2/core/core.hpp>
 #include <list>
@@ -48,6 +50,7 @@ class Memory;
 class BayesFilter;
 class Signature;
 class Optimizer;
+class StatisticsLogWriter;
 
 class RTABMAP_EXP Rtabmap
 {
@@ -150,7 +153,9 @@ private:
 			std::map<int, Transform> & optimizedPoses,
 			std::multimap<int, Link> * constraints = 0,
 			double * error = 0,
-			int * iterationsDone = 0) const;
+			int * iterationsDone = 0,
+			bool incremental = false,
+			bool * incrementalDone = 0) const;
 	std::map<int, Transform> optimizeGraph(
 			int fromId,
 			const std::set<int> & ids,
@@ -158,12 +163,16 @@ private:
 			bool lookInDatabase,
 			std::multimap<int, Link> * constraints = 0,
 			double * error = 0,
-			int * iterationsDone = 0) const;
+			int * iterationsDone = 0,
+			bool incremental = false,
+			bool * incrementalDone = 0) const;
 	void updateGoalIndex();
+	const PoseSpatialIndex & optimizedPosesIndex() const {return _optimizedPosesIndex;} // kept synchronized with _optimizedPoses
 	bool computePath(int targetNode, std::map<int, Transform> nodes, const std::multimap<int, rtabmap::Link> & constraints);
 
 	void setupLogFiles(bool overwrite = false);
 	void flushStatisticLogs();
+	void resetPublishedGraph();
 
 private:
 	// Modifiable parameters
@@ -171,6 +180,8 @@ private:
 	bool _publishLastSignatureData;
 	bool _publishPdf;
 	bool _publishLikelihood;
+	bool _publishStatsDelta;
+	int _publishStatsKeyFrame;
 	float _maxTimeAllowed; // in ms
 	unsigned int _maxMemoryAllowed; // signatures count in WM
 	float _loopThr;
@@ -181,6 +192,10 @@ private:
 	bool _statisticLogsBufferedInRAM;
 	bool _statisticLogged;
 	bool _statisticLoggedHeaders;
+	bool _statisticLogBinary;
+	bool _profiling;
+	bool _profilingTrace;
+	bool _deadlineScheduling;
 	bool _rgbdSlamMode;
 	float _rgbdLinearUpdate;
 	float _rgbdAngularUpdate;
@@ -196,8 +211,12 @@ private:
 	bool _proximityRawPosesUsed;
 	bool _proximityScansMerged;
 	float _proximityAngle;
+	bool _proximityParallel;
 	std::string _databasePath;
 	bool _optimizeFromGraphEnd;
+	bool _optimizeIncremental;
+	bool _optimizeHierarchical;
+	int _optimizeHierarchicalSegment;
 	float _optimizationMaxLinearError;
 	bool _startNewMapOnLoopClosure;
 	float _goalReachedRadius; // meters
@@ -225,12 +244,22 @@ private:
 	FILE* _foutInt;
 	std::list<std::string> _bufferedLogsF;
 	std::list<std::string> _bufferedLogsI;
+	StatisticsLogWriter * _statisticsLog;
 
 	Statistics statistics_;
 
+	// Last published graph (delta publication)
+	int _statsPublicationId;
+	int _statsLastKeyFrameId;
+	std::map<int, Transform> _publishedPoses;
+	std::multimap<int, Link> _publishedConstraints;
+	std::map<int, Signature> _publishedSignatures;
+
 	std::string _wDir;
 
 	std::map<int, Transform> _optimizedPoses;
+	PoseSpatialIndex _optimizedPosesIndex;
+	DeadlineScheduler _deadlineScheduler; // cost model of the process() stages
 	std::multimap<int, Link> _constraints;
 	Transform _mapCorrection;
 	Transform _lastLocalizationPose; // Corrected odometry pose. In mapping mode, this corresponds to last pose return by getLocalOptimizedPoses().
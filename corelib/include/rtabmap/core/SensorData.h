@@ -33,14 +33,22 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/CameraModel.h>
 #include <rtabmap/core/StereoCameraModel.h>
 #include <rtabmap/core/Transform.h>
+#include <rtabmap/core/ImagePyramidCache.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/features2d/features2d.hpp>
+#include <boost/shared_ptr.hpp>
 
 namespace rtabmap
 {
 
 /**
  * An id is automatically generated if id=0.
+ *
+ * Copies of a SensorData share the same buffers (images, laser scan, user data
+ * and features), so it can be passed between threads in events without deep
+ * copies. The buffers should be considered immutable: replace them with the setters,
+ * or use the *Mutable() accessors to modify them in place (copy-on-write: the
+ * buffer is copied only if it is shared). See getStatistics() to count the copies.
  */
 class RTABMAP_EXP SensorData
 {
@@ -128,6 +136,22 @@ public:
 
 	virtual ~SensorData() {}
 
+	/**
+	 * Counters for all SensorData of the process.
+	 * @param copies SensorData copies (buffers shared)
+	 * @param deepCopies buffers cloned by the *Mutable() accessors because they were shared
+	 * @param deepCopiesBytes total size of the buffers cloned
+	 * @param decompressions raw buffers allocated by uncompressData()
+	 * @param decompressionsBytes total size of the raw buffers decompressed
+	 */
+	static void getStatistics(
+			unsigned long & copies,
+			unsigned long & deepCopies,
+			unsigned long long & deepCopiesBytes,
+			unsigned long & decompressions,
+			unsigned long long & decompressionsBytes);
+	static void resetStatistics();
+
 	bool isValid() const {
 		return !(_id == 0 &&
 			_stamp == 0.0 &&
@@ -142,7 +166,7 @@ public:
 			!_stereoCameraModel.isValidForProjection() &&
 			_userDataRaw.empty() &&
 			_userDataCompressed.empty() &&
-			_keypoints.size() == 0 &&
+			keypoints().size() == 0 &&
 			_descriptors.empty());
 	}
 
@@ -160,17 +184,27 @@ public:
 	const cv::Mat & imageRaw() const {return _imageRaw;}
 	const cv::Mat & depthOrRightRaw() const {return _depthOrRightRaw;}
 	const cv::Mat & laserScanRaw() const {return _laserScanRaw;}
-	void setImageRaw(const cv::Mat & imageRaw) {_imageRaw = imageRaw;}
-	void setDepthOrRightRaw(const cv::Mat & depthOrImageRaw) {_depthOrRightRaw =depthOrImageRaw;}
+	void setImageRaw(const cv::Mat & imageRaw) {_imageRaw = imageRaw; _imagePyramid = cv::Ptr<ImagePyramidCache>();}
+	void setDepthOrRightRaw(const cv::Mat & depthOrImageRaw) {_depthOrRightRaw =depthOrImageRaw; _rightPyramid = cv::Ptr<ImagePyramidCache>();}
 	void setLaserScanRaw(const cv::Mat & laserScanRaw, int maxPts, float maxRange) {_laserScanRaw =laserScanRaw;_laserScanMaxPts = maxPts;_laserScanMaxRange=maxRange;}
 	void setCameraModel(const CameraModel & model) {_cameraModels.clear(); _cameraModels.push_back(model);}
 	void setCameraModels(const std::vector<CameraModel> & models) {_cameraModels = models;}
 	void setStereoCameraModel(const StereoCameraModel & stereoCameraModel) {_stereoCameraModel = stereoCameraModel;}
 
+	// Copy-on-write access to modify the raw buffers in place
+	cv::Mat & imageRawMutable();
+	cv::Mat & depthOrRightRawMutable();
+	cv::Mat & laserScanRawMutable();
+
 	//for convenience
 	cv::Mat depthRaw() const {return _depthOrRightRaw.type()!=CV_8UC1?_depthOrRightRaw:cv::Mat();}
 	cv::Mat rightRaw() const {return _depthOrRightRaw.type()==CV_8UC1?_depthOrRightRaw:cv::Mat();}
 
+	// Optical flow pyramids (see ImagePyramidCache) of imageRaw() and rightRaw(), built on first
+	// request and shared with the copies of this SensorData made afterwards.
+	std::vector<cv::Mat> imagePyramid(const cv::Size & winSize, int maxLevel) const;
+	std::vector<cv::Mat> rightPyramid(const cv::Size & winSize, int maxLevel) const;
+
 	void uncompressData();
 	void uncompressData(cv::Mat * imageRaw, cv::Mat * depthOrRightRaw, cv::Mat * laserScanRaw = 0, cv::Mat * userDataRaw = 0);
 	void uncompressDataConst(cv::Mat * imageRaw, cv::Mat * depthOrRightRaw, cv::Mat * laserScanRaw = 0, cv::Mat * userDataRaw = 0) const;
@@ -183,13 +217,12 @@ public:
 	const cv::Mat & userDataRaw() const {return _userDataRaw;}
 	const cv::Mat & userDataCompressed() const {return _userDataCompressed;}
 
-	void setFeatures(const std::vector<cv::KeyPoint> & keypoints, const cv::Mat & descriptors)
-	{
-		_keypoints = keypoints;
-		_descriptors = descriptors;
-	}
-	const std::vector<cv::KeyPoint> & keypoints() const {return _keypoints;}
+	void setFeatures(const std::vector<cv::KeyPoint> & keypoints, const cv::Mat & descriptors);
+	void setFeatures(const SensorData & data); // share the features of another SensorData
+	const std::vector<cv::KeyPoint> & keypoints() const;
 	const cv::Mat & descriptors() const {return _descriptors;}
+	std::vector<cv::KeyPoint> & keypointsMutable();
+	cv::Mat & descriptorsMutable();
 
 	void setGroundTruth(const Transform & pose) {groundTruth_ = pose;}
 	const Transform & groundTruth() const {return groundTruth_;}
@@ -215,11 +248,26 @@ private:
 	cv::Mat _userDataCompressed;      // compressed data
 	cv::Mat _userDataRaw;
 
-	// features
-	std::vector<cv::KeyPoint> _keypoints;
+	// features, shared between copies
+	boost::shared_ptr<std::vector<cv::KeyPoint> > _keypoints;
 	cv::Mat _descriptors;
 
 	Transform groundTruth_;
+
+	// cached pyramids
+	mutable cv::Ptr<ImagePyramidCache> _imagePyramid;
+	mutable cv::Ptr<ImagePyramidCache> _rightPyramid;
+
+	// counts the copies of SensorData (see getStatistics())
+	static void countCopy();
+	class CopyCounter
+	{
+	public:
+		CopyCounter() {}
+		CopyCounter(const CopyCounter &) {SensorData::countCopy();}
+		CopyCounter & operator=(const CopyCounter &) {SensorData::countCopy(); return *this;}
+	};
+	CopyCounter _copyCounter;
 };
 
 }
@@ -37,6 +37,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include <rtabmap/core/Signature.h>
 #include <rtabmap/core/Link.h>
+#include <rtabmap/core/Profiler.h>
 
 namespace rtabmap {
 
@@ -65,12 +66,15 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Loop, Optimization_max_error, m);
 	RTABMAP_STATS(Loop, Optimization_error, );
 	RTABMAP_STATS(Loop, Optimization_iterations, );
+	RTABMAP_STATS(Loop, Optimization_incremental, );
 
 	RTABMAP_STATS(Proximity, Time_detections,);
 	RTABMAP_STATS(Proximity, Space_last_detection_id,);
 	RTABMAP_STATS(Proximity, Space_paths,);
 	RTABMAP_STATS(Proximity, Space_detections_added_visually,);
 	RTABMAP_STATS(Proximity, Space_detections_added_icp_only,);
+	RTABMAP_STATS(Proximity, Space_candidates,);
+	RTABMAP_STATS(Proximity, Space_candidate_time, ms);
 
 	RTABMAP_STATS(NeighborLinkRefining, Accepted,);
 	RTABMAP_STATS(NeighborLinkRefining, Inliers,);
@@ -91,9 +95,23 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Memory, Rehearsal_id,);
 	RTABMAP_STATS(Memory, Rehearsal_merged,);
 	RTABMAP_STATS(Memory, Local_graph_size,);
+	RTABMAP_STATS(Memory, Published_poses,);
+	RTABMAP_STATS(Memory, Published_links,);
+	RTABMAP_STATS(Memory, Published_removed,);
+	RTABMAP_STATS(Memory, Sensor_data_copies,);
+	RTABMAP_STATS(Memory, Sensor_data_deep_copies,);
+	RTABMAP_STATS(Memory, Sensor_data_deep_copies_size, KB);
+	RTABMAP_STATS(Memory, Sensor_data_decompressions,);
+	RTABMAP_STATS(Memory, Sensor_data_decompressions_size, KB);
 	RTABMAP_STATS(Memory, Small_movement,);
 	RTABMAP_STATS(Memory, Distance_travelled, m);
 
+	RTABMAP_STATS(SpatialIndex, Nodes,);
+	RTABMAP_STATS(SpatialIndex, Cells,);
+	RTABMAP_STATS(SpatialIndex, Queries,);
+	RTABMAP_STATS(SpatialIndex, Queries_time, ms);
+	RTABMAP_STATS(SpatialIndex, Update_time, ms);
+
 	RTABMAP_STATS(Timing, Memory_update, ms);
 	RTABMAP_STATS(Timing, Neighbor_link_refining, ms);
 	RTABMAP_STATS(Timing, Proximity_by_time, ms);
@@ -113,6 +131,22 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Timing, Joining_trash, ms);
 	RTABMAP_STATS(Timing, Emptying_trash, ms);
 
+	RTABMAP_STATS(Deadline, Overruns,);
+	RTABMAP_STATS(Deadline, Late_frames,);
+	RTABMAP_STATS(Deadline, Skipped_proximity_by_time,);
+	RTABMAP_STATS(Deadline, Skipped_retrieval,);
+	RTABMAP_STATS(Deadline, Skipped_proximity_by_space,);
+	RTABMAP_STATS(Deadline, Memory_update_overruns,);
+	RTABMAP_STATS(Deadline, Proximity_by_time_overruns,);
+	RTABMAP_STATS(Deadline, Likelihood_overruns,);
+	RTABMAP_STATS(Deadline, Retrieval_overruns,);
+	RTABMAP_STATS(Deadline, Add_loop_closure_link_overruns,);
+	RTABMAP_STATS(Deadline, Proximity_by_space_overruns,);
+	RTABMAP_STATS(Deadline, Map_optimization_overruns,);
+	RTABMAP_STATS(Deadline, Statistics_overruns,);
+	RTABMAP_STATS(Deadline, Memory_cleanup_overruns,);
+	RTABMAP_STATS(Deadline, Transfer_overruns,);
+
 	RTABMAP_STATS(TimingMem, Pre_update, ms);
 	RTABMAP_STATS(TimingMem, Signature_creation, ms);
 	RTABMAP_STATS(TimingMem, Rehearsal, ms);
@@ -160,6 +194,15 @@ public:
 	void setCurrentGoalId(int goal) {_currentGoalId=goal;}
 	void setReducedIds(const std::map<int, int> & reducedIds) {_reducedIds = reducedIds;}
 
+	// Delta publication (see Rtabmap/PublishStatsDelta and StatisticsAccumulator)
+	void setPublicationId(int id) {_publicationId = id;}
+	void setDeltaBaseId(int id) {_deltaBaseId = id;}
+	void setRemovedPoses(const std::vector<int> & removedPoses) {_removedPoses = removedPoses;}
+	void setRemovedConstraints(const std::multimap<int, Link> & removedConstraints) {_removedConstraints = removedConstraints;}
+
+	// Timing tree of the frame (see Rtabmap/Profiling)
+	void setProfile(const std::vector<ProfileNode> & profile) {_profile = profile;}
+
 	// getters
 	bool extended() const {return _extended;}
 	int refImageId() const {return _refImageId;}
@@ -180,6 +223,15 @@ public:
 	int currentGoalId() const {return _currentGoalId;}
 	const std::map<int, int> & reducedIds() const {return _reducedIds;}
 
+	int publicationId() const {return _publicationId;}
+	// If >0, poses, constraints and signatures only contain what changed since publication deltaBaseId
+	int deltaBaseId() const {return _deltaBaseId;}
+	bool isDelta() const {return _deltaBaseId > 0;}
+	const std::vector<int> & removedPoses() const {return _removedPoses;}
+	const std::multimap<int, Link> & removedConstraints() const {return _removedConstraints;} // <from, link>, only end points and type are relevant
+
+	const std::vector<ProfileNode> & profile() const {return _profile;}
+
 	const std::map<std::string, float> & data() const {return _data;}
 
 private:
@@ -206,6 +258,13 @@ private:
 
 	std::map<int, int> _reducedIds;
 
+	int _publicationId;
+	int _deltaBaseId;
+	std::vector<int> _removedPoses;
+	std::multimap<int, Link> _removedConstraints;
+
+	std::vector<ProfileNode> _profile;
+
 	// Format for statistics (Plottable statistics must go in that map) :
 	// {"Group/Name/Unit", value}
 	// Example : {"Timing/Total time/ms", 500.0f}
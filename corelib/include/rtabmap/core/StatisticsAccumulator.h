@@ -0,0 +1,82 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef STATISTICSACCUMULATOR_H_
+#define STATISTICSACCUMULATOR_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Statistics.h>
+#include <map>
+
+namespace rtabmap {
+
+/**
+ * Consumer side of the delta publication of statistics (Rtabmap/PublishStatsDelta).
+ * Feed all received statistics in order to update(): keyframes (and statistics
+ * not delta-encoded) replace the graph, deltas are applied over it. If a delta
+ * is not based on the last publication received (e.g., an event has been dropped),
+ * the graph is invalid until the next keyframe.
+ *
+ * Signatures kept are only the node information (map id, weight, label, stamp, poses)
+ * of the nodes in the graph, sensor data of the received signatures is not accumulated.
+ */
+class RTABMAP_EXP StatisticsAccumulator
+{
+public:
+	StatisticsAccumulator();
+	virtual ~StatisticsAccumulator() {}
+
+	/**
+	 * @return true if the graph is valid after the update.
+	 */
+	bool update(const Statistics & stats);
+	void clear();
+
+	bool isValid() const {return valid_;}
+	int lastPublicationId() const {return lastPublicationId_;}
+	int deltasMissed() const {return deltasMissed_;}
+
+	const std::map<int, Transform> & poses() const {return poses_;}
+	const std::multimap<int, Link> & constraints() const {return constraints_;}
+	const std::map<int, Signature> & signatures() const {return signatures_;}
+
+private:
+	void removeConstraint(const Link & link); // same end points and type
+
+private:
+	bool valid_;
+	int lastPublicationId_;
+	int deltasMissed_;
+	std::map<int, Transform> poses_;
+	std::multimap<int, Link> constraints_;
+	std::map<int, Signature> signatures_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* STATISTICSACCUMULATOR_H_ */
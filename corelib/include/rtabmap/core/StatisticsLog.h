@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef STATISTICSLOG_H_
+#define STATISTICSLOG_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Statistics.h>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+namespace rtabmap {
+
+/**
+ * Binary columnar log of the statistics (Rtabmap/StatisticLogBinary).
+ *
+ * The schema is fixed when the file is created: one float column per key of
+ * Statistics::defaultData(), plus the node id and the stamp of each row. Rows are
+ * appended per processed frame and written in blocks, each block storing its
+ * columns contiguously:
+ *
+ *   header: "RTABSTAT", uint32 version, uint32 columns, uint32 header size, uint32 0,
+ *           column names (null-terminated), padding to 8 bytes
+ *   block:  uint32 marker, uint32 rows, double stamps[rows], int ids[rows],
+ *           float values[columns][rows], padding to 8 bytes
+ *
+ * Values missing from a frame are NaN. Statistics not in the default data are not logged.
+ */
+class RTABMAP_EXP StatisticsLogWriter
+{
+public:
+	StatisticsLogWriter();
+	virtual ~StatisticsLogWriter();
+
+	/**
+	 * Open the log. When append is true and the file already exists with the same
+	 * schema, new rows are added at its end, otherwise the file is overwritten.
+	 * Rows are written to the file every rowsPerBlock frames (and on flush()/close()).
+	 */
+	bool open(const std::string & path, bool append = true, int rowsPerBlock = 1024);
+	void close();
+	bool isOpen() const {return file_ != 0;}
+
+	void append(const Statistics & stats, double stamp);
+	void flush();
+
+	const std::vector<std::string> & columns() const {return columns_;}
+	int bufferedRows() const {return (int)stamps_.size();}
+
+private:
+	FILE * file_;
+	int rowsPerBlock_;
+	std::vector<std::string> columns_;
+	std::vector<double> stamps_;
+	std::vector<int> ids_;
+	std::vector<float> values_; // column-major, rowsPerBlock_ values per column
+};
+
+/**
+ * Memory-mapped reader of the files written by StatisticsLogWriter. Columns are
+ * read directly from the mapped blocks, a truncated last block (e.g., after a crash)
+ * is ignored.
+ */
+class RTABMAP_EXP StatisticsLogReader
+{
+public:
+	StatisticsLogReader();
+	virtual ~StatisticsLogReader();
+
+	bool open(const std::string & path);
+	void close();
+	bool isOpen() const {return data_ != 0;}
+
+	const std::vector<std::string> & columns() const {return columns_;}
+	int columnIndex(const std::string & name) const; // -1 if not found
+	size_t rows() const {return rows_;}
+
+	std::vector<double> stamps() const;
+	std::vector<int> ids() const;
+	std::vector<float> column(int index) const;
+
+	/**
+	 * Column decimated for plotting: if there are more than maxSamples rows, the rows
+	 * are split in maxSamples/2 buckets for which the minimum and maximum values (with
+	 * their node ids as x) are kept in order, so spikes stay visible.
+	 */
+	void column(int index, std::vector<float> & x, std::vector<float> & y, size_t maxSamples) const;
+
+private:
+	struct Block
+	{
+		const unsigned char * stamps;
+		const unsigned char * ids;
+		const unsigned char * values;
+		size_t rows;
+	};
+	friend class StatisticsLogWriter; // to append after the last valid block
+
+private:
+	const unsigned char * data_;
+	size_t size_;
+#ifdef _WIN32
+	void * file_;
+	void * mapping_;
+#endif
+	std::vector<std::string> columns_;
+	std::vector<Block> blocks_;
+	size_t rows_;
+	size_t end_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* STATISTICSLOG_H_ */
@@ -31,6 +31,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
 
 #include <rtabmap/core/Parameters.h>
+#include <rtabmap/core/SensorData.h>
 #include <opencv2/core/core.hpp>
 
 namespace rtabmap {
@@ -49,6 +50,11 @@ public:
 			const cv::Mat & rightImage,
 			const std::vector<cv::Point2f> & leftCorners,
 			std::vector<unsigned char> & status) const;
+	// Stereo images are taken from data (left is converted to gray if needed)
+	virtual std::vector<cv::Point2f> computeCorrespondences(
+			const SensorData & data,
+			const std::vector<cv::Point2f> & leftCorners,
+			std::vector<unsigned char> & status) const;
 
 	cv::Size winSize() const {return cv::Size(winWidth_, winHeight_);}
 	int iterations() const   {return iterations_;}
@@ -78,9 +84,21 @@ public:
 			const cv::Mat & rightImage,
 			const std::vector<cv::Point2f> & leftCorners,
 			std::vector<unsigned char> & status) const;
+	// Use the cached pyramids of data
+	virtual std::vector<cv::Point2f> computeCorrespondences(
+			const SensorData & data,
+			const std::vector<cv::Point2f> & leftCorners,
+			std::vector<unsigned char> & status) const;
 
 	float epsilon() const {return epsilon_;}
 
+private:
+	std::vector<cv::Point2f> computeCorrespondencesImpl(
+			cv::InputArray leftImage,
+			cv::InputArray rightImage,
+			const std::vector<cv::Point2f> & leftCorners,
+			std::vector<unsigned char> & status) const;
+
 private:
 	float epsilon_;
 };
@@ -0,0 +1,180 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef VOXELOCCUPANCYMAP_H_
+#define VOXELOCCUPANCYMAP_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Transform.h>
+#include <opencv2/core/core.hpp>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <map>
+#include <deque>
+#include <vector>
+
+namespace rtabmap {
+
+class SensorData;
+
+/**
+ * Sparse 3D occupancy map. Voxels are stored by blocks of 8x8x8 in a hash
+ * table, so memory is only used where something was observed. Each voxel
+ * accumulates log-odds of the rays (free space) and end points (obstacles)
+ * of the nodes' clouds.
+ *
+ * Nodes are added with their local cloud (see util3d::cloudFromSensorData())
+ * and integrated on update() with their current pose. When a node moves (e.g.,
+ * after a graph optimization), its contribution at the old pose is subtracted and
+ * it is integrated again at the new pose. To keep this exact, log-odds are
+ * accumulated without clamping and clamped only when read.
+ *
+ * Queries can be done at coarser resolutions (level l = cubes of 2^l voxels),
+ * returning the most occupied voxel of the cube.
+ */
+class RTABMAP_EXP VoxelOccupancyMap
+{
+public:
+	VoxelOccupancyMap(
+			float voxelSize = 0.05f,
+			float maxRange = 0.0f, // rays longer than this are truncated and only cleared, 0=inf
+			float probHit = 0.7f,
+			float probMiss = 0.4f,
+			float probClampingMin = 0.1192f,
+			float probClampingMax = 0.971f);
+	virtual ~VoxelOccupancyMap() {}
+
+	void clear();
+
+	/**
+	 * Set the local data of a node. It is integrated on the next update().
+	 * @param cloud points in the node frame
+	 * @param sensorOrigin position of the sensor in the node frame
+	 */
+	void addNode(
+			int id,
+			const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud,
+			const Transform & sensorOrigin = Transform::getIdentity());
+	// Cloud created with util3d::cloudFromSensorData(), sensor origin from the camera local transform.
+	void addNode(
+			int id,
+			const SensorData & data,
+			int decimation = 4,
+			float maxDepth = 4.0f);
+	// Remove the node and its contribution to the map
+	void removeNode(int id);
+
+	/**
+	 * Integrate nodes added since the last update, remove nodes not in poses anymore
+	 * and integrate again nodes that moved more than the update thresholds.
+	 * @return the number of nodes integrated
+	 */
+	int update(const std::map<int, Transform> & poses);
+	void setUpdateThresholds(float linearUpdate, float angularUpdate);
+
+	/**
+	 * Occupancy probability at this position, -1 if unknown. If level>0, the maximum
+	 * of the cube of 2^level voxels containing the position is returned.
+	 */
+	float getOccupancy(float x, float y, float z, int level = 0) const;
+
+	// Voxel centers of occupied voxels
+	pcl::PointCloud<pcl::PointXYZ>::Ptr getOccupiedCloud(float occupancyThr = 0.5f) const;
+
+	/**
+	 * Project voxels between minHeight and maxHeight in the 2D grid format of
+	 * util3d::create2DMap(): CV_8S, -1=unknown, 0=empty, 100=obstacle (if at
+	 * least one occupied voxel in the column), xMin and yMin are the corner of the first cell.
+	 */
+	cv::Mat to2DMap(float & xMin, float & yMin, float minHeight, float maxHeight, float occupancyThr = 0.5f) const;
+
+	float getVoxelSize() const {return voxelSize_;}
+	int getNodes() const {return (int)nodes_.size();}
+	int getBlocks() const {return (int)blocks_.size();}
+	unsigned long getMemoryUsage() const; // bytes
+
+	// statistics of the last update()
+	int getLastIntegrated() const {return lastIntegrated_;}
+	int getLastRemoved() const {return lastRemoved_;}
+	int getLastVoxelUpdates() const {return lastVoxelUpdates_;}
+	double getLastUpdateTime() const {return lastUpdateTime_;}
+
+private:
+	struct Voxel
+	{
+		int logOdds; // fixed-point, not clamped
+		int observations;
+	};
+	struct Block
+	{
+		Block(int x, int y, int z);
+		int x, y, z; // block coordinates
+		Voxel voxels[512];
+		// cached for coarse queries, valid if !dirty
+		mutable int maxLogOdds; // of the observed voxels
+		mutable bool observed; // at least one voxel observed
+		mutable bool dirty;
+	};
+	struct Node
+	{
+		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+		Transform sensorOrigin;
+		Transform pose; // pose at which it is integrated, null if not integrated
+	};
+
+	int integrate(const Node & node, const Transform & pose, int sign);
+	const Block * findBlock(int x, int y, int z) const;
+	Block * getBlock(int x, int y, int z);
+	void rehash(int size);
+	int clamp(int logOdds) const;
+	bool blockMax(const Block & block, int & maxLogOdds) const;
+	float probability(int logOdds) const;
+
+private:
+	float voxelSize_;
+	float maxRange_;
+	float linearUpdate_;
+	float angularUpdate_;
+	int hit_;
+	int miss_;
+	int clampingMin_;
+	int clampingMax_;
+
+	std::map<int, Node> nodes_;
+	std::deque<Block> blocks_; // deque: no copy of the blocks when growing
+	std::vector<int> table_; // open addressing, index in blocks_ or -1
+
+	int lastIntegrated_;
+	int lastRemoved_;
+	int lastVoxelUpdates_;
+	double lastUpdateTime_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* VOXELOCCUPANCYMAP_H_ */
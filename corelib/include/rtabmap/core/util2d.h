@@ -112,22 +112,30 @@ cv::Mat RTABMAP_EXP decimate(const cv::Mat & image, int d);
 cv::Mat RTABMAP_EXP interpolate(const cv::Mat & image, int factor, float depthErrorRatio = 0.02f);
 
 // Registration Depth to RGB (return registered depth image)
+// parallel: use the multi-threaded z-buffer version (same result as the serial
+//           version, except that null depth values are never projected)
 cv::Mat RTABMAP_EXP registerDepth(
 		const cv::Mat & depth,
 		const cv::Mat & depthK,
 		const cv::Mat & colorK,
-		const rtabmap::Transform & transform);
+		const rtabmap::Transform & transform,
+		bool parallel = true);
 
+// parallel: use the multi-threaded version (same result as the serial version)
 cv::Mat RTABMAP_EXP fillDepthHoles(
 		const cv::Mat & depth,
 		int maximumHoleSize = 1,
-		float errorRatio = 0.02f);
+		float errorRatio = 0.02f,
+		bool parallel = true);
 
+// parallel: use the multi-threaded version (same result as the serial version),
+//           only when one of vertical or horizontal is set
 void RTABMAP_EXP fillRegisteredDepthHoles(
 		cv::Mat & depthRegistered,
 		bool vertical,
 		bool horizontal,
-		bool fillDoubleHoles = false);
+		bool fillDoubleHoles = false,
+		bool parallel = true);
 
 } // namespace util3d
 } // namespace rtabmap
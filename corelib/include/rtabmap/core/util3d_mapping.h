@@ -60,6 +60,8 @@ cv::Mat RTABMAP_EXP create2DMapFromOccupancyLocalMaps(
 		float minMapSize = 0.0f,
 		bool erode = false);
 
+cv::Mat RTABMAP_EXP filter2DMap(const cv::Mat & map8S, bool erode = false);
+
 cv::Mat RTABMAP_EXP create2DMap(const std::map<int, Transform> & poses,
 		const std::map<int, pcl::PointCloud<pcl::PointXYZ>::Ptr > & scans,
 		float cellSize,
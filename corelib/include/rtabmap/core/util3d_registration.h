@@ -32,6 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
+#include <pcl/search/kdtree.h>
 #include <rtabmap/core/Transform.h>
 #include <opencv2/core/core.hpp>
 
@@ -64,13 +65,15 @@ void RTABMAP_EXP computeVarianceAndCorrespondences(
 		const pcl::PointCloud<pcl::PointNormal>::ConstPtr & cloudB,
 		double maxCorrespondenceDistance,
 		double & variance,
-		int & correspondencesOut);
+		int & correspondencesOut,
+		const pcl::search::KdTree<pcl::PointNormal>::Ptr & treeB = pcl::search::KdTree<pcl::PointNormal>::Ptr()); // optional, already built on cloudB
 void RTABMAP_EXP computeVarianceAndCorrespondences(
 		const pcl::PointCloud<pcl::PointXYZ>::ConstPtr & cloudA,
 		const pcl::PointCloud<pcl::PointXYZ>::ConstPtr & cloudB,
 		double maxCorrespondenceDistance,
 		double & variance,
-		int & correspondencesOut);
+		int & correspondencesOut,
+		const pcl::search::KdTree<pcl::PointXYZ>::Ptr & treeB = pcl::search::KdTree<pcl::PointXYZ>::Ptr()); // optional, already built on cloudB
 
 Transform RTABMAP_EXP icp(
 		const pcl::PointCloud<pcl::PointXYZ>::ConstPtr & cloud_source,
@@ -80,7 +83,8 @@ Transform RTABMAP_EXP icp(
 		bool & hasConverged,
 		pcl::PointCloud<pcl::PointXYZ> & cloud_source_registered,
 		float epsilon = 0.0f,
-		bool icp2D = false);
+		bool icp2D = false,
+		const pcl::search::KdTree<pcl::PointXYZ>::Ptr & treeTarget = pcl::search::KdTree<pcl::PointXYZ>::Ptr()); // optional, already built on cloud_target
 
 Transform RTABMAP_EXP icpPointToPlane(
 		const pcl::PointCloud<pcl::PointNormal>::ConstPtr & cloud_source,
@@ -90,7 +94,8 @@ Transform RTABMAP_EXP icpPointToPlane(
 		bool & hasConverged,
 		pcl::PointCloud<pcl::PointNormal> & cloud_source_registered,
 		float epsilon = 0.0f,
-		bool icp2D = false);
+		bool icp2D = false,
+		const pcl::search::KdTree<pcl::PointNormal>::Ptr & treeTarget = pcl::search::KdTree<pcl::PointNormal>::Ptr()); // optional, already built on cloud_target
 
 pcl::PointCloud<pcl::PointXYZ>::Ptr RTABMAP_EXP getICPReadyCloud(
 		const cv::Mat & depth,
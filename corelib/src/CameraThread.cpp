@@ -127,9 +127,9 @@ void CameraThread::mainLoop()
 		{
 			UDEBUG("");
 			UTimer timer;
-			cv::Mat tmpRgb;
-			cv::flip(data.imageRaw(), tmpRgb, 1);
-			data.setImageRaw(tmpRgb);
+			// in place, the image is copied only if the camera still shares it
+			cv::Mat & rgb = data.imageRawMutable();
+			cv::flip(rgb, rgb, 1);
 			UASSERT_MSG(data.cameraModels().size() <= 1 && !data.stereoCameraModel().isValidForProjection(), "Only single RGBD cameras are supported for mirroring.");
 			if(data.cameraModels().size() && data.cameraModels()[0].cx())
 			{
@@ -143,9 +143,8 @@ void CameraThread::mainLoop()
 			}
 			if(!data.depthRaw().empty())
 			{
-				cv::Mat tmpDepth;
-				cv::flip(data.depthRaw(), tmpDepth, 1);
-				data.setDepthOrRightRaw(tmpDepth);
+				cv::Mat & depth = data.depthOrRightRawMutable();
+				cv::flip(depth, depth, 1);
 			}
 			info.timeMirroring = timer.ticks();
 		}
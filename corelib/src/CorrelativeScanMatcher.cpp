@@ -0,0 +1,288 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/CorrelativeScanMatcher.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UMath.h>
+#include <algorithm>
+#include <limits>
+
+namespace rtabmap {
+
+static const int g_kernelRadius = 2; // cells, gaussian smoothing of the hits (sigma = 1 cell)
+
+CorrelativeScanMatcher::CorrelativeScanMatcher(
+		float resolution,
+		float linearWindow,
+		float angularWindow) :
+	resolution_(resolution),
+	linearWindow_(linearWindow),
+	angularWindow_(angularWindow),
+	levels_(1),
+	window_(0),
+	lastAngles_(0),
+	lastCandidatesScored_(0),
+	lastMatchTime_(0.0)
+{
+	UASSERT(resolution_ > 0.0f);
+	UASSERT(linearWindow_ >= 0.0f);
+	UASSERT(angularWindow_ >= 0.0f && angularWindow_ <= M_PI);
+
+	// enough levels so that a few blocks of the coarsest level cover the linear window
+	int windowCells = (int)ceil(linearWindow_/resolution_);
+	while((1<<(levels_-1)) < windowCells && levels_ < 10)
+	{
+		++levels_;
+	}
+}
+
+void CorrelativeScanMatcher::setReference(const cv::Mat & scan)
+{
+	UASSERT(scan.empty() || scan.type() == CV_32FC2 || scan.type() == CV_32FC3);
+	grids_.clear();
+	if(scan.empty())
+	{
+		return;
+	}
+
+	UTimer timer;
+	const float * ptr = scan.ptr<float>();
+	int channels = scan.channels();
+	cv::Point2i minCell(std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+	cv::Point2i maxCell(std::numeric_limits<int>::min(), std::numeric_limits<int>::min());
+	std::vector<cv::Point2i> cells(scan.cols);
+	for(int i=0; i<scan.cols; ++i)
+	{
+		cells[i].x = (int)floor(ptr[i*channels]/resolution_);
+		cells[i].y = (int)floor(ptr[i*channels+1]/resolution_);
+		minCell.x = std::min(minCell.x, cells[i].x);
+		minCell.y = std::min(minCell.y, cells[i].y);
+		maxCell.x = std::max(maxCell.x, cells[i].x);
+		maxCell.y = std::max(maxCell.y, cells[i].y);
+	}
+
+	// Padding on the low side for the coarse levels: a block starting up to
+	// 2^(levels-1)-1 cells before the first cell still covers it.
+	int padding = (1<<(levels_-1)) - 1;
+	origin_ = cv::Point2i(minCell.x - g_kernelRadius - padding, minCell.y - g_kernelRadius - padding);
+	cv::Mat grid = cv::Mat::zeros(maxCell.y - origin_.y + g_kernelRadius + 1, maxCell.x - origin_.x + g_kernelRadius + 1, CV_8UC1);
+
+	unsigned char kernel[2*g_kernelRadius+1][2*g_kernelRadius+1];
+	for(int dy=-g_kernelRadius; dy<=g_kernelRadius; ++dy)
+	{
+		for(int dx=-g_kernelRadius; dx<=g_kernelRadius; ++dx)
+		{
+			kernel[dy+g_kernelRadius][dx+g_kernelRadius] = (unsigned char)(255.0f*exp(-0.5f*float(dx*dx+dy*dy)) + 0.5f);
+		}
+	}
+	for(unsigned int i=0; i<cells.size(); ++i)
+	{
+		int cx = cells[i].x - origin_.x;
+		int cy = cells[i].y - origin_.y;
+		for(int dy=-g_kernelRadius; dy<=g_kernelRadius; ++dy)
+		{
+			unsigned char * row = grid.ptr<unsigned char>(cy+dy);
+			for(int dx=-g_kernelRadius; dx<=g_kernelRadius; ++dx)
+			{
+				row[cx+dx] = std::max(row[cx+dx], kernel[dy+g_kernelRadius][dx+g_kernelRadius]);
+			}
+		}
+	}
+	grids_.push_back(grid);
+
+	// level h = max of two blocks of level h-1 in x, then in y
+	for(int h=1; h<levels_; ++h)
+	{
+		const cv::Mat & previous = grids_.back();
+		int s = 1<<(h-1);
+		cv::Mat tmp = previous.clone();
+		if(s < previous.cols)
+		{
+			cv::max(previous.colRange(0, previous.cols-s), previous.colRange(s, previous.cols), tmp.colRange(0, previous.cols-s));
+		}
+		cv::Mat level = tmp.clone();
+		if(s < previous.rows)
+		{
+			cv::max(tmp.rowRange(0, tmp.rows-s), tmp.rowRange(s, tmp.rows), level.rowRange(0, tmp.rows-s));
+		}
+		grids_.push_back(level);
+	}
+	UDEBUG("Reference %d points, grid %dx%d, %d levels (%fs)", scan.cols, grid.cols, grid.rows, levels_, timer.ticks());
+}
+
+float CorrelativeScanMatcher::computeScore(const std::vector<cv::Point2i> & cells, int level, int ox, int oy) const
+{
+	const cv::Mat & grid = grids_[level];
+	int sum = 0;
+	for(unsigned int i=0; i<cells.size(); ++i)
+	{
+		int x = cells[i].x + ox;
+		int y = cells[i].y + oy;
+		if(x >= 0 && y >= 0 && x < grid.cols && y < grid.rows)
+		{
+			sum += grid.at<unsigned char>(y, x);
+		}
+	}
+	return float(sum) / float(255*cells.size());
+}
+
+void CorrelativeScanMatcher::branchAndBound(std::vector<Candidate> & candidates, int level, Candidate & best)
+{
+	std::sort(candidates.begin(), candidates.end());
+	for(unsigned int i=0; i<candidates.size(); ++i)
+	{
+		const Candidate & c = candidates[i];
+		if(c.score <= best.score)
+		{
+			// this and the next ones cannot be better
+			break;
+		}
+		if(level == 0)
+		{
+			best = c;
+		}
+		else
+		{
+			int s = 1<<(level-1);
+			std::vector<Candidate> children;
+			children.reserve(4);
+			for(int dy=0; dy<=s; dy+=s)
+			{
+				for(int dx=0; dx<=s; dx+=s)
+				{
+					if(c.ox+dx <= window_ && c.oy+dy <= window_)
+					{
+						children.push_back(Candidate(c.angle, c.ox+dx, c.oy+dy,
+								computeScore(rotatedCells_[c.angle], level-1, c.ox+dx, c.oy+dy)));
+					}
+				}
+			}
+			lastCandidatesScored_ += (int)children.size();
+			branchAndBound(children, level-1, best);
+		}
+	}
+}
+
+Transform CorrelativeScanMatcher::match(const cv::Mat & scan, const Transform & guess, float minScore, float * score)
+{
+	UASSERT(scan.empty() || scan.type() == CV_32FC2 || scan.type() == CV_32FC3);
+	UASSERT(!guess.isNull());
+	UTimer timer;
+	lastAngles_ = 0;
+	lastCandidatesScored_ = 0;
+	if(score)
+	{
+		*score = 0.0f;
+	}
+	if(grids_.empty() || scan.empty())
+	{
+		UWARN("Reference or scan empty! (reference levels=%d scan=%d)", (int)grids_.size(), scan.cols);
+		lastMatchTime_ = timer.ticks();
+		return Transform();
+	}
+
+	float x,y,z,roll,pitch,yaw;
+	guess.getTranslationAndEulerAngles(x,y,z,roll,pitch,yaw);
+
+	const float * ptr = scan.ptr<float>();
+	int channels = scan.channels();
+	float maxRangeSqr = 0.0f;
+	for(int i=0; i<scan.cols; ++i)
+	{
+		maxRangeSqr = std::max(maxRangeSqr, ptr[i*channels]*ptr[i*channels] + ptr[i*channels+1]*ptr[i*channels+1]);
+	}
+	float maxRange = sqrt(maxRangeSqr);
+	float angularStep = angularWindow_;
+	if(maxRange > resolution_)
+	{
+		// the farthest point moves by about one cell
+		angularStep = std::min(angularWindow_, (float)acos(1.0f - resolution_*resolution_/(2.0f*maxRange*maxRange)));
+	}
+	int angles = angularStep>0.0f?(int)ceil(angularWindow_/angularStep):0;
+	window_ = (int)ceil(linearWindow_/resolution_);
+
+	// discretized points for each rotation
+	rotatedCells_.resize(2*angles+1);
+	for(int a=-angles; a<=angles; ++a)
+	{
+		float theta = yaw + float(a)*angularStep;
+		float c = cos(theta);
+		float s = sin(theta);
+		std::vector<cv::Point2i> & cells = rotatedCells_[a+angles];
+		cells.resize(scan.cols);
+		for(int i=0; i<scan.cols; ++i)
+		{
+			float px = ptr[i*channels];
+			float py = ptr[i*channels+1];
+			cells[i].x = (int)floor((c*px - s*py + x)/resolution_) - origin_.x;
+			cells[i].y = (int)floor((s*px + c*py + y)/resolution_) - origin_.y;
+		}
+	}
+	lastAngles_ = (int)rotatedCells_.size();
+
+	// candidates at the coarsest level covering the whole window
+	int top = (int)grids_.size()-1;
+	int step = 1<<top;
+	std::vector<Candidate> candidates;
+	for(unsigned int a=0; a<rotatedCells_.size(); ++a)
+	{
+		for(int oy=-window_; oy<=window_; oy+=step)
+		{
+			for(int ox=-window_; ox<=window_; ox+=step)
+			{
+				candidates.push_back(Candidate(a, ox, oy, computeScore(rotatedCells_[a], top, ox, oy)));
+			}
+		}
+	}
+	lastCandidatesScored_ = (int)candidates.size();
+
+	Candidate best(-1, 0, 0, minScore);
+	branchAndBound(candidates, top, best);
+
+	Transform t;
+	if(best.angle >= 0)
+	{
+		t = Transform(
+				x + float(best.ox)*resolution_,
+				y + float(best.oy)*resolution_,
+				z,
+				roll,
+				pitch,
+				yaw + float(best.angle-angles)*angularStep);
+		if(score)
+		{
+			*score = best.score;
+		}
+	}
+	lastMatchTime_ = timer.ticks();
+	UDEBUG("angles=%d window=%d cells, candidates scored=%d, best score=%f, t=%s (%fs)",
+			lastAngles_, window_, lastCandidatesScored_, best.score, t.prettyPrint().c_str(), lastMatchTime_);
+	return t;
+}
+
+} /* namespace rtabmap */
@@ -32,6 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/VWDictionary.h"
 #include "rtabmap/core/util3d.h"
 #include "rtabmap/core/Compression.h"
+#include "rtabmap/core/Profiler.h"
 #include "DatabaseSchema_sql.h"
 #include <set>
 
@@ -701,6 +702,7 @@ int DBDriverSqlite3::getTotalDictionarySizeQuery() const
 
 void DBDriverSqlite3::loadNodeDataQuery(std::list<Signature *> & signatures) const
 {
+	UPROFILE("DBDriverSqlite3::loadNodeDataQuery");
 	UDEBUG("load data for %d signatures", (int)signatures.size());
 	if(_ppDb)
 	{
@@ -1017,6 +1019,7 @@ bool DBDriverSqlite3::getNodeInfoQuery(int signatureId,
 		double & stamp,
 		Transform & groundTruthPose) const
 {
+	UPROFILE("DBDriverSqlite3::getNodeInfoQuery");
 	bool found = false;
 	if(_ppDb && signatureId)
 	{
@@ -1145,6 +1148,7 @@ void DBDriverSqlite3::getAllNodeIdsQuery(std::set<int> & ids, bool ignoreChildre
 
 void DBDriverSqlite3::getAllLinksQuery(std::multimap<int, Link> & links, bool ignoreNullLinks) const
 {
+	UPROFILE("DBDriverSqlite3::getAllLinksQuery");
 	links.clear();
 	if(_ppDb)
 	{
@@ -1290,6 +1294,7 @@ void DBDriverSqlite3::getLastIdQuery(const std::string & tableName, int & id) co
 
 void DBDriverSqlite3::getInvertedIndexNiQuery(int nodeId, int & ni) const
 {
+	UPROFILE("DBDriverSqlite3::getInvertedIndexNiQuery");
 	ni = 0;
 	if(_ppDb)
 	{
@@ -1405,6 +1410,7 @@ void DBDriverSqlite3::getAllLabelsQuery(std::map<int, std::string> & labels) con
 
 void DBDriverSqlite3::getWeightQuery(int nodeId, int & weight) const
 {
+	UPROFILE("DBDriverSqlite3::getWeightQuery");
 	weight = 0;
 	if(_ppDb)
 	{
@@ -1440,6 +1446,7 @@ void DBDriverSqlite3::getWeightQuery(int nodeId, int & weight) const
 //may be slower than the previous version but don't have a limit of words that can be loaded at the same time
 void DBDriverSqlite3::loadSignaturesQuery(const std::list<int> & ids, std::list<Signature *> & nodes) const
 {
+	UPROFILE("DBDriverSqlite3::loadSignaturesQuery");
 	ULOGGER_DEBUG("count=%d", (int)ids.size());
 	if(_ppDb && ids.size())
 	{
@@ -1805,6 +1812,7 @@ void DBDriverSqlite3::loadSignaturesQuery(const std::list<int> & ids, std::list<
 
 void DBDriverSqlite3::loadLastNodesQuery(std::list<Signature *> & nodes) const
 {
+	UPROFILE("DBDriverSqlite3::loadLastNodesQuery");
 	ULOGGER_DEBUG("");
 	if(_ppDb)
 	{
@@ -1846,6 +1854,7 @@ void DBDriverSqlite3::loadLastNodesQuery(std::list<Signature *> & nodes) const
 
 void DBDriverSqlite3::loadQuery(VWDictionary * dictionary) const
 {
+	UPROFILE("DBDriverSqlite3::loadQuery");
 	ULOGGER_DEBUG("");
 	if(_ppDb && dictionary)
 	{
@@ -1930,6 +1939,7 @@ void DBDriverSqlite3::loadQuery(VWDictionary * dictionary) const
 //may be slower than the previous version but don't have a limit of words that can be loaded at the same time
 void DBDriverSqlite3::loadWordsQuery(const std::set<int> & wordIds, std::list<VisualWord *> & vws) const
 {
+	UPROFILE("DBDriverSqlite3::loadWordsQuery");
 	ULOGGER_DEBUG("size=%d", wordIds.size());
 	if(_ppDb && wordIds.size())
 	{
@@ -2026,6 +2036,7 @@ void DBDriverSqlite3::loadLinksQuery(
 		std::map<int, Link> & neighbors,
 		Link::Type typeIn) const
 {
+	UPROFILE("DBDriverSqlite3::loadLinksQuery");
 	neighbors.clear();
 	if(_ppDb)
 	{
@@ -2149,6 +2160,7 @@ void DBDriverSqlite3::loadLinksQuery(
 
 void DBDriverSqlite3::loadLinksQuery(std::list<Signature *> & signatures) const
 {
+	UPROFILE("DBDriverSqlite3::loadLinksQuery");
 	if(_ppDb)
 	{
 		UTimer timer;
@@ -2283,6 +2295,7 @@ void DBDriverSqlite3::loadLinksQuery(std::list<Signature *> & signatures) const
 
 void DBDriverSqlite3::updateQuery(const std::list<Signature *> & nodes, bool updateTimestamp) const
 {
+	UPROFILE("DBDriverSqlite3::updateQuery");
 	UDEBUG("nodes = %d", nodes.size());
 	if(_ppDb && nodes.size())
 	{
@@ -2426,6 +2439,7 @@ void DBDriverSqlite3::updateQuery(const std::list<Signature *> & nodes, bool upd
 
 void DBDriverSqlite3::updateQuery(const std::list<VisualWord *> & words, bool updateTimestamp) const
 {
+	UPROFILE("DBDriverSqlite3::updateQuery");
 	if(_ppDb && words.size() && updateTimestamp)
 	{
 		// Only timestamp update is done here, so don't enter this if at all if false
@@ -2466,6 +2480,7 @@ void DBDriverSqlite3::updateQuery(const std::list<VisualWord *> & words, bool up
 
 void DBDriverSqlite3::saveQuery(const std::list<Signature *> & signatures) const
 {
+	UPROFILE("DBDriverSqlite3::saveQuery");
 	UDEBUG("");
 	if(_ppDb && signatures.size())
 	{
@@ -2619,6 +2634,7 @@ void DBDriverSqlite3::saveQuery(const std::list<Signature *> & signatures) const
 
 void DBDriverSqlite3::saveQuery(const std::list<VisualWord *> & words) const
 {
+	UPROFILE("DBDriverSqlite3::saveQuery");
 	UDEBUG("visualWords size=%d", words.size());
 	if(_ppDb)
 	{
@@ -2676,6 +2692,7 @@ void DBDriverSqlite3::saveQuery(const std::list<VisualWord *> & words) const
 
 void DBDriverSqlite3::addLinkQuery(const Link & link) const
 {
+	UPROFILE("DBDriverSqlite3::addLinkQuery");
 	UDEBUG("");
 	if(_ppDb)
 	{
@@ -2704,6 +2721,7 @@ void DBDriverSqlite3::addLinkQuery(const Link & link) const
 
 void DBDriverSqlite3::updateLinkQuery(const Link & link) const
 {
+	UPROFILE("DBDriverSqlite3::updateLinkQuery");
 	UDEBUG("");
 	if(_ppDb)
 	{
@@ -0,0 +1,226 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/DeadlineScheduler.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <cmath>
+
+namespace rtabmap {
+
+const char * DeadlineScheduler::stageName(Stage stage)
+{
+	static const char * names[kStageCount] = {
+			"Memory update",
+			"Proximity by time",
+			"Likelihood",
+			"Retrieval",
+			"Add loop closure link",
+			"Proximity by space",
+			"Map optimization",
+			"Statistics",
+			"Memory cleanup",
+			"Transfer"};
+	UASSERT(stage >= 0 && stage < kStageCount);
+	return names[stage];
+}
+
+DeadlineScheduler::DeadlineScheduler(float smoothing) :
+	smoothing_(0.2f),
+	deadline_(0.0),
+	frameStart_(0.0),
+	stageStart_(0.0),
+	stage_(-1),
+	budget_(0.0),
+	frameOverruns_(0),
+	frames_(0),
+	lateFrames_(0)
+{
+	setSmoothing(smoothing);
+	reset();
+}
+
+void DeadlineScheduler::setSmoothing(float smoothing)
+{
+	UASSERT_MSG(smoothing > 0.0f && smoothing <= 1.0f, uFormat("smoothing=%f", smoothing).c_str());
+	smoothing_ = smoothing;
+}
+
+void DeadlineScheduler::reset()
+{
+	for(int i=0; i<kStageCount; ++i)
+	{
+		expected_[i] = 0.0;
+		samples_[i] = 0;
+		for(int j=0; j<kUnitModelCount; ++j)
+		{
+			unitExpected_[i][j] = 0.0;
+			unitSamples_[i][j] = 0;
+		}
+		frameSkipped_[i] = 0;
+		overruns_[i] = 0;
+		skipped_[i] = 0;
+	}
+	stage_ = -1;
+	budget_ = 0.0;
+	frameOverruns_ = 0;
+	frames_ = 0;
+	lateFrames_ = 0;
+}
+
+void DeadlineScheduler::beginFrame(double deadline)
+{
+	deadline_ = deadline>0.0?deadline:0.0;
+	frameStart_ = UTimer::now();
+	stageStart_ = frameStart_;
+	stage_ = -1;
+	budget_ = 0.0;
+	frameOverruns_ = 0;
+	for(int i=0; i<kStageCount; ++i)
+	{
+		frameSkipped_[i] = 0;
+	}
+}
+
+void DeadlineScheduler::beginStage(Stage stage)
+{
+	UASSERT(stage >= 0 && stage < kStageCount);
+	UASSERT_MSG((int)stage > stage_, uFormat("Stage %s started after %s", stageName(stage), stage_>=0?stageName((Stage)stage_):"").c_str());
+
+	double now = UTimer::now();
+	if(stage_ >= 0)
+	{
+		double duration = now - stageStart_;
+		update(expected_[stage_], samples_[stage_], duration);
+		if(deadline_ > 0.0 && duration > budget_)
+		{
+			++frameOverruns_;
+			++overruns_[stage_];
+			UDEBUG("Stage \"%s\" overrun: %fs > %fs", stageName((Stage)stage_), duration, budget_);
+		}
+	}
+	stage_ = stage;
+	stageStart_ = now;
+
+	budget_ = 0.0;
+	if(deadline_ > 0.0)
+	{
+		double left = deadline_ - (now - frameStart_);
+		double expectedLeft = expected_[stage] + reserve(stage);
+		budget_ = left <= 0.0?0.0:expectedLeft > 0.0?left * expected_[stage] / expectedLeft:left;
+	}
+}
+
+void DeadlineScheduler::endFrame()
+{
+	if(stage_ >= 0)
+	{
+		double duration = UTimer::now() - stageStart_;
+		update(expected_[stage_], samples_[stage_], duration);
+		if(deadline_ > 0.0 && duration > budget_)
+		{
+			++frameOverruns_;
+			++overruns_[stage_];
+		}
+		stage_ = -1;
+		++frames_;
+		if(deadline_ > 0.0 && remaining() < 0.0)
+		{
+			++lateFrames_;
+		}
+	}
+}
+
+double DeadlineScheduler::elapsed() const
+{
+	return UTimer::now() - frameStart_;
+}
+
+double DeadlineScheduler::remaining() const
+{
+	return deadline_ - elapsed();
+}
+
+int DeadlineScheduler::affordableUnits(int units, UnitModel model) const
+{
+	UASSERT(model >= 0 && model < kUnitModelCount);
+	if(deadline_ <= 0.0 || stage_ < 0 || units <= 0 || unitSamples_[stage_][model] == 0)
+	{
+		// no deadline or unknown cost (do it to learn the cost)
+		return units>0?units:0;
+	}
+	double left = remaining() - reserve((Stage)stage_);
+	if(left <= 0.0)
+	{
+		return 0;
+	}
+	if(unitExpected_[stage_][model] <= 0.0)
+	{
+		return units;
+	}
+	double affordable = std::floor(left / unitExpected_[stage_][model]);
+	return affordable < double(units)?int(affordable):units;
+}
+
+void DeadlineScheduler::addUnitCost(double time, int units, UnitModel model)
+{
+	UASSERT(stage_ >= 0);
+	UASSERT(model >= 0 && model < kUnitModelCount);
+	if(units > 0)
+	{
+		update(unitExpected_[stage_][model], unitSamples_[stage_][model], time/double(units));
+	}
+}
+
+void DeadlineScheduler::skip(int units)
+{
+	UASSERT(stage_ >= 0);
+	if(units > 0)
+	{
+		frameSkipped_[stage_] += units;
+		skipped_[stage_] += units;
+	}
+}
+
+double DeadlineScheduler::reserve(Stage stage) const
+{
+	double sum = 0.0;
+	for(int i=stage+1; i<kStageCount; ++i)
+	{
+		sum += expected_[i];
+	}
+	return sum;
+}
+
+void DeadlineScheduler::update(double & expected, int & samples, double value) const
+{
+	expected = samples==0?value:expected + double(smoothing_) * (value - expected);
+	++samples;
+}
+
+} /* namespace rtabmap */
@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/util3d_features.h"
 #include "rtabmap/core/Stereo.h"
 #include "rtabmap/core/util2d.h"
+#include "rtabmap/core/Profiler.h"
 #include "rtabmap/utilite/UStl.h"
 #include "rtabmap/utilite/UConversion.h"
 #include "rtabmap/utilite/ULogger.h"
@@ -347,7 +348,9 @@ Feature2D::Feature2D(const ParametersMap & parameters) :
 		_roiRatios(std::vector<float>(4, 0.0f)),
 		_subPixWinSize(Parameters::defaultKpSubPixWinSize()),
 		_subPixIterations(Parameters::defaultKpSubPixIterations()),
-		_subPixEps(Parameters::defaultKpSubPixEps())
+		_subPixEps(Parameters::defaultKpSubPixEps()),
+		_gridRows(Parameters::defaultKpGridRows()),
+		_gridCols(Parameters::defaultKpGridCols())
 {
 	_stereo = new Stereo(parameters);
 	this->parseParameters(parameters);
@@ -366,6 +369,9 @@ void Feature2D::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kKpSubPixWinSize(), _subPixWinSize);
 	Parameters::parse(parameters, Parameters::kKpSubPixIterations(), _subPixIterations);
 	Parameters::parse(parameters, Parameters::kKpSubPixEps(), _subPixEps);
+	Parameters::parse(parameters, Parameters::kKpGridRows(), _gridRows);
+	Parameters::parse(parameters, Parameters::kKpGridCols(), _gridCols);
+	UASSERT_MSG(_gridRows >= 1 && _gridCols >= 1, uFormat("%d %d", _gridRows, _gridCols).c_str());
 
 	// convert ROI from string to vector
 	ParametersMap::const_iterator iter;
@@ -490,6 +496,7 @@ Feature2D * Feature2D::create(Feature2D::Type type, const ParametersMap & parame
 
 std::vector<cv::KeyPoint> Feature2D::generateKeypoints(const cv::Mat & image, const cv::Mat & maskIn) const
 {
+	UPROFILE("Feature2D::generateKeypoints");
 	UASSERT(!image.empty());
 	UASSERT(image.type() == CV_8UC1);
 
@@ -527,19 +534,84 @@ std::vector<cv::KeyPoint> Feature2D::generateKeypoints(const cv::Mat & image, co
 	UTimer timer;
 
 	// Get keypoints
-	cv::Rect roi = Feature2D::computeRoi(image, _roiRatios);
-	keypoints = this->generateKeypointsImpl(image, roi.width && roi.height?roi:cv::Rect(0,0,image.cols, image.rows), mask);
-	UDEBUG("Keypoints extraction time = %f s, keypoints extracted = %d", timer.ticks(), keypoints.size());
-
-	limitKeypoints(keypoints, maxFeatures_);
+	cv::Rect globalRoi = Feature2D::computeRoi(image, _roiRatios);
+	if(!(globalRoi.width && globalRoi.height))
+	{
+		globalRoi = cv::Rect(0,0,image.cols, image.rows);
+	}
 
-	if(roi.x || roi.y)
+	int cells = _gridRows * _gridCols;
+	if(cells > 1 && globalRoi.width >= _gridCols && globalRoi.height >= _gridRows)
 	{
-		// Adjust keypoint position to raw image
-		for(std::vector<cv::KeyPoint>::iterator iter=keypoints.begin(); iter!=keypoints.end(); ++iter)
+		// Detect independently in each cell with its own budget, so that
+		// highly textured areas don't get all the features
+		int rowSize = globalRoi.height / _gridRows;
+		int colSize = globalRoi.width / _gridCols;
+		// spread the budget over the cells, the first cells get the remainder
+		int cellMaxFeatures = maxFeatures_>0?maxFeatures_ / cells:0;
+		int remainder = maxFeatures_>0?maxFeatures_ % cells:0;
+		std::vector<std::vector<cv::KeyPoint> > cellKeypoints(cells);
+		bool parallel = this->isDetectionThreadSafe();
+		int border = this->detectionBorder();
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic) if(parallel)
+#endif
+		for(int k=0; k<cells; ++k)
+		{
+			int i = k / _gridCols;
+			int j = k % _gridCols;
+			// last row/col get the remaining pixels
+			cv::Rect cell(
+					globalRoi.x + j*colSize,
+					globalRoi.y + i*rowSize,
+					j==_gridCols-1?globalRoi.width-j*colSize:colSize,
+					i==_gridRows-1?globalRoi.height-i*rowSize:rowSize);
+			// detect in the cell extended by the detector border, then keep
+			// only the keypoints of the cell
+			cv::Rect roi(cell.x-border, cell.y-border, cell.width+2*border, cell.height+2*border);
+			roi &= globalRoi;
+			std::vector<cv::KeyPoint> roiKeypoints = this->generateKeypointsImpl(image, roi, mask);
+			cellKeypoints[k].reserve(roiKeypoints.size());
+			for(std::vector<cv::KeyPoint>::iterator iter=roiKeypoints.begin(); iter!=roiKeypoints.end(); ++iter)
+			{
+				iter->pt.x += roi.x;
+				iter->pt.y += roi.y;
+				if(iter->pt.x >= cell.x && iter->pt.x < cell.x+cell.width &&
+				   iter->pt.y >= cell.y && iter->pt.y < cell.y+cell.height)
+				{
+					cellKeypoints[k].push_back(*iter);
+				}
+			}
+			if(maxFeatures_ > 0)
+			{
+				// at least 1 per cell (0 means no limit), the total is limited after the merge
+				limitKeypoints(cellKeypoints[k], std::max(1, cellMaxFeatures + (k<remainder?1:0)));
+			}
+		}
+		for(int k=0; k<cells; ++k)
 		{
-			iter->pt.x += roi.x;
-			iter->pt.y += roi.y;
+			keypoints.insert(keypoints.end(), cellKeypoints[k].begin(), cellKeypoints[k].end());
+		}
+		// with more cells than Kp/MaxFeatures
+		limitKeypoints(keypoints, maxFeatures_);
+		UDEBUG("Keypoints extraction time = %f s, keypoints extracted = %d (grid=%dx%d, parallel=%s)",
+				timer.ticks(), (int)keypoints.size(), _gridRows, _gridCols, parallel?"true":"false");
+	}
+	else
+	{
+		keypoints = this->generateKeypointsImpl(image, globalRoi, mask);
+		UDEBUG("Keypoints extraction time = %f s, keypoints extracted = %d", timer.ticks(), keypoints.size());
+
+		limitKeypoints(keypoints, maxFeatures_);
+
+		if(globalRoi.x || globalRoi.y)
+		{
+			// Adjust keypoint position to raw image
+			for(std::vector<cv::KeyPoint>::iterator iter=keypoints.begin(); iter!=keypoints.end(); ++iter)
+			{
+				iter->pt.x += globalRoi.x;
+				iter->pt.y += globalRoi.y;
+			}
 		}
 	}
 
@@ -566,6 +638,7 @@ cv::Mat Feature2D::generateDescriptors(
 		const cv::Mat & image,
 		std::vector<cv::KeyPoint> & keypoints) const
 {
+	UPROFILE("Feature2D::generateDescriptors");
 	UASSERT(!image.empty());
 	UASSERT(image.type() == CV_8UC1);
 	cv::Mat descriptors = generateDescriptorsImpl(image, keypoints);
@@ -582,25 +655,14 @@ std::vector<cv::Point3f> Feature2D::generateKeypoints3D(
 	if(!data.rightRaw().empty() && !data.imageRaw().empty() && data.stereoCameraModel().isValidForProjection())
 	{
 		//stereo
-		cv::Mat imageMono;
-		// convert to grayscale
-		if(data.imageRaw().channels() > 1)
-		{
-			cv::cvtColor(data.imageRaw(), imageMono, cv::COLOR_BGR2GRAY);
-		}
-		else
-		{
-			imageMono = data.imageRaw();
-		}
-
 		std::vector<cv::Point2f> leftCorners;
 		cv::KeyPoint::convert(keypoints, leftCorners);
 		std::vector<unsigned char> status;
 
+		// with optical flow, the pyramids cached in data are used
 		std::vector<cv::Point2f> rightCorners;
 		rightCorners = _stereo->computeCorrespondences(
-				imageMono,
-				data.rightRaw(),
+				data,
 				leftCorners,
 				status);
 
@@ -687,6 +749,12 @@ void SURF::parseParameters(const ParametersMap & parameters)
 #endif
 }
 
+int SURF::detectionBorder() const
+{
+	// half of the largest box filter of the first octave
+	return (9 + 6*(nOctaveLayers_+1))/2 + 1;
+}
+
 std::vector<cv::KeyPoint> SURF::generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi, const cv::Mat & mask) const
 {
 	UASSERT(!image.empty() && image.channels() == 1 && image.depth() == CV_8U);
@@ -795,6 +863,11 @@ void SIFT::parseParameters(const ParametersMap & parameters)
 #endif
 }
 
+int SIFT::detectionBorder() const
+{
+	return 5; // SIFT_IMG_BORDER of the first octave
+}
+
 std::vector<cv::KeyPoint> SIFT::generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi, const cv::Mat & mask) const
 {
 	UASSERT(!image.empty() && image.channels() == 1 && image.depth() == CV_8U);
@@ -916,6 +989,16 @@ void ORB::parseParameters(const ParametersMap & parameters)
 	}
 }
 
+bool ORB::isDetectionThreadSafe() const
+{
+#if CV_MAJOR_VERSION < 3
+	// our CV_ORB::detectImpl() is const and only uses local buffers
+	return !gpu_;
+#else
+	return false;
+#endif
+}
+
 std::vector<cv::KeyPoint> ORB::generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi, const cv::Mat & mask) const
 {
 	UASSERT(!image.empty() && image.channels() == 1 && image.depth() == CV_8U);
@@ -1104,6 +1187,12 @@ void FAST::parseParameters(const ParametersMap & parameters)
 	}
 }
 
+bool FAST::isDetectionThreadSafe() const
+{
+	// The plain FAST detector only reads its parameters, not the grid adaptor
+	return !gpu_ && (CV_MAJOR_VERSION >= 3 || gridRows_ <= 0 || gridCols_ <= 0);
+}
+
 std::vector<cv::KeyPoint> FAST::generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi, const cv::Mat & mask) const
 {
 	UASSERT(!image.empty() && image.channels() == 1 && image.depth() == CV_8U);
@@ -1439,6 +1528,12 @@ void BRISK::parseParameters(const ParametersMap & parameters)
 #endif
 }
 
+int BRISK::detectionBorder() const
+{
+	// keypoints whose sampling pattern (radius ~10.8 at the first octave) exceeds the image are removed
+	return (int)ceil(10.8f*patternScale_) + 1;
+}
+
 std::vector<cv::KeyPoint> BRISK::generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi, const cv::Mat & mask) const
 {
 	UASSERT(!image.empty() && image.channels() == 1 && image.depth() == CV_8U);
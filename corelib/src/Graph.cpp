@@ -34,12 +34,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UFile.h>
 #include <rtabmap/core/GeodeticCoords.h>
 #include <rtabmap/core/Memory.h>
+#include <rtabmap/core/PoseSpatialIndex.h>
 #include <rtabmap/core/util3d_filtering.h>
 #include <pcl/search/kdtree.h>
 #include <pcl/common/eigen.h>
 #include <pcl/common/common.h>
 #include <set>
 #include <queue>
+#include <limits>
+#include <algorithm>
 #include <fstream>
 
 #include <rtabmap/core/OptimizerTORO.h>
@@ -618,53 +621,45 @@ std::map<int, Transform> radiusPosesFiltering(
 {
 	if(poses.size() > 1 && radius > 0.0f)
 	{
-		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-		cloud->resize(poses.size());
-		int i=0;
-		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter, ++i)
+		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
 		{
-			(*cloud)[i] = pcl::PointXYZ(iter->second.x(), iter->second.y(), iter->second.z());
-			UASSERT_MSG(pcl::isFinite((*cloud)[i]), uFormat("Invalid pose (%d) %s", iter->first, iter->second.prettyPrint().c_str()).c_str());
+			UASSERT_MSG(uIsFinite(iter->second.x()) && uIsFinite(iter->second.y()) && uIsFinite(iter->second.z()),
+					uFormat("Invalid pose (%d) %s", iter->first, iter->second.prettyPrint().c_str()).c_str());
 		}
 
-		// radius filtering
-		std::vector<int> names = uKeys(poses);
-		std::vector<Transform> transforms = uValues(poses);
-
-		pcl::search::KdTree<pcl::PointXYZ>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZ> (false));
-		tree->setInputCloud(cloud);
-		std::set<int> indicesChecked;
-		std::set<int> indicesKept;
+		// radius filtering, with cells of the radius size
+		PoseSpatialIndex index(radius);
+		index.update(poses);
+		std::set<int> idsChecked;
+		std::set<int> idsKept;
 
-		for(unsigned int i=0; i<cloud->size(); ++i)
+		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
 		{
-			if(indicesChecked.find(i) == indicesChecked.end())
+			if(idsChecked.find(iter->first) == idsChecked.end())
 			{
-				std::vector<int> kIndices;
-				std::vector<float> kDistances;
-				tree->radiusSearch(cloud->at(i), radius, kIndices, kDistances);
+				std::map<int, float> nearIds = index.radiusSearch(iter->second, radius);
 
-				std::set<int> cloudIndices;
-				const Transform & currentT = transforms.at(i);
+				std::set<int> cloudIds;
+				const Transform & currentT = iter->second;
 				Eigen::Vector3f vA = currentT.toEigen3f().rotation()*Eigen::Vector3f(1,0,0);
-				for(unsigned int j=0; j<kIndices.size(); ++j)
+				for(std::map<int, float>::iterator jter=nearIds.begin(); jter!=nearIds.end(); ++jter)
 				{
-					if(indicesChecked.find(kIndices[j]) == indicesChecked.end())
+					if(idsChecked.find(jter->first) == idsChecked.end())
 					{
 						if(angle > 0.0f)
 						{
-							const Transform & checkT = transforms.at(kIndices[j]);
+							const Transform & checkT = index.getPose(jter->first);
 							// same orientation?
 							Eigen::Vector3f vB = checkT.toEigen3f().rotation()*Eigen::Vector3f(1,0,0);
 							double a = pcl::getAngle3D(Eigen::Vector4f(vA[0], vA[1], vA[2], 0), Eigen::Vector4f(vB[0], vB[1], vB[2], 0));
 							if(a <= angle)
 							{
-								cloudIndices.insert(kIndices[j]);
+								cloudIds.insert(jter->first);
 							}
 						}
 						else
 						{
-							cloudIndices.insert(kIndices[j]);
+							cloudIds.insert(jter->first);
 						}
 					}
 				}
@@ -672,42 +667,38 @@ std::map<int, Transform> radiusPosesFiltering(
 				if(keepLatest)
 				{
 					bool lastAdded = false;
-					for(std::set<int>::reverse_iterator iter = cloudIndices.rbegin(); iter!=cloudIndices.rend(); ++iter)
+					for(std::set<int>::reverse_iterator jter = cloudIds.rbegin(); jter!=cloudIds.rend(); ++jter)
 					{
 						if(!lastAdded)
 						{
-							indicesKept.insert(*iter);
+							idsKept.insert(*jter);
 							lastAdded = true;
 						}
-						indicesChecked.insert(*iter);
+						idsChecked.insert(*jter);
 					}
 				}
 				else
 				{
 					bool firstAdded = false;
-					for(std::set<int>::iterator iter = cloudIndices.begin(); iter!=cloudIndices.end(); ++iter)
+					for(std::set<int>::iterator jter = cloudIds.begin(); jter!=cloudIds.end(); ++jter)
 					{
 						if(!firstAdded)
 						{
-							indicesKept.insert(*iter);
+							idsKept.insert(*jter);
 							firstAdded = true;
 						}
-						indicesChecked.insert(*iter);
+						idsChecked.insert(*jter);
 					}
 				}
 			}
 		}
 
-		//pcl::IndicesPtr indicesOut(new std::vector<int>);
-		//indicesOut->insert(indicesOut->end(), indicesKept.begin(), indicesKept.end());
-		UINFO("Cloud filtered In = %d, Out = %d", cloud->size(), indicesKept.size());
-		//pcl::io::savePCDFile("duplicateIn.pcd", *cloud);
-		//pcl::io::savePCDFile("duplicateOut.pcd", *cloud, *indicesOut);
+		UINFO("Poses filtered In = %d, Out = %d", (int)poses.size(), (int)idsKept.size());
 
 		std::map<int, Transform> keptPoses;
-		for(std::set<int>::iterator iter = indicesKept.begin(); iter!=indicesKept.end(); ++iter)
+		for(std::set<int>::iterator iter = idsKept.begin(); iter!=idsKept.end(); ++iter)
 		{
-			keptPoses.insert(std::make_pair(names.at(*iter), transforms.at(*iter)));
+			keptPoses.insert(*poses.find(*iter));
 		}
 
 		return keptPoses;
@@ -1116,6 +1107,263 @@ std::list<std::pair<int, Transform> > computePath(
 	return path;
 }
 
+// Binary min-heap of dense node indices, with decrease-key
+class IndexedHeap
+{
+public:
+	IndexedHeap(int size) : positions_(size, -1) {}
+	bool empty() const {return heap_.empty();}
+	int top() const {return heap_.front().second;}
+	float topKey() const {return heap_.front().first;}
+	void pop()
+	{
+		positions_[heap_.front().second] = -1;
+		heap_.front() = heap_.back();
+		heap_.pop_back();
+		if(heap_.size())
+		{
+			positions_[heap_.front().second] = 0;
+			down(0);
+		}
+	}
+	// insert or decrease the key
+	void push(int index, float key)
+	{
+		int i = positions_[index];
+		if(i < 0)
+		{
+			i = (int)heap_.size();
+			heap_.push_back(std::make_pair(key, index));
+			positions_[index] = i;
+		}
+		else
+		{
+			heap_[i].first = key;
+		}
+		up(i);
+	}
+
+private:
+	void up(int i)
+	{
+		while(i > 0)
+		{
+			int parent = (i-1)/2;
+			if(heap_[parent].first <= heap_[i].first)
+			{
+				break;
+			}
+			swap(i, parent);
+			i = parent;
+		}
+	}
+	void down(int i)
+	{
+		int size = (int)heap_.size();
+		while(true)
+		{
+			int smallest = i;
+			int l = 2*i+1;
+			int r = l+1;
+			if(l < size && heap_[l].first < heap_[smallest].first)
+			{
+				smallest = l;
+			}
+			if(r < size && heap_[r].first < heap_[smallest].first)
+			{
+				smallest = r;
+			}
+			if(smallest == i)
+			{
+				break;
+			}
+			swap(i, smallest);
+			i = smallest;
+		}
+	}
+	void swap(int a, int b)
+	{
+		std::swap(heap_[a], heap_[b]);
+		positions_[heap_[a].second] = a;
+		positions_[heap_[b].second] = b;
+	}
+
+private:
+	std::vector<std::pair<float, int> > heap_; // <key, index>
+	std::vector<int> positions_; // index -> position in heap_ (-1 if not in the heap)
+};
+
+// (dist(p,to) - dist(from,p))/2
+inline float averagePotential(const float * p, const float * from, const float * to)
+{
+	float dTo = sqrt((p[0]-to[0])*(p[0]-to[0]) + (p[1]-to[1])*(p[1]-to[1]) + (p[2]-to[2])*(p[2]-to[2]));
+	float dFrom = sqrt((p[0]-from[0])*(p[0]-from[0]) + (p[1]-from[1])*(p[1]-from[1]) + (p[2]-from[2])*(p[2]-from[2]));
+	return (dTo - dFrom)/2.0f;
+}
+
+// Bidirectional A*
+std::list<std::pair<int, Transform> > computePathBidirectional(
+			const std::map<int, rtabmap::Transform> & poses,
+			const std::multimap<int, int> & links,
+			int from,
+			int to)
+{
+	std::list<std::pair<int, Transform> > path;
+	UASSERT_MSG(uContains(poses, from), uFormat("from=%d", from).c_str());
+	UASSERT_MSG(uContains(poses, to), uFormat("to=%d", to).c_str());
+	if(from == to)
+	{
+		path.push_back(*poses.find(from));
+		return path;
+	}
+
+	// dense indices (poses are sorted by id)
+	int n = (int)poses.size();
+	std::vector<int> ids(n);
+	std::vector<const Transform *> transforms(n);
+	std::vector<float> xyz(n*3);
+	int i=0;
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter, ++i)
+	{
+		ids[i] = iter->first;
+		transforms[i] = &iter->second;
+		xyz[i*3] = iter->second.x();
+		xyz[i*3+1] = iter->second.y();
+		xyz[i*3+2] = iter->second.z();
+	}
+
+	// CSR adjacency, forward (out links) and backward (in links)
+	std::vector<std::pair<int, int> > edges;
+	edges.reserve(links.size());
+	int lastFrom = -1;
+	int lastFromIndex = -1;
+	for(std::multimap<int, int>::const_iterator iter=links.begin(); iter!=links.end(); ++iter)
+	{
+		if(iter->first != lastFrom)
+		{
+			lastFrom = iter->first;
+			std::vector<int>::iterator jter = std::lower_bound(ids.begin(), ids.end(), iter->first);
+			lastFromIndex = jter!=ids.end() && *jter==iter->first?int(jter-ids.begin()):-1;
+		}
+		std::vector<int>::iterator jter = std::lower_bound(ids.begin(), ids.end(), iter->second);
+		if(lastFromIndex >= 0 && jter!=ids.end() && *jter==iter->second)
+		{
+			edges.push_back(std::make_pair(lastFromIndex, int(jter-ids.begin())));
+		}
+	}
+	std::vector<int> offsets[2];
+	std::vector<int> targets[2];
+	std::vector<float> weights[2];
+	for(int d=0; d<2; ++d)
+	{
+		offsets[d].resize(n+1, 0);
+		targets[d].resize(edges.size());
+		weights[d].resize(edges.size());
+		for(unsigned int e=0; e<edges.size(); ++e)
+		{
+			++offsets[d][(d==0?edges[e].first:edges[e].second)+1];
+		}
+		for(int j=0; j<n; ++j)
+		{
+			offsets[d][j+1] += offsets[d][j];
+		}
+		std::vector<int> fill(offsets[d].begin(), offsets[d].end()-1);
+		for(unsigned int e=0; e<edges.size(); ++e)
+		{
+			int a = d==0?edges[e].first:edges[e].second;
+			int b = d==0?edges[e].second:edges[e].first;
+			float dx = xyz[a*3]-xyz[b*3];
+			float dy = xyz[a*3+1]-xyz[b*3+1];
+			float dz = xyz[a*3+2]-xyz[b*3+2];
+			targets[d][fill[a]] = b;
+			weights[d][fill[a]++] = sqrt(dx*dx + dy*dy + dz*dz);
+		}
+	}
+
+	// Average potentials: p(v) = (dist(v,to) - dist(from,v))/2 for the forward
+	// search and -p(v) for the backward search, so both searches use the same
+	// non-negative reduced costs and can be stopped as a bidirectional Dijkstra.
+	int indices[2];
+	indices[0] = int(std::lower_bound(ids.begin(), ids.end(), from) - ids.begin());
+	indices[1] = int(std::lower_bound(ids.begin(), ids.end(), to) - ids.begin());
+	std::vector<float> potentials(n, std::numeric_limits<float>::quiet_NaN());
+	std::vector<float> costs[2];
+	std::vector<int> parents[2];
+	std::vector<char> closed[2];
+	IndexedHeap heap0(n), heap1(n);
+	IndexedHeap * heaps[2] = {&heap0, &heap1};
+	for(int d=0; d<2; ++d)
+	{
+		costs[d].resize(n, std::numeric_limits<float>::max());
+		parents[d].resize(n, -1);
+		closed[d].resize(n, 0);
+	}
+	float best = std::numeric_limits<float>::max();
+	int meeting = -1;
+	int expanded = 0;
+	for(int d=0; d<2; ++d)
+	{
+		int s = indices[d];
+		costs[d][s] = 0.0f;
+		potentials[s] = averagePotential(&xyz[s*3], &xyz[indices[0]*3], &xyz[indices[1]*3]);
+		heaps[d]->push(s, d==0?potentials[s]:-potentials[s]);
+	}
+
+	while(!heap0.empty() && !heap1.empty())
+	{
+		if(heap0.topKey() + heap1.topKey() >= best)
+		{
+			break;
+		}
+		// expand the smallest frontier
+		int d = heap0.topKey() <= heap1.topKey()?0:1;
+		IndexedHeap & heap = *heaps[d];
+		int u = heap.top();
+		heap.pop();
+		closed[d][u] = 1;
+		++expanded;
+
+		for(int e=offsets[d][u]; e<offsets[d][u+1]; ++e)
+		{
+			int v = targets[d][e];
+			if(closed[d][v])
+			{
+				continue;
+			}
+			float cost = costs[d][u] + weights[d][e];
+			if(cost < costs[d][v])
+			{
+				costs[d][v] = cost;
+				parents[d][v] = u;
+				if(potentials[v] != potentials[v]) // NaN: not computed yet
+				{
+					potentials[v] = averagePotential(&xyz[v*3], &xyz[indices[0]*3], &xyz[indices[1]*3]);
+				}
+				heap.push(v, cost + (d==0?potentials[v]:-potentials[v]));
+				if(costs[1-d][v] < std::numeric_limits<float>::max() && cost + costs[1-d][v] < best)
+				{
+					best = cost + costs[1-d][v];
+					meeting = v;
+				}
+			}
+		}
+	}
+
+	if(meeting >= 0)
+	{
+		for(int v=meeting; v>=0; v=parents[0][v])
+		{
+			path.push_front(std::make_pair(ids[v], *transforms[v]));
+		}
+		for(int v=parents[1][meeting]; v>=0; v=parents[1][v])
+		{
+			path.push_back(std::make_pair(ids[v], *transforms[v]));
+		}
+	}
+	UDEBUG("from=%d to=%d nodes=%d edges=%d expanded=%d path=%d", from, to, n, (int)edges.size(), expanded, (int)path.size());
+	return path;
+}
+
 // Dijksta
 std::list<int> RTABMAP_EXP computePath(
 			const std::multimap<int, Link> & links,
@@ -1586,6 +1834,59 @@ std::map<int, Transform> getPosesInRadius(
 	return foundNodes;
 }
 
+int findNearestNode(
+		const PoseSpatialIndex & index,
+		const rtabmap::Transform & targetPose,
+		const std::set<int> & ignoredIds)
+{
+	return index.nearest(targetPose, ignoredIds);
+}
+
+// return <id, sqrd distance>, excluding query
+std::map<int, float> getNodesInRadius(
+		int nodeId,
+		const PoseSpatialIndex & index,
+		float radius)
+{
+	std::map<int, float> foundNodes = index.radiusSearch(index.getPose(nodeId), radius);
+	foundNodes.erase(nodeId);
+	UDEBUG("found nodes=%d", (int)foundNodes.size());
+	return foundNodes;
+}
+
+// return <id, Transform>, excluding query
+std::map<int, Transform> getPosesInRadius(
+		int nodeId,
+		const PoseSpatialIndex & index,
+		float radius,
+		float angle)
+{
+	const Transform & fromT = index.getPose(nodeId);
+	std::map<int, float> ids = index.radiusSearch(fromT, radius);
+	Eigen::Vector3f vA = fromT.toEigen3f().rotation()*Eigen::Vector3f(1,0,0);
+	std::map<int, Transform> foundNodes;
+	for(std::map<int, float>::iterator iter=ids.begin(); iter!=ids.end(); ++iter)
+	{
+		if(iter->first != nodeId)
+		{
+			const Transform & checkT = index.getPose(iter->first);
+			if(angle > 0.0f)
+			{
+				// same orientation?
+				Eigen::Vector3f vB = checkT.toEigen3f().rotation()*Eigen::Vector3f(1,0,0);
+				double a = pcl::getAngle3D(Eigen::Vector4f(vA[0], vA[1], vA[2], 0), Eigen::Vector4f(vB[0], vB[1], vB[2], 0));
+				if(a > angle)
+				{
+					continue;
+				}
+			}
+			foundNodes.insert(foundNodes.end(), std::make_pair(iter->first, checkT));
+		}
+	}
+	UDEBUG("found nodes=%d", (int)foundNodes.size());
+	return foundNodes;
+}
+
 float computePathLength(
 		const std::vector<std::pair<int, Transform> > & path,
 		unsigned int fromIndex,
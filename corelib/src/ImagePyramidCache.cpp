@@ -0,0 +1,202 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/ImagePyramidCache.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+#include <list>
+
+namespace rtabmap {
+
+static UMutex g_poolMutex;
+static std::list<std::vector<cv::Mat> > g_pool;
+static const unsigned int g_poolMaxSize = 8;
+static unsigned long g_builds = 0;
+static unsigned long g_hits = 0;
+static unsigned long g_allocations = 0;
+
+static bool isUniquelyOwned(const cv::Mat & m)
+{
+#if CV_MAJOR_VERSION < 3
+	return m.refcount == 0 || *m.refcount == 1;
+#else
+	return m.u == 0 || m.u->refcount == 1;
+#endif
+}
+
+void ImagePyramidCache::getStatistics(
+		unsigned long & builds,
+		unsigned long & hits,
+		unsigned long & allocations)
+{
+	UScopeMutex lock(g_poolMutex);
+	builds = g_builds;
+	hits = g_hits;
+	allocations = g_allocations;
+}
+
+void ImagePyramidCache::resetStatistics()
+{
+	UScopeMutex lock(g_poolMutex);
+	g_builds = 0;
+	g_hits = 0;
+	g_allocations = 0;
+}
+
+void ImagePyramidCache::clearPool()
+{
+	UScopeMutex lock(g_poolMutex);
+	g_pool.clear();
+}
+
+ImagePyramidCache::ImagePyramidCache() :
+	maxLevel_(-1)
+{
+}
+
+ImagePyramidCache::~ImagePyramidCache()
+{
+	if(pyramid_.size())
+	{
+		// give the buffers back only if nobody else is still using them
+		for(unsigned int i=0; i<pyramid_.size(); ++i)
+		{
+			if(!isUniquelyOwned(pyramid_[i]))
+			{
+				return;
+			}
+		}
+		UScopeMutex lock(g_poolMutex);
+		if(g_pool.size() < g_poolMaxSize)
+		{
+			g_pool.push_back(std::vector<cv::Mat>());
+			g_pool.back().swap(pyramid_);
+		}
+	}
+}
+
+std::vector<cv::Mat> ImagePyramidCache::get(const cv::Mat & image, const cv::Size & winSize, int maxLevel)
+{
+	UASSERT(!image.empty() && image.depth() == CV_8U);
+	UASSERT(maxLevel >= 0);
+
+	UScopeMutex lock(mutex_);
+	if(pyramid_.size() &&
+	   image.data == image_.data &&
+	   image.size() == image_.size() &&
+	   winSize.width <= winSize_.width &&
+	   winSize.height <= winSize_.height &&
+	   maxLevel <= maxLevel_)
+	{
+		UScopeMutex poolLock(g_poolMutex);
+		++g_hits;
+		return pyramid_;
+	}
+
+	cv::Mat gray;
+	if(image.channels() > 1)
+	{
+		cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+	}
+	else
+	{
+		gray = image;
+	}
+
+	// keep the largest requirements seen for this image
+	cv::Size buildWinSize = winSize;
+	int buildMaxLevel = maxLevel;
+	if(image.data == image_.data && image.size() == image_.size())
+	{
+		buildWinSize.width = std::max(buildWinSize.width, winSize_.width);
+		buildWinSize.height = std::max(buildWinSize.height, winSize_.height);
+		buildMaxLevel = std::max(buildMaxLevel, maxLevel_);
+	}
+
+	// levels still used outside would be overwritten by the rebuild
+	for(unsigned int i=0; i<pyramid_.size(); ++i)
+	{
+		if(!isUniquelyOwned(pyramid_[i]))
+		{
+			pyramid_.clear();
+			break;
+		}
+	}
+
+	if(pyramid_.empty())
+	{
+		UScopeMutex poolLock(g_poolMutex);
+		// prefer buffers of the same size, cv::buildOpticalFlowPyramid() reuses them as is
+		std::list<std::vector<cv::Mat> >::iterator iter=g_pool.begin();
+		for(; iter!=g_pool.end(); ++iter)
+		{
+			if(iter->size() && iter->front().size() == gray.size())
+			{
+				break;
+			}
+		}
+		if(iter == g_pool.end() && g_pool.size())
+		{
+			iter = g_pool.begin();
+		}
+		if(iter != g_pool.end())
+		{
+			pyramid_.swap(*iter);
+			g_pool.erase(iter);
+		}
+	}
+
+	std::vector<const uchar*> previousData(pyramid_.size());
+	for(unsigned int i=0; i<pyramid_.size(); ++i)
+	{
+		previousData[i] = pyramid_[i].datastart;
+	}
+
+	// don't reuse input image as level 0, the buffers go back to the pool afterwards
+	cv::buildOpticalFlowPyramid(gray, pyramid_, buildWinSize, buildMaxLevel, true, cv::BORDER_REFLECT_101, cv::BORDER_CONSTANT, false);
+
+	int allocations = 0;
+	for(unsigned int i=0; i<pyramid_.size(); ++i)
+	{
+		if(i>=previousData.size() || pyramid_[i].datastart != previousData[i])
+		{
+			++allocations;
+		}
+	}
+
+	image_ = image;
+	winSize_ = buildWinSize;
+	maxLevel_ = buildMaxLevel;
+
+	UScopeMutex poolLock(g_poolMutex);
+	++g_builds;
+	g_allocations += allocations;
+	return pyramid_;
+}
+
+} /* namespace rtabmap */
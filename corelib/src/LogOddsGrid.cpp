@@ -0,0 +1,423 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/LogOddsGrid.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UMath.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <limits>
+
+#if CV_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace rtabmap {
+
+// cell flags in the ray masks, hits have priority over misses
+static const unsigned char g_miss = 1;
+static const unsigned char g_hit = 2;
+static const int g_margin = 20; // cells added around the grid when it grows
+
+static float logOdds(float probability)
+{
+	return log(probability/(1.0f-probability));
+}
+
+LogOddsGrid::LogOddsGrid(
+		float cellSize,
+		int cellType,
+		float probHit,
+		float probMiss,
+		float probClampingMin,
+		float probClampingMax) :
+	cellSize_(cellSize),
+	cellType_(cellType),
+	scale_(cellType==CV_8SC1?32.0f:1000.0f),
+	hit_(0),
+	miss_(0),
+	clampingMin_(0),
+	clampingMax_(0),
+	lastRays_(0),
+	lastCellsUpdated_(0),
+	lastUpdateTime_(0.0)
+{
+	UASSERT(cellSize_ > 0.0f);
+	UASSERT(cellType_ == CV_8SC1 || cellType_ == CV_16SC1);
+	UASSERT(probHit > 0.5f && probHit < 1.0f);
+	UASSERT(probMiss > 0.0f && probMiss < 0.5f);
+	UASSERT(probClampingMin > 0.0f && probClampingMin < probClampingMax && probClampingMax < 1.0f);
+
+	// the minimum value of the type is reserved for unknown cells
+	int minValue = cellType_==CV_8SC1?-127:-32767;
+	int maxValue = cellType_==CV_8SC1?127:32767;
+	hit_ = cvRound(logOdds(probHit)*scale_);
+	miss_ = cvRound(logOdds(probMiss)*scale_);
+	clampingMin_ = std::max(minValue, cvRound(logOdds(probClampingMin)*scale_));
+	clampingMax_ = std::min(maxValue, cvRound(logOdds(probClampingMax)*scale_));
+	UASSERT_MSG(hit_ > 0 && miss_ < 0, uFormat("probHit (%f) and probMiss (%f) are too close to 0.5 for the cell type", probHit, probMiss).c_str());
+	UDEBUG("hit=%d miss=%d clamping=[%d,%d] (scale=%f)", hit_, miss_, clampingMin_, clampingMax_, scale_);
+}
+
+void LogOddsGrid::clear()
+{
+	grid_ = cv::Mat();
+	origin_ = cv::Point2i(0,0);
+	masks_.clear();
+	lastRays_ = 0;
+	lastCellsUpdated_ = 0;
+	lastUpdateTime_ = 0.0;
+}
+
+// DDA traversal in cell units: cells crossed are marked as miss, the last one with endValue.
+// The axis to step is selected without branching and never passes the end cell.
+static void traceRay(
+		const cv::Point2f & start,
+		const cv::Point2f & end,
+		unsigned char endValue,
+		const cv::Rect & roi,
+		unsigned char * mask)
+{
+	int x = cvFloor(start.x);
+	int y = cvFloor(start.y);
+	int endX = cvFloor(end.x);
+	int endY = cvFloor(end.y);
+	float dx = end.x - start.x;
+	float dy = end.y - start.y;
+	int stepX = dx>=0.0f?1:-1;
+	int stepY = dy>=0.0f?1:-1;
+	float tDeltaX = dx!=0.0f?fabs(1.0f/dx):std::numeric_limits<float>::max();
+	float tDeltaY = dy!=0.0f?fabs(1.0f/dy):std::numeric_limits<float>::max();
+	float tMaxX = dx>0.0f?(float(x+1)-start.x)*tDeltaX:dx<0.0f?(start.x-float(x))*tDeltaX:std::numeric_limits<float>::max();
+	float tMaxY = dy>0.0f?(float(y+1)-start.y)*tDeltaY:dy<0.0f?(start.y-float(y))*tDeltaY:std::numeric_limits<float>::max();
+
+	int steps = abs(endX-x) + abs(endY-y);
+	int offsetY = stepY*roi.width;
+	unsigned char * cell = mask + (y-roi.y)*roi.width + (x-roi.x);
+	for(int i=0; i<steps; ++i)
+	{
+		*cell |= g_miss;
+		bool moveX = x != endX && (y == endY || tMaxX < tMaxY);
+		x += moveX?stepX:0;
+		y += moveX?0:stepY;
+		tMaxX += moveX?tDeltaX:0.0f;
+		tMaxY += moveX?0.0f:tDeltaY;
+		cell += moveX?stepX:offsetY;
+	}
+	*cell |= endValue;
+}
+
+int LogOddsGrid::update(const cv::Mat & scan, const Transform & pose, float maxRange)
+{
+	UTimer timer;
+	lastRays_ = 0;
+	lastCellsUpdated_ = 0;
+	lastUpdateTime_ = 0.0;
+	if(scan.empty())
+	{
+		return 0;
+	}
+	UASSERT(scan.type() == CV_32FC2 || scan.type() == CV_32FC3);
+	UASSERT(scan.isContinuous());
+	UASSERT(!pose.isNull());
+
+	float x,y,z,roll,pitch,yaw;
+	pose.getTranslationAndEulerAngles(x,y,z,roll,pitch,yaw);
+	float cosT = cos(yaw);
+	float sinT = sin(yaw);
+
+	// end points in cell units
+	int channels = scan.channels();
+	int n = (int)scan.total();
+	const float * data = scan.ptr<float>();
+	std::vector<cv::Point2f> ends(n);
+	std::vector<unsigned char> endValues(n, 0); // 0 = invalid point
+	cv::Point2f start(x/cellSize_, y/cellSize_);
+	cv::Point2i minCell(cvFloor(start.x), cvFloor(start.y));
+	cv::Point2i maxCell = minCell;
+	for(int i=0; i<n; ++i)
+	{
+		float px = data[i*channels];
+		float py = data[i*channels+1];
+		if(!uIsFinite(px) || !uIsFinite(py))
+		{
+			continue;
+		}
+		float dx = cosT*px - sinT*py;
+		float dy = sinT*px + cosT*py;
+		endValues[i] = g_hit;
+		if(maxRange > 0.0f)
+		{
+			float d2 = dx*dx + dy*dy;
+			if(d2 > maxRange*maxRange)
+			{
+				float ratio = maxRange/sqrt(d2);
+				dx *= ratio;
+				dy *= ratio;
+				endValues[i] = g_miss;
+			}
+		}
+		ends[i] = cv::Point2f((x+dx)/cellSize_, (y+dy)/cellSize_);
+		cv::Point2i cell(cvFloor(ends[i].x), cvFloor(ends[i].y));
+		minCell.x = std::min(minCell.x, cell.x);
+		minCell.y = std::min(minCell.y, cell.y);
+		maxCell.x = std::max(maxCell.x, cell.x);
+		maxCell.y = std::max(maxCell.y, cell.y);
+		++lastRays_;
+	}
+	if(lastRays_ == 0)
+	{
+		return 0;
+	}
+
+	reserve(minCell, maxCell);
+
+	// trace rays in parallel, each thread in its own mask
+	cv::Rect roi(minCell.x, minCell.y, maxCell.x-minCell.x+1, maxCell.y-minCell.y+1);
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	if((int)masks_.size() < threads)
+	{
+		masks_.resize(threads);
+	}
+	std::vector<unsigned char> masksUsed(threads, 0);
+#ifdef _OPENMP
+	#pragma omp parallel
+#endif
+	{
+		int thread = 0;
+#ifdef _OPENMP
+		thread = omp_get_thread_num();
+#endif
+		std::vector<unsigned char> & mask = masks_[thread];
+		mask.assign(roi.area(), 0);
+		masksUsed[thread] = 1;
+#ifdef _OPENMP
+		#pragma omp for schedule(static)
+#endif
+		for(int i=0; i<n; ++i)
+		{
+			if(endValues[i])
+			{
+				traceRay(start, ends[i], endValues[i], roi, &mask[0]);
+			}
+		}
+	}
+
+	unsigned char * mask = &masks_[0][0];
+	for(int t=1; t<threads; ++t)
+	{
+		if(masksUsed[t])
+		{
+			const unsigned char * other = &masks_[t][0];
+			for(int i=0; i<roi.area(); ++i)
+			{
+				mask[i] |= other[i];
+			}
+		}
+	}
+
+	if(cellType_ == CV_8SC1)
+	{
+		applyMask<signed char>(roi, mask);
+	}
+	else
+	{
+		applyMask<short>(roi, mask);
+	}
+	lastCellsUpdated_ = cv::countNonZero(cv::Mat(roi.height, roi.width, CV_8UC1, mask));
+
+	lastUpdateTime_ = timer.ticks();
+	UDEBUG("rays=%d cells updated=%d grid=%dx%d time=%fs", lastRays_, lastCellsUpdated_, grid_.cols, grid_.rows, lastUpdateTime_);
+	return lastRays_;
+}
+
+#if CV_SSE2
+// Returns the number of cells processed
+static int applyMaskSSE2(short * row, const unsigned char * mask, int width, int hit, int miss, int clampingMin, int clampingMax)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i unknown = _mm_set1_epi16(std::numeric_limits<short>::min());
+	const __m128i missFlag = _mm_set1_epi16(g_miss);
+	const __m128i hitValue = _mm_set1_epi16(hit);
+	const __m128i missValue = _mm_set1_epi16(miss);
+	const __m128i minValue = _mm_set1_epi16(clampingMin);
+	const __m128i maxValue = _mm_set1_epi16(clampingMax);
+	int j=0;
+	for(; j<=width-8; j+=8)
+	{
+		__m128i flags = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(mask+j)), zero);
+		__m128i cell = _mm_loadu_si128((const __m128i*)(row+j));
+		__m128i touched = _mm_cmpgt_epi16(flags, zero);
+		__m128i isHit = _mm_cmpgt_epi16(flags, missFlag);
+		__m128i delta = _mm_or_si128(_mm_and_si128(isHit, hitValue), _mm_andnot_si128(isHit, missValue));
+		__m128i value = _mm_andnot_si128(_mm_cmpeq_epi16(cell, unknown), cell);
+		value = _mm_min_epi16(_mm_max_epi16(_mm_adds_epi16(value, delta), minValue), maxValue);
+		value = _mm_or_si128(_mm_and_si128(touched, value), _mm_andnot_si128(touched, cell));
+		_mm_storeu_si128((__m128i*)(row+j), value);
+	}
+	return j;
+}
+
+static int applyMaskSSE2(signed char * row, const unsigned char * mask, int width, int hit, int miss, int clampingMin, int clampingMax)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i unknown = _mm_set1_epi8(std::numeric_limits<signed char>::min());
+	const __m128i missFlag = _mm_set1_epi8(g_miss);
+	const __m128i hitValue = _mm_set1_epi8(hit);
+	const __m128i missValue = _mm_set1_epi8(miss);
+	const __m128i minValue = _mm_set1_epi8(clampingMin);
+	const __m128i maxValue = _mm_set1_epi8(clampingMax);
+	int j=0;
+	for(; j<=width-16; j+=16)
+	{
+		__m128i flags = _mm_loadu_si128((const __m128i*)(mask+j));
+		__m128i cell = _mm_loadu_si128((const __m128i*)(row+j));
+		__m128i touched = _mm_cmpgt_epi8(flags, zero);
+		__m128i isHit = _mm_cmpgt_epi8(flags, missFlag);
+		__m128i delta = _mm_or_si128(_mm_and_si128(isHit, hitValue), _mm_andnot_si128(isHit, missValue));
+		__m128i value = _mm_andnot_si128(_mm_cmpeq_epi8(cell, unknown), cell);
+		value = _mm_adds_epi8(value, delta);
+		// no signed 8 bits min/max in SSE2
+		__m128i below = _mm_cmpgt_epi8(minValue, value);
+		value = _mm_or_si128(_mm_and_si128(below, minValue), _mm_andnot_si128(below, value));
+		__m128i above = _mm_cmpgt_epi8(value, maxValue);
+		value = _mm_or_si128(_mm_and_si128(above, maxValue), _mm_andnot_si128(above, value));
+		value = _mm_or_si128(_mm_and_si128(touched, value), _mm_andnot_si128(touched, cell));
+		_mm_storeu_si128((__m128i*)(row+j), value);
+	}
+	return j;
+}
+#endif
+
+template<typename T>
+void LogOddsGrid::applyMask(const cv::Rect & roi, const unsigned char * mask)
+{
+	const T unknown = std::numeric_limits<T>::min();
+	for(int i=0; i<roi.height; ++i)
+	{
+		T * row = grid_.ptr<T>(roi.y - origin_.y + i) + (roi.x - origin_.x);
+		const unsigned char * flags = mask + i*roi.width;
+		int j=0;
+#if CV_SSE2
+		j = applyMaskSSE2(row, flags, roi.width, hit_, miss_, clampingMin_, clampingMax_);
+#endif
+		for(; j<roi.width; ++j)
+		{
+			if(flags[j])
+			{
+				int value = row[j]==unknown?0:row[j];
+				value += (flags[j] & g_hit)?hit_:miss_;
+				row[j] = value<clampingMin_?clampingMin_:value>clampingMax_?clampingMax_:value;
+			}
+		}
+	}
+}
+
+void LogOddsGrid::reserve(const cv::Point2i & minCell, const cv::Point2i & maxCell)
+{
+	cv::Scalar unknown(cellType_==CV_8SC1?std::numeric_limits<signed char>::min():std::numeric_limits<short>::min());
+	if(grid_.empty())
+	{
+		origin_ = cv::Point2i(minCell.x - g_margin, minCell.y - g_margin);
+		grid_ = cv::Mat(maxCell.y - origin_.y + 1 + g_margin, maxCell.x - origin_.x + 1 + g_margin, cellType_, unknown);
+		return;
+	}
+
+	cv::Point2i gridMax(origin_.x + grid_.cols - 1, origin_.y + grid_.rows - 1);
+	if(minCell.x >= origin_.x && minCell.y >= origin_.y && maxCell.x <= gridMax.x && maxCell.y <= gridMax.y)
+	{
+		return;
+	}
+
+	// grow by at least half of the current size on the overflowing sides, so that
+	// the cost of the copies is amortized
+	cv::Point2i newOrigin = origin_;
+	cv::Point2i newMax = gridMax;
+	if(minCell.x < origin_.x)
+	{
+		newOrigin.x = std::min(minCell.x - g_margin, origin_.x - grid_.cols/2);
+	}
+	if(minCell.y < origin_.y)
+	{
+		newOrigin.y = std::min(minCell.y - g_margin, origin_.y - grid_.rows/2);
+	}
+	if(maxCell.x > gridMax.x)
+	{
+		newMax.x = std::max(maxCell.x + g_margin, gridMax.x + grid_.cols/2);
+	}
+	if(maxCell.y > gridMax.y)
+	{
+		newMax.y = std::max(maxCell.y + g_margin, gridMax.y + grid_.rows/2);
+	}
+	cv::Mat grid(newMax.y - newOrigin.y + 1, newMax.x - newOrigin.x + 1, cellType_, unknown);
+	grid_.copyTo(grid(cv::Rect(origin_.x - newOrigin.x, origin_.y - newOrigin.y, grid_.cols, grid_.rows)));
+	UDEBUG("grid resized from %dx%d to %dx%d", grid_.cols, grid_.rows, grid.cols, grid.rows);
+	grid_ = grid;
+	origin_ = newOrigin;
+}
+
+cv::Mat LogOddsGrid::getMap(float & xMin, float & yMin, float occupancyThr) const
+{
+	cv::Mat map;
+	if(grid_.empty())
+	{
+		return map;
+	}
+	UASSERT(occupancyThr > 0.0f && occupancyThr < 1.0f);
+	xMin = float(origin_.x)*cellSize_;
+	yMin = float(origin_.y)*cellSize_;
+	int threshold = cvRound(logOdds(occupancyThr)*scale_);
+	cv::Mat logOdds;
+	grid_.convertTo(logOdds, CV_16SC1);
+	short unknown = cellType_==CV_8SC1?std::numeric_limits<signed char>::min():std::numeric_limits<short>::min();
+	map = cv::Mat(grid_.rows, grid_.cols, CV_8S);
+	for(int i=0; i<logOdds.rows; ++i)
+	{
+		const short * in = logOdds.ptr<short>(i);
+		char * out = map.ptr<char>(i);
+		for(int j=0; j<logOdds.cols; ++j)
+		{
+			out[j] = in[j]==unknown?-1:in[j]>threshold?100:0;
+		}
+	}
+	return map;
+}
+
+const cv::Mat & LogOddsGrid::getLogOdds(float & xMin, float & yMin) const
+{
+	xMin = float(origin_.x)*cellSize_;
+	yMin = float(origin_.y)*cellSize_;
+	return grid_;
+}
+
+} /* namespace rtabmap */
@@ -57,10 +57,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Compression.h"
 #include "rtabmap/core/Graph.h"
 #include "rtabmap/core/Stereo.h"
+#include "rtabmap/core/Profiler.h"
 
 #include <pcl/io/pcd_io.h>
 #include <pcl/common/common.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace rtabmap {
 
 const int Memory::kIdStart = 0;
@@ -375,6 +380,14 @@ Memory::~Memory()
 	{
 		delete _registrationIcp;
 	}
+	for(unsigned int i=0; i<_parallelRegistrations.size(); ++i)
+	{
+		delete _parallelRegistrations[i];
+	}
+	for(unsigned int i=0; i<_parallelRegistrationsIcp.size(); ++i)
+	{
+		delete _parallelRegistrationsIcp[i];
+	}
 }
 
 void Memory::parseParameters(const ParametersMap & parameters)
@@ -465,16 +478,31 @@ void Memory::parseParameters(const ParametersMap & parameters)
 		}
 
 		_registrationPipeline = Registration::create(regStrategy, parameters_);
+
+		// recreated on next parallel registration
+		for(unsigned int i=0; i<_parallelRegistrations.size(); ++i)
+		{
+			delete _parallelRegistrations[i];
+		}
+		_parallelRegistrations.clear();
 	}
 	else if(_registrationPipeline)
 	{
 		_registrationPipeline->parseParameters(parameters);
+		for(unsigned int i=0; i<_parallelRegistrations.size(); ++i)
+		{
+			_parallelRegistrations[i]->parseParameters(parameters);
+		}
 	}
 
 	if(_registrationIcp)
 	{
 		_registrationIcp->parseParameters(parameters);
 	}
+	for(unsigned int i=0; i<_parallelRegistrationsIcp.size(); ++i)
+	{
+		_parallelRegistrationsIcp[i]->parseParameters(parameters);
+	}
 
 	// do this after all parameters are parsed
 	// SLAM mode vs Localization mode
@@ -523,6 +551,7 @@ bool Memory::update(
 		const cv::Mat & covariance,
 		Statistics * stats)
 {
+	UPROFILE("Memory::update");
 	UDEBUG("");
 	UTimer timer;
 	UTimer totalTimer;
@@ -972,6 +1001,7 @@ std::map<int, int> Memory::getNeighborsId(
 		double * dbAccessTime
 		) const
 {
+	UPROFILE("Memory::getNeighborsId");
 	UASSERT(maxGraphDepth >= 0);
 	//UDEBUG("signatureId=%d, neighborsMargin=%d", signatureId, margin);
 	if(dbAccessTime)
@@ -1084,6 +1114,7 @@ std::map<int, float> Memory::getNeighborsIdRadius(
 		int maxGraphDepth // 0 means infinite margin
 		) const
 {
+	UPROFILE("Memory::getNeighborsIdRadius");
 	UASSERT(maxGraphDepth >= 0);
 	UASSERT(uContains(optimizedPoses, signatureId));
 	UASSERT(signatureId > 0);
@@ -1336,6 +1367,7 @@ void Memory::clear()
  */
 std::map<int, float> Memory::computeLikelihood(const Signature * signature, const std::list<int> & ids)
 {
+	UPROFILE("Memory::computeLikelihood");
 	if(!_tfIdfLikelihoodUsed)
 	{
 		UTimer timer;
@@ -1474,6 +1506,7 @@ std::map<int, int> Memory::getWeights() const
 
 std::list<int> Memory::forget(const std::set<int> & ignoredIds)
 {
+	UPROFILE("Memory::forget");
 	UDEBUG("");
 	std::list<int> signaturesRemoved;
 	if(this->isIncremental() &&
@@ -1546,6 +1579,7 @@ std::list<int> Memory::forget(const std::set<int> & ignoredIds)
 
 int Memory::cleanup()
 {
+	UPROFILE("Memory::cleanup");
 	UDEBUG("");
 	int signatureRemoved = 0;
 
@@ -1573,6 +1607,7 @@ void Memory::emptyTrash()
 
 void Memory::joinTrashThread()
 {
+	UPROFILE("Memory::joinTrashThread");
 	if(_dbDriver)
 	{
 		UDEBUG("");
@@ -1614,6 +1649,7 @@ public:
 };
 std::list<Signature *> Memory::getRemovableSignatures(int count, const std::set<int> & ignoredIds)
 {
+	UPROFILE("Memory::getRemovableSignatures");
 	//UDEBUG("");
 	std::list<Signature *> removableSignatures;
 	std::map<WeightAgeIdKey, Signature *> weightAgeIdMap;
@@ -2052,6 +2088,27 @@ void Memory::removeRawData(int id, bool image, bool scan, bool userData)
 	}
 }
 
+// load binary data from database if not in RAM and uncompress only what the registration pipeline needs
+void Memory::loadDataForRegistration(Signature * s)
+{
+	UASSERT(s != 0);
+	// make sure we have all data needed
+	// load binary data from database if not in RAM (if image is already here, scan and userData should be or they are null)
+	if((_reextractLoopClosureFeatures && _registrationPipeline->isImageRequired() && s->sensorData().imageCompressed().empty()) ||
+	   (_registrationPipeline->isScanRequired() && s->sensorData().imageCompressed().empty() && s->sensorData().laserScanCompressed().empty()) ||
+	   (_registrationPipeline->isUserDataRequired() && s->sensorData().imageCompressed().empty() && s->sensorData().userDataCompressed().empty()))
+	{
+		getNodeData(s->id());
+	}
+	// uncompress only what we need
+	cv::Mat imgBuf, depthBuf, laserBuf, userBuf;
+	s->sensorData().uncompressData(
+			(_reextractLoopClosureFeatures && _registrationPipeline->isImageRequired())?&imgBuf:0,
+			(_reextractLoopClosureFeatures && _registrationPipeline->isImageRequired())?&depthBuf:0,
+			_registrationPipeline->isScanRequired()?&laserBuf:0,
+			_registrationPipeline->isUserDataRequired()?&userBuf:0);
+}
+
 // compute transform fromId -> toId
 Transform Memory::computeTransform(
 		int fromId,
@@ -2066,124 +2123,179 @@ Transform Memory::computeTransform(
 
 	if(fromS && toS)
 	{
-		// make sure we have all data needed
-		// load binary data from database if not in RAM (if image is already here, scan and userData should be or they are null)
-		if((_reextractLoopClosureFeatures && _registrationPipeline->isImageRequired() && fromS->sensorData().imageCompressed().empty()) ||
-		   (_registrationPipeline->isScanRequired() && fromS->sensorData().imageCompressed().empty() && fromS->sensorData().laserScanCompressed().empty()) ||
-		   (_registrationPipeline->isUserDataRequired() && fromS->sensorData().imageCompressed().empty() && fromS->sensorData().userDataCompressed().empty()))
+		loadDataForRegistration(fromS);
+		loadDataForRegistration(toS);
+		transform = computeTransform(*fromS, *toS, guess, info, *_registrationPipeline);
+	}
+	else
+	{
+		std::string msg = uFormat("Did not find nodes %d and/or %d", fromId, toId);
+		if(info)
 		{
-			getNodeData(fromS->id());
+			info->rejectedMsg = msg;
 		}
-		if((_reextractLoopClosureFeatures && _registrationPipeline->isImageRequired() && toS->sensorData().imageCompressed().empty()) ||
-		   (_registrationPipeline->isScanRequired() && toS->sensorData().imageCompressed().empty() && toS->sensorData().laserScanCompressed().empty()) ||
-		   (_registrationPipeline->isUserDataRequired() && toS->sensorData().imageCompressed().empty() && toS->sensorData().userDataCompressed().empty()))
+		UWARN(msg.c_str());
+	}
+	return transform;
+}
+
+// Data of the signatures should be already loaded and uncompressed (see loadDataForRegistration()).
+// This doesn't modify the memory, so it can be called from multiple threads
+// as long as each thread uses its own registration instance.
+Transform Memory::computeTransform(
+		const Signature & fromS,
+		const Signature & toS,
+		Transform guess,
+		RegistrationInfo * info,
+		const Registration & registration) const
+{
+	UPROFILE("Memory::computeTransform");
+	Transform transform;
+
+	// compute transform fromId -> toId
+	if(_reextractLoopClosureFeatures || (fromS.getWords().size() && toS.getWords().size()))
+	{
+		Signature tmpFrom = fromS;
+		Signature tmpTo = toS;
+
+		// make a guess fast with known correspondences (if there are)
+		RegistrationVis regVis(parameters_);
+		if(tmpFrom.getWords().size() &&
+			tmpTo.getWords().size() &&
+			tmpFrom.getWords3().size() &&
+			tmpTo.getWords3().size())
 		{
-			getNodeData(toS->id());
+			UDEBUG("");
+			// Remove descriptors, this will avoid recomputation of the correspondences in regVis
+			tmpFrom.setWordsDescriptors(std::multimap<int, cv::Mat>());
+			tmpTo.setWordsDescriptors(std::multimap<int, cv::Mat>());
+			guess = regVis.computeTransformation(tmpFrom, tmpTo, guess, info);
+			// set back descriptors
+			tmpFrom.setWordsDescriptors(fromS.getWordsDescriptors());
+			tmpTo.setWordsDescriptors(toS.getWordsDescriptors());
 		}
-		// uncompress only what we need
-		cv::Mat imgBuf, depthBuf, laserBuf, userBuf;
-		fromS->sensorData().uncompressData(
-				(_reextractLoopClosureFeatures && _registrationPipeline->isImageRequired())?&imgBuf:0,
-				(_reextractLoopClosureFeatures && _registrationPipeline->isImageRequired())?&depthBuf:0,
-				_registrationPipeline->isScanRequired()?&laserBuf:0,
-				_registrationPipeline->isUserDataRequired()?&userBuf:0);
-		toS->sensorData().uncompressData(
-				(_reextractLoopClosureFeatures && _registrationPipeline->isImageRequired())?&imgBuf:0,
-				(_reextractLoopClosureFeatures && _registrationPipeline->isImageRequired())?&depthBuf:0,
-				_registrationPipeline->isScanRequired()?&laserBuf:0,
-				_registrationPipeline->isUserDataRequired()?&userBuf:0);
-
 
-		// compute transform fromId -> toId
-		std::vector<int> inliersV;
-		if(_reextractLoopClosureFeatures || (fromS->getWords().size() && toS->getWords().size()))
+		if(_reextractLoopClosureFeatures)
 		{
-			Signature tmpFrom = *fromS;
-			Signature tmpTo = *toS;
+			UDEBUG("");
+			tmpFrom.setWords(std::multimap<int, cv::KeyPoint>());
+			tmpFrom.setWords3(std::multimap<int, cv::Point3f>());
+			tmpFrom.setWordsDescriptors(std::multimap<int, cv::Mat>());
+			tmpFrom.sensorData().setFeatures(std::vector<cv::KeyPoint>(), cv::Mat());
+			tmpTo.setWords(std::multimap<int, cv::KeyPoint>());
+			tmpTo.setWords3(std::multimap<int, cv::Point3f>());
+			tmpTo.setWordsDescriptors(std::multimap<int, cv::Mat>());
+			tmpTo.sensorData().setFeatures(std::vector<cv::KeyPoint>(), cv::Mat());
+		}
 
-			// make a guess fast with known correspondences (if there are)
-			RegistrationVis regVis(parameters_);
-			if(tmpFrom.getWords().size() &&
-				tmpTo.getWords().size() &&
-				tmpFrom.getWords3().size() &&
-				tmpTo.getWords3().size())
+		if(guess.isNull())
+		{
+			if(!registration.isImageRequired())
 			{
 				UDEBUG("");
-				// Remove descriptors, this will avoid recomputation of the correspondences in regVis
-				tmpFrom.setWordsDescriptors(std::multimap<int, cv::Mat>());
-				tmpTo.setWordsDescriptors(std::multimap<int, cv::Mat>());
+				// no visual in the pipeline, make visual registration for guess
 				guess = regVis.computeTransformation(tmpFrom, tmpTo, guess, info);
-				// set back descriptors
-				tmpFrom.setWordsDescriptors(fromS->getWordsDescriptors());
-				tmpTo.setWordsDescriptors(toS->getWordsDescriptors());
 			}
-
-			if(_reextractLoopClosureFeatures)
+			else
 			{
 				UDEBUG("");
-				tmpFrom.setWords(std::multimap<int, cv::KeyPoint>());
-				tmpFrom.setWords3(std::multimap<int, cv::Point3f>());
-				tmpFrom.setWordsDescriptors(std::multimap<int, cv::Mat>());
-				tmpFrom.sensorData().setFeatures(std::vector<cv::KeyPoint>(), cv::Mat());
-				tmpTo.setWords(std::multimap<int, cv::KeyPoint>());
-				tmpTo.setWords3(std::multimap<int, cv::Point3f>());
-				tmpTo.setWordsDescriptors(std::multimap<int, cv::Mat>());
-				tmpTo.sensorData().setFeatures(std::vector<cv::KeyPoint>(), cv::Mat());
+				guess.setIdentity();
 			}
+		}
 
-			if(guess.isNull())
-			{
-				if(!_registrationPipeline->isImageRequired())
-				{
-					UDEBUG("");
-					// no visual in the pipeline, make visual registration for guess
-					guess = regVis.computeTransformation(tmpFrom, tmpTo, guess, info);
-				}
-				else
-				{
-					UDEBUG("");
-					guess.setIdentity();
-				}
-			}
+		if(!guess.isNull())
+		{
+			UDEBUG("");
+			transform = registration.computeTransformation(tmpFrom, tmpTo, guess, info);
 
-			if(!guess.isNull())
+			if(!transform.isNull())
 			{
 				UDEBUG("");
-				transform = _registrationPipeline->computeTransformation(tmpFrom, tmpTo, guess, info);
-
-				if(!transform.isNull())
+				// verify if it is a 180 degree transform, well verify > 90
+				float x,y,z, roll,pitch,yaw;
+				transform.getTranslationAndEulerAngles(x,y,z, roll,pitch,yaw);
+				if(fabs(roll) > CV_PI/2 ||
+				   fabs(pitch) > CV_PI/2 ||
+				   fabs(yaw) > CV_PI/2)
 				{
-					UDEBUG("");
-					// verify if it is a 180 degree transform, well verify > 90
-					float x,y,z, roll,pitch,yaw;
-					transform.getTranslationAndEulerAngles(x,y,z, roll,pitch,yaw);
-					if(fabs(roll) > CV_PI/2 ||
-					   fabs(pitch) > CV_PI/2 ||
-					   fabs(yaw) > CV_PI/2)
+					transform.setNull();
+					std::string msg = uFormat("Too large rotation detected! (roll=%f, pitch=%f, yaw=%f)",
+							roll, pitch, yaw);
+					UINFO(msg.c_str());
+					if(info)
 					{
-						transform.setNull();
-						std::string msg = uFormat("Too large rotation detected! (roll=%f, pitch=%f, yaw=%f)",
-								roll, pitch, yaw);
-						UINFO(msg.c_str());
-						if(info)
-						{
-							info->rejectedMsg = msg;
-						}
+						info->rejectedMsg = msg;
 					}
 				}
 			}
 		}
 	}
-	else
+	return transform;
+}
+
+// compute transforms fromId -> toIds[i] (null guess), in parallel
+std::vector<Transform> Memory::computeTransforms(
+		int fromId,
+		const std::vector<int> & toIds,
+		std::vector<RegistrationInfo> * infos)
+{
+	std::vector<Transform> transforms(toIds.size());
+	std::vector<RegistrationInfo> infosTmp(toIds.size());
+
+	// Loading and uncompressing data modify the memory, do it first
+	Signature * fromS = this->_getSignature(fromId);
+	std::vector<Signature *> toS(toIds.size(), (Signature*)0);
+	if(fromS)
 	{
-		std::string msg = uFormat("Did not find nodes %d and/or %d", fromId, toId);
-		if(info)
+		loadDataForRegistration(fromS);
+	}
+	for(unsigned int i=0; i<toIds.size(); ++i)
+	{
+		toS[i] = this->_getSignature(toIds[i]);
+		if(fromS && toS[i])
 		{
-			info->rejectedMsg = msg;
+			loadDataForRegistration(toS[i]);
+		}
+		else
+		{
+			infosTmp[i].rejectedMsg = uFormat("Did not find nodes %d and/or %d", fromId, toIds[i]);
+			UWARN(infosTmp[i].rejectedMsg.c_str());
 		}
-		UWARN(msg.c_str());
 	}
-	return transform;
+
+	// independent registration pipelines, one per thread, kept
+	// between calls so that their caches are not lost
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	while((int)_parallelRegistrations.size() < threads)
+	{
+		_parallelRegistrations.push_back(Registration::create(parameters_));
+	}
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic)
+#endif
+	for(int i=0; i<(int)toIds.size(); ++i)
+	{
+		if(fromS && toS[i])
+		{
+			int thread = 0;
+#ifdef _OPENMP
+			thread = omp_get_thread_num();
+#endif
+			UTimer timer;
+			transforms[i] = computeTransform(*fromS, *toS[i], Transform(), &infosTmp[i], *_parallelRegistrations[thread]);
+			infosTmp[i].totalTime = timer.ticks();
+		}
+	}
+
+	if(infos)
+	{
+		*infos = infosTmp;
+	}
+	return transforms;
 }
 
 // compute transform fromId -> toId
@@ -2193,6 +2305,7 @@ Transform Memory::computeIcpTransform(
 		Transform guess,
 		RegistrationInfo * info)
 {
+	UPROFILE("Memory::computeIcpTransform");
 	Signature * fromS = this->_getSignature(fromId);
 	Signature * toS = this->_getSignature(toId);
 
@@ -2241,12 +2354,13 @@ Transform Memory::computeIcpTransform(
 	return t;
 }
 
-// compute transform fromId -> multiple toId
-Transform Memory::computeIcpTransformMulti(
+// Create a fake sensor data with all scans of the poses merged in toId referential.
+// Return false if fromId doesn't have a laser scan.
+bool Memory::assembleScans(
 		int fromId,
 		int toId,
 		const std::map<int, Transform> & poses,
-		RegistrationInfo * info)
+		SensorData & assembledData)
 {
 	UASSERT(uContains(poses, fromId) && uContains(_signatures, fromId));
 	UASSERT(uContains(poses, toId) && uContains(_signatures, toId));
@@ -2275,13 +2389,9 @@ Transform Memory::computeIcpTransformMulti(
 	cv::Mat fromScan;
 	fromS->sensorData().uncompressData(0, 0, &fromScan);
 
-	Transform t;
 	if(!fromScan.empty())
 	{
-		// Create a fake signature with all scans merged in oldId referential
-		SensorData assembledData;
 		Transform toPose = poses.at(toId);
-		std::string msg;
 		pcl::PointCloud<pcl::PointXYZ>::Ptr assembledToClouds(new pcl::PointCloud<pcl::PointXYZ>);
 		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
 		{
@@ -2305,15 +2415,84 @@ Transform Memory::computeIcpTransformMulti(
 		{
 			assembledData.setLaserScanRaw(util3d::laserScanFromPointCloud(*assembledToClouds, Transform()), fromS->sensorData().laserScanMaxPts(), fromS->sensorData().laserScanMaxRange());
 		}
+		return true;
+	}
+	return false;
+}
 
+// compute transform fromId -> multiple toId
+Transform Memory::computeIcpTransformMulti(
+		int fromId,
+		int toId,
+		const std::map<int, Transform> & poses,
+		RegistrationInfo * info)
+{
+	Transform t;
+	SensorData assembledData;
+	if(assembleScans(fromId, toId, poses, assembledData))
+	{
 		Transform guess = poses.at(fromId).inverse() * poses.at(toId);
-		std::vector<int> inliersV;
-		t = _registrationIcp->computeTransformation(fromS->sensorData(), assembledData, guess, info);
+		t = _registrationIcp->computeTransformation(_getSignature(fromId)->sensorData(), assembledData, guess, info);
 	}
 
 	return t;
 }
 
+// compute transforms fromId -> multiple toIds[i].first, in parallel
+std::vector<Transform> Memory::computeIcpTransformsMulti(
+		int fromId,
+		const std::vector<std::pair<int, std::map<int, Transform> > > & toIds,
+		std::vector<RegistrationInfo> * infos)
+{
+	std::vector<Transform> transforms(toIds.size());
+	std::vector<RegistrationInfo> infosTmp(toIds.size());
+
+	// Loading data and assembling scans modify the memory, do it first
+	std::vector<SensorData> assembledData(toIds.size());
+	std::vector<bool> valid(toIds.size(), false);
+	for(unsigned int i=0; i<toIds.size(); ++i)
+	{
+		valid[i] = assembleScans(fromId, toIds[i].first, toIds[i].second, assembledData[i]);
+	}
+	const Signature * fromS = this->getSignature(fromId);
+
+	// independent registrations, one per thread, kept between
+	// calls so that their preprocessed scan caches are not lost
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	while((int)_parallelRegistrationsIcp.size() < threads)
+	{
+		_parallelRegistrationsIcp.push_back(new RegistrationIcp(parameters_));
+	}
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic)
+#endif
+	for(int i=0; i<(int)toIds.size(); ++i)
+	{
+		if(valid[i])
+		{
+			int thread = 0;
+#ifdef _OPENMP
+			thread = omp_get_thread_num();
+#endif
+			UTimer timer;
+			const std::map<int, Transform> & poses = toIds[i].second;
+			Transform guess = poses.at(fromId).inverse() * poses.at(toIds[i].first);
+			transforms[i] = _parallelRegistrationsIcp[thread]->computeTransformation(fromS->sensorData(), assembledData[i], guess, &infosTmp[i]);
+			infosTmp[i].totalTime = timer.ticks();
+		}
+	}
+
+	if(infos)
+	{
+		*infos = infosTmp;
+	}
+	return transforms;
+}
+
 bool Memory::addLink(const Link & link)
 {
 	UASSERT(link.type() > Link::kNeighbor && link.type() != Link::kUndef);
@@ -2594,6 +2773,7 @@ void Memory::dumpMemoryTree(const char * fileNameTree) const
 
 void Memory::rehearsal(Signature * signature, Statistics * stats)
 {
+	UPROFILE("Memory::rehearsal");
 	UTimer timer;
 	if(signature->getLinks().size() != 1 ||
 	   signature->isBadSignature())
@@ -3079,6 +3259,7 @@ private:
 
 Signature * Memory::createSignature(const SensorData & data, const Transform & pose, Statistics * stats)
 {
+	UPROFILE("Memory::createSignature");
 	UDEBUG("");
 	UASSERT(data.imageRaw().empty() ||
 			data.imageRaw().type() == CV_8UC1 ||
@@ -3599,6 +3780,7 @@ Signature * Memory::createSignature(const SensorData & data, const Transform & p
 
 void Memory::disableWordsRef(int signatureId)
 {
+	UPROFILE("Memory::disableWordsRef");
 	UDEBUG("id=%d", signatureId);
 
 	Signature * ss = this->_getSignature(signatureId);
@@ -3647,6 +3829,7 @@ void Memory::cleanUnusedWords()
 
 void Memory::enableWordsRef(const std::list<int> & signatureIds)
 {
+	UPROFILE("Memory::enableWordsRef");
 	UDEBUG("size=%d", signatureIds.size());
 	UTimer timer;
 	timer.start();
@@ -3761,6 +3944,7 @@ void Memory::enableWordsRef(const std::list<int> & signatureIds)
 
 std::set<int> Memory::reactivateSignatures(const std::list<int> & ids, unsigned int maxLoaded, double & timeDbAccess)
 {
+	UPROFILE("Memory::reactivateSignatures");
 	// get the signatures, if not in the working memory, they
 	// will be loaded from the database in an more efficient way
 	// than how it is done in the Memory
@@ -3809,6 +3993,7 @@ void Memory::getMetricConstraints(
 		std::multimap<int, Link> & links,
 		bool lookInDatabase)
 {
+	UPROFILE("Memory::getMetricConstraints");
 	UDEBUG("");
 	for(std::set<int>::const_iterator iter=ids.begin(); iter!=ids.end(); ++iter)
 	{
@@ -0,0 +1,413 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/OccupancyGridAssembler.h"
+#include "rtabmap/core/util3d_mapping.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UStl.h>
+
+namespace rtabmap {
+
+static const int g_tileBits = 6; // 64x64 cells
+static const int g_tileSize = 1 << g_tileBits;
+static const int g_margin = 10; // cells, same as util3d::create2DMapFromOccupancyLocalMaps()
+// util3d::filter2DMap() sets a cell from the cells up to 4 cells away (3 for
+// the empty cells removed beside obstacles, +1 for erosion)
+static const int g_filterRadius = 4;
+
+OccupancyGridAssembler::Tile::Tile() :
+	empty(g_tileSize*g_tileSize, 0),
+	obstacles(g_tileSize*g_tileSize, 0),
+	cells(0)
+{
+}
+
+OccupancyGridAssembler::OccupancyGridAssembler(float cellSize, float linearUpdate, float angularUpdate) :
+	cellSize_(cellSize),
+	linearUpdate_(linearUpdate),
+	angularUpdate_(angularUpdate),
+	hasBounds_(false),
+	boundsChanged_(false),
+	erode_(false),
+	lastAdded_(0),
+	lastMoved_(0),
+	lastRemoved_(0),
+	lastUpdateTime_(0.0)
+{
+	UASSERT(cellSize_ > 0.0f);
+}
+
+void OccupancyGridAssembler::setCellSize(float cellSize)
+{
+	UASSERT(cellSize > 0.0f);
+	if(cellSize != cellSize_)
+	{
+		cellSize_ = cellSize;
+		clear();
+	}
+}
+
+void OccupancyGridAssembler::setUpdateThresholds(float linearUpdate, float angularUpdate)
+{
+	linearUpdate_ = linearUpdate;
+	angularUpdate_ = angularUpdate;
+}
+
+void OccupancyGridAssembler::clear()
+{
+	nodes_.clear();
+	tiles_.clear();
+	hasBounds_ = false;
+	boundsChanged_ = false;
+	dirtyTiles_.clear();
+	bufferRect_ = cv::Rect();
+	raw_ = cv::Mat();
+	filtered_ = cv::Mat();
+	lastAdded_ = 0;
+	lastMoved_ = 0;
+	lastRemoved_ = 0;
+	lastUpdateTime_ = 0.0;
+}
+
+int OccupancyGridAssembler::update(
+		const std::map<int, Transform> & poses,
+		const std::map<int, std::pair<cv::Mat, cv::Mat> > & occupancy)
+{
+	UTimer timer;
+	lastAdded_ = 0;
+	lastMoved_ = 0;
+	lastRemoved_ = 0;
+
+	// remove nodes not in the graph anymore
+	for(std::map<int, Node>::iterator iter=nodes_.begin(); iter!=nodes_.end();)
+	{
+		if(poses.find(iter->first) == poses.end() || occupancy.find(iter->first) == occupancy.end())
+		{
+			addCells(iter->second.emptyCells, false, -1);
+			addCells(iter->second.obstacleCells, true, -1);
+			nodes_.erase(iter++);
+			++lastRemoved_;
+		}
+		else
+		{
+			++iter;
+		}
+	}
+
+	float x,y,z,roll,pitch,yaw;
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		UASSERT(!iter->second.isNull());
+		std::map<int, std::pair<cv::Mat, cv::Mat> >::const_iterator jter = occupancy.find(iter->first);
+		if(jter == occupancy.end())
+		{
+			continue;
+		}
+
+		iter->second.getTranslationAndEulerAngles(x,y,z,roll,pitch,yaw);
+		std::map<int, Node>::iterator nter = nodes_.find(iter->first);
+		if(nter != nodes_.end())
+		{
+			float dx = x - nter->second.x;
+			float dy = y - nter->second.y;
+			float dyaw = yaw - nter->second.yaw;
+			dyaw = atan2(sin(dyaw), cos(dyaw));
+			if(dx*dx + dy*dy <= linearUpdate_*linearUpdate_ && fabs(dyaw) <= angularUpdate_)
+			{
+				continue;
+			}
+			// moved: remove it from the grid before projecting it again
+			addCells(nter->second.emptyCells, false, -1);
+			addCells(nter->second.obstacleCells, true, -1);
+			++lastMoved_;
+		}
+		else
+		{
+			nter = nodes_.insert(std::make_pair(iter->first, Node())).first;
+			++lastAdded_;
+		}
+
+		Node & node = nter->second;
+		node.x = x;
+		node.y = y;
+		node.yaw = yaw;
+		node.cell = cv::Point2i(cvFloor(x/cellSize_ + 0.5f), cvFloor(y/cellSize_ + 0.5f));
+		includeCell(node.cell);
+		project(node, jter->second.first, node.emptyCells, false);
+		project(node, jter->second.second, node.obstacleCells, true);
+	}
+
+	if(boundsChanged_)
+	{
+		computeBounds();
+	}
+
+	lastUpdateTime_ = timer.ticks();
+	UDEBUG("added=%d moved=%d removed=%d nodes=%d tiles=%d time=%fs",
+			lastAdded_, lastMoved_, lastRemoved_, (int)nodes_.size(), (int)tiles_.size(), lastUpdateTime_);
+	return lastAdded_ + lastMoved_;
+}
+
+void OccupancyGridAssembler::project(Node & node, const cv::Mat & localMap, std::vector<cv::Point2i> & cells, bool obstacle)
+{
+	cells.clear();
+	if(localMap.empty())
+	{
+		return;
+	}
+	UASSERT(localMap.type() == CV_32FC2);
+	float cosT = cos(node.yaw);
+	float sinT = sin(node.yaw);
+	cells.resize(localMap.total());
+	const cv::Vec2f * pts = localMap.ptr<cv::Vec2f>();
+	for(unsigned int i=0; i<cells.size(); ++i)
+	{
+		float px = cosT*pts[i][0] - sinT*pts[i][1] + node.x;
+		float py = sinT*pts[i][0] + cosT*pts[i][1] + node.y;
+		cells[i] = cv::Point2i(cvFloor(px/cellSize_ + 0.5f), cvFloor(py/cellSize_ + 0.5f));
+	}
+	addCells(cells, obstacle, 1);
+}
+
+void OccupancyGridAssembler::addCells(const std::vector<cv::Point2i> & cells, bool obstacle, int increment)
+{
+	Tile * tile = 0;
+	std::pair<int, int> tileId;
+	for(unsigned int i=0; i<cells.size(); ++i)
+	{
+		const cv::Point2i & cell = cells[i];
+		std::pair<int, int> id(cell.x >> g_tileBits, cell.y >> g_tileBits);
+		if(tile == 0 || id != tileId)
+		{
+			// consecutive cells are generally in the same tile
+			tile = &tiles_[id];
+			tileId = id;
+			dirtyTiles_.insert(id);
+		}
+		int index = (cell.y & (g_tileSize-1))*g_tileSize + (cell.x & (g_tileSize-1));
+		int & count = (obstacle?tile->obstacles:tile->empty)[index];
+		if(increment > 0)
+		{
+			tile->cells += count==0?1:0;
+			count += increment;
+			includeCell(cell);
+		}
+		else
+		{
+			UASSERT(count > 0);
+			count += increment;
+			if(count == 0 && --tile->cells == 0)
+			{
+				tiles_.erase(id);
+				tile = 0;
+			}
+			boundsChanged_ = true;
+		}
+	}
+}
+
+void OccupancyGridAssembler::includeCell(const cv::Point2i & cell)
+{
+	if(!hasBounds_)
+	{
+		minCell_ = maxCell_ = cell;
+		hasBounds_ = true;
+	}
+	else
+	{
+		minCell_.x = std::min(minCell_.x, cell.x);
+		minCell_.y = std::min(minCell_.y, cell.y);
+		maxCell_.x = std::max(maxCell_.x, cell.x);
+		maxCell_.y = std::max(maxCell_.y, cell.y);
+	}
+}
+
+void OccupancyGridAssembler::computeBounds()
+{
+	hasBounds_ = false;
+	boundsChanged_ = false;
+	for(std::map<int, Node>::iterator iter=nodes_.begin(); iter!=nodes_.end(); ++iter)
+	{
+		includeCell(iter->second.cell);
+	}
+	if(tiles_.empty())
+	{
+		return;
+	}
+
+	// only the cells of the tiles on the border of the tiled area can be bounds
+	int minTileX = tiles_.begin()->first.first;
+	int maxTileX = tiles_.rbegin()->first.first;
+	int minTileY = tiles_.begin()->first.second;
+	int maxTileY = minTileY;
+	for(std::map<std::pair<int, int>, Tile>::const_iterator iter=tiles_.begin(); iter!=tiles_.end(); ++iter)
+	{
+		minTileY = std::min(minTileY, iter->first.second);
+		maxTileY = std::max(maxTileY, iter->first.second);
+	}
+	for(std::map<std::pair<int, int>, Tile>::const_iterator iter=tiles_.begin(); iter!=tiles_.end(); ++iter)
+	{
+		if(iter->first.first != minTileX && iter->first.first != maxTileX &&
+		   iter->first.second != minTileY && iter->first.second != maxTileY)
+		{
+			continue;
+		}
+		const Tile & tile = iter->second;
+		for(int index=0; index<g_tileSize*g_tileSize; ++index)
+		{
+			if(tile.empty[index] > 0 || tile.obstacles[index] > 0)
+			{
+				includeCell(cv::Point2i(
+						(iter->first.first << g_tileBits) + (index & (g_tileSize-1)),
+						(iter->first.second << g_tileBits) + (index >> g_tileBits)));
+			}
+		}
+	}
+}
+
+void OccupancyGridAssembler::allocateBuffer(const cv::Rect & area)
+{
+	// slack so that the buffer is not reallocated each time the bounds grow
+	int slackX = std::max(2*g_tileSize, area.width/4);
+	int slackY = std::max(2*g_tileSize, area.height/4);
+	int minTileX = (area.x - slackX) >> g_tileBits;
+	int minTileY = (area.y - slackY) >> g_tileBits;
+	int maxTileX = (area.x + area.width + slackX) >> g_tileBits;
+	int maxTileY = (area.y + area.height + slackY) >> g_tileBits;
+	cv::Rect rect(
+			minTileX << g_tileBits,
+			minTileY << g_tileBits,
+			(maxTileX - minTileX + 1) << g_tileBits,
+			(maxTileY - minTileY + 1) << g_tileBits);
+
+	cv::Mat raw(rect.size(), CV_8S, cv::Scalar(-1));
+	cv::Mat filtered(rect.size(), CV_8S, cv::Scalar(-1));
+	// outside the tiles changed since the last getMap(), the cells were already
+	// assembled and filtered in the old buffer, or are unknown
+	cv::Rect overlap = bufferRect_ & rect;
+	if(overlap.area())
+	{
+		raw_(overlap - bufferRect_.tl()).copyTo(raw(overlap - rect.tl()));
+		filtered_(overlap - bufferRect_.tl()).copyTo(filtered(overlap - rect.tl()));
+	}
+	raw_ = raw;
+	filtered_ = filtered;
+	bufferRect_ = rect;
+	UDEBUG("Buffer %dx%d cells", rect.width, rect.height);
+}
+
+cv::Mat OccupancyGridAssembler::getMap(float & xMin, float & yMin, bool erode)
+{
+	cv::Mat map;
+	if(!hasBounds_ || minCell_.x == maxCell_.x || minCell_.y == maxCell_.y)
+	{
+		return map;
+	}
+
+	cv::Rect area(
+			minCell_.x - g_margin,
+			minCell_.y - g_margin,
+			maxCell_.x - minCell_.x + 1 + 2*g_margin,
+			maxCell_.y - minCell_.y + 1 + 2*g_margin);
+	if((area & bufferRect_) != area)
+	{
+		allocateBuffer(area);
+	}
+
+	// assemble the changed tiles
+	for(std::set<std::pair<int, int> >::iterator iter=dirtyTiles_.begin(); iter!=dirtyTiles_.end(); ++iter)
+	{
+		cv::Rect tileRect(iter->first << g_tileBits, iter->second << g_tileBits, g_tileSize, g_tileSize);
+		cv::Rect rect = tileRect & bufferRect_;
+		if(rect.area() == 0)
+		{
+			continue;
+		}
+		std::map<std::pair<int, int>, Tile>::const_iterator jter = tiles_.find(*iter);
+		for(int y=rect.y; y<rect.y+rect.height; ++y)
+		{
+			char * row = raw_.ptr<char>(y - bufferRect_.y);
+			for(int x=rect.x; x<rect.x+rect.width; ++x)
+			{
+				char value = -1;
+				if(jter != tiles_.end())
+				{
+					int index = (y - tileRect.y)*g_tileSize + (x - tileRect.x);
+					if(jter->second.obstacles[index] > 0)
+					{
+						value = 100;
+					}
+					else if(jter->second.empty[index] > 0)
+					{
+						value = 0;
+					}
+				}
+				row[x - bufferRect_.x] = value;
+			}
+		}
+	}
+
+	// filter around the changed tiles
+	if(erode != erode_)
+	{
+		erode_ = erode;
+		filtered_ = util3d::filter2DMap(raw_, erode_);
+	}
+	else
+	{
+		for(std::set<std::pair<int, int> >::iterator iter=dirtyTiles_.begin(); iter!=dirtyTiles_.end(); ++iter)
+		{
+			cv::Rect tileRect(iter->first << g_tileBits, iter->second << g_tileBits, g_tileSize, g_tileSize);
+			cv::Rect output(
+					tileRect.x - g_filterRadius,
+					tileRect.y - g_filterRadius,
+					tileRect.width + 2*g_filterRadius,
+					tileRect.height + 2*g_filterRadius);
+			output &= bufferRect_;
+			cv::Rect input(
+					output.x - g_filterRadius,
+					output.y - g_filterRadius,
+					output.width + 2*g_filterRadius,
+					output.height + 2*g_filterRadius);
+			input &= bufferRect_;
+			if(output.area() == 0)
+			{
+				continue;
+			}
+			cv::Mat filtered = util3d::filter2DMap(raw_(input - bufferRect_.tl()), erode_);
+			filtered(output - input.tl()).copyTo(filtered_(output - bufferRect_.tl()));
+		}
+	}
+	dirtyTiles_.clear();
+
+	xMin = float(area.x)*cellSize_;
+	yMin = float(area.y)*cellSize_;
+	return filtered_(area - bufferRect_.tl());
+}
+
+} /* namespace rtabmap */
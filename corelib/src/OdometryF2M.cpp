@@ -215,7 +215,7 @@ Transform OdometryF2M::computeTransform(
 					guess.isNull()?Transform():this->getPose()*guess,
 					&regInfo);
 
-			data.setFeatures(lastFrame_->sensorData().keypoints(), lastFrame_->sensorData().descriptors());
+			data.setFeatures(lastFrame_->sensorData());
 
 			if(!transform.isNull())
 			{
@@ -417,7 +417,7 @@ Transform OdometryF2M::computeTransform(
 						dummy);
 			}
 
-			data.setFeatures(lastFrame_->sensorData().keypoints(), lastFrame_->sensorData().descriptors());
+			data.setFeatures(lastFrame_->sensorData());
 
 			if(fixedMapPath_.empty())
 			{
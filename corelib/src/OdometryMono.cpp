@@ -308,7 +308,7 @@ Transform OdometryMono::computeTransform(SensorData & data, const Transform & gu
 					std::vector<float> err;
 					UDEBUG("cv::calcOpticalFlowPyrLK() begin");
 					cv::calcOpticalFlowPyrLK(
-							prevS->sensorData().imageRaw(),
+							prevS->sensorData().imagePyramid(cv::Size(flowWinSize_, flowWinSize_), flowMaxLevel_),
 							newFrame,
 							refCorners,
 							newCorners,
@@ -549,8 +549,9 @@ Transform OdometryMono::computeTransform(SensorData & data, const Transform & gu
 			std::vector<unsigned char> statusFlowInliers;
 			std::vector<float> err;
 			UDEBUG("cv::calcOpticalFlowPyrLK() begin");
+			// the pyramid of the reference frame is computed once and reused until the next key frame
 			cv::calcOpticalFlowPyrLK(
-					refS->sensorData().imageRaw(),
+					refS->sensorData().imagePyramid(cv::Size(flowWinSize_, flowWinSize_), flowMaxLevel_),
 					newFrame,
 					refCorners,
 					refCornersGuess,
@@ -29,10 +29,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UStl.h>
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/utilite/UTimer.h>
 #include <rtabmap/core/Optimizer.h>
 #include <rtabmap/core/Graph.h>
 #include <set>
 #include <queue>
+#include <vector>
 
 #include <rtabmap/core/OptimizerTORO.h>
 #include <rtabmap/core/OptimizerG2O.h>
@@ -202,6 +204,294 @@ std::map<int, Transform> Optimizer::optimizeBA(
 	return std::map<int, Transform>();
 }
 
+std::map<int, Transform> Optimizer::optimizeIncremental(
+		int rootId,
+		const std::map<int, Transform> & poses,
+		const std::multimap<int, Link> & constraints,
+		double * finalError,
+		int * iterationsDone,
+		bool * incrementalDone)
+{
+	if(incrementalDone)
+	{
+		*incrementalDone = false;
+	}
+	return optimize(rootId, poses, constraints, 0, finalError, iterationsDone);
+}
+
+// Chain of neighbor links between two skeleton nodes
+struct HierarchicalSegment
+{
+	int from;
+	int to;
+	std::vector<int> ids; // intermediate nodes
+	std::vector<Link> links; // oriented from -> to (links.size() == ids.size()+1)
+};
+
+// Covariance of a link, the diagonal variances are used if its information matrix is singular
+static cv::Mat linkCovariance(const Link & link)
+{
+	cv::Mat covariance;
+	if(cv::invert(link.infMatrix(), covariance) == 0)
+	{
+		covariance = cv::Mat::zeros(6,6,CV_64FC1);
+		for(int k=0; k<6; ++k)
+		{
+			covariance.at<double>(k,k) = 1.0/link.infMatrix().at<double>(k,k);
+		}
+	}
+	return covariance;
+}
+
+std::map<int, Transform> Optimizer::optimizeHierarchical(
+		int rootId,
+		const std::map<int, Transform> & poses,
+		const std::multimap<int, Link> & constraints,
+		int maxSegmentSize,
+		double * finalError,
+		int * iterationsDone,
+		int * skeletonSize)
+{
+	UASSERT(maxSegmentSize >= 1);
+	UASSERT(uContains(poses, rootId));
+	UTimer timer;
+
+	// Skeleton nodes: root, nodes with loop closures and ends of the neighbor chains
+	std::set<int> skeleton;
+	skeleton.insert(rootId);
+	std::multimap<int, const Link *> neighbors;
+	std::multimap<int, Link> skeletonLinks;
+	std::set<std::pair<int, int> > skeletonPairs;
+	for(std::multimap<int, Link>::const_iterator iter=constraints.begin(); iter!=constraints.end(); ++iter)
+	{
+		const Link & link = iter->second;
+		if(!uContains(poses, link.from()) || !uContains(poses, link.to()))
+		{
+			continue;
+		}
+		if(link.type() == Link::kNeighbor || link.type() == Link::kNeighborMerged)
+		{
+			neighbors.insert(std::make_pair(link.from(), &link));
+			neighbors.insert(std::make_pair(link.to(), &link));
+		}
+		else
+		{
+			skeleton.insert(link.from());
+			skeleton.insert(link.to());
+			skeletonLinks.insert(*iter);
+			skeletonPairs.insert(std::make_pair(std::min(link.from(), link.to()), std::max(link.from(), link.to())));
+		}
+	}
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		if(neighbors.count(iter->first) != 2)
+		{
+			skeleton.insert(iter->first);
+		}
+	}
+
+	// Walk the chains from each skeleton node up to the next skeleton node
+	std::vector<HierarchicalSegment> segments;
+	std::set<const Link *> visited;
+	std::list<int> queue(skeleton.begin(), skeleton.end());
+	while(queue.size())
+	{
+		int start = queue.front();
+		queue.pop_front();
+		for(std::multimap<int, const Link *>::const_iterator iter=neighbors.find(start); iter!=neighbors.end() && iter->first==start; ++iter)
+		{
+			if(visited.find(iter->second) != visited.end())
+			{
+				continue;
+			}
+			HierarchicalSegment segment;
+			segment.from = start;
+			int current = start;
+			const Link * link = iter->second;
+			while(true)
+			{
+				visited.insert(link);
+				segment.links.push_back(link->from()==current?*link:link->inverse());
+				current = segment.links.back().to();
+				if(skeleton.find(current) != skeleton.end())
+				{
+					break;
+				}
+				if((int)segment.links.size() >= maxSegmentSize)
+				{
+					skeleton.insert(current);
+					queue.push_back(current);
+					break;
+				}
+				segment.ids.push_back(current);
+				// intermediate nodes have exactly two neighbor links
+				std::multimap<int, const Link *>::const_iterator jter=neighbors.find(current);
+				link = jter->second==link?(++jter)->second:jter->second;
+			}
+			segment.to = current;
+			segments.push_back(segment);
+		}
+	}
+
+	if(visited.size() != neighbors.size()/2)
+	{
+		UWARN("Hierarchical optimization: some neighbor links are not reachable from "
+			  "skeleton nodes (%d/%d), doing batch optimization...", (int)visited.size(), (int)neighbors.size()/2);
+		return optimize(rootId, poses, constraints, 0, finalError, iterationsDone);
+	}
+
+	// Only one link between two skeleton nodes: split segments
+	// ending on nodes already linked together.
+	for(unsigned int i=0; i<segments.size(); ++i)
+	{
+		HierarchicalSegment & segment = segments[i];
+		if(segment.from == segment.to)
+		{
+			UWARN("Hierarchical optimization: cycle of neighbor links detected on node %d, doing batch optimization...", segment.from);
+			return optimize(rootId, poses, constraints, 0, finalError, iterationsDone);
+		}
+		std::pair<int, int> pair(std::min(segment.from, segment.to), std::max(segment.from, segment.to));
+		if(skeletonPairs.find(pair) != skeletonPairs.end() && segment.ids.size())
+		{
+			int mid = (int)segment.ids.size()/2;
+			HierarchicalSegment second;
+			second.from = segment.ids[mid];
+			second.to = segment.to;
+			second.ids.assign(segment.ids.begin()+mid+1, segment.ids.end());
+			second.links.assign(segment.links.begin()+mid+1, segment.links.end());
+			segment.to = segment.ids[mid];
+			segment.ids.resize(mid);
+			segment.links.resize(mid+1);
+			skeleton.insert(second.from);
+			segments.push_back(second); // invalidates "segment"
+			pair = std::make_pair(std::min(segments[i].from, segments[i].to), std::max(segments[i].from, segments[i].to));
+		}
+		skeletonPairs.insert(pair);
+	}
+
+	// Composed relative constraints, the covariance is the sum of the link covariances
+	std::vector<Link> segmentLinks(segments.size());
+#ifdef _OPENMP
+	#pragma omp parallel for
+#endif
+	for(int i=0; i<(int)segments.size(); ++i)
+	{
+		const HierarchicalSegment & segment = segments[i];
+		if(segment.links.size() == 1)
+		{
+			segmentLinks[i] = segment.links[0];
+		}
+		else
+		{
+			Transform t = Transform::getIdentity();
+			cv::Mat covariance = cv::Mat::zeros(6,6,CV_64FC1);
+			for(unsigned int j=0; j<segment.links.size(); ++j)
+			{
+				t *= segment.links[j].transform();
+				covariance += linkCovariance(segment.links[j]);
+			}
+			cv::Mat information;
+			if(cv::invert(covariance, information) == 0)
+			{
+				// singular sum, keep only the variances
+				information = cv::Mat::zeros(6,6,CV_64FC1);
+				for(int k=0; k<6; ++k)
+				{
+					information.at<double>(k,k) = 1.0/covariance.at<double>(k,k);
+				}
+			}
+			segmentLinks[i] = Link(segment.from, segment.to, Link::kNeighborMerged, t, information);
+		}
+	}
+	for(unsigned int i=0; i<segments.size(); ++i)
+	{
+		skeletonLinks.insert(std::make_pair(segments[i].from, segmentLinks[i]));
+	}
+	std::map<int, Transform> skeletonPoses;
+	for(std::set<int>::iterator iter=skeleton.begin(); iter!=skeleton.end(); ++iter)
+	{
+		skeletonPoses.insert(*poses.find(*iter));
+	}
+	if(skeletonSize)
+	{
+		*skeletonSize = (int)skeletonPoses.size();
+	}
+	double skeletonTime = timer.ticks();
+
+	std::map<int, Transform> optimizedSkeleton = optimize(rootId, skeletonPoses, skeletonLinks, 0, finalError, iterationsDone);
+	if(optimizedSkeleton.size() != skeletonPoses.size())
+	{
+		UERROR("Hierarchical optimization: skeleton optimization failed (%d/%d poses)!",
+				(int)optimizedSkeleton.size(), (int)skeletonPoses.size());
+		return std::map<int, Transform>();
+	}
+	double optimizationTime = timer.ticks();
+
+	// Recover the other poses: dead-reckoning from the optimized start of
+	// their segment, with the closing error distributed along the segment
+	// proportionally to the link variances.
+	std::map<int, Transform> optimizedPoses = optimizedSkeleton;
+	std::vector<std::vector<Transform *> > outputs(segments.size());
+	for(unsigned int i=0; i<segments.size(); ++i)
+	{
+		outputs[i].resize(segments[i].ids.size());
+		for(unsigned int j=0; j<segments[i].ids.size(); ++j)
+		{
+			outputs[i][j] = &optimizedPoses.insert(optimizedPoses.end(), std::make_pair(segments[i].ids[j], Transform()))->second;
+		}
+	}
+#ifdef _OPENMP
+	#pragma omp parallel for
+#endif
+	for(int i=0; i<(int)segments.size(); ++i)
+	{
+		const HierarchicalSegment & segment = segments[i];
+		if(segment.ids.empty())
+		{
+			continue;
+		}
+		const Transform & start = optimizedSkeleton.at(segment.from);
+		const Transform & end = optimizedSkeleton.at(segment.to);
+		std::vector<Transform> chain(segment.links.size());
+		std::vector<double> transVariances(segment.links.size());
+		std::vector<double> rotVariances(segment.links.size());
+		Transform t = start;
+		double transVariance = 0.0;
+		double rotVariance = 0.0;
+		for(unsigned int j=0; j<segment.links.size(); ++j)
+		{
+			t = t * segment.links[j].transform();
+			chain[j] = t;
+			transVariance += segment.links[j].transVariance();
+			rotVariance += segment.links[j].rotVariance();
+			transVariances[j] = transVariance;
+			rotVariances[j] = rotVariance;
+		}
+		// correction closing the segment on the optimized end (in start frame),
+		// translation and rotation errors are distributed independently
+		Transform startInv = start.inverse();
+		Transform correction = startInv * end * chain.back().inverse() * start;
+		for(unsigned int j=0; j<segment.ids.size(); ++j)
+		{
+			float linear = float(j+1)/float(segment.links.size());
+			float transRatio = transVariance > 0.0?float(transVariances[j]/transVariance):linear;
+			float rotRatio = rotVariance > 0.0?float(rotVariances[j]/rotVariance):linear;
+			Transform partial =
+					Transform::getIdentity().interpolate(transRatio, correction).translation() *
+					Transform::getIdentity().interpolate(rotRatio, correction).rotation();
+			*outputs[i][j] = start * partial * startInv * chain[j];
+		}
+	}
+	UASSERT(optimizedPoses.size() == poses.size());
+
+	UINFO("Hierarchical optimization: %d poses, %d links -> skeleton of %d poses, %d links "
+		  "(skeleton=%fs, optimization=%fs, recovery=%fs)",
+			(int)poses.size(), (int)constraints.size(),
+			(int)skeletonPoses.size(), (int)skeletonLinks.size(),
+			skeletonTime, optimizationTime, timer.ticks());
+	return optimizedPoses;
+}
+
 void Optimizer::getConnectedGraph(
 		int fromId,
 		const std::map<int, Transform> & posesIn,
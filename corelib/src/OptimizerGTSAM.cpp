@@ -49,6 +49,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <gtsam/nonlinear/NonlinearOptimizer.h>
 #include <gtsam/nonlinear/Marginals.h>
 #include <gtsam/nonlinear/Values.h>
+#include <gtsam/nonlinear/ISAM2.h>
 
 #ifdef RTABMAP_VERTIGO
 #include "vertigo/gtsam/betweenFactorMaxMix.h"
@@ -60,6 +61,100 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace rtabmap {
 
+#ifdef RTABMAP_GTSAM
+static gtsam::noiseModel::Gaussian::shared_ptr linkNoiseModel(const Link & link, bool slam2d, bool covarianceIgnored)
+{
+	if(slam2d)
+	{
+		Eigen::Matrix<double, 3, 3> information = Eigen::Matrix<double, 3, 3>::Identity();
+		if(!covarianceIgnored)
+		{
+			// For some reasons, dividing by 1000 avoids some exceptions (maybe too large numbers on optimization)
+			information(0,0) = link.infMatrix().at<double>(0,0)/1000.0; // x-x
+			information(0,1) = link.infMatrix().at<double>(0,1)/1000.0; // x-y
+			information(0,2) = link.infMatrix().at<double>(0,5)/1000.0; // x-theta
+			information(1,0) = link.infMatrix().at<double>(1,0)/1000.0; // y-x
+			information(1,1) = link.infMatrix().at<double>(1,1)/1000.0; // y-y
+			information(1,2) = link.infMatrix().at<double>(1,5)/1000.0; // y-theta
+			information(2,0) = link.infMatrix().at<double>(5,0)/1000.0; // theta-x
+			information(2,1) = link.infMatrix().at<double>(5,1)/1000.0; // theta-y
+			information(2,2) = link.infMatrix().at<double>(5,5)/1000.0; // theta-theta
+		}
+		return gtsam::noiseModel::Gaussian::Information(information);
+	}
+
+	Eigen::Matrix<double, 6, 6> information = Eigen::Matrix<double, 6, 6>::Identity();
+	if(!covarianceIgnored)
+	{
+		memcpy(information.data(), link.infMatrix().data, link.infMatrix().total()*sizeof(double));
+		// For some reasons, dividing by 1000 avoids some exceptions (maybe too large numbers on optimization)
+		information = information / 1000.0;
+	}
+	return gtsam::noiseModel::Gaussian::Information(information);
+}
+
+static void addPriorFactor(gtsam::NonlinearFactorGraph & graph, int id, const Transform & pose, bool slam2d)
+{
+	if(slam2d)
+	{
+		gtsam::noiseModel::Diagonal::shared_ptr priorNoise = gtsam::noiseModel::Diagonal::Sigmas(gtsam::Vector3(0.01, 0.01, 0.01));
+		graph.add(gtsam::PriorFactor<gtsam::Pose2>(id, gtsam::Pose2(pose.x(), pose.y(), pose.theta()), priorNoise));
+	}
+	else
+	{
+		gtsam::noiseModel::Diagonal::shared_ptr priorNoise = gtsam::noiseModel::Diagonal::Sigmas((gtsam::Vector(6) << 1e-6, 1e-6, 1e-6, 1e-4, 1e-4, 1e-4).finished());
+		graph.add(gtsam::PriorFactor<gtsam::Pose3>(id, gtsam::Pose3(pose.toEigen4d()), priorNoise));
+	}
+}
+
+static void addBetweenFactor(gtsam::NonlinearFactorGraph & graph, const Link & link, bool slam2d, bool covarianceIgnored)
+{
+	gtsam::noiseModel::Gaussian::shared_ptr model = linkNoiseModel(link, slam2d, covarianceIgnored);
+	if(slam2d)
+	{
+		graph.add(gtsam::BetweenFactor<gtsam::Pose2>(link.from(), link.to(), gtsam::Pose2(link.transform().x(), link.transform().y(), link.transform().theta()), model));
+	}
+	else
+	{
+		graph.add(gtsam::BetweenFactor<gtsam::Pose3>(link.from(), link.to(), gtsam::Pose3(link.transform().toEigen4d()), model));
+	}
+}
+
+static void insertValue(gtsam::Values & values, int id, const Transform & pose, bool slam2d)
+{
+	if(slam2d)
+	{
+		values.insert(id, gtsam::Pose2(pose.x(), pose.y(), pose.theta()));
+	}
+	else
+	{
+		values.insert(id, gtsam::Pose3(pose.toEigen4d()));
+	}
+}
+
+static std::map<int, Transform> valuesToPoses(const gtsam::Values & values, bool slam2d)
+{
+	std::map<int, Transform> poses;
+	for(gtsam::Values::const_iterator iter=values.begin(); iter!=values.end(); ++iter)
+	{
+		if(iter->value.dim() > 1)
+		{
+			if(slam2d)
+			{
+				gtsam::Pose2 p = iter->value.cast<gtsam::Pose2>();
+				poses.insert(std::make_pair((int)iter->key, Transform(p.x(), p.y(), p.theta())));
+			}
+			else
+			{
+				gtsam::Pose3 p = iter->value.cast<gtsam::Pose3>();
+				poses.insert(std::make_pair((int)iter->key, Transform::fromEigen4d(p.matrix())));
+			}
+		}
+	}
+	return poses;
+}
+#endif
+
 bool OptimizerGTSAM::available()
 {
 #ifdef RTABMAP_GTSAM
@@ -95,31 +190,14 @@ std::map<int, Transform> OptimizerGTSAM::optimize(
 
 		//prior first pose
 		UASSERT(uContains(poses, rootId));
-		const Transform & initialPose = poses.at(rootId);
-		if(isSlam2d())
-		{
-			gtsam::noiseModel::Diagonal::shared_ptr priorNoise = gtsam::noiseModel::Diagonal::Sigmas(gtsam::Vector3(0.01, 0.01, 0.01));
-			graph.add(gtsam::PriorFactor<gtsam::Pose2>(rootId, gtsam::Pose2(initialPose.x(), initialPose.y(), initialPose.theta()), priorNoise));
-		}
-		else
-		{
-			gtsam::noiseModel::Diagonal::shared_ptr priorNoise = gtsam::noiseModel::Diagonal::Sigmas((gtsam::Vector(6) << 1e-6, 1e-6, 1e-6, 1e-4, 1e-4, 1e-4).finished());
-			graph.add(gtsam::PriorFactor<gtsam::Pose3>(rootId, gtsam::Pose3(initialPose.toEigen4d()), priorNoise));
-		}
+		addPriorFactor(graph, rootId, poses.at(rootId), isSlam2d());
 
 		UDEBUG("fill poses to gtsam...");
 		gtsam::Values initialEstimate;
 		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
 		{
 			UASSERT(!iter->second.isNull());
-			if(isSlam2d())
-			{
-				initialEstimate.insert(iter->first, gtsam::Pose2(iter->second.x(), iter->second.y(), iter->second.theta()));
-			}
-			else
-			{
-				initialEstimate.insert(iter->first, gtsam::Pose3(iter->second.toEigen4d()));
-			}
+			insertValue(initialEstimate, iter->first, iter->second, isSlam2d());
 		}
 
 		UDEBUG("fill edges to gtsam...");
@@ -156,21 +234,7 @@ std::map<int, Transform> OptimizerGTSAM::optimize(
 
 			if(isSlam2d())
 			{
-				Eigen::Matrix<double, 3, 3> information = Eigen::Matrix<double, 3, 3>::Identity();
-				if(!isCovarianceIgnored())
-				{
-					// For some reasons, dividing by 1000 avoids some exceptions (maybe too large numbers on optimization)
-					information(0,0) = iter->second.infMatrix().at<double>(0,0)/1000.0; // x-x
-					information(0,1) = iter->second.infMatrix().at<double>(0,1)/1000.0; // x-y
-					information(0,2) = iter->second.infMatrix().at<double>(0,5)/1000.0; // x-theta
-					information(1,0) = iter->second.infMatrix().at<double>(1,0)/1000.0; // y-x
-					information(1,1) = iter->second.infMatrix().at<double>(1,1)/1000.0; // y-y
-					information(1,2) = iter->second.infMatrix().at<double>(1,5)/1000.0; // y-theta
-					information(2,0) = iter->second.infMatrix().at<double>(5,0)/1000.0; // theta-x
-					information(2,1) = iter->second.infMatrix().at<double>(5,1)/1000.0; // theta-y
-					information(2,2) = iter->second.infMatrix().at<double>(5,5)/1000.0; // theta-theta
-				}
-				gtsam::noiseModel::Gaussian::shared_ptr model = gtsam::noiseModel::Gaussian::Information(information);
+				gtsam::noiseModel::Gaussian::shared_ptr model = linkNoiseModel(iter->second, true, isCovarianceIgnored());
 
 #ifdef RTABMAP_VERTIGO
 				if(this->isRobust() &&
@@ -188,15 +252,7 @@ std::map<int, Transform> OptimizerGTSAM::optimize(
 			}
 			else
 			{
-				Eigen::Matrix<double, 6, 6> information = Eigen::Matrix<double, 6, 6>::Identity();
-				if(!isCovarianceIgnored())
-				{
-					memcpy(information.data(), iter->second.infMatrix().data, iter->second.infMatrix().total()*sizeof(double));
-					// For some reasons, dividing by 1000 avoids some exceptions (maybe too large numbers on optimization)
-					information = information / 1000.0;
-				}
-
-				gtsam::noiseModel::Gaussian::shared_ptr model = gtsam::noiseModel::Gaussian::Information(information);
+				gtsam::noiseModel::Gaussian::shared_ptr model = linkNoiseModel(iter->second, false, isCovarianceIgnored());
 
 #ifdef RTABMAP_VERTIGO
 				if(this->isRobust() &&
@@ -299,36 +355,294 @@ std::map<int, Transform> OptimizerGTSAM::optimize(
 		}
 		UINFO("GTSAM optimizing end (%d iterations done, error=%f (initial=%f final=%f), time=%f s)", optimizer.iterations(), optimizer.error(), graph.error(initialEstimate), graph.error(optimizer.values()), timer.ticks());
 
-		for(gtsam::Values::const_iterator iter=optimizer.values().begin(); iter!=optimizer.values().end(); ++iter)
+		optimizedPoses = valuesToPoses(optimizer.values(), isSlam2d());
+	}
+	else if(poses.size() == 1 || iterations() <= 0)
+	{
+		optimizedPoses = poses;
+	}
+	else
+	{
+		UWARN("This method should be called at least with 1 pose!");
+	}
+	UDEBUG("Optimizing graph...end!");
+#else
+	UERROR("Not built with GTSAM support!");
+#endif
+	return optimizedPoses;
+}
+
+OptimizerGTSAM::~OptimizerGTSAM()
+{
+	resetIncremental();
+}
+
+OptimizerGTSAM::IsamLinkKey OptimizerGTSAM::isamLinkKey(const Link & link)
+{
+	// Links are identified by their end points and their type, so that
+	// parallel links of different types between the same nodes (e.g.,
+	// neighbor + loop closure) don't look like a structural change.
+	return std::make_pair(std::make_pair(link.from(), link.to()), (int)link.type());
+}
+
+void OptimizerGTSAM::resetIncremental()
+{
+#ifdef RTABMAP_GTSAM
+	delete isam_;
+#endif
+	isam_ = 0;
+	isamRootId_ = 0;
+	isamPoses_.clear();
+	isamLinks_.clear();
+}
+
+std::map<int, Transform> OptimizerGTSAM::optimizeIncremental(
+		int rootId,
+		const std::map<int, Transform> & poses,
+		const std::multimap<int, Link> & edgeConstraints,
+		double * finalError,
+		int * iterationsDone,
+		bool * incrementalDone)
+{
+	if(incrementalDone)
+	{
+		*incrementalDone = false;
+	}
+#ifdef RTABMAP_GTSAM
+	if(!isIncrementalAvailable() || edgeConstraints.size()<1 || poses.size()<2 || iterations() <= 0)
+	{
+		resetIncremental();
+		return optimize(rootId, poses, edgeConstraints, 0, finalError, iterationsDone);
+	}
+
+	UTimer timer;
+
+	// Structural change detection: all poses and links already
+	// in the problem should be still there and unchanged.
+	bool structuralChange = isam_ == 0 || isamSlam2d_ != isSlam2d() || !uContains(poses, isamRootId_);
+	for(std::set<int>::const_iterator iter=isamPoses_.begin(); !structuralChange && iter!=isamPoses_.end(); ++iter)
+	{
+		structuralChange = poses.find(*iter) == poses.end();
+	}
+	std::list<const Link *> newLinks;
+	unsigned int linksFound = 0;
+	for(std::multimap<int, Link>::const_iterator iter=edgeConstraints.begin(); !structuralChange && iter!=edgeConstraints.end(); ++iter)
+	{
+		UASSERT(!iter->second.transform().isNull());
+		std::map<IsamLinkKey, Link>::const_iterator jter = isamLinks_.find(isamLinkKey(iter->second));
+		if(jter == isamLinks_.end())
 		{
-			if(iter->value.dim() > 1)
+			newLinks.push_back(&iter->second);
+		}
+		else if(jter->second.transform() != iter->second.transform() ||
+				jter->second.transVariance() != iter->second.transVariance() ||
+				jter->second.rotVariance() != iter->second.rotVariance())
+		{
+			structuralChange = true;
+		}
+		else
+		{
+			++linksFound;
+		}
+	}
+	structuralChange = structuralChange || linksFound != isamLinks_.size();
+
+	std::map<int, Transform> optimizedPoses;
+	if(structuralChange)
+	{
+		UINFO("GTSAM incremental: structural change detected (poses=%d/%d, links=%d/%d), doing batch optimization...",
+				(int)poses.size(), (int)isamPoses_.size(), (int)edgeConstraints.size(), (int)isamLinks_.size());
+		resetIncremental();
+		optimizedPoses = optimize(rootId, poses, edgeConstraints, 0, finalError, iterationsDone);
+		if(optimizedPoses.size() == poses.size())
+		{
+			// initialize the incremental problem with the batch solution
+			gtsam::NonlinearFactorGraph graph;
+			gtsam::Values values;
+			addPriorFactor(graph, rootId, optimizedPoses.at(rootId), isSlam2d());
+			for(std::map<int, Transform>::const_iterator iter=optimizedPoses.begin(); iter!=optimizedPoses.end(); ++iter)
+			{
+				insertValue(values, iter->first, iter->second, isSlam2d());
+				isamPoses_.insert(iter->first);
+			}
+			for(std::multimap<int, Link>::const_iterator iter=edgeConstraints.begin(); iter!=edgeConstraints.end(); ++iter)
+			{
+				addBetweenFactor(graph, iter->second, isSlam2d(), isCovarianceIgnored());
+				isamLinks_.insert(std::make_pair(isamLinkKey(iter->second), iter->second));
+			}
+			gtsam::ISAM2Params params;
+			params.relinearizeThreshold = 0.01;
+			params.relinearizeSkip = 1;
+			isam_ = new gtsam::ISAM2(params);
+			isamRootId_ = rootId;
+			isamSlam2d_ = isSlam2d();
+			try
+			{
+				isam_->update(graph, values);
+			}
+			catch(gtsam::IndeterminantLinearSystemException & e)
+			{
+				UWARN("GTSAM exception catched while initializing iSAM2: %s", e.what());
+				resetIncremental();
+			}
+		}
+		UINFO("GTSAM incremental: batch optimization time=%fs", timer.ticks());
+		return optimizedPoses;
+	}
+
+	// Initial guess of new poses: chained from poses already estimated
+	// through new links, otherwise from odometry corrected by the root's estimate.
+	std::map<int, Transform> estimates;
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		if(isamPoses_.find(iter->first) == isamPoses_.end())
+		{
+			estimates.insert(std::make_pair(iter->first, Transform()));
+		}
+	}
+	std::map<int, Transform> knownEstimates;
+	bool progress = true;
+	while(progress)
+	{
+		progress = false;
+		for(std::list<const Link *>::const_iterator iter=newLinks.begin(); iter!=newLinks.end(); ++iter)
+		{
+			int from = (*iter)->from();
+			int to = (*iter)->to();
+			std::map<int, Transform>::iterator fromIter = estimates.find(from);
+			std::map<int, Transform>::iterator toIter = estimates.find(to);
+			bool fromKnown = fromIter == estimates.end() || !fromIter->second.isNull();
+			bool toKnown = toIter == estimates.end() || !toIter->second.isNull();
+			if(fromKnown != toKnown)
+			{
+				int knownId = fromKnown?from:to;
+				Transform knownPose;
+				if(estimates.find(knownId) != estimates.end())
+				{
+					knownPose = estimates.at(knownId);
+				}
+				else if(knownEstimates.find(knownId) != knownEstimates.end())
+				{
+					knownPose = knownEstimates.at(knownId);
+				}
+				else
+				{
+					if(isSlam2d())
+					{
+						gtsam::Pose2 p = isam_->calculateEstimate<gtsam::Pose2>(knownId);
+						knownPose = Transform(p.x(), p.y(), p.theta());
+					}
+					else
+					{
+						gtsam::Pose3 p = isam_->calculateEstimate<gtsam::Pose3>(knownId);
+						knownPose = Transform::fromEigen4d(p.matrix());
+					}
+					knownEstimates.insert(std::make_pair(knownId, knownPose));
+				}
+				if(fromKnown)
+				{
+					toIter->second = knownPose * (*iter)->transform();
+				}
+				else
+				{
+					fromIter->second = knownPose * (*iter)->transform().inverse();
+				}
+				progress = true;
+			}
+		}
+	}
+
+	gtsam::NonlinearFactorGraph newFactors;
+	gtsam::Values newValues;
+	Transform rootCorrection;
+	for(std::map<int, Transform>::iterator iter=estimates.begin(); iter!=estimates.end(); ++iter)
+	{
+		if(iter->second.isNull())
+		{
+			if(rootCorrection.isNull())
 			{
 				if(isSlam2d())
 				{
-					gtsam::Pose2 p = iter->value.cast<gtsam::Pose2>();
-					optimizedPoses.insert(std::make_pair((int)iter->key, Transform(p.x(), p.y(), p.theta())));
+					gtsam::Pose2 p = isam_->calculateEstimate<gtsam::Pose2>(isamRootId_);
+					rootCorrection = Transform(p.x(), p.y(), p.theta()) * poses.at(isamRootId_).inverse();
 				}
 				else
 				{
-					gtsam::Pose3 p = iter->value.cast<gtsam::Pose3>();
-					optimizedPoses.insert(std::make_pair((int)iter->key, Transform::fromEigen4d(p.matrix())));
+					gtsam::Pose3 p = isam_->calculateEstimate<gtsam::Pose3>(isamRootId_);
+					rootCorrection = Transform::fromEigen4d(p.matrix()) * poses.at(isamRootId_).inverse();
 				}
 			}
+			iter->second = rootCorrection * poses.at(iter->first);
 		}
+		insertValue(newValues, iter->first, iter->second, isSlam2d());
 	}
-	else if(poses.size() == 1 || iterations() <= 0)
+	for(std::list<const Link *>::const_iterator iter=newLinks.begin(); iter!=newLinks.end(); ++iter)
 	{
-		optimizedPoses = poses;
+		addBetweenFactor(newFactors, **iter, isSlam2d(), isCovarianceIgnored());
 	}
-	else
+
+	UINFO("GTSAM incremental: adding %d poses and %d links (total poses=%d links=%d)",
+			(int)newValues.size(), (int)newFactors.size(), (int)poses.size(), (int)edgeConstraints.size());
+	int it = 0;
+	try
 	{
-		UWARN("This method should be called at least with 1 pose!");
+		gtsam::ISAM2Result result = isam_->update(newFactors, newValues);
+		++it;
+		// Additional relinearization steps, until no more variables are relinearized
+		while(it < iterations() && result.variablesRelinearized > 0)
+		{
+			result = isam_->update();
+			++it;
+		}
 	}
-	UDEBUG("Optimizing graph...end!");
+	catch(gtsam::IndeterminantLinearSystemException & e)
+	{
+		UWARN("GTSAM exception catched during incremental update: %s. Doing batch optimization...", e.what());
+		resetIncremental();
+		return optimize(rootId, poses, edgeConstraints, 0, finalError, iterationsDone);
+	}
+
+	for(std::map<int, Transform>::iterator iter=estimates.begin(); iter!=estimates.end(); ++iter)
+	{
+		isamPoses_.insert(iter->first);
+	}
+	for(std::list<const Link *>::const_iterator iter=newLinks.begin(); iter!=newLinks.end(); ++iter)
+	{
+		isamLinks_.insert(std::make_pair(isamLinkKey(**iter), **iter));
+	}
+
+	gtsam::Values values = isam_->calculateEstimate();
+	optimizedPoses = valuesToPoses(values, isSlam2d());
+
+	// The root of the problem may not be the requested root, move the
+	// graph so that the requested root keeps its input pose.
+	std::map<int, Transform>::iterator rootIter = optimizedPoses.find(rootId);
+	UASSERT(rootIter != optimizedPoses.end());
+	Transform gauge = poses.at(rootId) * rootIter->second.inverse();
+	for(std::map<int, Transform>::iterator iter=optimizedPoses.begin(); iter!=optimizedPoses.end(); ++iter)
+	{
+		iter->second = gauge * iter->second;
+	}
+
+	double error = isam_->getFactorsUnsafe().error(values);
+	if(finalError)
+	{
+		*finalError = error;
+	}
+	if(iterationsDone)
+	{
+		*iterationsDone = it;
+	}
+	if(incrementalDone)
+	{
+		*incrementalDone = true;
+	}
+	UINFO("GTSAM incremental optimizing end (%d updates, error=%f, time=%f s)", it, error, timer.ticks());
+	return optimizedPoses;
 #else
 	UERROR("Not built with GTSAM support!");
+	return std::map<int, Transform>();
 #endif
-	return optimizedPoses;
 }
 
 } /* namespace rtabmap */
@@ -0,0 +1,376 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/PoseSpatialIndex.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace rtabmap {
+
+PoseSpatialIndex::PoseSpatialIndex(float cellSize) :
+	cellSize_(cellSize),
+	hasBounds_(false),
+	lastAdded_(0),
+	lastMoved_(0),
+	lastRemoved_(0),
+	lastUpdateTime_(0.0),
+	updatesTime_(0.0),
+	queries_(0),
+	queriesTime_(0.0)
+{
+	UASSERT(cellSize_ > 0.0f);
+}
+
+void PoseSpatialIndex::setCellSize(float cellSize)
+{
+	UASSERT(cellSize > 0.0f);
+	if(cellSize != cellSize_)
+	{
+		cellSize_ = cellSize;
+		std::map<int, Transform> poses;
+		for(std::map<int, Node>::iterator iter=nodes_.begin(); iter!=nodes_.end(); ++iter)
+		{
+			poses.insert(poses.end(), std::make_pair(iter->first, iter->second.pose));
+		}
+		clear();
+		update(poses);
+	}
+}
+
+void PoseSpatialIndex::clear()
+{
+	nodes_.clear();
+	cells_.clear();
+	hasBounds_ = false;
+	lastAdded_ = 0;
+	lastMoved_ = 0;
+	lastRemoved_ = 0;
+	lastUpdateTime_ = 0.0;
+}
+
+int PoseSpatialIndex::update(const std::map<int, Transform> & poses)
+{
+	UTimer timer;
+	lastAdded_ = 0;
+	lastMoved_ = 0;
+	lastRemoved_ = 0;
+
+	// both maps are sorted by id
+	std::map<int, Node>::iterator iter = nodes_.begin();
+	std::map<int, Transform>::const_iterator jter = poses.begin();
+	while(iter!=nodes_.end() || jter!=poses.end())
+	{
+		if(jter==poses.end() || (iter!=nodes_.end() && iter->first < jter->first))
+		{
+			removeFromCell(iter->first, iter->second.cell);
+			nodes_.erase(iter++);
+			++lastRemoved_;
+		}
+		else if(iter==nodes_.end() || jter->first < iter->first)
+		{
+			UASSERT_MSG(!jter->second.isNull(), uFormat("id=%d", jter->first).c_str());
+			Node node;
+			node.pose = Transform(jter->second.dataMatrix().clone());
+			node.cell = cellOf(node.pose.x(), node.pose.y(), node.pose.z());
+			nodes_.insert(iter, std::make_pair(jter->first, node));
+			insertInCell(jter->first, node.cell);
+			++jter;
+			++lastAdded_;
+		}
+		else
+		{
+			if(iter->second.pose != jter->second)
+			{
+				UASSERT_MSG(!jter->second.isNull(), uFormat("id=%d", jter->first).c_str());
+				iter->second.pose = Transform(jter->second.dataMatrix().clone());
+				Cell cell = cellOf(iter->second.pose.x(), iter->second.pose.y(), iter->second.pose.z());
+				if(!(cell == iter->second.cell))
+				{
+					removeFromCell(iter->first, iter->second.cell);
+					insertInCell(iter->first, cell);
+					iter->second.cell = cell;
+				}
+				++lastMoved_;
+			}
+			++iter;
+			++jter;
+		}
+	}
+	lastUpdateTime_ = timer.ticks();
+	updatesTime_ += lastUpdateTime_;
+	UDEBUG("nodes=%d cells=%d (added=%d moved=%d removed=%d) time=%fs",
+			(int)nodes_.size(), (int)cells_.size(), lastAdded_, lastMoved_, lastRemoved_, lastUpdateTime_);
+	return lastAdded_ + lastMoved_ + lastRemoved_;
+}
+
+void PoseSpatialIndex::add(int id, const Transform & pose)
+{
+	UASSERT(!pose.isNull());
+	remove(id);
+	Node node;
+	node.pose = Transform(pose.dataMatrix().clone());
+	node.cell = cellOf(pose.x(), pose.y(), pose.z());
+	nodes_.insert(std::make_pair(id, node));
+	insertInCell(id, node.cell);
+}
+
+void PoseSpatialIndex::remove(int id)
+{
+	std::map<int, Node>::iterator iter = nodes_.find(id);
+	if(iter != nodes_.end())
+	{
+		removeFromCell(id, iter->second.cell);
+		nodes_.erase(iter);
+	}
+}
+
+const Transform & PoseSpatialIndex::getPose(int id) const
+{
+	std::map<int, Node>::const_iterator iter = nodes_.find(id);
+	UASSERT_MSG(iter != nodes_.end(), uFormat("id=%d", id).c_str());
+	return iter->second.pose;
+}
+
+int PoseSpatialIndex::nearest(const Transform & pose, const std::set<int> & ignoredIds) const
+{
+	if(nodes_.empty() || pose.isNull())
+	{
+		return 0;
+	}
+	UTimer timer;
+	float x = pose.x();
+	float y = pose.y();
+	float z = pose.z();
+	Cell center = cellOf(x, y, z);
+
+	// Search by rings of cells around the query cell. The cells of ring k+1 are
+	// at least k*cellSize from the query, stop when the nearest node found is closer.
+	int id = 0;
+	float bestSqrd = std::numeric_limits<float>::max();
+	int maxRing = std::max(
+			std::max(std::max(center.x-minCell_.x, maxCell_.x-center.x), std::max(center.y-minCell_.y, maxCell_.y-center.y)),
+			std::max(center.z-minCell_.z, maxCell_.z-center.z));
+	long visited = 0;
+	for(int k=0; k<=maxRing; ++k)
+	{
+		int x0 = std::max(center.x-k, minCell_.x), x1 = std::min(center.x+k, maxCell_.x);
+		int y0 = std::max(center.y-k, minCell_.y), y1 = std::min(center.y+k, maxCell_.y);
+		int z0 = std::max(center.z-k, minCell_.z), z1 = std::min(center.z+k, maxCell_.z);
+		visited += long(x1-x0+1)*long(y1-y0+1)*long(z1-z0+1);
+		if(visited > (long)cells_.size()*4)
+		{
+			// sparse index, a linear search is faster
+			id = bruteForceNearest(x, y, z, ignoredIds);
+			break;
+		}
+		for(int cx=x0; cx<=x1; ++cx)
+		{
+			for(int cy=y0; cy<=y1; ++cy)
+			{
+				for(int cz=z0; cz<=z1; ++cz)
+				{
+					// only the shell of the ring
+					if(k>0 && abs(cx-center.x)!=k && abs(cy-center.y)!=k && abs(cz-center.z)!=k)
+					{
+						continue;
+					}
+					std::map<Cell, std::vector<int> >::const_iterator iter = cells_.find(Cell(cx, cy, cz));
+					if(iter == cells_.end())
+					{
+						continue;
+					}
+					for(unsigned int i=0; i<iter->second.size(); ++i)
+					{
+						int candidate = iter->second[i];
+						if(ignoredIds.size() && ignoredIds.find(candidate) != ignoredIds.end())
+						{
+							continue;
+						}
+						const Transform & p = nodes_.find(candidate)->second.pose;
+						float dx = p.x()-x, dy = p.y()-y, dz = p.z()-z;
+						float d = dx*dx + dy*dy + dz*dz;
+						if(d < bestSqrd || (d == bestSqrd && candidate < id))
+						{
+							bestSqrd = d;
+							id = candidate;
+						}
+					}
+				}
+			}
+		}
+		if(id > 0 && bestSqrd <= float(k)*cellSize_*float(k)*cellSize_)
+		{
+			break;
+		}
+	}
+	++queries_;
+	queriesTime_ += timer.ticks();
+	return id;
+}
+
+std::map<int, float> PoseSpatialIndex::radiusSearch(const Transform & pose, float radius) const
+{
+	std::map<int, float> found;
+	if(nodes_.empty() || pose.isNull() || radius <= 0.0f)
+	{
+		return found;
+	}
+	UTimer timer;
+	float x = pose.x();
+	float y = pose.y();
+	float z = pose.z();
+	float radiusSqrd = radius*radius;
+	Cell c0 = cellOf(x-radius, y-radius, z-radius);
+	Cell c1 = cellOf(x+radius, y+radius, z+radius);
+	c0 = Cell(std::max(c0.x, minCell_.x), std::max(c0.y, minCell_.y), std::max(c0.z, minCell_.z));
+	c1 = Cell(std::min(c1.x, maxCell_.x), std::min(c1.y, maxCell_.y), std::min(c1.z, maxCell_.z));
+	long range = long(c1.x-c0.x+1)*long(c1.y-c0.y+1)*long(c1.z-c0.z+1);
+	if(c0.x<=c1.x && c0.y<=c1.y && c0.z<=c1.z)
+	{
+		if(range <= (long)cells_.size())
+		{
+			for(int cx=c0.x; cx<=c1.x; ++cx)
+			{
+				for(int cy=c0.y; cy<=c1.y; ++cy)
+				{
+					for(int cz=c0.z; cz<=c1.z; ++cz)
+					{
+						std::map<Cell, std::vector<int> >::const_iterator iter = cells_.find(Cell(cx, cy, cz));
+						if(iter == cells_.end())
+						{
+							continue;
+						}
+						for(unsigned int i=0; i<iter->second.size(); ++i)
+						{
+							const Transform & p = nodes_.find(iter->second[i])->second.pose;
+							float dx = p.x()-x, dy = p.y()-y, dz = p.z()-z;
+							float d = dx*dx + dy*dy + dz*dz;
+							if(d <= radiusSqrd)
+							{
+								found.insert(std::make_pair(iter->second[i], d));
+							}
+						}
+					}
+				}
+			}
+		}
+		else
+		{
+			// large radius: iterate over all nodes
+			for(std::map<int, Node>::const_iterator iter=nodes_.begin(); iter!=nodes_.end(); ++iter)
+			{
+				float dx = iter->second.pose.x()-x, dy = iter->second.pose.y()-y, dz = iter->second.pose.z()-z;
+				float d = dx*dx + dy*dy + dz*dz;
+				if(d <= radiusSqrd)
+				{
+					found.insert(found.end(), std::make_pair(iter->first, d));
+				}
+			}
+		}
+	}
+	++queries_;
+	queriesTime_ += timer.ticks();
+	return found;
+}
+
+void PoseSpatialIndex::resetStatistics()
+{
+	updatesTime_ = 0.0;
+	queries_ = 0;
+	queriesTime_ = 0.0;
+}
+
+PoseSpatialIndex::Cell PoseSpatialIndex::cellOf(float x, float y, float z) const
+{
+	return Cell(
+			(int)std::floor(x/cellSize_),
+			(int)std::floor(y/cellSize_),
+			(int)std::floor(z/cellSize_));
+}
+
+void PoseSpatialIndex::insertInCell(int id, const Cell & cell)
+{
+	cells_[cell].push_back(id);
+	if(!hasBounds_)
+	{
+		minCell_ = maxCell_ = cell;
+		hasBounds_ = true;
+	}
+	else
+	{
+		minCell_ = Cell(std::min(minCell_.x, cell.x), std::min(minCell_.y, cell.y), std::min(minCell_.z, cell.z));
+		maxCell_ = Cell(std::max(maxCell_.x, cell.x), std::max(maxCell_.y, cell.y), std::max(maxCell_.z, cell.z));
+	}
+}
+
+void PoseSpatialIndex::removeFromCell(int id, const Cell & cell)
+{
+	std::map<Cell, std::vector<int> >::iterator iter = cells_.find(cell);
+	UASSERT(iter != cells_.end());
+	std::vector<int> & ids = iter->second;
+	for(unsigned int i=0; i<ids.size(); ++i)
+	{
+		if(ids[i] == id)
+		{
+			ids[i] = ids.back();
+			ids.pop_back();
+			break;
+		}
+	}
+	if(ids.empty())
+	{
+		cells_.erase(iter);
+	}
+}
+
+int PoseSpatialIndex::bruteForceNearest(float x, float y, float z, const std::set<int> & ignoredIds) const
+{
+	int id = 0;
+	float bestSqrd = std::numeric_limits<float>::max();
+	for(std::map<int, Node>::const_iterator iter=nodes_.begin(); iter!=nodes_.end(); ++iter)
+	{
+		if(ignoredIds.size() && ignoredIds.find(iter->first) != ignoredIds.end())
+		{
+			continue;
+		}
+		float dx = iter->second.pose.x()-x, dy = iter->second.pose.y()-y, dz = iter->second.pose.z()-z;
+		float d = dx*dx + dy*dy + dz*dz;
+		if(d < bestSqrd)
+		{
+			bestSqrd = d;
+			id = iter->first;
+		}
+	}
+	return id;
+}
+
+} /* namespace rtabmap */
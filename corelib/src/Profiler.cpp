@@ -0,0 +1,294 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/Profiler.h"
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UMutex.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UFile.h>
+#include <list>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#define RTABMAP_THREAD_LOCAL __declspec(thread)
+#else
+#define RTABMAP_THREAD_LOCAL __thread
+#endif
+
+namespace rtabmap {
+
+namespace {
+
+// maximum nodes per tree, scopes entered after that are ignored
+static const int kMaxNodes = 4096;
+
+class Recorder
+{
+public:
+	Recorder() : active(false), roots(-1) {}
+	void clear()
+	{
+		nodes.clear();
+		names.clear();
+		firstChild.clear();
+		nextSibling.clear();
+		stack.clear();
+		starts.clear();
+		roots = -1;
+	}
+
+	bool active;
+	std::vector<ProfileNode> nodes;
+	std::vector<const char *> names; // address of the name of each node
+	std::vector<int> firstChild;
+	std::vector<int> nextSibling;
+	int roots;
+	std::vector<int> stack; // opened nodes
+	std::vector<double> starts; // start time of the opened nodes
+};
+
+// Recorders are created on the first beginFrame() of a thread and
+// deleted on exit, they are not reused across threads.
+class RecorderRegistry
+{
+public:
+	~RecorderRegistry()
+	{
+		for(std::list<Recorder*>::iterator iter=recorders_.begin(); iter!=recorders_.end(); ++iter)
+		{
+			delete *iter;
+		}
+	}
+	Recorder * create()
+	{
+		Recorder * recorder = new Recorder();
+		UScopeMutex lock(mutex_);
+		recorders_.push_back(recorder);
+		return recorder;
+	}
+private:
+	UMutex mutex_;
+	std::list<Recorder*> recorders_;
+};
+
+static RecorderRegistry g_registry;
+static RTABMAP_THREAD_LOCAL Recorder * g_recorder = 0;
+
+std::string escapeJson(const std::string & str)
+{
+	std::string out;
+	out.reserve(str.size());
+	for(unsigned int i=0; i<str.size(); ++i)
+	{
+		if(str[i] == '"' || str[i] == '\\')
+		{
+			out.push_back('\\');
+			out.push_back(str[i]);
+		}
+		else if((unsigned char)str[i] >= 0x20)
+		{
+			out.push_back(str[i]);
+		}
+	}
+	return out;
+}
+
+}
+
+void Profiler::beginFrame()
+{
+	if(g_recorder == 0)
+	{
+		g_recorder = g_registry.create();
+	}
+	g_recorder->clear();
+	g_recorder->active = true;
+}
+
+std::vector<ProfileNode> Profiler::endFrame()
+{
+	std::vector<ProfileNode> tree;
+	if(g_recorder && g_recorder->active)
+	{
+		Recorder & r = *g_recorder;
+		if(r.stack.size())
+		{
+			double now = UTimer::now();
+			for(unsigned int i=0; i<r.stack.size(); ++i)
+			{
+				ProfileNode & node = r.nodes[r.stack[i]];
+				node.time += now - r.starts[i];
+				++node.calls;
+			}
+		}
+		tree.swap(r.nodes);
+		r.clear();
+		r.active = false;
+	}
+	return tree;
+}
+
+bool Profiler::isRecording()
+{
+	return g_recorder && g_recorder->active;
+}
+
+bool Profiler::push(const char * name)
+{
+	Recorder * r = g_recorder;
+	if(r == 0 || !r->active)
+	{
+		return false;
+	}
+
+	int parent = r->stack.size()?r->stack.back():-1;
+	int index = parent>=0?r->firstChild[parent]:r->roots;
+	int last = -1;
+	while(index >= 0 && r->names[index] != name && strcmp(r->names[index], name) != 0)
+	{
+		last = index;
+		index = r->nextSibling[index];
+	}
+
+	double now = UTimer::now();
+	if(index < 0)
+	{
+		if((int)r->nodes.size() >= kMaxNodes)
+		{
+			return false;
+		}
+		index = (int)r->nodes.size();
+		ProfileNode node;
+		node.name = name;
+		node.parent = parent;
+		node.depth = (int)r->stack.size();
+		node.start = now;
+		r->nodes.push_back(node);
+		r->names.push_back(name);
+		r->firstChild.push_back(-1);
+		r->nextSibling.push_back(-1);
+		if(last >= 0)
+		{
+			r->nextSibling[last] = index;
+		}
+		else if(parent >= 0)
+		{
+			r->firstChild[parent] = index;
+		}
+		else
+		{
+			r->roots = index;
+		}
+	}
+	r->stack.push_back(index);
+	r->starts.push_back(now);
+	return true;
+}
+
+void Profiler::pop()
+{
+	Recorder * r = g_recorder;
+	// endFrame() may have been called inside the scope
+	if(r && r->active && r->stack.size())
+	{
+		ProfileNode & node = r->nodes[r->stack.back()];
+		node.time += UTimer::now() - r->starts.back();
+		++node.calls;
+		r->stack.pop_back();
+		r->starts.pop_back();
+	}
+}
+
+std::string Profiler::chromeTraceEvents(const std::vector<ProfileNode> & tree, int pid, int tid)
+{
+	std::string out;
+	// end of the previous sibling at each depth, and (start, end) of the nodes
+	std::vector<double> starts(tree.size());
+	std::vector<double> ends(tree.size());
+	std::vector<int> previousSibling(tree.size(), -1);
+	std::vector<int> lastChild(tree.size(), -1);
+	int lastRoot = -1;
+	char buf[128];
+	for(unsigned int i=0; i<tree.size(); ++i)
+	{
+		const ProfileNode & node = tree[i];
+		int & previous = node.parent>=0?lastChild[node.parent]:lastRoot;
+		double start = node.start;
+		if(previous >= 0 && start < ends[previous])
+		{
+			start = ends[previous];
+		}
+		if(node.parent >= 0)
+		{
+			// keep merged calls inside their parent
+			if(start + node.time > ends[node.parent])
+			{
+				start = ends[node.parent] - node.time;
+			}
+			if(start < starts[node.parent])
+			{
+				start = starts[node.parent];
+			}
+		}
+		starts[i] = start;
+		ends[i] = start + node.time;
+		previous = i;
+
+		out += "{\"name\":\"" + escapeJson(node.name) + "\",\"cat\":\"rtabmap\",\"ph\":\"X\"";
+		sprintf(buf, ",\"ts\":%.0f,\"dur\":%.0f,\"pid\":%d,\"tid\":%d,\"args\":{\"calls\":%d}},\n",
+				start*1000000.0, node.time*1000000.0, pid, tid, node.calls);
+		out += buf;
+	}
+	return out;
+}
+
+bool Profiler::appendChromeTrace(const std::string & path, const std::vector<ProfileNode> & tree, int pid, int tid)
+{
+	bool exists = UFile::exists(path) && UFile::length(path) > 0;
+	FILE* file = 0;
+#ifdef _MSC_VER
+	fopen_s(&file, path.c_str(), "a");
+#else
+	file = fopen(path.c_str(), "a");
+#endif
+	if(!file)
+	{
+		UERROR("Cannot open trace file \"%s\"", path.c_str());
+		return false;
+	}
+	if(!exists)
+	{
+		fprintf(file, "[\n");
+	}
+	std::string events = chromeTraceEvents(tree, pid, tid);
+	fwrite(events.c_str(), 1, events.size(), file);
+	fclose(file);
+	return true;
+}
+
+} /* namespace rtabmap */
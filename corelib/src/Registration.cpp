@@ -28,6 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <rtabmap/core/RegistrationVis.h>
 #include <rtabmap/core/RegistrationIcp.h>
+#include <rtabmap/core/Profiler.h>
 #include <rtabmap/utilite/ULogger.h>
 
 namespace rtabmap {
@@ -180,6 +181,7 @@ Transform Registration::computeTransformationMod(
 		Transform guess,
 		RegistrationInfo * infoOut) const
 {
+	UPROFILE("Registration::computeTransformationMod");
 	RegistrationInfo info;
 	if(infoOut)
 	{
@@ -27,16 +27,19 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
 #include <rtabmap/core/RegistrationIcp.h>
+#include <rtabmap/core/CorrelativeScanMatcher.h>
 #include <rtabmap/core/util3d_registration.h>
 #include <rtabmap/core/util3d_surface.h>
 #include <rtabmap/core/util3d.h>
 #include <rtabmap/core/util3d_transforms.h>
 #include <rtabmap/core/util3d_filtering.h>
+#include <rtabmap/core/Profiler.h>
 #include <rtabmap/utilite/ULogger.h>
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UTimer.h>
 #include <pcl/io/pcd_io.h>
+#include <pcl/common/io.h>
 
 namespace rtabmap {
 
@@ -51,7 +54,16 @@ RegistrationIcp::RegistrationIcp(const ParametersMap & parameters, Registration
 	_epsilon(Parameters::defaultIcpEpsilon()),
 	_correspondenceRatio(Parameters::defaultIcpCorrespondenceRatio()),
 	_pointToPlane(Parameters::defaultIcpPointToPlane()),
-	_pointToPlaneNormalNeighbors(Parameters::defaultIcpPointToPlaneNormalNeighbors())
+	_pointToPlaneNormalNeighbors(Parameters::defaultIcpPointToPlaneNormalNeighbors()),
+	_correlative(Parameters::defaultIcpCorrelative()),
+	_correlativeResolution(Parameters::defaultIcpCorrelativeResolution()),
+	_correlativeLinearWindow(Parameters::defaultIcpCorrelativeLinearWindow()),
+	_correlativeAngularWindow(Parameters::defaultIcpCorrelativeAngularWindow()),
+	_correlativeMinScore(Parameters::defaultIcpCorrelativeMinScore()),
+	_cacheSize(Parameters::defaultIcpCacheSize()),
+	_cacheHits(0),
+	_cacheMisses(0),
+	_cacheTimeSaved(0.0)
 {
 	this->parseParameters(parameters);
 }
@@ -70,6 +82,12 @@ void RegistrationIcp::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kIcpCorrespondenceRatio(), _correspondenceRatio);
 	Parameters::parse(parameters, Parameters::kIcpPointToPlane(), _pointToPlane);
 	Parameters::parse(parameters, Parameters::kIcpPointToPlaneNormalNeighbors(), _pointToPlaneNormalNeighbors);
+	Parameters::parse(parameters, Parameters::kIcpCorrelative(), _correlative);
+	Parameters::parse(parameters, Parameters::kIcpCorrelativeResolution(), _correlativeResolution);
+	Parameters::parse(parameters, Parameters::kIcpCorrelativeLinearWindow(), _correlativeLinearWindow);
+	Parameters::parse(parameters, Parameters::kIcpCorrelativeAngularWindow(), _correlativeAngularWindow);
+	Parameters::parse(parameters, Parameters::kIcpCorrelativeMinScore(), _correlativeMinScore);
+	Parameters::parse(parameters, Parameters::kIcpCacheSize(), _cacheSize);
 
 	UASSERT_MSG(_voxelSize >= 0, uFormat("value=%d", _voxelSize).c_str());
 	UASSERT_MSG(_downsamplingStep >= 0, uFormat("value=%d", _downsamplingStep).c_str());
@@ -78,6 +96,139 @@ void RegistrationIcp::parseParameters(const ParametersMap & parameters)
 	UASSERT(_epsilon >= 0.0f);
 	UASSERT_MSG(_correspondenceRatio >=0.0f && _correspondenceRatio <=1.0f, uFormat("value=%f", _correspondenceRatio).c_str());
 	UASSERT_MSG(_pointToPlaneNormalNeighbors > 0, uFormat("value=%d", _pointToPlaneNormalNeighbors).c_str());
+	UASSERT_MSG(_correlativeResolution > 0.0f, uFormat("value=%f", _correlativeResolution).c_str());
+	UASSERT_MSG(_correlativeLinearWindow >= 0.0f, uFormat("value=%f", _correlativeLinearWindow).c_str());
+	UASSERT_MSG(_correlativeAngularWindow >= 0.0f && _correlativeAngularWindow <= M_PI, uFormat("value=%f", _correlativeAngularWindow).c_str());
+	UASSERT_MSG(_correlativeMinScore >= 0.0f && _correlativeMinScore <= 1.0f, uFormat("value=%f", _correlativeMinScore).c_str());
+	UASSERT_MSG(_cacheSize >= 0, uFormat("value=%d", _cacheSize).c_str());
+
+	// preprocessing parameters may have changed
+	clearCache();
+}
+
+void RegistrationIcp::clearCache()
+{
+	_cache.clear();
+	_cacheIndex.clear();
+	_cacheHits = 0;
+	_cacheMisses = 0;
+	_cacheTimeSaved = 0.0;
+}
+
+const pcl::search::KdTree<pcl::PointXYZ>::Ptr & RegistrationIcp::PreprocessedScan::getTree()
+{
+	if(cloudFiltered.get() == cloud.get())
+	{
+		return getFilteredTree();
+	}
+	if(!tree_.get())
+	{
+		UTimer timer;
+		tree_.reset(new pcl::search::KdTree<pcl::PointXYZ>);
+		tree_->setInputCloud(cloud);
+		time += timer.ticks();
+	}
+	return tree_;
+}
+
+const pcl::search::KdTree<pcl::PointXYZ>::Ptr & RegistrationIcp::PreprocessedScan::getFilteredTree()
+{
+	if(!filteredTree_.get())
+	{
+		UTimer timer;
+		filteredTree_.reset(new pcl::search::KdTree<pcl::PointXYZ>);
+		filteredTree_->setInputCloud(cloudFiltered);
+		time += timer.ticks();
+	}
+	return filteredTree_;
+}
+
+const pcl::search::KdTree<pcl::PointNormal>::Ptr & RegistrationIcp::PreprocessedScan::getNormalsTree()
+{
+	if(!normalsTree_.get())
+	{
+		UTimer timer;
+		normalsTree_.reset(new pcl::search::KdTree<pcl::PointNormal>);
+		normalsTree_->setInputCloud(normals);
+		time += timer.ticks();
+	}
+	return normalsTree_;
+}
+
+// rawScan is the key in the cache, scan is the downsampled version of rawScan
+boost::shared_ptr<RegistrationIcp::PreprocessedScan> RegistrationIcp::preprocessScan(
+		const cv::Mat & rawScan,
+		const cv::Mat & scan,
+		RegistrationInfo & info) const
+{
+	UPROFILE("RegistrationIcp::preprocessScan");
+	if(_cacheSize > 0)
+	{
+		std::map<const unsigned char *, std::list<boost::shared_ptr<PreprocessedScan> >::iterator>::iterator iter = _cacheIndex.find(rawScan.data);
+		if(iter != _cacheIndex.end() &&
+		   (*iter->second)->scan.cols == rawScan.cols &&
+		   (*iter->second)->scan.type() == rawScan.type())
+		{
+			// move to front
+			_cache.splice(_cache.begin(), _cache, iter->second);
+			++info.icpCacheHits;
+			info.icpCacheTimeSaved += _cache.front()->time;
+			++_cacheHits;
+			_cacheTimeSaved += _cache.front()->time;
+			return _cache.front();
+		}
+	}
+
+	UTimer timer;
+	boost::shared_ptr<PreprocessedScan> preprocessed(new PreprocessedScan);
+	preprocessed->scan = rawScan;
+	if( _pointToPlane &&
+		_voxelSize == 0.0f &&
+		scan.channels() == 6)
+	{
+		//special case if we have already normals computed and there is no filtering
+		preprocessed->normals = util3d::laserScanToPointCloudNormal(scan, Transform());
+		preprocessed->normals = util3d::removeNaNNormalsFromPointCloud(preprocessed->normals);
+		preprocessed->cloud.reset(new pcl::PointCloud<pcl::PointXYZ>);
+		pcl::copyPointCloud(*preprocessed->normals, *preprocessed->cloud);
+		preprocessed->cloudFiltered = preprocessed->cloud;
+	}
+	else
+	{
+		preprocessed->cloud = util3d::laserScanToPointCloud(scan, Transform());
+		preprocessed->cloudFiltered = preprocessed->cloud;
+		if(_voxelSize > 0.0f)
+		{
+			preprocessed->cloudFiltered = util3d::voxelize(preprocessed->cloud, _voxelSize);
+		}
+		if(_pointToPlane)
+		{
+			preprocessed->normals = util3d::computeNormals(preprocessed->cloudFiltered, _pointToPlaneNormalNeighbors);
+			preprocessed->normals = util3d::removeNaNNormalsFromPointCloud(preprocessed->normals);
+		}
+	}
+	preprocessed->time = timer.ticks();
+
+	if(_cacheSize > 0 && rawScan.data)
+	{
+		++info.icpCacheMisses;
+		++_cacheMisses;
+		std::map<const unsigned char *, std::list<boost::shared_ptr<PreprocessedScan> >::iterator>::iterator iter = _cacheIndex.find(rawScan.data);
+		if(iter != _cacheIndex.end())
+		{
+			// same address but different scan
+			_cache.erase(iter->second);
+			_cacheIndex.erase(iter);
+		}
+		_cache.push_front(preprocessed);
+		_cacheIndex.insert(std::make_pair((const unsigned char *)rawScan.data, _cache.begin()));
+		while((int)_cache.size() > _cacheSize)
+		{
+			_cacheIndex.erase(_cache.back()->scan.data);
+			_cache.pop_back();
+		}
+	}
+	return preprocessed;
 }
 
 Transform RegistrationIcp::computeTransformationImpl(
@@ -86,6 +237,7 @@ Transform RegistrationIcp::computeTransformationImpl(
 			Transform guess,
 			RegistrationInfo & info) const
 {
+	UPROFILE("RegistrationIcp::computeTransformationImpl");
 	UDEBUG("Guess transform = %s", guess.prettyPrint().c_str());
 	UDEBUG("Voxel size=%f", _voxelSize);
 	UDEBUG("PointToPlane=%d", _pointToPlane?1:0);
@@ -96,6 +248,7 @@ Transform RegistrationIcp::computeTransformationImpl(
 	UDEBUG("Max translation=%f", _maxTranslation);
 	UDEBUG("Max rotation=%f", _maxRotation);
 	UDEBUG("Downsampling step=%d", _downsamplingStep);
+	UDEBUG("Correlative=%d", _correlative?1:0);
 
 	UTimer timer;
 	std::string msg;
@@ -124,168 +277,138 @@ Transform RegistrationIcp::computeTransformationImpl(
 			UDEBUG("Downsampling time (step=%d) = %f s", _downsamplingStep, timer.ticks());
 		}
 
-		if(fromScan.cols && toScan.cols)
+		if(_correlative && fromScan.cols && toScan.cols)
 		{
-			Transform icpT;
-			bool hasConverged = false;
-			float correspondencesRatio = 0.0f;
-			int correspondences = 0;
-			double variance = 1.0;
-
-			if( _pointToPlane &&
-				_voxelSize == 0.0f &&
-				fromScan.channels() == 6 &&
-				toScan.channels() == 6)
+			if(fromScan.type() == CV_32FC2 && toScan.type() == CV_32FC2)
 			{
-				//special case if we have already normals computed and there is no filtering
-				pcl::PointCloud<pcl::PointNormal>::Ptr fromCloudNormals = util3d::laserScanToPointCloudNormal(fromScan, Transform());
-				pcl::PointCloud<pcl::PointNormal>::Ptr toCloudNormals = util3d::laserScanToPointCloudNormal(toScan, guess);
-				UDEBUG("Conversion time = %f s", timer.ticks());
-				pcl::PointCloud<pcl::PointNormal>::Ptr fromCloudNormalsRegistered(new pcl::PointCloud<pcl::PointNormal>());
-				icpT = util3d::icpPointToPlane(
-						fromCloudNormals,
-						toCloudNormals,
-					   _maxCorrespondenceDistance,
-					   _maxIterations,
-					   hasConverged,
-					   *fromCloudNormalsRegistered,
-					   _epsilon,
-					   this->force3DoF());
-				if(!icpT.isNull() && hasConverged)
+				// coarse alignment of the "to" scan on the "from" scan, then ICP from there
+				CorrelativeScanMatcher matcher(_correlativeResolution, _correlativeLinearWindow, _correlativeAngularWindow);
+				matcher.setReference(fromScan);
+				float score = 0.0f;
+				Transform coarse = matcher.match(toScan, guess, _correlativeMinScore, &score);
+				UDEBUG("Correlative scan matching (angles=%d candidates=%d score=%f) time = %f s",
+						matcher.getLastAngles(), matcher.getLastCandidatesScored(), score, timer.ticks());
+				if(!coarse.isNull())
 				{
-					util3d::computeVarianceAndCorrespondences(
-							fromCloudNormalsRegistered,
-							toCloudNormals,
-							_maxCorrespondenceDistance,
-							variance,
-							correspondences);
-					/*
-					UWARN("icpT=%s", icpT.prettyPrint().c_str());
-					pcl::io::savePCDFile("fromCloud.pcd", *fromCloudNormals);
-					pcl::io::savePCDFile("toCloud.pcd", *toCloudNormals);
-					UWARN("saved fromCloud.pcd and toCloud.pcd");
-					if(!icpT.isNull())
-					{
-						pcl::PointCloud<pcl::PointNormal>::Ptr fromCloudTmp = util3d::transformPointCloud(fromCloudNormals, icpT);
-						pcl::io::savePCDFile("fromCloudFinal.pcd", *fromCloudTmp);
-						pcl::io::savePCDFile("fromCloudFinal2.pcd", *fromCloudNormalsRegistered);
-						UWARN("saved fromCloudFinal.pcd");
-					}
-					*/
-
+					UDEBUG("Correlative guess = %s", coarse.prettyPrint().c_str());
+					guess = coarse;
+				}
+				else
+				{
+					UDEBUG("Correlative scan matching failed (score<%f), keep the guess", _correlativeMinScore);
 				}
 			}
 			else
 			{
-				pcl::PointCloud<pcl::PointXYZ>::Ptr fromCloud = util3d::laserScanToPointCloud(fromScan, Transform());
-				pcl::PointCloud<pcl::PointXYZ>::Ptr toCloud = util3d::laserScanToPointCloud(toScan, guess);
-				UDEBUG("Conversion time = %f s", timer.ticks());
-
-				pcl::PointCloud<pcl::PointXYZ>::Ptr fromCloudFiltered = fromCloud;
-				pcl::PointCloud<pcl::PointXYZ>::Ptr toCloudFiltered = toCloud;
-				bool filtered = false;
-				if(_voxelSize > 0.0f)
-				{
-					fromCloudFiltered = util3d::voxelize(fromCloudFiltered, _voxelSize);
-					int pointsBeforeFiltering = toCloudFiltered->size();
-					toCloudFiltered = util3d::voxelize(toCloudFiltered, _voxelSize);
-					filtered = true;
-					UDEBUG("Voxel filtering time (voxel=%f m) = %f s", _voxelSize, timer.ticks());
-
-					//Adjust maxLaserScans
-					maxLaserScans = maxLaserScans * toCloudFiltered->size() / pointsBeforeFiltering;
-				}
-
-				bool correspondencesComputed = false;
-				pcl::PointCloud<pcl::PointXYZ>::Ptr fromCloudRegistered(new pcl::PointCloud<pcl::PointXYZ>());
-				if(_pointToPlane) // ICP Point To Plane, only in 3D
-				{
-					pcl::PointCloud<pcl::PointNormal>::Ptr fromCloudNormals = util3d::computeNormals(fromCloudFiltered, _pointToPlaneNormalNeighbors);
-					pcl::PointCloud<pcl::PointNormal>::Ptr toCloudNormals = util3d::computeNormals(toCloudFiltered, _pointToPlaneNormalNeighbors);
+				UDEBUG("Correlative scan matching is only done on 2D laser scans (CV_32FC2)");
+			}
+		}
 
-					std::vector<int> indices;
-					toCloudNormals = util3d::removeNaNNormalsFromPointCloud(toCloudNormals);
-					fromCloudNormals = util3d::removeNaNNormalsFromPointCloud(fromCloudNormals);
+		if(fromScan.cols && toScan.cols)
+		{
+			// The scans are preprocessed in their own frame so that they can be
+			// reused from the cache: the "to" scan is the ICP target and the "from"
+			// scan is moved in the "to" frame with the inverse of the guess.
+			// icpT is then the correction in the "to" frame.
+			boost::shared_ptr<PreprocessedScan> from = preprocessScan(dataFrom.laserScanRaw(), fromScan, info);
+			boost::shared_ptr<PreprocessedScan> to = preprocessScan(dataTo.laserScanRaw(), toScan, info);
+			UDEBUG("Preprocessing time = %f s (cache hits=%d, time saved=%f s)", timer.ticks(), info.icpCacheHits, info.icpCacheTimeSaved);
+			Transform guessInv = guess.inverse();
 
-					UDEBUG("Compute normals time = %f s", timer.ticks());
+			Transform icpT;
+			bool hasConverged = false;
+			float correspondencesRatio = 0.0f;
+			int correspondences = 0;
+			double variance = 1.0;
+			bool filtered = to->cloudFiltered.get() != to->cloud.get();
+			if(filtered && to->cloud->size())
+			{
+				//Adjust maxLaserScans
+				maxLaserScans = maxLaserScans * to->cloudFiltered->size() / to->cloud->size();
+			}
 
-					if(toCloudNormals->size() && fromCloudNormals->size())
-					{
-						pcl::PointCloud<pcl::PointNormal>::Ptr fromCloudNormalsRegistered(new pcl::PointCloud<pcl::PointNormal>());
-						icpT = util3d::icpPointToPlane(
-								fromCloudNormals,
-								toCloudNormals,
-							   _maxCorrespondenceDistance,
-							   _maxIterations,
-							   hasConverged,
-							   *fromCloudNormalsRegistered,
-							   _epsilon,
-							   this->force3DoF());
-						if(!filtered &&
-							!icpT.isNull() &&
-							hasConverged)
-						{
-							util3d::computeVarianceAndCorrespondences(
-									fromCloudNormalsRegistered,
-									toCloudNormals,
-									_maxCorrespondenceDistance,
-									variance,
-									correspondences);
-							correspondencesComputed = true;
-						}
-					}
-				}
-				else // ICP Point to Point
+			bool correspondencesComputed = false;
+			if(_pointToPlane) // ICP Point To Plane, only in 3D
+			{
+				if(to->normals->size() && from->normals->size())
 				{
-					icpT = util3d::icp(
-							fromCloudFiltered,
-							toCloudFiltered,
+					pcl::PointCloud<pcl::PointNormal>::Ptr fromCloudNormals = util3d::transformPointCloud(from->normals, guessInv);
+					pcl::PointCloud<pcl::PointNormal>::Ptr fromCloudNormalsRegistered(new pcl::PointCloud<pcl::PointNormal>());
+					icpT = util3d::icpPointToPlane(
+							fromCloudNormals,
+							to->normals,
 						   _maxCorrespondenceDistance,
 						   _maxIterations,
 						   hasConverged,
-						   *fromCloudRegistered,
+						   *fromCloudNormalsRegistered,
 						   _epsilon,
-						   this->force3DoF()); // icp2D
-				}
-
-				/*pcl::io::savePCDFile("fromCloud.pcd", *fromCloud);
-				pcl::io::savePCDFile("toCloud.pcd", *toCloud);
-				UWARN("saved fromCloud.pcd and toCloud.pcd");
-				if(!icpT.isNull())
-				{
-					pcl::PointCloud<pcl::PointXYZ>::Ptr fromCloudTmp = util3d::transformPointCloud(fromCloud, icpT);
-					pcl::io::savePCDFile("fromCloudFinal.pcd", *fromCloudTmp);
-					UWARN("saved fromCloudFinal.pcd");
-				}*/
-
-				if(!icpT.isNull() &&
-					hasConverged &&
-					!correspondencesComputed)
-				{
-					if(filtered)
-					{
-						fromCloud = util3d::transformPointCloud(fromCloud, icpT);
-					}
-					else
+						   this->force3DoF(),
+						   to->getNormalsTree());
+					if(!filtered &&
+						!icpT.isNull() &&
+						hasConverged)
 					{
-						fromCloud = fromCloudRegistered;
+						util3d::computeVarianceAndCorrespondences(
+								fromCloudNormalsRegistered,
+								to->normals,
+								_maxCorrespondenceDistance,
+								variance,
+								correspondences,
+								to->getNormalsTree());
+						correspondencesComputed = true;
 					}
-
+				}
+			}
+			else // ICP Point to Point
+			{
+				pcl::PointCloud<pcl::PointXYZ>::Ptr fromCloudFiltered = util3d::transformPointCloud(from->cloudFiltered, guessInv);
+				pcl::PointCloud<pcl::PointXYZ>::Ptr fromCloudRegistered(new pcl::PointCloud<pcl::PointXYZ>());
+				icpT = util3d::icp(
+						fromCloudFiltered,
+						to->cloudFiltered,
+					   _maxCorrespondenceDistance,
+					   _maxIterations,
+					   hasConverged,
+					   *fromCloudRegistered,
+					   _epsilon,
+					   this->force3DoF(), // icp2D
+					   to->getFilteredTree());
+				if(!filtered &&
+					!icpT.isNull() &&
+					hasConverged)
+				{
 					util3d::computeVarianceAndCorrespondences(
-							fromCloud,
-							toCloud,
+							fromCloudRegistered,
+							to->cloudFiltered,
 							_maxCorrespondenceDistance,
 							variance,
-							correspondences);
+							correspondences,
+							to->getFilteredTree());
+					correspondencesComputed = true;
 				}
 			}
+
+			if(!icpT.isNull() &&
+				hasConverged &&
+				!correspondencesComputed)
+			{
+				// on the clouds before filtering
+				pcl::PointCloud<pcl::PointXYZ>::Ptr fromCloudRegistered = util3d::transformPointCloud(from->cloud, icpT * guessInv);
+				util3d::computeVarianceAndCorrespondences(
+						fromCloudRegistered,
+						to->cloud,
+						_maxCorrespondenceDistance,
+						variance,
+						correspondences,
+						to->getTree());
+			}
 			UDEBUG("ICP (iterations=%d) time = %f s", _maxIterations, timer.ticks());
 
 			if(!icpT.isNull() &&
 				hasConverged)
 			{
 				float ix,iy,iz, iroll,ipitch,iyaw;
-				Transform icpInTargetReferential = guess.inverse() * icpT.inverse() * guess; // actual local ICP refinement
+				Transform icpInTargetReferential = icpT.inverse(); // actual local ICP refinement
 				icpInTargetReferential.getTranslationAndEulerAngles(ix,iy,iz,iroll,ipitch,iyaw);
 				if((_maxTranslation>0.0f &&
 					uMax3(fabs(ix), fabs(iy), fabs(iz)) > _maxTranslation)
@@ -333,7 +456,7 @@ Transform RegistrationIcp::computeTransformationImpl(
 					}
 					else
 					{
-						transform = icpT.inverse()*guess;
+						transform = guess*icpT.inverse();
 					}
 				}
 			}
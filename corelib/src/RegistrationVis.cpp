@@ -34,6 +34,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/VWDictionary.h>
 #include <rtabmap/core/util2d.h>
 #include <rtabmap/core/Features2d.h>
+#include <rtabmap/core/Profiler.h>
 #include <rtabmap/utilite/ULogger.h>
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UStl.h>
@@ -172,6 +173,7 @@ Transform RegistrationVis::computeTransformationImpl(
 			Transform guess, // (flowMaxLevel is set to 0 when guess is used)
 			RegistrationInfo & info) const
 {
+	UPROFILE("RegistrationVis::computeTransformationImpl");
 	UDEBUG("%s=%d", Parameters::kVisMinInliers().c_str(), _minInliers);
 	UDEBUG("%s=%f", Parameters::kVisInlierDistance().c_str(), _inlierDistance);
 	UDEBUG("%s=%d", Parameters::kVisIterations().c_str(), _iterations);
@@ -294,19 +296,10 @@ Transform RegistrationVis::computeTransformationImpl(
 		   !toSignature.sensorData().imageRaw().empty())
 		{
 			UDEBUG("");
-			// convert to grayscale
-			if(fromSignature.sensorData().imageRaw().channels() > 1)
-			{
-				cv::Mat tmp;
-				cv::cvtColor(fromSignature.sensorData().imageRaw(), tmp, cv::COLOR_BGR2GRAY);
-				fromSignature.sensorData().setImageRaw(tmp);
-			}
-			if(toSignature.sensorData().imageRaw().channels() > 1)
-			{
-				cv::Mat tmp;
-				cv::cvtColor(toSignature.sensorData().imageRaw(), tmp, cv::COLOR_BGR2GRAY);
-				toSignature.sensorData().setImageRaw(tmp);
-			}
+			// Images are not converted to grayscale here: the cached
+			// pyramids below are gray and the stereo matching converts
+			// the left image itself, so copies of the signatures keep
+			// sharing the pyramids already computed.
 
 			std::vector<cv::Point3f> kptsFrom3D;
 			if(fromSignature.getWords3().empty())
@@ -344,14 +337,15 @@ Transform RegistrationVis::computeTransformationImpl(
 				std::vector<unsigned char> status;
 				std::vector<float> err;
 				UDEBUG("cv::calcOpticalFlowPyrLK() begin");
+				cv::Size flowWinSize(_flowWinSize, _flowWinSize);
 				cv::calcOpticalFlowPyrLK(
-						fromSignature.sensorData().imageRaw(),
-						toSignature.sensorData().imageRaw(),
+						fromSignature.sensorData().imagePyramid(flowWinSize, _flowMaxLevel),
+						toSignature.sensorData().imagePyramid(flowWinSize, _flowMaxLevel),
 						cornersFrom,
 						cornersTo,
 						status,
 						err,
-						cv::Size(_flowWinSize, _flowWinSize),
+						flowWinSize,
 						guessSet?0:_flowMaxLevel,
 						cv::TermCriteria(cv::TermCriteria::COUNT+cv::TermCriteria::EPS, _flowIterations, _flowEps),
 						cv::OPTFLOW_LK_GET_MIN_EIGENVALS | (guessSet?cv::OPTFLOW_USE_INITIAL_FLOW:0), 1e-4);
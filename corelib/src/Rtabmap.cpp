@@ -39,6 +39,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/BayesFilter.h"
 #include "rtabmap/core/Compression.h"
 #include "rtabmap/core/RegistrationInfo.h"
+#include "rtabmap/core/Profiler.h"
+#include "rtabmap/core/StatisticsLog.h"
 
 #include <rtabmap/utilite/ULogger.h>
 #include <rtabmap/utilite/UFile.h>
@@ -55,6 +57,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define LOG_F "LogF.txt"
 #define LOG_I "LogI.txt"
+#define LOG_STATS "LogStats.bin"
 
 #define GRAPH_FILE_NAME "Graph.dot"
 
@@ -77,6 +80,8 @@ Rtabmap::Rtabmap() :
 	_publishLastSignatureData(Parameters::defaultRtabmapPublishLastSignature()),
 	_publishPdf(Parameters::defaultRtabmapPublishPdf()),
 	_publishLikelihood(Parameters::defaultRtabmapPublishLikelihood()),
+	_publishStatsDelta(Parameters::defaultRtabmapPublishStatsDelta()),
+	_publishStatsKeyFrame(Parameters::defaultRtabmapPublishStatsKeyFrame()),
 	_maxTimeAllowed(Parameters::defaultRtabmapTimeThr()), // 700 ms
 	_maxMemoryAllowed(Parameters::defaultRtabmapMemoryThr()), // 0=inf
 	_loopThr(Parameters::defaultRtabmapLoopThr()),
@@ -87,6 +92,10 @@ Rtabmap::Rtabmap() :
 	_statisticLogsBufferedInRAM(Parameters::defaultRtabmapStatisticLogsBufferedInRAM()),
 	_statisticLogged(Parameters::defaultRtabmapStatisticLogged()),
 	_statisticLoggedHeaders(Parameters::defaultRtabmapStatisticLoggedHeaders()),
+	_statisticLogBinary(Parameters::defaultRtabmapStatisticLogBinary()),
+	_profiling(Parameters::defaultRtabmapProfiling()),
+	_profilingTrace(Parameters::defaultRtabmapProfilingTrace()),
+	_deadlineScheduling(Parameters::defaultRtabmapDeadlineScheduling()),
 	_rgbdSlamMode(Parameters::defaultRGBDEnabled()),
 	_rgbdLinearUpdate(Parameters::defaultRGBDLinearUpdate()),
 	_rgbdAngularUpdate(Parameters::defaultRGBDAngularUpdate()),
@@ -102,8 +111,12 @@ Rtabmap::Rtabmap() :
 	_proximityRawPosesUsed(Parameters::defaultRGBDProximityPathRawPosesUsed()),
 	_proximityScansMerged(Parameters::defaultRGBDProximityPathScansMerged()),
 	_proximityAngle(Parameters::defaultRGBDProximityAngle()*M_PI/180.0f),
+	_proximityParallel(Parameters::defaultRGBDProximityParallel()),
 	_databasePath(""),
 	_optimizeFromGraphEnd(Parameters::defaultRGBDOptimizeFromGraphEnd()),
+	_optimizeIncremental(Parameters::defaultRGBDOptimizeIncremental()),
+	_optimizeHierarchical(Parameters::defaultRGBDOptimizeHierarchical()),
+	_optimizeHierarchicalSegment(Parameters::defaultRGBDOptimizeHierarchicalSegment()),
 	_optimizationMaxLinearError(Parameters::defaultRGBDOptimizeMaxError()),
 	_startNewMapOnLoopClosure(Parameters::defaultRtabmapStartNewMapOnLoopClosure()),
 	_goalReachedRadius(Parameters::defaultRGBDGoalReachedRadius()),
@@ -122,6 +135,9 @@ Rtabmap::Rtabmap() :
 	_memory(0),
 	_foutFloat(0),
 	_foutInt(0),
+	_statisticsLog(0),
+	_statsPublicationId(0),
+	_statsLastKeyFrameId(0),
 	_wDir(""),
 	_mapCorrection(Transform::getIdentity()),
 	_lastLocalizationNodeId(0),
@@ -152,8 +168,24 @@ void Rtabmap::setupLogFiles(bool overwrite)
 		fclose(_foutInt);
 		_foutInt = 0;
 	}
+	if(_statisticsLog)
+	{
+		delete _statisticsLog;
+		_statisticsLog = 0;
+	}
 
-	if(_statisticLogged && !_wDir.empty())
+	if(_statisticLogged && _statisticLogBinary && !_wDir.empty())
+	{
+		// Blocks of 1024 frames when buffered, otherwise each frame is written
+		_statisticsLog = new StatisticsLogWriter();
+		if(!_statisticsLog->open(_wDir+"/"+LOG_STATS, !overwrite, _statisticLogsBufferedInRAM?1024:1))
+		{
+			delete _statisticsLog;
+			_statisticsLog = 0;
+		}
+		ULOGGER_DEBUG("Log file (statistics)=%s", (_wDir+"/"+LOG_STATS).c_str());
+	}
+	else if(_statisticLogged && !_wDir.empty())
 	{
 		std::string attributes = "a+"; // append to log files
 		if(overwrite)
@@ -264,6 +296,19 @@ void Rtabmap::flushStatisticLogs()
 		}
 		_bufferedLogsI.clear();
 	}
+	if(_statisticsLog)
+	{
+		_statisticsLog->flush();
+	}
+}
+
+void Rtabmap::resetPublishedGraph()
+{
+	// next publication will be a keyframe
+	_statsLastKeyFrameId = 0;
+	_publishedPoses.clear();
+	_publishedConstraints.clear();
+	_publishedSignatures.clear();
 }
 
 void Rtabmap::init(const ParametersMap & parameters, const std::string & databasePath)
@@ -326,12 +371,15 @@ void Rtabmap::close(bool databaseSaved)
 	_lastProcessTime = 0.0;
 	_someNodesHaveBeenTransferred = false;
 	_optimizedPoses.clear();
+	_optimizedPosesIndex.clear();
 	_constraints.clear();
 	_mapCorrection.setIdentity();
 	_lastLocalizationPose.setNull();
 	_lastLocalizationNodeId = 0;
 	_distanceTravelled = 0.0f;
+	_deadlineScheduler.reset();
 	this->clearPath(0);
+	this->resetPublishedGraph();
 
 	flushStatisticLogs();
 	if(_foutFloat)
@@ -344,6 +392,11 @@ void Rtabmap::close(bool databaseSaved)
 		fclose(_foutInt);
 		_foutInt = 0;
 	}
+	if(_statisticsLog)
+	{
+		delete _statisticsLog;
+		_statisticsLog = 0;
+	}
 
 	if(_epipolarGeometry)
 	{
@@ -386,6 +439,8 @@ void Rtabmap::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kRtabmapPublishLastSignature(), _publishLastSignatureData);
 	Parameters::parse(parameters, Parameters::kRtabmapPublishPdf(), _publishPdf);
 	Parameters::parse(parameters, Parameters::kRtabmapPublishLikelihood(), _publishLikelihood);
+	Parameters::parse(parameters, Parameters::kRtabmapPublishStatsDelta(), _publishStatsDelta);
+	Parameters::parse(parameters, Parameters::kRtabmapPublishStatsKeyFrame(), _publishStatsKeyFrame);
 	Parameters::parse(parameters, Parameters::kRtabmapTimeThr(), _maxTimeAllowed);
 	Parameters::parse(parameters, Parameters::kRtabmapMemoryThr(), _maxMemoryAllowed);
 	Parameters::parse(parameters, Parameters::kRtabmapLoopThr(), _loopThr);
@@ -396,6 +451,10 @@ void Rtabmap::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kRtabmapStatisticLogsBufferedInRAM(), _statisticLogsBufferedInRAM);
 	Parameters::parse(parameters, Parameters::kRtabmapStatisticLogged(), _statisticLogged);
 	Parameters::parse(parameters, Parameters::kRtabmapStatisticLoggedHeaders(), _statisticLoggedHeaders);
+	Parameters::parse(parameters, Parameters::kRtabmapStatisticLogBinary(), _statisticLogBinary);
+	Parameters::parse(parameters, Parameters::kRtabmapProfiling(), _profiling);
+	Parameters::parse(parameters, Parameters::kRtabmapProfilingTrace(), _profilingTrace);
+	Parameters::parse(parameters, Parameters::kRtabmapDeadlineScheduling(), _deadlineScheduling);
 	Parameters::parse(parameters, Parameters::kRGBDEnabled(), _rgbdSlamMode);
 	Parameters::parse(parameters, Parameters::kRGBDLinearUpdate(), _rgbdLinearUpdate);
 	Parameters::parse(parameters, Parameters::kRGBDAngularUpdate(), _rgbdAngularUpdate);
@@ -405,6 +464,7 @@ void Rtabmap::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kRGBDProximityBySpace(), _proximityBySpace);
 	Parameters::parse(parameters, Parameters::kRGBDScanMatchingIdsSavedInLinks(), _scanMatchingIdsSavedInLinks);
 	Parameters::parse(parameters, Parameters::kRGBDLocalRadius(), _localRadius);
+	_optimizedPosesIndex.setCellSize(_localRadius>0.0f?_localRadius:1.0f);
 	Parameters::parse(parameters, Parameters::kRGBDLocalImmunizationRatio(), _localImmunizationRatio);
 	Parameters::parse(parameters, Parameters::kRGBDProximityMaxGraphDepth(), _proximityMaxGraphDepth);
 	Parameters::parse(parameters, Parameters::kRGBDProximityPathFilteringRadius(), _proximityFilteringRadius);
@@ -412,7 +472,12 @@ void Rtabmap::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kRGBDProximityPathScansMerged(), _proximityScansMerged);
 	Parameters::parse(parameters, Parameters::kRGBDProximityAngle(), _proximityAngle);
 	_proximityAngle *= M_PI/180.0f;
+	Parameters::parse(parameters, Parameters::kRGBDProximityParallel(), _proximityParallel);
 	Parameters::parse(parameters, Parameters::kRGBDOptimizeFromGraphEnd(), _optimizeFromGraphEnd);
+	Parameters::parse(parameters, Parameters::kRGBDOptimizeIncremental(), _optimizeIncremental);
+	Parameters::parse(parameters, Parameters::kRGBDOptimizeHierarchical(), _optimizeHierarchical);
+	Parameters::parse(parameters, Parameters::kRGBDOptimizeHierarchicalSegment(), _optimizeHierarchicalSegment);
+	UASSERT(_optimizeHierarchicalSegment >= 1);
 	Parameters::parse(parameters, Parameters::kRGBDOptimizeMaxError(), _optimizationMaxLinearError);
 	Parameters::parse(parameters, Parameters::kRtabmapStartNewMapOnLoopClosure(), _startNewMapOnLoopClosure);
 	Parameters::parse(parameters, Parameters::kRGBDGoalReachedRadius(), _goalReachedRadius);
@@ -447,12 +512,19 @@ void Rtabmap::parseParameters(const ParametersMap & parameters)
 	else if(_graphOptimizer)
 	{
 		_graphOptimizer->parseParameters(parameters);
+		_graphOptimizer->resetIncremental();
 	}
 	else
 	{
 		optimizerType = (Optimizer::Type)Parameters::defaultOptimizerStrategy();
 		_graphOptimizer = Optimizer::create(optimizerType, parameters);
 	}
+	if(_optimizeIncremental && !_graphOptimizer->isIncrementalAvailable())
+	{
+		UWARN("Parameter %s is true but the selected graph optimizer doesn't support "
+			  "incremental optimization (only GTSAM without %s). Batch optimization will be done.",
+			  Parameters::kRGBDOptimizeIncremental().c_str(), Parameters::kOptimizerRobust().c_str());
+	}
 
 	if(_memory)
 	{
@@ -638,7 +710,9 @@ int Rtabmap::triggerNewMap()
 		mapId = _memory->incrementMapId(&reducedIds);
 		UINFO("New map triggered, new map = %d", mapId);
 		_optimizedPoses.clear();
+		_optimizedPosesIndex.clear();
 		_constraints.clear();
+		_graphOptimizer->resetIncremental();
 		_lastLocalizationNodeId = 0;
 
 		//Verify if there are nodes that were merged through graph reduction
@@ -772,12 +846,19 @@ void Rtabmap::resetMemory()
 	_lastProcessTime = 0.0;
 	_someNodesHaveBeenTransferred = false;
 	_optimizedPoses.clear();
+	_optimizedPosesIndex.clear();
 	_constraints.clear();
 	_mapCorrection.setIdentity();
 	_lastLocalizationPose.setNull();
 	_lastLocalizationNodeId = 0;
 	_distanceTravelled = 0.0f;
+	_deadlineScheduler.reset();
 	this->clearPath(0);
+	this->resetPublishedGraph();
+	if(_graphOptimizer)
+	{
+		_graphOptimizer->resetIncremental();
+	}
 
 	if(_memory)
 	{
@@ -785,6 +866,7 @@ void Rtabmap::resetMemory()
 		if(_memory->getLastWorkingSignature())
 		{
 			optimizeCurrentMap(_memory->getLastWorkingSignature()->id(), false, _optimizedPoses, &_constraints);
+			_optimizedPosesIndex.update(_optimizedPoses);
 		}
 		if(_bayesFilter)
 		{
@@ -813,6 +895,7 @@ bool Rtabmap::process(
 	//============================================================
 	UTimer timer;
 	UTimer timerTotal;
+	_optimizedPosesIndex.resetStatistics();
 	double timeMemoryUpdate = 0;
 	double timeNeighborLinkRefining = 0;
 	double timeProximityByTimeDetection = 0;
@@ -864,6 +947,10 @@ bool Rtabmap::process(
 
 	timer.start();
 	timerTotal.start();
+	_deadlineScheduler.beginFrame(_deadlineScheduling?_maxTimeAllowed/1000.0:0.0);
+
+	ScopedFrame profilerFrame(_profiling); // ended on all return paths
+	ScopedTimer processTimer("Rtabmap::process");
 
 	UASSERT_MSG(_memory, "RTAB-Map is not initialized!");
 	UASSERT_MSG(_bayesFilter, "RTAB-Map is not initialized!");
@@ -917,6 +1004,8 @@ bool Rtabmap::process(
 	// Memory Update : Location creation + Add to STM + Weight Update (Rehearsal)
 	//============================================================
 	ULOGGER_INFO("Updating memory...");
+	ScopedTimer stageTimer("Memory update");
+	_deadlineScheduler.beginStage(DeadlineScheduler::kMemoryUpdate);
 	if(_rgbdSlamMode)
 	{
 		if(!_memory->update(data, odomPose, covariance, &statistics_))
@@ -940,6 +1029,8 @@ bool Rtabmap::process(
 
 	ULOGGER_INFO("Processing signature %d w=%d", signature->id(), signature->getWeight());
 	timeMemoryUpdate = timer.ticks();
+	stageTimer.next("Proximity by time");
+	_deadlineScheduler.beginStage(DeadlineScheduler::kProximityByTime);
 	ULOGGER_INFO("timeMemoryUpdate=%fs", timeMemoryUpdate);
 
 	//============================================================
@@ -954,6 +1045,7 @@ bool Rtabmap::process(
 		if(rehearsedId > 0)
 		{
 			_optimizedPoses.erase(rehearsedId);
+			_optimizedPosesIndex.remove(rehearsedId);
 		}
 		else if(signature->getWeight() >= 0 && _rgbdLinearUpdate > 0.0f && _rgbdAngularUpdate > 0.0f)
 		{
@@ -1044,6 +1136,7 @@ bool Rtabmap::process(
 							{
 								iter->second = mapCorrectionInv * up * iter->second;
 							}
+							_optimizedPosesIndex.update(_optimizedPoses);
 						}
 					}
 					else
@@ -1086,6 +1179,7 @@ bool Rtabmap::process(
 		UDEBUG("Added pose %s (odom=%s)", newPose.prettyPrint().c_str(), signature->getPose().prettyPrint().c_str());
 		// Update Poses and Constraints
 		_optimizedPoses.insert(std::make_pair(signature->id(), newPose));
+		_optimizedPosesIndex.add(signature->id(), newPose);
 		_lastLocalizationPose = newPose; // keep in cache the latest corrected pose
 		if(signature->getLinks().size() == 1 &&
 		   signature->getLinks().begin()->second.type() == Link::kNeighbor)
@@ -1108,6 +1202,7 @@ bool Rtabmap::process(
 				{
 					tmp = _constraints.rbegin()->second.merge(tmp, tmp.type());
 					_optimizedPoses.erase(s->id());
+					_optimizedPosesIndex.remove(s->id());
 					_constraints.erase(--_constraints.end());
 				}
 			}
@@ -1136,6 +1231,7 @@ bool Rtabmap::process(
 				int erased = (int)_optimizedPoses.erase(iter->first);
 				if(erased)
 				{
+					_optimizedPosesIndex.remove(iter->first);
 					for(std::multimap<int, Link>::iterator jter = _constraints.begin(); jter!=_constraints.end();)
 					{
 						if(jter->second.from() == iter->first || jter->second.to() == iter->first)
@@ -1169,6 +1265,12 @@ bool Rtabmap::process(
 				   _memory->getSignature(*iter)->mapId() == signature->mapId() &&
 				   _memory->getSignature(*iter)->getWeight()>=0)
 				{
+					if(!_deadlineScheduler.affordable())
+					{
+						UDEBUG("Skip local transform between %d and %d (deadline)", signature->id(), *iter);
+						_deadlineScheduler.skip();
+						continue;
+					}
 					std::string rejectedMsg;
 					UDEBUG("Check local transform between %d and %d", signature->id(), *iter);
 					RegistrationInfo info;
@@ -1178,7 +1280,9 @@ bool Rtabmap::process(
 						guess = newPose.inverse() * _optimizedPoses.at(*iter);
 					}
 
+					UTimer unitTimer;
 					Transform transform = _memory->computeTransform(signature->id(), *iter, guess, &info);
+					_deadlineScheduler.addUnitCost(unitTimer.ticks());
 
 					if(!transform.isNull())
 					{
@@ -1211,6 +1315,8 @@ bool Rtabmap::process(
 	}
 
 	timeProximityByTimeDetection = timer.ticks();
+	stageTimer.next("Bayes filter update");
+	_deadlineScheduler.beginStage(DeadlineScheduler::kLikelihood);
 	UINFO("timeLocalTimeDetection=%fs", timeProximityByTimeDetection);
 
 	//============================================================
@@ -1358,6 +1464,8 @@ bool Rtabmap::process(
 	_memory->joinTrashThread();
 	timeEmptyingTrash = _memory->getDbSavingTime();
 	timeJoiningTrash = timer.ticks();
+	stageTimer.next("Retrieval");
+	_deadlineScheduler.beginStage(DeadlineScheduler::kRetrieval);
 	ULOGGER_INFO("Time emptying memory trash = %fs,  joining (actual overhead) = %fs", timeEmptyingTrash, timeJoiningTrash);
 
 	//============================================================
@@ -1550,16 +1658,8 @@ bool Rtabmap::process(
 		if(immunizedLocally < maxLocalLocationsImmunized &&
 			_memory->isIncremental()) // Can only work in mapping mode
 		{
-			std::map<int ,Transform> poses;
-			// remove poses from STM
-			for(std::map<int, Transform>::iterator iter=_optimizedPoses.begin(); iter!=_optimizedPoses.end(); ++iter)
-			{
-				if(!_memory->isInSTM(iter->first))
-				{
-					poses.insert(*iter);
-				}
-			}
-			int nearestId = graph::findNearestNode(poses, _optimizedPoses.at(signature->id()));
+			// ignore poses from STM
+			int nearestId = graph::findNearestNode(optimizedPosesIndex(), _optimizedPoses.at(signature->id()), _memory->getStMem());
 
 			if(nearestId > 0 &&
 				(_localRadius==0 ||
@@ -1575,7 +1675,7 @@ bool Rtabmap::process(
 					}
 				}
 
-				std::list<std::pair<int, Transform> > path = graph::computePath(_optimizedPoses, links, nearestId, signature->id());
+				std::list<std::pair<int, Transform> > path = graph::computePathBidirectional(_optimizedPoses, links, nearestId, signature->id());
 				if(path.size() == 0)
 				{
 					UWARN("Could not compute a path between %d and %d", nearestId, signature->id());
@@ -1620,7 +1720,7 @@ bool Rtabmap::process(
 
 		// retrieval based on the nodes close the the nearest pose in WM
 		// immunize closest nodes
-		std::map<int, float> nearNodes = graph::getNodesInRadius(signature->id(), _optimizedPoses, _localRadius);
+		std::map<int, float> nearNodes = graph::getNodesInRadius(signature->id(), optimizedPosesIndex(), _localRadius);
 		// sort by distance
 		std::multimap<float, int> nearNodesByDist;
 		for(std::map<int, float>::iterator iter=nearNodes.begin(); iter!=nearNodes.end(); ++iter)
@@ -1700,11 +1800,37 @@ bool Rtabmap::process(
 	if(reactivatedIds.size())
 	{
 		// Not important if the loop closure hypothesis don't have all its neighbors loaded,
-		// only a loop closure link is added...
-		signaturesRetrieved = _memory->reactivateSignatures(
-				reactivatedIds,
-				_maxRetrieved+(unsigned int)retrievalLocalIds.size(), // add path retrieved
-				timeRetrievalDbAccess);
+		// only a loop closure link is added... so they are the first dropped if the
+		// deadline is at risk (the path retrieved is always loaded).
+		// With Rtabmap/MaxRetrieved=0 (no limit), all reactivated ids are budgeted.
+		unsigned int requested = _maxRetrieved>0?_maxRetrieved:(unsigned int)reactivatedIds.size();
+		unsigned int maxRetrieved = (unsigned int)_deadlineScheduler.affordableUnits((int)requested);
+		unsigned int maxLoaded = maxRetrieved+(unsigned int)retrievalLocalIds.size(); // add path retrieved
+		UTimer unitTimer;
+		if(maxLoaded > 0) // 0 would mean no limit for reactivateSignatures()
+		{
+			signaturesRetrieved = _memory->reactivateSignatures(
+					reactivatedIds,
+					maxLoaded,
+					timeRetrievalDbAccess);
+		}
+		if(signaturesRetrieved.size())
+		{
+			_deadlineScheduler.addUnitCost(unitTimer.ticks(), (int)signaturesRetrieved.size());
+		}
+		if(maxRetrieved < requested)
+		{
+			int maxSkipped = int(requested - maxRetrieved);
+			int notRetrieved = 0;
+			for(std::list<int>::iterator iter=reactivatedIds.begin(); iter!=reactivatedIds.end() && notRetrieved < maxSkipped; ++iter)
+			{
+				if(_memory->getSignature(*iter) == 0)
+				{
+					++notRetrieved;
+				}
+			}
+			_deadlineScheduler.skip(notRetrieved);
+		}
 
 		ULOGGER_INFO("retrieval of %d (db time = %fs)", (int)signaturesRetrieved.size(), timeRetrievalDbAccess);
 
@@ -1715,6 +1841,8 @@ bool Rtabmap::process(
 		immunizedLocations.insert(signaturesRetrieved.begin(), signaturesRetrieved.end());
 	}
 	timeReactivations = timer.ticks();
+	stageTimer.next("Add loop closure links");
+	_deadlineScheduler.beginStage(DeadlineScheduler::kAddLoopClosureLink);
 	ULOGGER_INFO("timeReactivations=%fs", timeReactivations);
 
 	//=============================================================
@@ -1758,12 +1886,16 @@ bool Rtabmap::process(
 	}
 
 	timeAddLoopClosureLink = timer.ticks();
+	stageTimer.next("Proximity by space");
+	_deadlineScheduler.beginStage(DeadlineScheduler::kProximityBySpace);
 	ULOGGER_INFO("timeAddLoopClosureLink=%fs", timeAddLoopClosureLink);
 
 	int proximityDetectionsAddedVisually = 0;
 	int proximityDetectionsAddedByICPOnly = 0;
 	int lastProximitySpaceClosureId = 0;
 	int proximitySpacePaths = 0;
+	int proximitySpaceCandidates = 0;
+	double proximitySpaceCandidatesTime = 0.0;
 	if(_proximityBySpace &&
 	   _localRadius > 0 &&
 	   _rgbdSlamMode &&
@@ -1797,7 +1929,7 @@ bool Rtabmap::process(
 				}
 				else
 				{
-					nearestIds = graph::getNodesInRadius(signature->id(), _optimizedPoses, _localRadius);
+					nearestIds = graph::getNodesInRadius(signature->id(), optimizedPosesIndex(), _localRadius);
 				}
 				UDEBUG("nearestIds=%d/%d", (int)nearestIds.size(), (int)_optimizedPoses.size());
 				std::map<int, Transform> nearestPoses;
@@ -1814,8 +1946,10 @@ bool Rtabmap::process(
 				std::list<std::map<int, Transform> > nearestPaths = getPaths(nearestPoses);
 				UDEBUG("nearestPaths=%d", (int)nearestPaths.size());
 
+				// candidates in path order
+				std::vector<int> candidates;
 				for(std::list<std::map<int, Transform> >::const_iterator iter=nearestPaths.begin();
-					iter!=nearestPaths.end() && (_memory->isIncremental() || lastProximitySpaceClosureId == 0);
+					iter!=nearestPaths.end();
 					++iter)
 				{
 					std::map<int, Transform> path = *iter;
@@ -1832,39 +1966,87 @@ bool Rtabmap::process(
 							(_proximityFilteringRadius <= 0.0f ||
 							 _optimizedPoses.at(signature->id()).getDistanceSquared(_optimizedPoses.at(nearestId)) < _proximityFilteringRadius*_proximityFilteringRadius))
 						{
-							RegistrationInfo info;
-							Transform transform = _memory->computeTransform(signature->id(), nearestId, Transform(), &info);
-							if(!transform.isNull())
-							{
-								if(_proximityFilteringRadius <= 0 || transform.getNormSquared() <= _proximityFilteringRadius*_proximityFilteringRadius)
-								{
-									UINFO("[Visual] Add local loop closure in SPACE (%d->%d) %s",
-											signature->id(),
-											nearestId,
-											transform.prettyPrint().c_str());
-									UASSERT(info.variance > 0.0);
-									_memory->addLink(Link(signature->id(), nearestId, Link::kLocalSpaceClosure, transform, info.variance, info.variance));
-									loopClosureLinksAdded.push_back(std::make_pair(signature->id(), nearestId));
+							candidates.push_back(nearestId);
+						}
+					}
+				}
 
-									if(loopClosureVisualInliers == 0)
-									{
-										loopClosureVisualInliers = info.inliers;
-									}
+				std::vector<Transform> transforms;
+				std::vector<RegistrationInfo> infos;
+				if(_proximityParallel && candidates.size() > 1)
+				{
+					// drop the last candidates if they cannot be registered before the deadline
+					int affordable = _deadlineScheduler.affordableUnits((int)candidates.size(), DeadlineScheduler::kUnitVisualParallel);
+					_deadlineScheduler.skip((int)candidates.size() - affordable);
+					candidates.resize(affordable);
+				}
+				if(_proximityParallel && candidates.size() > 1)
+				{
+					UTimer unitTimer;
+					transforms = _memory->computeTransforms(signature->id(), candidates, &infos);
+					_deadlineScheduler.addUnitCost(unitTimer.ticks(), (int)candidates.size(), DeadlineScheduler::kUnitVisualParallel);
+					proximitySpaceCandidates += (int)candidates.size();
+					for(unsigned int i=0; i<infos.size(); ++i)
+					{
+						proximitySpaceCandidatesTime += infos[i].totalTime;
+					}
+				}
 
-									if(_loopClosureHypothesis.first == 0)
-									{
-										++proximityDetectionsAddedVisually;
-										lastProximitySpaceClosureId = nearestId;
-									}
-								}
-								else
-								{
-									UWARN("Ignoring local loop closure with %d because resulting "
-										  "transform is to large!? (%fm > %fm)",
-											nearestId, transform.getNorm(), _proximityFilteringRadius);
-								}
+				for(unsigned int i=0;
+					i<candidates.size() && (_memory->isIncremental() || lastProximitySpaceClosureId == 0);
+					++i)
+				{
+					int nearestId = candidates[i];
+					RegistrationInfo info;
+					Transform transform;
+					if(transforms.size())
+					{
+						transform = transforms[i];
+						info = infos[i];
+					}
+					else
+					{
+						if(!_deadlineScheduler.affordable(DeadlineScheduler::kUnitVisual))
+						{
+							_deadlineScheduler.skip();
+							continue;
+						}
+						UTimer candidateTimer;
+						transform = _memory->computeTransform(signature->id(), nearestId, Transform(), &info);
+						double candidateTime = candidateTimer.ticks();
+						proximitySpaceCandidatesTime += candidateTime;
+						_deadlineScheduler.addUnitCost(candidateTime, 1, DeadlineScheduler::kUnitVisual);
+						++proximitySpaceCandidates;
+					}
+					if(!transform.isNull())
+					{
+						if(_proximityFilteringRadius <= 0 || transform.getNormSquared() <= _proximityFilteringRadius*_proximityFilteringRadius)
+						{
+							UINFO("[Visual] Add local loop closure in SPACE (%d->%d) %s",
+									signature->id(),
+									nearestId,
+									transform.prettyPrint().c_str());
+							UASSERT(info.variance > 0.0);
+							_memory->addLink(Link(signature->id(), nearestId, Link::kLocalSpaceClosure, transform, info.variance, info.variance));
+							loopClosureLinksAdded.push_back(std::make_pair(signature->id(), nearestId));
+
+							if(loopClosureVisualInliers == 0)
+							{
+								loopClosureVisualInliers = info.inliers;
+							}
+
+							if(_loopClosureHypothesis.first == 0)
+							{
+								++proximityDetectionsAddedVisually;
+								lastProximitySpaceClosureId = nearestId;
 							}
 						}
+						else
+						{
+							UWARN("Ignoring local loop closure with %d because resulting "
+								  "transform is to large!? (%fm > %fm)",
+									nearestId, transform.getNorm(), _proximityFilteringRadius);
+						}
 					}
 				}
 
@@ -1881,130 +2063,185 @@ bool Rtabmap::process(
 
 					proximitySpacePaths = (int)nearestPaths.size();
 
-					for(std::list<std::map<int, Transform> >::iterator iter=nearestPaths.begin();
-							iter!=nearestPaths.end() && (_memory->isIncremental() || lastProximitySpaceClosureId == 0);
-							++iter)
+					std::list<std::map<int, Transform> >::iterator iter=nearestPaths.begin();
+					while(iter!=nearestPaths.end() && (_memory->isIncremental() || lastProximitySpaceClosureId == 0))
 					{
-						std::map<int, Transform> & path = *iter;
-						UASSERT(path.size());
-
-						//find the nearest pose on the path
-						int nearestId = rtabmap::graph::findNearestNode(path, _optimizedPoses.at(signature->id()));
-						UASSERT(nearestId > 0);
-						UDEBUG("Path %d distance=%fm", nearestId, _optimizedPoses.at(signature->id()).getDistance(_optimizedPoses.at(nearestId)));
-
-						// nearest pose must be close and not linked to current location
-						if(!signature->hasLink(nearestId) &&
-						   (_proximityFilteringRadius <= 0.0f ||
-							_optimizedPoses.at(signature->id()).getDistanceSquared(_optimizedPoses.at(nearestId)) < _proximityFilteringRadius*_proximityFilteringRadius))
+						// candidates <nearest id, path> in path order, in serial
+						// mode each candidate is registered as soon as it is found
+						std::vector<std::pair<int, std::map<int, Transform> > > candidates;
+						for(; iter!=nearestPaths.end() && (candidates.empty() || _proximityParallel); ++iter)
 						{
-							if(!_proximityScansMerged)
-							{
-								//only keep the nearest node
-								std::map<int, Transform> tmp;
-								tmp.insert(*path.find(nearestId));
-								path = tmp;
-							}
-							else
+							std::map<int, Transform> & path = *iter;
+							UASSERT(path.size());
+
+							//find the nearest pose on the path
+							int nearestId = rtabmap::graph::findNearestNode(path, _optimizedPoses.at(signature->id()));
+							UASSERT(nearestId > 0);
+							UDEBUG("Path %d distance=%fm", nearestId, _optimizedPoses.at(signature->id()).getDistance(_optimizedPoses.at(nearestId)));
+
+							// nearest pose must be close and not linked to current location
+							if(!signature->hasLink(nearestId) &&
+							   (_proximityFilteringRadius <= 0.0f ||
+								_optimizedPoses.at(signature->id()).getDistanceSquared(_optimizedPoses.at(nearestId)) < _proximityFilteringRadius*_proximityFilteringRadius))
 							{
-								// Assemble scans in the path and do ICP only
-								if(_proximityRawPosesUsed)
+								if(!_proximityScansMerged)
+								{
+									//only keep the nearest node
+									std::map<int, Transform> tmp;
+									tmp.insert(*path.find(nearestId));
+									path = tmp;
+								}
+								else
 								{
-									//optimize the path's poses locally
-									path = optimizeGraph(nearestId, uKeysSet(path), std::map<int, Transform>(), false);
-									// transform local poses in optimized graph referential
-									UASSERT(uContains(path, nearestId));
-									Transform t = _optimizedPoses.at(nearestId) * path.at(nearestId).inverse();
-									for(std::map<int, Transform>::iterator jter=path.begin(); jter!=path.end(); ++jter)
+									// Assemble scans in the path and do ICP only
+									if(_proximityRawPosesUsed)
 									{
-										jter->second = t * jter->second;
+										//optimize the path's poses locally
+										path = optimizeGraph(nearestId, uKeysSet(path), std::map<int, Transform>(), false);
+										// transform local poses in optimized graph referential
+										UASSERT(uContains(path, nearestId));
+										Transform t = _optimizedPoses.at(nearestId) * path.at(nearestId).inverse();
+										for(std::map<int, Transform>::iterator jter=path.begin(); jter!=path.end(); ++jter)
+										{
+											jter->second = t * jter->second;
+										}
+									}
+									if(path.size() > 2 && _proximityFilteringRadius > 0.0f)
+									{
+										// path filtering
+										std::map<int, Transform> filteredPath = graph::radiusPosesFiltering(path, _proximityFilteringRadius, 0, true);
+										// make sure the nearest and farthest poses are still here
+										filteredPath.insert(*path.find(nearestId));
+										filteredPath.insert(*path.begin());
+										filteredPath.insert(*path.rbegin());
+										path = filteredPath;
 									}
 								}
-								if(path.size() > 2 && _proximityFilteringRadius > 0.0f)
+
+								if(path.size() > 0)
 								{
-									// path filtering
-									std::map<int, Transform> filteredPath = graph::radiusPosesFiltering(path, _proximityFilteringRadius, 0, true);
-									// make sure the nearest and farthest poses are still here
-									filteredPath.insert(*path.find(nearestId));
-									filteredPath.insert(*path.begin());
-									filteredPath.insert(*path.rbegin());
-									path = filteredPath;
+									// add current node to poses
+									path.insert(std::make_pair(signature->id(), _optimizedPoses.at(signature->id())));
+									//The nearest will be the reference for a loop closure transform
+									if(signature->getLinks().find(nearestId) == signature->getLinks().end())
+									{
+										candidates.push_back(std::make_pair(nearestId, path));
+									}
 								}
 							}
+							else
+							{
+								UDEBUG("Path %d ignored", nearestId);
+							}
+						}
+
+						std::vector<Transform> transforms;
+						std::vector<RegistrationInfo> infos;
+						if(_proximityParallel && candidates.size() > 1)
+						{
+							int affordable = _deadlineScheduler.affordableUnits((int)candidates.size(), DeadlineScheduler::kUnitScanParallel);
+							_deadlineScheduler.skip((int)candidates.size() - affordable);
+							candidates.resize(affordable);
+						}
+						if(_proximityParallel && candidates.size() > 1)
+						{
+							UTimer unitTimer;
+							transforms = _memory->computeIcpTransformsMulti(signature->id(), candidates, &infos);
+							_deadlineScheduler.addUnitCost(unitTimer.ticks(), (int)candidates.size(), DeadlineScheduler::kUnitScanParallel);
+							proximitySpaceCandidates += (int)candidates.size();
+							for(unsigned int i=0; i<infos.size(); ++i)
+							{
+								proximitySpaceCandidatesTime += infos[i].totalTime;
+							}
+						}
 
-							if(path.size() > 0)
+						for(unsigned int i=0;
+							i<candidates.size() && (_memory->isIncremental() || lastProximitySpaceClosureId == 0);
+							++i)
+						{
+							int nearestId = candidates[i].first;
+							const std::map<int, Transform> & path = candidates[i].second;
+							RegistrationInfo info;
+							Transform transform;
+							if(transforms.size())
 							{
-								// add current node to poses
-								path.insert(std::make_pair(signature->id(), _optimizedPoses.at(signature->id())));
-								//The nearest will be the reference for a loop closure transform
-								if(signature->getLinks().find(nearestId) == signature->getLinks().end())
+								transform = transforms[i];
+								info = infos[i];
+							}
+							else
+							{
+								if(!_deadlineScheduler.affordable(DeadlineScheduler::kUnitScan))
 								{
-									RegistrationInfo info;
-									Transform transform = _memory->computeIcpTransformMulti(signature->id(), nearestId, path, &info);
-									if(!transform.isNull())
+									_deadlineScheduler.skip();
+									continue;
+								}
+								UTimer candidateTimer;
+								transform = _memory->computeIcpTransformMulti(signature->id(), nearestId, path, &info);
+								double candidateTime = candidateTimer.ticks();
+								proximitySpaceCandidatesTime += candidateTime;
+								_deadlineScheduler.addUnitCost(candidateTime, 1, DeadlineScheduler::kUnitScan);
+								++proximitySpaceCandidates;
+							}
+							if(!transform.isNull())
+							{
+								if(_proximityFilteringRadius <= 0 || transform.getNormSquared() <= _proximityFilteringRadius*_proximityFilteringRadius)
+								{
+									UINFO("[Scan matching] Add local loop closure in SPACE (%d->%d) %s",
+											signature->id(),
+											nearestId,
+											transform.prettyPrint().c_str());
+
+									cv::Mat scanMatchingIds;
+									if(_scanMatchingIdsSavedInLinks)
 									{
-										if(_proximityFilteringRadius <= 0 || transform.getNormSquared() <= _proximityFilteringRadius*_proximityFilteringRadius)
+										std::stringstream stream;
+										stream << "SCANS:";
+										for(std::map<int, Transform>::const_iterator jter=path.begin(); jter!=path.end(); ++jter)
 										{
-											UINFO("[Scan matching] Add local loop closure in SPACE (%d->%d) %s",
-													signature->id(),
-													nearestId,
-													transform.prettyPrint().c_str());
-
-											cv::Mat scanMatchingIds;
-											if(_scanMatchingIdsSavedInLinks)
+											if(jter->first!=signature->id())
 											{
-												std::stringstream stream;
-												stream << "SCANS:";
-												for(std::map<int, Transform>::iterator iter=path.begin(); iter!=path.end(); ++iter)
+												if(jter != path.begin())
 												{
-													if(iter->first!=signature->id())
-													{
-														if(iter != path.begin())
-														{
-															stream << ";";
-														}
-														stream << uNumber2Str(iter->first);
-													}
+													stream << ";";
 												}
-												std::string scansStr = stream.str();
-												scanMatchingIds = cv::Mat(1, int(scansStr.size()+1), CV_8SC1, (void *)scansStr.c_str());
-												scanMatchingIds = compressData2(scanMatchingIds); // compressed
+												stream << uNumber2Str(jter->first);
 											}
+										}
+										std::string scansStr = stream.str();
+										scanMatchingIds = cv::Mat(1, int(scansStr.size()+1), CV_8SC1, (void *)scansStr.c_str());
+										scanMatchingIds = compressData2(scanMatchingIds); // compressed
+									}
 
-											// set Identify covariance for laser scan matching only
-											UASSERT(info.variance>0.0);
-											double sqrtVar = sqrt(info.variance);
-											_memory->addLink(Link(signature->id(), nearestId, Link::kLocalSpaceClosure, transform, sqrtVar, sqrtVar, scanMatchingIds));
-											loopClosureLinksAdded.push_back(std::make_pair(signature->id(), nearestId));
+									// set Identify covariance for laser scan matching only
+									UASSERT(info.variance>0.0);
+									double sqrtVar = sqrt(info.variance);
+									_memory->addLink(Link(signature->id(), nearestId, Link::kLocalSpaceClosure, transform, sqrtVar, sqrtVar, scanMatchingIds));
+									loopClosureLinksAdded.push_back(std::make_pair(signature->id(), nearestId));
 
-											++proximityDetectionsAddedByICPOnly;
+									++proximityDetectionsAddedByICPOnly;
 
-											// no local loop closure added visually
-											if(proximityDetectionsAddedVisually == 0 && _loopClosureHypothesis.first == 0)
-											{
-												lastProximitySpaceClosureId = nearestId;
-											}
-										}
-										else
-										{
-											UWARN("Ignoring local loop closure with %d because resulting "
-												  "transform is to large!? (%fm > %fm)",
-													nearestId, transform.getNorm(), _proximityFilteringRadius);
-										}
+									// no local loop closure added visually
+									if(proximityDetectionsAddedVisually == 0 && _loopClosureHypothesis.first == 0)
+									{
+										lastProximitySpaceClosureId = nearestId;
 									}
 								}
+								else
+								{
+									UWARN("Ignoring local loop closure with %d because resulting "
+										  "transform is to large!? (%fm > %fm)",
+											nearestId, transform.getNorm(), _proximityFilteringRadius);
+								}
 							}
 						}
-						else
-						{
-							UDEBUG("Path %d ignored", nearestId);
-						}
 					}
 				}
 			}
 		}
 	}
 	timeProximityBySpaceDetection = timer.ticks();
+	stageTimer.next("Map optimization");
+	_deadlineScheduler.beginStage(DeadlineScheduler::kMapOptimization);
 	ULOGGER_INFO("timeProximityBySpaceDetection=%fs", timeProximityBySpaceDetection);
 
 	//============================================================
@@ -2039,6 +2276,7 @@ bool Rtabmap::process(
 	float maxLinearError = 0.0f;
 	double optimizationError = 0.0;
 	int optimizationIterations = 0;
+	bool optimizationIncremental = false;
 	if(_rgbdSlamMode &&
 		(_loopClosureHypothesis.first>0 ||
 	     lastProximitySpaceClosureId>0 || // can be different map of the current one
@@ -2077,10 +2315,12 @@ bool Rtabmap::process(
 					iter->second = mapCorrectionInv * up * iter->second;
 				}
 				_optimizedPoses.at(signature->id()) = signature->getPose();
+				_optimizedPosesIndex.update(_optimizedPoses);
 			}
 			else
 			{
 				_optimizedPoses.at(signature->id()) = _optimizedPoses.at(signature->getLinks().begin()->first) * signature->getLinks().begin()->second.transform().inverse();
+				_optimizedPosesIndex.add(signature->id(), _optimizedPoses.at(signature->id()));
 			}
 		}
 		else
@@ -2098,7 +2338,7 @@ bool Rtabmap::process(
 			}
 
 			std::multimap<int, Link> constraints;
-			optimizeCurrentMap(signature->id(), false, poses, &constraints, &optimizationError, &optimizationIterations);
+			optimizeCurrentMap(signature->id(), false, poses, &constraints, &optimizationError, &optimizationIterations, _optimizeIncremental, &optimizationIncremental);
 
 			// Check added loop closures have broken the graph
 			// (in case of wrong loop closures).
@@ -2171,6 +2411,7 @@ bool Rtabmap::process(
 			{
 				UINFO("Updated local map (old size=%d, new size=%d)", (int)_optimizedPoses.size(), (int)poses.size());
 				_optimizedPoses = poses;
+				_optimizedPosesIndex.update(_optimizedPoses);
 				_constraints = constraints;
 			}
 		}
@@ -2186,6 +2427,8 @@ bool Rtabmap::process(
 	_lastLocalizationNodeId = _loopClosureHypothesis.first>0?_loopClosureHypothesis.first:lastProximitySpaceClosureId>0?lastProximitySpaceClosureId:_lastLocalizationNodeId;
 
 	timeMapOptimization = timer.ticks();
+	stageTimer.next("Statistics creation");
+	_deadlineScheduler.beginStage(DeadlineScheduler::kStatistics);
 	ULOGGER_INFO("timeMapOptimization=%fs", timeMapOptimization);
 
 	//============================================================
@@ -2237,11 +2480,14 @@ bool Rtabmap::process(
 			statistics_.addStatistic(Statistics::kLoopOptimization_max_error(), maxLinearError);
 			statistics_.addStatistic(Statistics::kLoopOptimization_error(), optimizationError);
 			statistics_.addStatistic(Statistics::kLoopOptimization_iterations(), optimizationIterations);
+			statistics_.addStatistic(Statistics::kLoopOptimization_incremental(), optimizationIncremental?1.0f:0.0f);
 
 			statistics_.addStatistic(Statistics::kProximityTime_detections(), proximityDetectionsInTimeFound);
 			statistics_.addStatistic(Statistics::kProximitySpace_detections_added_visually(), proximityDetectionsAddedVisually);
 			statistics_.addStatistic(Statistics::kProximitySpace_detections_added_icp_only(), proximityDetectionsAddedByICPOnly);
 			statistics_.addStatistic(Statistics::kProximitySpace_paths(), proximitySpacePaths);
+			statistics_.addStatistic(Statistics::kProximitySpace_candidates(), proximitySpaceCandidates);
+			statistics_.addStatistic(Statistics::kProximitySpace_candidate_time(), proximitySpaceCandidates?proximitySpaceCandidatesTime*1000.0/double(proximitySpaceCandidates):0.0);
 			statistics_.addStatistic(Statistics::kProximitySpace_last_detection_id(), lastProximitySpaceClosureId);
 			statistics_.setProximityDetectionId(lastProximitySpaceClosureId);
 			if(_loopClosureHypothesis.first || lastProximitySpaceClosureId)
@@ -2308,6 +2554,8 @@ bool Rtabmap::process(
 		ULOGGER_INFO("Time creating stats = %f...", timeStatsCreation);
 	}
 
+	stageTimer.next("Memory cleanup");
+	_deadlineScheduler.beginStage(DeadlineScheduler::kMemoryCleanup);
 	Signature lastSignatureData(signature->id());
 	if(_publishLastSignatureData)
 	{
@@ -2356,6 +2604,8 @@ bool Rtabmap::process(
 	signature = 0;
 
 	timeMemoryCleanup = timer.ticks();
+	stageTimer.next("Transfer");
+	_deadlineScheduler.beginStage(DeadlineScheduler::kTransfer);
 	ULOGGER_INFO("timeMemoryCleanup = %fs... %d signatures removed", timeMemoryCleanup, (int)signaturesRemoved.size());
 
 
@@ -2427,6 +2677,7 @@ bool Rtabmap::process(
 				{
 					UDEBUG("Removed %d from local map", iter->first);
 					UASSERT(iter->first != _lastLocalizationNodeId);
+					_optimizedPosesIndex.remove(iter->first);
 					_optimizedPoses.erase(iter++);
 				}
 				else
@@ -2449,6 +2700,7 @@ bool Rtabmap::process(
 		else
 		{
 			_optimizedPoses.clear();
+			_optimizedPosesIndex.clear();
 			_constraints.clear();
 		}
 	}
@@ -2463,6 +2715,8 @@ bool Rtabmap::process(
 
 
 	timeRealTimeLimitReachedProcess = timer.ticks();
+	stageTimer.next("Statistics finalization");
+	_deadlineScheduler.endFrame();
 	ULOGGER_INFO("Time limit reached processing = %f...", timeRealTimeLimitReachedProcess);
 
 	//==============================================================
@@ -2489,6 +2743,44 @@ bool Rtabmap::process(
 		statistics_.addStatistic(Statistics::kMemoryShort_time_memory_size(), _memory->getStMem().size());
 		statistics_.addStatistic(Statistics::kMemoryDatabase_memory_used(), _memory->getDatabaseMemoryUsed());
 
+		// latency of proximity, nearest node and radius queries
+		statistics_.addStatistic(Statistics::kSpatialIndexNodes(), _optimizedPosesIndex.size());
+		statistics_.addStatistic(Statistics::kSpatialIndexCells(), _optimizedPosesIndex.getCells());
+		statistics_.addStatistic(Statistics::kSpatialIndexQueries(), _optimizedPosesIndex.getQueries());
+		statistics_.addStatistic(Statistics::kSpatialIndexQueries_time(), _optimizedPosesIndex.getQueriesTime()*1000);
+		statistics_.addStatistic(Statistics::kSpatialIndexUpdate_time(), _optimizedPosesIndex.getUpdatesTime()*1000);
+
+		if(_deadlineScheduling && _maxTimeAllowed > 0.0f)
+		{
+			// overruns of this frame and work dropped to meet the deadline
+			statistics_.addStatistic(Statistics::kDeadlineOverruns(), _deadlineScheduler.getFrameOverruns());
+			statistics_.addStatistic(Statistics::kDeadlineSkipped_proximity_by_time(), _deadlineScheduler.getFrameSkipped(DeadlineScheduler::kProximityByTime));
+			statistics_.addStatistic(Statistics::kDeadlineSkipped_retrieval(), _deadlineScheduler.getFrameSkipped(DeadlineScheduler::kRetrieval));
+			statistics_.addStatistic(Statistics::kDeadlineSkipped_proximity_by_space(), _deadlineScheduler.getFrameSkipped(DeadlineScheduler::kProximityBySpace));
+			// accumulated since the beginning
+			statistics_.addStatistic(Statistics::kDeadlineLate_frames(), _deadlineScheduler.getLateFrames());
+			statistics_.addStatistic(Statistics::kDeadlineMemory_update_overruns(), _deadlineScheduler.getOverruns(DeadlineScheduler::kMemoryUpdate));
+			statistics_.addStatistic(Statistics::kDeadlineProximity_by_time_overruns(), _deadlineScheduler.getOverruns(DeadlineScheduler::kProximityByTime));
+			statistics_.addStatistic(Statistics::kDeadlineLikelihood_overruns(), _deadlineScheduler.getOverruns(DeadlineScheduler::kLikelihood));
+			statistics_.addStatistic(Statistics::kDeadlineRetrieval_overruns(), _deadlineScheduler.getOverruns(DeadlineScheduler::kRetrieval));
+			statistics_.addStatistic(Statistics::kDeadlineAdd_loop_closure_link_overruns(), _deadlineScheduler.getOverruns(DeadlineScheduler::kAddLoopClosureLink));
+			statistics_.addStatistic(Statistics::kDeadlineProximity_by_space_overruns(), _deadlineScheduler.getOverruns(DeadlineScheduler::kProximityBySpace));
+			statistics_.addStatistic(Statistics::kDeadlineMap_optimization_overruns(), _deadlineScheduler.getOverruns(DeadlineScheduler::kMapOptimization));
+			statistics_.addStatistic(Statistics::kDeadlineStatistics_overruns(), _deadlineScheduler.getOverruns(DeadlineScheduler::kStatistics));
+			statistics_.addStatistic(Statistics::kDeadlineMemory_cleanup_overruns(), _deadlineScheduler.getOverruns(DeadlineScheduler::kMemoryCleanup));
+			statistics_.addStatistic(Statistics::kDeadlineTransfer_overruns(), _deadlineScheduler.getOverruns(DeadlineScheduler::kTransfer));
+		}
+
+		// SensorData copies since the start of the process, deep copies should stay 0
+		unsigned long sensorDataCopies, sensorDataDeepCopies, sensorDataDecompressions;
+		unsigned long long sensorDataDeepCopiesBytes, sensorDataDecompressionsBytes;
+		SensorData::getStatistics(sensorDataCopies, sensorDataDeepCopies, sensorDataDeepCopiesBytes, sensorDataDecompressions, sensorDataDecompressionsBytes);
+		statistics_.addStatistic(Statistics::kMemorySensor_data_copies(), sensorDataCopies);
+		statistics_.addStatistic(Statistics::kMemorySensor_data_deep_copies(), sensorDataDeepCopies);
+		statistics_.addStatistic(Statistics::kMemorySensor_data_deep_copies_size(), float(sensorDataDeepCopiesBytes)/1024.0f);
+		statistics_.addStatistic(Statistics::kMemorySensor_data_decompressions(), sensorDataDecompressions);
+		statistics_.addStatistic(Statistics::kMemorySensor_data_decompressions_size(), float(sensorDataDecompressionsBytes)/1024.0f);
+
 		std::map<int, Signature> signatures;
 		if(_publishLastSignatureData)
 		{
@@ -2509,6 +2801,7 @@ bool Rtabmap::process(
 			poses = _optimizedPoses;
 			constraints = _constraints;
 		}
+		std::map<int, Signature> nodes;
 		for(std::map<int, Transform>::iterator iter=poses.begin(); iter!=poses.end(); ++iter)
 		{
 			Transform odomPose;
@@ -2519,7 +2812,7 @@ bool Rtabmap::process(
 			Transform groundTruth;
 			std::vector<unsigned char> userData;
 			_memory->getNodeInfo(iter->first, odomPose, mapId, weight, label, stamp, groundTruth, false);
-			signatures.insert(std::make_pair(iter->first,
+			nodes.insert(nodes.end(), std::make_pair(iter->first,
 					Signature(iter->first,
 							mapId,
 							weight,
@@ -2528,15 +2821,125 @@ bool Rtabmap::process(
 							odomPose,
 							groundTruth)));
 		}
-		statistics_.setPoses(poses);
-		statistics_.setConstraints(constraints);
-		statistics_.setSignatures(signatures);
+		statistics_.setPublicationId(++_statsPublicationId);
 		statistics_.addStatistic(Statistics::kMemoryLocal_graph_size(), poses.size());
 		localGraphSize = (int)poses.size();
+
+		bool keyFrame = !_publishStatsDelta ||
+				_statsLastKeyFrameId == 0 ||
+				(_publishStatsKeyFrame > 0 && _statsPublicationId - _statsLastKeyFrameId >= _publishStatsKeyFrame);
+		if(keyFrame)
+		{
+			signatures.insert(nodes.begin(), nodes.end());
+			statistics_.setPoses(poses);
+			statistics_.setConstraints(constraints);
+			statistics_.addStatistic(Statistics::kMemoryPublished_poses(), poses.size());
+			statistics_.addStatistic(Statistics::kMemoryPublished_links(), constraints.size());
+			statistics_.addStatistic(Statistics::kMemoryPublished_removed(), 0);
+		}
+		else
+		{
+			// Only what changed since the last publication
+			std::map<int, Transform> changedPoses;
+			std::vector<int> removedPoses;
+			for(std::map<int, Transform>::iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+			{
+				std::map<int, Transform>::iterator jter = _publishedPoses.find(iter->first);
+				if(jter == _publishedPoses.end() || jter->second != iter->second)
+				{
+					changedPoses.insert(changedPoses.end(), *iter);
+				}
+			}
+			for(std::map<int, Transform>::iterator iter=_publishedPoses.begin(); iter!=_publishedPoses.end(); ++iter)
+			{
+				if(poses.find(iter->first) == poses.end())
+				{
+					removedPoses.push_back(iter->first);
+				}
+			}
+			for(std::map<int, Signature>::iterator iter=nodes.begin(); iter!=nodes.end(); ++iter)
+			{
+				std::map<int, Signature>::iterator jter = _publishedSignatures.find(iter->first);
+				if(jter == _publishedSignatures.end() ||
+				   jter->second.getWeight() != iter->second.getWeight() ||
+				   jter->second.mapId() != iter->second.mapId() ||
+				   jter->second.getLabel().compare(iter->second.getLabel()) != 0)
+				{
+					signatures.insert(*iter);
+				}
+			}
+
+			// links are identified by their end points and their type
+			std::multimap<int, Link> changedConstraints;
+			std::multimap<int, Link> removedConstraints;
+			for(std::multimap<int, Link>::iterator iter=constraints.begin(); iter!=constraints.end(); ++iter)
+			{
+				bool found = false;
+				for(std::multimap<int, Link>::iterator jter=_publishedConstraints.find(iter->first);
+					jter!=_publishedConstraints.end() && jter->first == iter->first;
+					++jter)
+				{
+					if(jter->second.to() == iter->second.to() &&
+					   jter->second.type() == iter->second.type())
+					{
+						found = jter->second.transform() == iter->second.transform() &&
+								jter->second.transVariance() == iter->second.transVariance() &&
+								jter->second.rotVariance() == iter->second.rotVariance();
+						break;
+					}
+				}
+				if(!found)
+				{
+					changedConstraints.insert(*iter);
+				}
+			}
+			for(std::multimap<int, Link>::iterator iter=_publishedConstraints.begin(); iter!=_publishedConstraints.end(); ++iter)
+			{
+				bool found = false;
+				for(std::multimap<int, Link>::iterator jter=constraints.find(iter->first);
+					!found && jter!=constraints.end() && jter->first == iter->first;
+					++jter)
+				{
+					found = jter->second.to() == iter->second.to() &&
+							jter->second.type() == iter->second.type();
+				}
+				if(!found)
+				{
+					removedConstraints.insert(*iter);
+				}
+			}
+
+			statistics_.setDeltaBaseId(_statsPublicationId-1);
+			statistics_.setPoses(changedPoses);
+			statistics_.setConstraints(changedConstraints);
+			statistics_.setRemovedPoses(removedPoses);
+			statistics_.setRemovedConstraints(removedConstraints);
+			statistics_.addStatistic(Statistics::kMemoryPublished_poses(), changedPoses.size());
+			statistics_.addStatistic(Statistics::kMemoryPublished_links(), changedConstraints.size());
+			statistics_.addStatistic(Statistics::kMemoryPublished_removed(), removedPoses.size()+removedConstraints.size());
+		}
+		statistics_.setSignatures(signatures);
+
+		if(_publishStatsDelta)
+		{
+			if(keyFrame)
+			{
+				_statsLastKeyFrameId = _statsPublicationId;
+			}
+			_publishedPoses.swap(poses);
+			_publishedConstraints.swap(constraints);
+			_publishedSignatures.swap(nodes);
+		}
+		else if(_publishedPoses.size())
+		{
+			resetPublishedGraph();
+		}
 	}
 
 	//Start trashing
+	stageTimer.next("Emptying trash");
 	_memory->emptyTrash();
+	stageTimer.stop();
 
 	// Log info...
 	// TODO : use a specific class which will handle the RtabmapEvent
@@ -2610,6 +3013,25 @@ bool Rtabmap::process(
 		UINFO("Time logging = %f...", timer.ticks());
 		//ULogger::flush();
 	}
+	else if(_statisticsLog)
+	{
+		_statisticsLog->append(statistics_, data.stamp());
+		UINFO("Time logging = %f...", timer.ticks());
+	}
+
+	if(_profiling)
+	{
+		processTimer.stop();
+		statistics_.setProfile(profilerFrame.end());
+		if(_profilingTrace && !_wDir.empty())
+		{
+			Profiler::appendChromeTrace(_wDir+"/trace.json", statistics_.profile());
+		}
+	}
+	else if(statistics_.profile().size())
+	{
+		statistics_.setProfile(std::vector<ProfileNode>());
+	}
 	UDEBUG("End process");
 
 	return true;
@@ -2729,7 +3151,7 @@ std::map<int, Transform> Rtabmap::getForwardWMPoses(
 		}
 		else
 		{
-			foundIds = graph::getNodesInRadius(fromId, _optimizedPoses, radius);
+			foundIds = graph::getNodesInRadius(fromId, optimizedPosesIndex(), radius);
 		}
 
 		float radiusSqrd = radius * radius;
@@ -2852,7 +3274,9 @@ void Rtabmap::optimizeCurrentMap(
 		std::map<int, Transform> & optimizedPoses,
 		std::multimap<int, Link> * constraints,
 		double * error,
-		int * iterationsDone) const
+		int * iterationsDone,
+		bool incremental,
+		bool * incrementalDone) const
 {
 	//Optimize the map
 	UINFO("Optimize map: around location %d", id);
@@ -2866,7 +3290,7 @@ void Rtabmap::optimizeCurrentMap(
 		}
 		UINFO("get %d ids time %f s", (int)ids.size(), timer.ticks());
 
-		std::map<int, Transform> poses = Rtabmap::optimizeGraph(id, uKeysSet(ids), optimizedPoses, lookInDatabase, constraints, error, iterationsDone);
+		std::map<int, Transform> poses = Rtabmap::optimizeGraph(id, uKeysSet(ids), optimizedPoses, lookInDatabase, constraints, error, iterationsDone, incremental, incrementalDone);
 		UINFO("optimize time %f s", timer.ticks());
 
 		if(poses.size())
@@ -2898,7 +3322,9 @@ std::map<int, Transform> Rtabmap::optimizeGraph(
 		bool lookInDatabase,
 		std::multimap<int, Link> * constraints,
 		double * error,
-		int * iterationsDone) const
+		int * iterationsDone,
+		bool incremental,
+		bool * incrementalDone) const
 {
 	UTimer timer;
 	std::map<int, Transform> optimizedPoses;
@@ -2967,11 +3393,19 @@ std::map<int, Transform> Rtabmap::optimizeGraph(
 		// Optimization desactivated! Return not optimized poses.
 		optimizedPoses = poses;
 	}
+	else if(incremental)
+	{
+		optimizedPoses = _graphOptimizer->optimizeIncremental(fromId, poses, edgeConstraints, error, iterationsDone, incrementalDone);
+	}
+	else if(_optimizeHierarchical)
+	{
+		optimizedPoses = _graphOptimizer->optimizeHierarchical(fromId, poses, edgeConstraints, _optimizeHierarchicalSegment, error, iterationsDone);
+	}
 	else
 	{
 		optimizedPoses = _graphOptimizer->optimize(fromId, poses, edgeConstraints, 0, error, iterationsDone);
 	}
-	UINFO("Optimization time %f s", timer.ticks());
+	UINFO("Optimization time %f s (incremental=%d)", timer.ticks(), incrementalDone&&*incrementalDone?1:0);
 
 	return optimizedPoses;
 }
@@ -3296,7 +3730,7 @@ bool Rtabmap::computePath(int targetNode, bool global)
 				UWARN("Last localization pose is null... cannot compute a path");
 				return false;
 			}
-			currentNode = graph::findNearestNode(_optimizedPoses, _lastLocalizationPose);
+			currentNode = graph::findNearestNode(optimizedPosesIndex(), _lastLocalizationPose);
 		}
 		if(currentNode && targetNode)
 		{
@@ -3436,12 +3870,12 @@ bool Rtabmap::computePath(const Transform & targetPose)
 					UWARN("Last localization pose is null... cannot compute a path");
 					return false;
 				}
-				currentNode = graph::findNearestNode(_optimizedPoses, _lastLocalizationPose);
+				currentNode = graph::findNearestNode(optimizedPosesIndex(), _lastLocalizationPose);
 			}
 
 			UINFO("Computing path from location %d to %d", currentNode, nearestId);
 			UTimer timer;
-			_path = uListToVector(rtabmap::graph::computePath(nodes, links, currentNode, nearestId));
+			_path = uListToVector(rtabmap::graph::computePathBidirectional(nodes, links, currentNode, nearestId));
 			UINFO("A* time = %fs", timer.ticks());
 
 			if(_path.size() == 0)
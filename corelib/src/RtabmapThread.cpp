@@ -586,17 +586,12 @@ void RtabmapThread::addData(const OdometryEvent & odomEvent)
 			{
 				_transVariance = 1.0;
 			}
+			_dataBuffer.push_back(OdometryEvent(odomEvent.data(), odomEvent.pose(), _rotVariance, _transVariance));
 			if(ignoreFrame)
 			{
 				// set negative id so rtabmap will detect it as an intermediate node
-				SensorData tmp = odomEvent.data();
-				tmp.setId(-1);
-				tmp.setFeatures(std::vector<cv::KeyPoint>(), cv::Mat());// remove features
-				_dataBuffer.push_back(OdometryEvent(tmp, odomEvent.pose(), _rotVariance, _transVariance));
-			}
-			else
-			{
-				_dataBuffer.push_back(OdometryEvent(odomEvent.data(), odomEvent.pose(), _rotVariance, _transVariance));
+				_dataBuffer.back().data().setId(-1);
+				_dataBuffer.back().data().setFeatures(std::vector<cv::KeyPoint>(), cv::Mat());// remove features
 			}
 			UDEBUG("Added data %d", odomEvent.data().id());
 
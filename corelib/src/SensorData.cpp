@@ -30,10 +30,84 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Compression.h"
 #include "rtabmap/utilite/ULogger.h"
 #include <rtabmap/utilite/UMath.h>
+#include <rtabmap/utilite/UMutex.h>
+#include <rtabmap/utilite/UAtomic.h>
 
 namespace rtabmap
 {
 
+// statistics, updated atomically (SensorData are copied by all threads)
+static volatile long g_copies = 0;
+static volatile long g_deepCopies = 0;
+static volatile long long g_deepCopiesBytes = 0;
+static volatile long g_decompressions = 0;
+static volatile long long g_decompressionsBytes = 0;
+static const std::vector<cv::KeyPoint> g_emptyKeypoints;
+// the pyramid caches are created on first request by const accessors, from any thread
+static UMutex g_pyramidMutex;
+
+static void countDeepCopy(size_t bytes)
+{
+	uAtomicIncrement(&g_deepCopies);
+	uAtomicAdd(&g_deepCopiesBytes, (long long)bytes);
+}
+
+static void countDecompression(const cv::Mat & m)
+{
+	if(!m.empty())
+	{
+		uAtomicIncrement(&g_decompressions);
+		uAtomicAdd(&g_decompressionsBytes, (long long)(m.total()*m.elemSize()));
+	}
+}
+
+static bool isShared(const cv::Mat & m)
+{
+#if CV_MAJOR_VERSION < 3
+	return m.refcount != 0 && *m.refcount > 1;
+#else
+	return m.u != 0 && m.u->refcount > 1;
+#endif
+}
+
+// copy-on-write
+static void detach(cv::Mat & m)
+{
+	if(isShared(m))
+	{
+		m = m.clone();
+		countDeepCopy(m.total()*m.elemSize());
+	}
+}
+
+void SensorData::getStatistics(
+		unsigned long & copies,
+		unsigned long & deepCopies,
+		unsigned long long & deepCopiesBytes,
+		unsigned long & decompressions,
+		unsigned long long & decompressionsBytes)
+{
+	copies = (unsigned long)uAtomicLoad(&g_copies);
+	deepCopies = (unsigned long)uAtomicLoad(&g_deepCopies);
+	deepCopiesBytes = (unsigned long long)uAtomicLoad(&g_deepCopiesBytes);
+	decompressions = (unsigned long)uAtomicLoad(&g_decompressions);
+	decompressionsBytes = (unsigned long long)uAtomicLoad(&g_decompressionsBytes);
+}
+
+void SensorData::resetStatistics()
+{
+	g_copies = 0;
+	g_deepCopies = 0;
+	g_deepCopiesBytes = 0;
+	g_decompressions = 0;
+	g_decompressionsBytes = 0;
+}
+
+void SensorData::countCopy()
+{
+	uAtomicIncrement(&g_copies);
+}
+
 // empty constructor
 SensorData::SensorData() :
 		_id(0),
@@ -479,6 +553,100 @@ void SensorData::setUserData(const cv::Mat & userData)
 	}
 }
 
+cv::Mat & SensorData::imageRawMutable()
+{
+	detach(_imageRaw);
+	_imagePyramid = cv::Ptr<ImagePyramidCache>();
+	return _imageRaw;
+}
+
+cv::Mat & SensorData::depthOrRightRawMutable()
+{
+	detach(_depthOrRightRaw);
+	_rightPyramid = cv::Ptr<ImagePyramidCache>();
+	return _depthOrRightRaw;
+}
+
+cv::Mat & SensorData::laserScanRawMutable()
+{
+	detach(_laserScanRaw);
+	return _laserScanRaw;
+}
+
+void SensorData::setFeatures(const std::vector<cv::KeyPoint> & keypoints, const cv::Mat & descriptors)
+{
+	if(keypoints.empty())
+	{
+		_keypoints.reset();
+	}
+	else
+	{
+		_keypoints.reset(new std::vector<cv::KeyPoint>(keypoints));
+	}
+	_descriptors = descriptors;
+}
+
+void SensorData::setFeatures(const SensorData & data)
+{
+	_keypoints = data._keypoints;
+	_descriptors = data._descriptors;
+}
+
+const std::vector<cv::KeyPoint> & SensorData::keypoints() const
+{
+	return _keypoints.get()?*_keypoints:g_emptyKeypoints;
+}
+
+std::vector<cv::KeyPoint> & SensorData::keypointsMutable()
+{
+	if(!_keypoints.get())
+	{
+		_keypoints.reset(new std::vector<cv::KeyPoint>());
+	}
+	else if(!_keypoints.unique())
+	{
+		_keypoints.reset(new std::vector<cv::KeyPoint>(*_keypoints));
+		countDeepCopy(_keypoints->size()*sizeof(cv::KeyPoint));
+	}
+	return *_keypoints;
+}
+
+cv::Mat & SensorData::descriptorsMutable()
+{
+	detach(_descriptors);
+	return _descriptors;
+}
+
+std::vector<cv::Mat> SensorData::imagePyramid(const cv::Size & winSize, int maxLevel) const
+{
+	UASSERT(!_imageRaw.empty());
+	cv::Ptr<ImagePyramidCache> cache;
+	{
+		UScopeMutex lock(g_pyramidMutex);
+		if(_imagePyramid.empty())
+		{
+			_imagePyramid = cv::Ptr<ImagePyramidCache>(new ImagePyramidCache());
+		}
+		cache = _imagePyramid;
+	}
+	return cache->get(_imageRaw, winSize, maxLevel);
+}
+
+std::vector<cv::Mat> SensorData::rightPyramid(const cv::Size & winSize, int maxLevel) const
+{
+	UASSERT(!_depthOrRightRaw.empty() && _depthOrRightRaw.type() == CV_8UC1);
+	cv::Ptr<ImagePyramidCache> cache;
+	{
+		UScopeMutex lock(g_pyramidMutex);
+		if(_rightPyramid.empty())
+		{
+			_rightPyramid = cv::Ptr<ImagePyramidCache>(new ImagePyramidCache());
+		}
+		cache = _rightPyramid;
+	}
+	return cache->get(_depthOrRightRaw, winSize, maxLevel);
+}
+
 void SensorData::uncompressData()
 {
 	cv::Mat tmpA, tmpB, tmpC, tmpD;
@@ -571,6 +739,7 @@ void SensorData::uncompressDataConst(cv::Mat * imageRaw, cv::Mat * depthRaw, cv:
 		if(imageRaw && imageRaw->empty())
 		{
 			*imageRaw = ctImage.getUncompressedData();
+			countDecompression(*imageRaw);
 			if(imageRaw->empty())
 			{
 				UWARN("Requested raw image data, but the sensor data (%d) doesn't have image.", this->id());
@@ -579,6 +748,7 @@ void SensorData::uncompressDataConst(cv::Mat * imageRaw, cv::Mat * depthRaw, cv:
 		if(depthRaw && depthRaw->empty())
 		{
 			*depthRaw = ctDepth.getUncompressedData();
+			countDecompression(*depthRaw);
 			if(depthRaw->empty())
 			{
 				UWARN("Requested depth/right image data, but the sensor data (%d) doesn't have depth/right image.", this->id());
@@ -587,6 +757,7 @@ void SensorData::uncompressDataConst(cv::Mat * imageRaw, cv::Mat * depthRaw, cv:
 		if(laserScanRaw && laserScanRaw->empty())
 		{
 			*laserScanRaw = ctLaserScan.getUncompressedData();
+			countDecompression(*laserScanRaw);
 
 			if(laserScanRaw->empty())
 			{
@@ -596,6 +767,7 @@ void SensorData::uncompressDataConst(cv::Mat * imageRaw, cv::Mat * depthRaw, cv:
 		if(userDataRaw && userDataRaw->empty())
 		{
 			*userDataRaw = ctUserData.getUncompressedData();
+			countDecompression(*userDataRaw);
 
 			if(userDataRaw->empty())
 			{
@@ -43,7 +43,9 @@ Statistics::Statistics() :
 	_refImageId(0),
 	_loopClosureId(0),
 	_proximiyDetectionId(0),
-	_currentGoalId(0)
+	_currentGoalId(0),
+	_publicationId(0),
+	_deltaBaseId(0)
 {
 	_defaultDataInitialized = true;
 }
@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/StatisticsAccumulator.h"
+#include <rtabmap/utilite/ULogger.h>
+
+namespace rtabmap {
+
+StatisticsAccumulator::StatisticsAccumulator() :
+	valid_(false),
+	lastPublicationId_(0),
+	deltasMissed_(0)
+{
+}
+
+void StatisticsAccumulator::clear()
+{
+	valid_ = false;
+	lastPublicationId_ = 0;
+	deltasMissed_ = 0;
+	poses_.clear();
+	constraints_.clear();
+	signatures_.clear();
+}
+
+bool StatisticsAccumulator::update(const Statistics & stats)
+{
+	if(!stats.isDelta())
+	{
+		poses_ = stats.poses();
+		constraints_ = stats.constraints();
+		signatures_.clear();
+		for(std::map<int, Signature>::const_iterator iter=stats.getSignatures().begin(); iter!=stats.getSignatures().end(); ++iter)
+		{
+			if(poses_.find(iter->first) == poses_.end())
+			{
+				continue;
+			}
+			signatures_.insert(signatures_.end(), std::make_pair(iter->first,
+					Signature(iter->first,
+							iter->second.mapId(),
+							iter->second.getWeight(),
+							iter->second.getStamp(),
+							iter->second.getLabel(),
+							iter->second.getPose(),
+							iter->second.getGroundTruthPose())));
+		}
+		valid_ = true;
+		lastPublicationId_ = stats.publicationId();
+		return valid_;
+	}
+
+	if(!valid_ || stats.deltaBaseId() != lastPublicationId_)
+	{
+		if(valid_)
+		{
+			UWARN("Received delta statistics %d based on publication %d but last publication "
+				  "received is %d, waiting for the next keyframe...",
+				  stats.publicationId(), stats.deltaBaseId(), lastPublicationId_);
+		}
+		++deltasMissed_;
+		valid_ = false;
+		return valid_;
+	}
+
+	for(unsigned int i=0; i<stats.removedPoses().size(); ++i)
+	{
+		int id = stats.removedPoses()[i];
+		poses_.erase(id);
+		signatures_.erase(id);
+	}
+	for(std::multimap<int, Link>::const_iterator iter=stats.removedConstraints().begin(); iter!=stats.removedConstraints().end(); ++iter)
+	{
+		removeConstraint(iter->second);
+	}
+
+	for(std::map<int, Transform>::const_iterator iter=stats.poses().begin(); iter!=stats.poses().end(); ++iter)
+	{
+		poses_[iter->first] = iter->second;
+	}
+	for(std::multimap<int, Link>::const_iterator iter=stats.constraints().begin(); iter!=stats.constraints().end(); ++iter)
+	{
+		// changed links replace the old ones
+		removeConstraint(iter->second);
+		constraints_.insert(*iter);
+	}
+	for(std::map<int, Signature>::const_iterator iter=stats.getSignatures().begin(); iter!=stats.getSignatures().end(); ++iter)
+	{
+		if(poses_.find(iter->first) == poses_.end())
+		{
+			continue;
+		}
+		signatures_[iter->first] = Signature(iter->first,
+				iter->second.mapId(),
+				iter->second.getWeight(),
+				iter->second.getStamp(),
+				iter->second.getLabel(),
+				iter->second.getPose(),
+				iter->second.getGroundTruthPose());
+	}
+
+	lastPublicationId_ = stats.publicationId();
+	return valid_;
+}
+
+void StatisticsAccumulator::removeConstraint(const Link & link)
+{
+	std::multimap<int, Link>::iterator iter = constraints_.find(link.from());
+	while(iter!=constraints_.end() && iter->first == link.from())
+	{
+		if(iter->second.to() == link.to() && iter->second.type() == link.type())
+		{
+			constraints_.erase(iter++);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+} /* namespace rtabmap */
@@ -0,0 +1,545 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/StatisticsLog.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UFile.h>
+#include <limits>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace rtabmap {
+
+namespace {
+const char kMagic[8] = {'R','T','A','B','S','T','A','T'};
+const unsigned int kVersion = 1;
+const unsigned int kBlockMarker = 0x4B4C4253; // "SBLK"
+
+// 64-bit file offsets ("long" is 32-bit on Windows)
+int seek64(FILE * file, long long offset, int origin)
+{
+#ifdef _WIN32
+	return _fseeki64(file, offset, origin);
+#else
+	return fseeko(file, (off_t)offset, origin);
+#endif
+}
+
+long long tell64(FILE * file)
+{
+#ifdef _WIN32
+	return _ftelli64(file);
+#else
+	return (long long)ftello(file);
+#endif
+}
+
+size_t align8(size_t size)
+{
+	return (size + 7) & ~size_t(7);
+}
+
+size_t blockSize(size_t rows, size_t columns)
+{
+	return align8(2*sizeof(unsigned int) + rows*(sizeof(double) + sizeof(int) + columns*sizeof(float)));
+}
+
+std::vector<unsigned char> createHeader(const std::vector<std::string> & columns)
+{
+	size_t namesSize = 0;
+	for(unsigned int i=0; i<columns.size(); ++i)
+	{
+		namesSize += columns[i].size()+1;
+	}
+	unsigned int values[4];
+	values[0] = kVersion;
+	values[1] = (unsigned int)columns.size();
+	values[2] = (unsigned int)align8(sizeof(kMagic) + sizeof(values) + namesSize);
+	values[3] = 0;
+
+	std::vector<unsigned char> header(values[2], 0);
+	memcpy(&header[0], kMagic, sizeof(kMagic));
+	memcpy(&header[sizeof(kMagic)], values, sizeof(values));
+	size_t offset = sizeof(kMagic) + sizeof(values);
+	for(unsigned int i=0; i<columns.size(); ++i)
+	{
+		memcpy(&header[offset], columns[i].c_str(), columns[i].size()+1);
+		offset += columns[i].size()+1;
+	}
+	return header;
+}
+}
+
+StatisticsLogWriter::StatisticsLogWriter() :
+	file_(0),
+	rowsPerBlock_(1)
+{
+}
+
+StatisticsLogWriter::~StatisticsLogWriter()
+{
+	close();
+}
+
+bool StatisticsLogWriter::open(const std::string & path, bool append, int rowsPerBlock)
+{
+	close();
+
+	UASSERT(rowsPerBlock >= 1);
+	rowsPerBlock_ = rowsPerBlock;
+	columns_.clear();
+	const std::map<std::string, float> & defaultData = Statistics::defaultData();
+	for(std::map<std::string, float>::const_iterator iter=defaultData.begin(); iter!=defaultData.end(); ++iter)
+	{
+		columns_.push_back(iter->first);
+	}
+	values_.resize(columns_.size()*rowsPerBlock_);
+	stamps_.reserve(rowsPerBlock_);
+	ids_.reserve(rowsPerBlock_);
+
+	if(append && UFile::exists(path))
+	{
+		size_t end = 0;
+		{
+			StatisticsLogReader reader;
+			if(reader.open(path) && reader.columns() == columns_)
+			{
+				end = reader.end_;
+			}
+		}
+		if(end)
+		{
+#ifdef _MSC_VER
+			fopen_s(&file_, path.c_str(), "r+b");
+#else
+			file_ = fopen(path.c_str(), "r+b");
+#endif
+			if(file_)
+			{
+				// remove a block partially written by a previous session
+				seek64(file_, 0, SEEK_END);
+				if(tell64(file_) > (long long)end)
+				{
+					UWARN("Removing truncated block at the end of \"%s\".", path.c_str());
+#ifdef _WIN32
+					_chsize_s(_fileno(file_), end);
+#else
+					if(ftruncate(fileno(file_), end) != 0)
+					{
+						UERROR("Cannot truncate \"%s\", log disabled.", path.c_str());
+						fclose(file_);
+						file_ = 0;
+						return false;
+					}
+#endif
+				}
+				seek64(file_, (long long)end, SEEK_SET);
+				UDEBUG("Appending statistics to \"%s\"", path.c_str());
+				return true;
+			}
+		}
+		else
+		{
+			UWARN("Statistics log \"%s\" has a different format or schema, it will be overwritten.", path.c_str());
+		}
+	}
+
+#ifdef _MSC_VER
+	fopen_s(&file_, path.c_str(), "wb");
+#else
+	file_ = fopen(path.c_str(), "wb");
+#endif
+	if(!file_)
+	{
+		UERROR("Cannot open statistics log \"%s\".", path.c_str());
+		return false;
+	}
+	std::vector<unsigned char> header = createHeader(columns_);
+	fwrite(&header[0], 1, header.size(), file_);
+	fflush(file_);
+	UDEBUG("Statistics log \"%s\" created (%d columns)", path.c_str(), (int)columns_.size());
+	return true;
+}
+
+void StatisticsLogWriter::close()
+{
+	if(file_)
+	{
+		flush();
+		fclose(file_);
+		file_ = 0;
+	}
+	stamps_.clear();
+	ids_.clear();
+}
+
+void StatisticsLogWriter::append(const Statistics & stats, double stamp)
+{
+	if(!file_)
+	{
+		return;
+	}
+
+	size_t row = stamps_.size();
+	stamps_.push_back(stamp);
+	ids_.push_back(stats.refImageId());
+
+	// both are sorted by name
+	const std::map<std::string, float> & data = stats.data();
+	std::map<std::string, float>::const_iterator iter = data.begin();
+	for(unsigned int i=0; i<columns_.size(); ++i)
+	{
+		while(iter != data.end() && iter->first < columns_[i])
+		{
+			++iter;
+		}
+		values_[i*rowsPerBlock_ + row] = iter != data.end() && iter->first == columns_[i]?iter->second:std::numeric_limits<float>::quiet_NaN();
+	}
+
+	if((int)stamps_.size() >= rowsPerBlock_)
+	{
+		flush();
+	}
+}
+
+void StatisticsLogWriter::flush()
+{
+	if(!file_ || stamps_.empty())
+	{
+		return;
+	}
+	unsigned int rows = (unsigned int)stamps_.size();
+	unsigned int header[2] = {kBlockMarker, rows};
+	fwrite(header, sizeof(unsigned int), 2, file_);
+	fwrite(&stamps_[0], sizeof(double), rows, file_);
+	fwrite(&ids_[0], sizeof(int), rows, file_);
+	for(unsigned int i=0; i<columns_.size(); ++i)
+	{
+		fwrite(&values_[i*rowsPerBlock_], sizeof(float), rows, file_);
+	}
+	size_t written = 2*sizeof(unsigned int) + rows*(sizeof(double) + sizeof(int) + columns_.size()*sizeof(float));
+	size_t padding = blockSize(rows, columns_.size()) - written;
+	if(padding)
+	{
+		const unsigned char zeros[8] = {0};
+		fwrite(zeros, 1, padding, file_);
+	}
+	fflush(file_);
+	stamps_.clear();
+	ids_.clear();
+}
+
+StatisticsLogReader::StatisticsLogReader() :
+	data_(0),
+	size_(0),
+#ifdef _WIN32
+	file_(0),
+	mapping_(0),
+#endif
+	rows_(0),
+	end_(0)
+{
+}
+
+StatisticsLogReader::~StatisticsLogReader()
+{
+	close();
+}
+
+bool StatisticsLogReader::open(const std::string & path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	LARGE_INTEGER fileSize;
+	if(file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		if(file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file);
+		}
+		UERROR("Cannot open statistics log \"%s\".", path.c_str());
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	void * data = mapping?MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0):0;
+	if(!data)
+	{
+		if(mapping)
+		{
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		UERROR("Cannot map statistics log \"%s\".", path.c_str());
+		return false;
+	}
+	file_ = file;
+	mapping_ = mapping;
+	size_ = (size_t)fileSize.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		if(fd >= 0)
+		{
+			::close(fd);
+		}
+		UERROR("Cannot open statistics log \"%s\".", path.c_str());
+		return false;
+	}
+	void * data = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(data == MAP_FAILED)
+	{
+		UERROR("Cannot map statistics log \"%s\".", path.c_str());
+		return false;
+	}
+	size_ = st.st_size;
+#endif
+	data_ = (const unsigned char *)data;
+
+	unsigned int values[4] = {0};
+	if(size_ < sizeof(kMagic) + sizeof(values) || memcmp(data_, kMagic, sizeof(kMagic)) != 0)
+	{
+		UERROR("\"%s\" is not a statistics log.", path.c_str());
+		close();
+		return false;
+	}
+	memcpy(values, data_ + sizeof(kMagic), sizeof(values));
+	if(values[0] != kVersion || values[2] > size_)
+	{
+		UERROR("Statistics log \"%s\" has an unsupported version (%d) or is corrupted.", path.c_str(), values[0]);
+		close();
+		return false;
+	}
+
+	size_t offset = sizeof(kMagic) + sizeof(values);
+	for(unsigned int i=0; i<values[1]; ++i)
+	{
+		const char * name = (const char *)data_ + offset;
+		size_t length = strnlen(name, values[2] - offset);
+		if(offset + length >= values[2])
+		{
+			UERROR("Statistics log \"%s\" is corrupted (column names).", path.c_str());
+			close();
+			return false;
+		}
+		columns_.push_back(std::string(name, length));
+		offset += length+1;
+	}
+
+	offset = values[2];
+	while(offset + 2*sizeof(unsigned int) <= size_)
+	{
+		unsigned int header[2];
+		memcpy(header, data_ + offset, sizeof(header));
+		size_t size = blockSize(header[1], columns_.size());
+		if(header[0] != kBlockMarker || header[1] == 0 || offset + size > size_)
+		{
+			UWARN("Statistics log \"%s\": ignoring %d bytes after the last valid block (truncated?).", path.c_str(), int(size_ - offset));
+			break;
+		}
+		Block block;
+		block.rows = header[1];
+		block.stamps = data_ + offset + sizeof(header);
+		block.ids = block.stamps + block.rows*sizeof(double);
+		block.values = block.ids + block.rows*sizeof(int);
+		blocks_.push_back(block);
+		rows_ += block.rows;
+		offset += size;
+	}
+	end_ = offset;
+
+	UDEBUG("Statistics log \"%s\": %d columns, %d rows, %d blocks", path.c_str(), (int)columns_.size(), (int)rows_, (int)blocks_.size());
+	return true;
+}
+
+void StatisticsLogReader::close()
+{
+	if(data_)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(data_);
+		CloseHandle((HANDLE)mapping_);
+		CloseHandle((HANDLE)file_);
+		mapping_ = 0;
+		file_ = 0;
+#else
+		munmap((void*)data_, size_);
+#endif
+		data_ = 0;
+	}
+	size_ = 0;
+	columns_.clear();
+	blocks_.clear();
+	rows_ = 0;
+	end_ = 0;
+}
+
+int StatisticsLogReader::columnIndex(const std::string & name) const
+{
+	for(unsigned int i=0; i<columns_.size(); ++i)
+	{
+		if(columns_[i].compare(name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+std::vector<double> StatisticsLogReader::stamps() const
+{
+	std::vector<double> stamps;
+	stamps.reserve(rows_);
+	for(unsigned int i=0; i<blocks_.size(); ++i)
+	{
+		const double * v = (const double *)blocks_[i].stamps;
+		stamps.insert(stamps.end(), v, v + blocks_[i].rows);
+	}
+	return stamps;
+}
+
+std::vector<int> StatisticsLogReader::ids() const
+{
+	std::vector<int> ids;
+	ids.reserve(rows_);
+	for(unsigned int i=0; i<blocks_.size(); ++i)
+	{
+		const int * v = (const int *)blocks_[i].ids;
+		ids.insert(ids.end(), v, v + blocks_[i].rows);
+	}
+	return ids;
+}
+
+std::vector<float> StatisticsLogReader::column(int index) const
+{
+	UASSERT(index >= 0 && index < (int)columns_.size());
+	std::vector<float> values;
+	values.reserve(rows_);
+	for(unsigned int i=0; i<blocks_.size(); ++i)
+	{
+		const float * v = (const float *)blocks_[i].values + index*blocks_[i].rows;
+		values.insert(values.end(), v, v + blocks_[i].rows);
+	}
+	return values;
+}
+
+void StatisticsLogReader::column(int index, std::vector<float> & x, std::vector<float> & y, size_t maxSamples) const
+{
+	UASSERT(index >= 0 && index < (int)columns_.size());
+	x.clear();
+	y.clear();
+	size_t buckets = maxSamples/2;
+	size_t bucketSize = buckets?(rows_ + buckets - 1) / buckets:1;
+	if(rows_ <= maxSamples || bucketSize <= 1)
+	{
+		bucketSize = 1;
+	}
+	x.reserve(bucketSize>1?buckets*2:rows_);
+	y.reserve(bucketSize>1?buckets*2:rows_);
+
+	size_t inBucket = 0;
+	int minId=0, maxId=0;
+	size_t minRow=0, maxRow=0;
+	float minValue=0.0f, maxValue=0.0f;
+	bool valid = false;
+	size_t row = 0;
+	for(unsigned int i=0; i<blocks_.size(); ++i)
+	{
+		const float * v = (const float *)blocks_[i].values + index*blocks_[i].rows;
+		const int * ids = (const int *)blocks_[i].ids;
+		for(size_t j=0; j<blocks_[i].rows; ++j, ++row)
+		{
+			if(bucketSize == 1)
+			{
+				if(v[j] == v[j]) // not NaN
+				{
+					x.push_back(ids[j]);
+					y.push_back(v[j]);
+				}
+				continue;
+			}
+
+			if(v[j] == v[j])
+			{
+				if(!valid || v[j] < minValue)
+				{
+					minValue = v[j];
+					minId = ids[j];
+					minRow = row;
+				}
+				if(!valid || v[j] > maxValue)
+				{
+					maxValue = v[j];
+					maxId = ids[j];
+					maxRow = row;
+				}
+				valid = true;
+			}
+			if(++inBucket == bucketSize || row+1 == rows_)
+			{
+				if(valid)
+				{
+					// keep the order of appearance
+					if(minRow <= maxRow)
+					{
+						x.push_back(minId);
+						y.push_back(minValue);
+						if(maxRow != minRow)
+						{
+							x.push_back(maxId);
+							y.push_back(maxValue);
+						}
+					}
+					else
+					{
+						x.push_back(maxId);
+						y.push_back(maxValue);
+						x.push_back(minId);
+						y.push_back(minValue);
+					}
+				}
+				inBucket = 0;
+				valid = false;
+			}
+		}
+	}
+}
+
+} /* namespace rtabmap */
@@ -29,6 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/util2d.h>
 #include <rtabmap/utilite/ULogger.h>
 #include <opencv2/video/tracking.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 
 namespace rtabmap {
 
@@ -92,6 +93,24 @@ std::vector<cv::Point2f> Stereo::computeCorrespondences(
 	return rightCorners;
 }
 
+std::vector<cv::Point2f> Stereo::computeCorrespondences(
+		const SensorData & data,
+		const std::vector<cv::Point2f> & leftCorners,
+		std::vector<unsigned char> & status) const
+{
+	UASSERT(!data.imageRaw().empty() && !data.rightRaw().empty());
+	cv::Mat leftMono;
+	if(data.imageRaw().channels() > 1)
+	{
+		cv::cvtColor(data.imageRaw(), leftMono, cv::COLOR_BGR2GRAY);
+	}
+	else
+	{
+		leftMono = data.imageRaw();
+	}
+	return this->computeCorrespondences(leftMono, data.rightRaw(), leftCorners, status);
+}
+
 StereoOpticalFlow::StereoOpticalFlow(const ParametersMap & parameters) :
 		Stereo(parameters),
 		epsilon_(Parameters::defaultStereoEps())
@@ -111,6 +130,28 @@ std::vector<cv::Point2f> StereoOpticalFlow::computeCorrespondences(
 		const cv::Mat & rightImage,
 		const std::vector<cv::Point2f> & leftCorners,
 		std::vector<unsigned char> & status) const
+{
+	return computeCorrespondencesImpl(leftImage, rightImage, leftCorners, status);
+}
+
+std::vector<cv::Point2f> StereoOpticalFlow::computeCorrespondences(
+		const SensorData & data,
+		const std::vector<cv::Point2f> & leftCorners,
+		std::vector<unsigned char> & status) const
+{
+	UASSERT(!data.imageRaw().empty() && !data.rightRaw().empty());
+	return computeCorrespondencesImpl(
+			data.imagePyramid(this->winSize(), this->maxLevel()),
+			data.rightPyramid(this->winSize(), this->maxLevel()),
+			leftCorners,
+			status);
+}
+
+std::vector<cv::Point2f> StereoOpticalFlow::computeCorrespondencesImpl(
+		cv::InputArray leftImage,
+		cv::InputArray rightImage,
+		const std::vector<cv::Point2f> & leftCorners,
+		std::vector<unsigned char> & status) const
 {
 	std::vector<cv::Point2f> rightCorners;
 	UDEBUG("util2d::calcOpticalFlowPyrLKStereo() begin");
@@ -31,6 +31,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Signature.h"
 #include "rtabmap/core/DBDriver.h"
 #include "rtabmap/core/Parameters.h"
+#include "rtabmap/core/Profiler.h"
 
 #include "rtabmap/utilite/UtiLite.h"
 
@@ -593,6 +594,7 @@ unsigned int VWDictionary::getIndexMemoryUsed() const
 
 void VWDictionary::update()
 {
+	UPROFILE("VWDictionary::update");
 	ULOGGER_DEBUG("");
 	if(!_incrementalDictionary && !_notIndexedWords.size())
 	{
@@ -825,6 +827,7 @@ void VWDictionary::removeAllWordRef(int wordId, int signatureId)
 std::list<int> VWDictionary::addNewWords(const cv::Mat & descriptorsIn,
 							   int signatureId)
 {
+	UPROFILE("VWDictionary::addNewWords");
 	UASSERT(signatureId > 0);
 
 	cv::Mat descriptors;
@@ -1139,6 +1142,7 @@ std::vector<int> VWDictionary::findNN(const std::list<VisualWord *> & vws) const
 }
 std::vector<int> VWDictionary::findNN(const cv::Mat & query) const
 {
+	UPROFILE("VWDictionary::findNN");
 	UTimer timer;
 	timer.start();
 	std::vector<int> resultIds(query.rows, 0);
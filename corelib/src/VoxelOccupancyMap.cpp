@@ -0,0 +1,602 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/VoxelOccupancyMap.h"
+#include "rtabmap/core/SensorData.h"
+#include "rtabmap/core/util3d.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UMath.h>
+#include <pcl/common/common.h>
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace rtabmap {
+
+static const unsigned char g_miss = 1;
+static const unsigned char g_hit = 2;
+static const float g_scale = 1000.0f; // fixed-point log-odds
+
+struct VoxelUpdate
+{
+	VoxelUpdate(int x, int y, int z, unsigned char flag) : x(x), y(y), z(z), flag(flag) {}
+	int x, y, z;
+	unsigned char flag;
+	// hits first for the same voxel
+	bool operator<(const VoxelUpdate & o) const
+	{
+		return x<o.x || (x==o.x && (y<o.y || (y==o.y && (z<o.z || (z==o.z && flag>o.flag)))));
+	}
+	bool sameVoxel(const VoxelUpdate & o) const {return x==o.x && y==o.y && z==o.z;}
+};
+
+static inline int voxelIndex(int x, int y, int z)
+{
+	return (x & 7) + ((y & 7) << 3) + ((z & 7) << 6);
+}
+
+static inline unsigned int hashBlock(int x, int y, int z)
+{
+	return ((unsigned int)x*73856093u) ^ ((unsigned int)y*19349663u) ^ ((unsigned int)z*83492791u);
+}
+
+static float logOdds(float probability)
+{
+	return log(probability/(1.0f-probability));
+}
+
+// 3D DDA in voxel units: voxels crossed are added as miss, the last one as hit if set
+static void traceRay(const cv::Point3f & start, const cv::Point3f & end, bool hit, std::vector<VoxelUpdate> & updates)
+{
+	float s[3] = {start.x, start.y, start.z};
+	float e[3] = {end.x, end.y, end.z};
+	int cur[3], last[3], step[3];
+	float tMax[3], tDelta[3];
+	int steps = 0;
+	for(int i=0; i<3; ++i)
+	{
+		cur[i] = cvFloor(s[i]);
+		last[i] = cvFloor(e[i]);
+		float d = e[i] - s[i];
+		step[i] = d>=0.0f?1:-1;
+		tDelta[i] = d!=0.0f?fabs(1.0f/d):std::numeric_limits<float>::max();
+		tMax[i] = d>0.0f?(float(cur[i]+1)-s[i])*tDelta[i]:d<0.0f?(s[i]-float(cur[i]))*tDelta[i]:std::numeric_limits<float>::max();
+		steps += abs(last[i]-cur[i]);
+	}
+	for(int i=0; i<steps; ++i)
+	{
+		updates.push_back(VoxelUpdate(cur[0], cur[1], cur[2], g_miss));
+		// step on the closest voxel border, without passing the end voxel
+		int axis = -1;
+		for(int a=0; a<3; ++a)
+		{
+			if(cur[a] != last[a] && (axis < 0 || tMax[a] < tMax[axis]))
+			{
+				axis = a;
+			}
+		}
+		cur[axis] += step[axis];
+		tMax[axis] += tDelta[axis];
+	}
+	updates.push_back(VoxelUpdate(cur[0], cur[1], cur[2], hit?g_hit:g_miss));
+}
+
+VoxelOccupancyMap::Block::Block(int x, int y, int z) :
+	x(x), y(y), z(z),
+	maxLogOdds(0),
+	observed(false),
+	dirty(false)
+{
+	memset(voxels, 0, sizeof(voxels));
+}
+
+VoxelOccupancyMap::VoxelOccupancyMap(
+		float voxelSize,
+		float maxRange,
+		float probHit,
+		float probMiss,
+		float probClampingMin,
+		float probClampingMax) :
+	voxelSize_(voxelSize),
+	maxRange_(maxRange),
+	linearUpdate_(0.05f),
+	angularUpdate_(0.01f),
+	hit_(cvRound(logOdds(probHit)*g_scale)),
+	miss_(cvRound(logOdds(probMiss)*g_scale)),
+	clampingMin_(cvRound(logOdds(probClampingMin)*g_scale)),
+	clampingMax_(cvRound(logOdds(probClampingMax)*g_scale)),
+	lastIntegrated_(0),
+	lastRemoved_(0),
+	lastVoxelUpdates_(0),
+	lastUpdateTime_(0.0)
+{
+	UASSERT(voxelSize_ > 0.0f);
+	UASSERT(probHit > 0.5f && probHit < 1.0f);
+	UASSERT(probMiss > 0.0f && probMiss < 0.5f);
+	UASSERT(probClampingMin > 0.0f && probClampingMin < probClampingMax && probClampingMax < 1.0f);
+}
+
+void VoxelOccupancyMap::clear()
+{
+	nodes_.clear();
+	blocks_.clear();
+	table_.clear();
+	lastIntegrated_ = 0;
+	lastRemoved_ = 0;
+	lastVoxelUpdates_ = 0;
+	lastUpdateTime_ = 0.0;
+}
+
+void VoxelOccupancyMap::addNode(
+		int id,
+		const pcl::PointCloud<pcl::PointXYZ>::Ptr & cloud,
+		const Transform & sensorOrigin)
+{
+	UASSERT(cloud.get() != 0);
+	UASSERT(!sensorOrigin.isNull());
+	removeNode(id);
+	Node & node = nodes_[id];
+	node.cloud = cloud;
+	node.sensorOrigin = sensorOrigin;
+}
+
+void VoxelOccupancyMap::addNode(
+		int id,
+		const SensorData & data,
+		int decimation,
+		float maxDepth)
+{
+	Transform sensorOrigin = Transform::getIdentity();
+	if(data.cameraModels().size())
+	{
+		sensorOrigin = data.cameraModels()[0].localTransform().translation();
+	}
+	else if(data.stereoCameraModel().isValidForProjection())
+	{
+		sensorOrigin = data.stereoCameraModel().localTransform().translation();
+	}
+	addNode(id, util3d::cloudFromSensorData(data, decimation, maxDepth, voxelSize_), sensorOrigin);
+}
+
+void VoxelOccupancyMap::removeNode(int id)
+{
+	std::map<int, Node>::iterator iter = nodes_.find(id);
+	if(iter != nodes_.end())
+	{
+		if(!iter->second.pose.isNull())
+		{
+			integrate(iter->second, iter->second.pose, -1);
+		}
+		nodes_.erase(iter);
+	}
+}
+
+void VoxelOccupancyMap::setUpdateThresholds(float linearUpdate, float angularUpdate)
+{
+	linearUpdate_ = linearUpdate;
+	angularUpdate_ = angularUpdate;
+}
+
+int VoxelOccupancyMap::update(const std::map<int, Transform> & poses)
+{
+	UTimer timer;
+	lastIntegrated_ = 0;
+	lastRemoved_ = 0;
+	lastVoxelUpdates_ = 0;
+
+	for(std::map<int, Node>::iterator iter=nodes_.begin(); iter!=nodes_.end(); ++iter)
+	{
+		Node & node = iter->second;
+		std::map<int, Transform>::const_iterator jter = poses.find(iter->first);
+		if(jter == poses.end())
+		{
+			if(!node.pose.isNull())
+			{
+				// not in the graph anymore
+				lastVoxelUpdates_ += integrate(node, node.pose, -1);
+				node.pose.setNull();
+				++lastRemoved_;
+			}
+			continue;
+		}
+
+		UASSERT(!jter->second.isNull());
+		if(!node.pose.isNull())
+		{
+			float x,y,z,roll,pitch,yaw;
+			(node.pose.inverse() * jter->second).getTranslationAndEulerAngles(x,y,z,roll,pitch,yaw);
+			if(x*x+y*y+z*z <= linearUpdate_*linearUpdate_ &&
+				fabs(roll) <= angularUpdate_ && fabs(pitch) <= angularUpdate_ && fabs(yaw) <= angularUpdate_)
+			{
+				continue;
+			}
+			// moved: remove the contribution at the old pose
+			lastVoxelUpdates_ += integrate(node, node.pose, -1);
+		}
+		lastVoxelUpdates_ += integrate(node, jter->second, 1);
+		node.pose = jter->second;
+		++lastIntegrated_;
+	}
+
+	lastUpdateTime_ = timer.ticks();
+	UDEBUG("integrated=%d removed=%d voxel updates=%d blocks=%d memory=%ld KB time=%fs",
+			lastIntegrated_, lastRemoved_, lastVoxelUpdates_, (int)blocks_.size(), getMemoryUsage()/1024, lastUpdateTime_);
+	return lastIntegrated_;
+}
+
+int VoxelOccupancyMap::integrate(const Node & node, const Transform & pose, int sign)
+{
+	const pcl::PointCloud<pcl::PointXYZ> & cloud = *node.cloud;
+	Transform sensor = pose * node.sensorOrigin;
+	Eigen::Vector3f origin(sensor.x(), sensor.y(), sensor.z());
+	cv::Point3f start(origin[0]/voxelSize_, origin[1]/voxelSize_, origin[2]/voxelSize_);
+	Eigen::Affine3f t = pose.toEigen3f();
+
+	// trace rays in parallel, each thread in its own list
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	std::vector<std::vector<VoxelUpdate> > threadUpdates(threads);
+#ifdef _OPENMP
+	#pragma omp parallel
+#endif
+	{
+		int thread = 0;
+#ifdef _OPENMP
+		thread = omp_get_thread_num();
+#endif
+		std::vector<VoxelUpdate> & updates = threadUpdates[thread];
+#ifdef _OPENMP
+		#pragma omp for schedule(static)
+#endif
+		for(int i=0; i<(int)cloud.size(); ++i)
+		{
+			if(!pcl::isFinite(cloud.points[i]))
+			{
+				continue;
+			}
+			Eigen::Vector3f pt = t * cloud.points[i].getVector3fMap();
+			bool hit = true;
+			if(maxRange_ > 0.0f)
+			{
+				Eigen::Vector3f ray = pt - origin;
+				float length = ray.norm();
+				if(length > maxRange_)
+				{
+					pt = origin + ray*(maxRange_/length);
+					hit = false;
+				}
+			}
+			traceRay(start, cv::Point3f(pt[0]/voxelSize_, pt[1]/voxelSize_, pt[2]/voxelSize_), hit, updates);
+		}
+	}
+
+	std::vector<VoxelUpdate> updates;
+	for(int i=0; i<threads; ++i)
+	{
+		updates.insert(updates.end(), threadUpdates[i].begin(), threadUpdates[i].end());
+	}
+	// each voxel is updated once per node (hit if at least one point ends in it)
+	std::sort(updates.begin(), updates.end());
+
+	int voxelUpdates = 0;
+	Block * block = 0;
+	for(unsigned int i=0; i<updates.size(); ++i)
+	{
+		const VoxelUpdate & u = updates[i];
+		if(i>0 && u.sameVoxel(updates[i-1]))
+		{
+			continue;
+		}
+		int bx = u.x >> 3;
+		int by = u.y >> 3;
+		int bz = u.z >> 3;
+		if(block == 0 || block->x != bx || block->y != by || block->z != bz)
+		{
+			block = sign>0?getBlock(bx, by, bz):const_cast<Block*>(findBlock(bx, by, bz));
+			if(block == 0)
+			{
+				UWARN("Block (%d,%d,%d) not found when removing a node", bx, by, bz);
+				continue;
+			}
+		}
+		Voxel & voxel = block->voxels[voxelIndex(u.x, u.y, u.z)];
+		voxel.logOdds += sign*(u.flag==g_hit?hit_:miss_);
+		voxel.observations += sign;
+		block->dirty = true;
+		++voxelUpdates;
+	}
+	return voxelUpdates;
+}
+
+const VoxelOccupancyMap::Block * VoxelOccupancyMap::findBlock(int x, int y, int z) const
+{
+	if(table_.empty())
+	{
+		return 0;
+	}
+	unsigned int mask = (unsigned int)table_.size()-1;
+	for(unsigned int i=hashBlock(x,y,z)&mask;; i=(i+1)&mask)
+	{
+		int index = table_[i];
+		if(index < 0)
+		{
+			return 0;
+		}
+		const Block & block = blocks_[index];
+		if(block.x == x && block.y == y && block.z == z)
+		{
+			return &block;
+		}
+	}
+	return 0;
+}
+
+VoxelOccupancyMap::Block * VoxelOccupancyMap::getBlock(int x, int y, int z)
+{
+	Block * block = const_cast<Block*>(findBlock(x,y,z));
+	if(block == 0)
+	{
+		// keep the load factor under 0.5
+		if((blocks_.size()+1)*2 > table_.size())
+		{
+			rehash(std::max(1024, (int)table_.size()*2));
+		}
+		blocks_.push_back(Block(x,y,z));
+		unsigned int mask = (unsigned int)table_.size()-1;
+		unsigned int i=hashBlock(x,y,z)&mask;
+		while(table_[i] >= 0)
+		{
+			i=(i+1)&mask;
+		}
+		table_[i] = (int)blocks_.size()-1;
+		block = &blocks_.back();
+	}
+	return block;
+}
+
+void VoxelOccupancyMap::rehash(int size)
+{
+	table_ = std::vector<int>(size, -1);
+	unsigned int mask = (unsigned int)size-1;
+	for(unsigned int j=0; j<blocks_.size(); ++j)
+	{
+		unsigned int i=hashBlock(blocks_[j].x, blocks_[j].y, blocks_[j].z)&mask;
+		while(table_[i] >= 0)
+		{
+			i=(i+1)&mask;
+		}
+		table_[i] = j;
+	}
+}
+
+int VoxelOccupancyMap::clamp(int logOdds) const
+{
+	return logOdds<clampingMin_?clampingMin_:logOdds>clampingMax_?clampingMax_:logOdds;
+}
+
+float VoxelOccupancyMap::probability(int logOdds) const
+{
+	return 1.0f - 1.0f/(1.0f+exp(float(clamp(logOdds))/g_scale));
+}
+
+bool VoxelOccupancyMap::blockMax(const Block & block, int & maxLogOdds) const
+{
+	if(block.dirty)
+	{
+		block.observed = false;
+		for(int i=0; i<512; ++i)
+		{
+			if(block.voxels[i].observations > 0 &&
+				(!block.observed || block.voxels[i].logOdds > block.maxLogOdds))
+			{
+				block.maxLogOdds = block.voxels[i].logOdds;
+				block.observed = true;
+			}
+		}
+		block.dirty = false;
+	}
+	maxLogOdds = block.maxLogOdds;
+	return block.observed;
+}
+
+float VoxelOccupancyMap::getOccupancy(float x, float y, float z, int level) const
+{
+	UASSERT(level >= 0 && level < 16);
+	int v[3] = {cvFloor(x/voxelSize_), cvFloor(y/voxelSize_), cvFloor(z/voxelSize_)};
+	bool found = false;
+	int maxLogOdds = 0;
+	if(level <= 3)
+	{
+		// cube inside a single block
+		const Block * block = findBlock(v[0]>>3, v[1]>>3, v[2]>>3);
+		if(block == 0)
+		{
+			return -1.0f;
+		}
+		int size = 1 << level;
+		int base[3];
+		for(int i=0; i<3; ++i)
+		{
+			base[i] = (v[i] >> level) << level;
+		}
+		for(int k=0; k<size; ++k)
+		{
+			for(int j=0; j<size; ++j)
+			{
+				for(int i=0; i<size; ++i)
+				{
+					const Voxel & voxel = block->voxels[voxelIndex(base[0]+i, base[1]+j, base[2]+k)];
+					if(voxel.observations > 0 && (!found || voxel.logOdds > maxLogOdds))
+					{
+						maxLogOdds = voxel.logOdds;
+						found = true;
+					}
+				}
+			}
+		}
+	}
+	else
+	{
+		// cube of blocks
+		int size = 1 << (level-3);
+		int base[3];
+		for(int i=0; i<3; ++i)
+		{
+			base[i] = (v[i] >> level) << (level-3);
+		}
+		for(int k=0; k<size; ++k)
+		{
+			for(int j=0; j<size; ++j)
+			{
+				for(int i=0; i<size; ++i)
+				{
+					const Block * block = findBlock(base[0]+i, base[1]+j, base[2]+k);
+					int blockMaxLogOdds;
+					if(block && blockMax(*block, blockMaxLogOdds) && (!found || blockMaxLogOdds > maxLogOdds))
+					{
+						maxLogOdds = blockMaxLogOdds;
+						found = true;
+					}
+				}
+			}
+		}
+	}
+	return found?probability(maxLogOdds):-1.0f;
+}
+
+pcl::PointCloud<pcl::PointXYZ>::Ptr VoxelOccupancyMap::getOccupiedCloud(float occupancyThr) const
+{
+	UASSERT(occupancyThr > 0.0f && occupancyThr < 1.0f);
+	int threshold = cvRound(logOdds(occupancyThr)*g_scale);
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+	for(std::deque<Block>::const_iterator iter=blocks_.begin(); iter!=blocks_.end(); ++iter)
+	{
+		int maxLogOdds;
+		if(!blockMax(*iter, maxLogOdds) || clamp(maxLogOdds) <= threshold)
+		{
+			continue;
+		}
+		for(int i=0; i<512; ++i)
+		{
+			const Voxel & voxel = iter->voxels[i];
+			if(voxel.observations > 0 && clamp(voxel.logOdds) > threshold)
+			{
+				cloud->push_back(pcl::PointXYZ(
+						(float(iter->x*8 + (i&7)) + 0.5f)*voxelSize_,
+						(float(iter->y*8 + ((i>>3)&7)) + 0.5f)*voxelSize_,
+						(float(iter->z*8 + (i>>6)) + 0.5f)*voxelSize_));
+			}
+		}
+	}
+	return cloud;
+}
+
+cv::Mat VoxelOccupancyMap::to2DMap(float & xMin, float & yMin, float minHeight, float maxHeight, float occupancyThr) const
+{
+	UASSERT(minHeight <= maxHeight);
+	UASSERT(occupancyThr > 0.0f && occupancyThr < 1.0f);
+	int threshold = cvRound(logOdds(occupancyThr)*g_scale);
+	int zMin = cvFloor(minHeight/voxelSize_);
+	int zMax = cvFloor(maxHeight/voxelSize_);
+
+	// bounds of the blocks in the height range
+	bool hasBounds = false;
+	cv::Point2i minCell, maxCell;
+	for(std::deque<Block>::const_iterator iter=blocks_.begin(); iter!=blocks_.end(); ++iter)
+	{
+		if(iter->z*8+7 < zMin || iter->z*8 > zMax)
+		{
+			continue;
+		}
+		if(!hasBounds)
+		{
+			minCell = cv::Point2i(iter->x*8, iter->y*8);
+			maxCell = cv::Point2i(iter->x*8+7, iter->y*8+7);
+			hasBounds = true;
+		}
+		else
+		{
+			minCell.x = std::min(minCell.x, iter->x*8);
+			minCell.y = std::min(minCell.y, iter->y*8);
+			maxCell.x = std::max(maxCell.x, iter->x*8+7);
+			maxCell.y = std::max(maxCell.y, iter->y*8+7);
+		}
+	}
+
+	cv::Mat map;
+	if(!hasBounds)
+	{
+		return map;
+	}
+	xMin = float(minCell.x)*voxelSize_;
+	yMin = float(minCell.y)*voxelSize_;
+	map = cv::Mat(maxCell.y-minCell.y+1, maxCell.x-minCell.x+1, CV_8S, cv::Scalar(-1));
+	for(std::deque<Block>::const_iterator iter=blocks_.begin(); iter!=blocks_.end(); ++iter)
+	{
+		if(iter->z*8+7 < zMin || iter->z*8 > zMax)
+		{
+			continue;
+		}
+		for(int i=0; i<512; ++i)
+		{
+			const Voxel & voxel = iter->voxels[i];
+			int z = iter->z*8 + (i>>6);
+			if(voxel.observations > 0 && z >= zMin && z <= zMax)
+			{
+				char & cell = map.at<char>(iter->y*8 + ((i>>3)&7) - minCell.y, iter->x*8 + (i&7) - minCell.x);
+				if(clamp(voxel.logOdds) > threshold)
+				{
+					cell = 100;
+				}
+				else if(cell != 100)
+				{
+					cell = 0;
+				}
+			}
+		}
+	}
+	return map;
+}
+
+unsigned long VoxelOccupancyMap::getMemoryUsage() const
+{
+	unsigned long memory = blocks_.size()*sizeof(Block) + table_.size()*sizeof(int);
+	for(std::map<int, Node>::const_iterator iter=nodes_.begin(); iter!=nodes_.end(); ++iter)
+	{
+		memory += sizeof(Node) + iter->second.cloud->size()*sizeof(pcl::PointXYZ);
+	}
+	return memory;
+}
+
+} /* namespace rtabmap */
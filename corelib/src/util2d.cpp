@@ -32,12 +32,22 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UTimer.h>
 #include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UAtomic.h>
 #include <rtabmap/core/util3d_transforms.h>
 #include <opencv2/calib3d/calib3d.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/video/tracking.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <map>
+#include <limits>
+#include <string.h>
+
+#if CV_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace rtabmap
 {
@@ -53,27 +63,22 @@ float ssd(const cv::Mat & windowLeft, const cv::Mat & windowRight)
 	UASSERT_MSG(windowLeft.rows == windowRight.rows, uFormat("%d vs %d", windowLeft.rows, windowRight.rows).c_str());
 	UASSERT_MSG(windowLeft.cols == windowRight.cols, uFormat("%d vs %d", windowLeft.cols, windowRight.cols).c_str());
 
+	if(windowLeft.type() != CV_16SC2)
+	{
+		// cv::norm() is vectorized (SSE/NEON) and works directly on the ROIs
+		return (float)cv::norm(windowLeft, windowRight, cv::NORM_L2SQR);
+	}
+
 	float score = 0.0f;
 	for(int v=0; v<windowLeft.rows; ++v)
 	{
-		for(int u=0; u<windowLeft.cols; ++u)
+		const short * pL = windowLeft.ptr<short>(v);
+		const short * pR = windowRight.ptr<short>(v);
+		for(int u=0; u<windowLeft.cols*2; u+=2)
 		{
-			float s = 0.0f;
-			if(windowLeft.type() == CV_8UC1)
-			{
-				s = float(windowLeft.at<unsigned char>(v,u))-float(windowRight.at<unsigned char>(v,u));
-			}
-			else if(windowLeft.type() == CV_32FC1)
-			{
-				s = windowLeft.at<float>(v,u)-windowRight.at<float>(v,u);
-			}
-			else if(windowLeft.type() == CV_16SC2)
-			{
-				float sL = float(windowLeft.at<cv::Vec2s>(v,u)[0])*0.5f+float(windowLeft.at<cv::Vec2s>(v,u)[1])*0.5f;
-				float sR = float(windowRight.at<cv::Vec2s>(v,u)[0])*0.5f+float(windowRight.at<cv::Vec2s>(v,u)[1])*0.5f;
-				s = sL - sR;
-			}
-
+			float sL = float(pL[u])*0.5f+float(pL[u+1])*0.5f;
+			float sR = float(pR[u])*0.5f+float(pR[u+1])*0.5f;
+			float s = sL - sR;
 			score += s*s;
 		}
 	}
@@ -88,25 +93,22 @@ float sad(const cv::Mat & windowLeft, const cv::Mat & windowRight)
 	UASSERT_MSG(windowLeft.rows == windowRight.rows, uFormat("%d vs %d", windowLeft.rows, windowRight.rows).c_str());
 	UASSERT_MSG(windowLeft.cols == windowRight.cols, uFormat("%d vs %d", windowLeft.cols, windowRight.cols).c_str());
 
+	if(windowLeft.type() != CV_16SC2)
+	{
+		// cv::norm() is vectorized (SSE/NEON) and works directly on the ROIs
+		return (float)cv::norm(windowLeft, windowRight, cv::NORM_L1);
+	}
+
 	float score = 0.0f;
 	for(int v=0; v<windowLeft.rows; ++v)
 	{
-		for(int u=0; u<windowLeft.cols; ++u)
+		const short * pL = windowLeft.ptr<short>(v);
+		const short * pR = windowRight.ptr<short>(v);
+		for(int u=0; u<windowLeft.cols*2; u+=2)
 		{
-			if(windowLeft.type() == CV_8UC1)
-			{
-				score += fabs(float(windowLeft.at<unsigned char>(v,u))-float(windowRight.at<unsigned char>(v,u)));
-			}
-			else if(windowLeft.type() == CV_32FC1)
-			{
-				score += fabs(windowLeft.at<float>(v,u)-windowRight.at<float>(v,u));
-			}
-			else if(windowLeft.type() == CV_16SC2)
-			{
-				float sL = float(windowLeft.at<cv::Vec2s>(v,u)[0])*0.5f+float(windowLeft.at<cv::Vec2s>(v,u)[1])*0.5f;
-				float sR = float(windowRight.at<cv::Vec2s>(v,u)[0])*0.5f+float(windowRight.at<cv::Vec2s>(v,u)[1])*0.5f;
-				score += fabs(sL - sR);
-			}
+			float sL = float(pL[u])*0.5f+float(pL[u+1])*0.5f;
+			float sR = float(pR[u])*0.5f+float(pR[u+1])*0.5f;
+			score += fabs(sL - sR);
 		}
 	}
 	return score;
@@ -145,8 +147,7 @@ std::vector<cv::Point2f> calcStereoCorrespondences(
 
 	UTimer timer;
 	double pyramidTime = 0.0;
-	double disparityTime = 0.0;
-	double subpixelTime = 0.0;
+	double matchingTime = 0.0;
 
 	std::vector<cv::Point2f> rightCorners(leftCorners.size());
 	std::vector<cv::Mat> leftPyramid, rightPyramid;
@@ -158,7 +159,11 @@ std::vector<cv::Point2f> calcStereoCorrespondences(
 	int totalIterations = 0;
 	int noSubPixel = 0;
 	int added = 0;
-	for(unsigned int i=0; i<leftCorners.size(); ++i)
+	// Corners are independent, each thread writes only in its own rightCorners[i]/status[i]
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 16) reduction(+:totalIterations,noSubPixel,added)
+#endif
+	for(int i=0; i<(int)leftCorners.size(); ++i)
 	{
 		int oi=0;
 		float bestScore = -1.0f;
@@ -239,7 +244,6 @@ std::vector<cv::Point2f> calcStereoCorrespondences(
 				}
 			}
 		}
-		disparityTime+=timer.ticks();
 		totalIterations+=iterations;
 
 		if(bestScoreIndex>=0)
@@ -328,13 +332,12 @@ std::vector<cv::Point2f> calcStereoCorrespondences(
 				++added;
 			}
 		}
-		subpixelTime+=timer.ticks();
 	}
+	matchingTime = timer.ticks();
 	UDEBUG("SubPixel=%d/%d added (total=%d)", noSubPixel, added, (int)status.size());
 	UDEBUG("totalIterations=%d", totalIterations);
 	UDEBUG("Time pyramid = %f s", pyramidTime);
-	UDEBUG("Time disparity = %f s", disparityTime);
-	UDEBUG("Time sub-pixel = %f s", subpixelTime);
+	UDEBUG("Time disparity+sub-pixel = %f s", matchingTime);
 
 	return rightCorners;
 }
@@ -505,215 +508,275 @@ void calcOpticalFlowPyrLKStereo( cv::InputArray _prevImg, cv::InputArray _nextIm
 			const cv::Mat& J = nextImg;
 			const cv::Mat& derivI = prevDeriv;
 
-			int j, cn = I.channels(), cn2 = cn*2;
-			cv::AutoBuffer<short> _buf(winSize.area()*(cn + cn2));
+			int cn = I.channels(), cn2 = cn*2;
 			int derivDepth = cv::DataType<short>::depth;
 
-			cv::Mat IWinBuf(winSize, CV_MAKETYPE(derivDepth, cn), (short*)_buf);
-			cv::Mat derivIWinBuf(winSize, CV_MAKETYPE(derivDepth, cn2), (short*)_buf + winSize.area()*cn);
-
-			for( int ptidx = 0; ptidx < npoints; ptidx++ )
+			// Points are tracked independently: each thread
+			// has its own patch buffers and only writes at ptidx.
+#ifdef _OPENMP
+			#pragma omp parallel
+#endif
 			{
-				cv::Point2f prevPt = prevPts[ptidx]*(float)(1./(1 << level));
-				cv::Point2f nextPt;
-				if( level == maxLevel )
-				{
-					if( flags & cv::OPTFLOW_USE_INITIAL_FLOW )
-						nextPt = nextPts[ptidx]*(float)(1./(1 << level));
-					else
-						nextPt = prevPt;
-				}
-				else
-					nextPt = nextPts[ptidx]*2.f;
-				nextPts[ptidx] = nextPt;
+				cv::AutoBuffer<short> _buf(winSize.area()*(cn + cn2));
+				cv::Mat IWinBuf(winSize, CV_MAKETYPE(derivDepth, cn), (short*)_buf);
+				cv::Mat derivIWinBuf(winSize, CV_MAKETYPE(derivDepth, cn2), (short*)_buf + winSize.area()*cn);
 
-				cv::Point2i iprevPt, inextPt;
-				prevPt -= halfWin;
-				iprevPt.x = cvFloor(prevPt.x);
-				iprevPt.y = cvFloor(prevPt.y);
-
-				if( iprevPt.x < -winSize.width || iprevPt.x >= derivI.cols ||
-					iprevPt.y < -winSize.height || iprevPt.y >= derivI.rows )
+#ifdef _OPENMP
+				#pragma omp for schedule(dynamic, 16)
+#endif
+				for( int ptidx = 0; ptidx < npoints; ptidx++ )
 				{
-					if( level == 0 )
+					cv::Point2f prevPt = prevPts[ptidx]*(float)(1./(1 << level));
+					cv::Point2f nextPt;
+					if( level == maxLevel )
 					{
-						if( status )
-							status[ptidx] = false;
-						if( err )
-							err[ptidx] = 0;
+						if( flags & cv::OPTFLOW_USE_INITIAL_FLOW )
+							nextPt = nextPts[ptidx]*(float)(1./(1 << level));
+						else
+							nextPt = prevPt;
 					}
-					continue;
-				}
-
-				float a = prevPt.x - iprevPt.x;
-				float b = prevPt.y - iprevPt.y;
-				const int W_BITS = 14, W_BITS1 = 14;
-				const float FLT_SCALE = 1.f/(1 << 20);
-				int iw00 = cvRound((1.f - a)*(1.f - b)*(1 << W_BITS));
-				int iw01 = cvRound(a*(1.f - b)*(1 << W_BITS));
-				int iw10 = cvRound((1.f - a)*b*(1 << W_BITS));
-				int iw11 = (1 << W_BITS) - iw00 - iw01 - iw10;
-
-				int dstep = (int)(derivI.step/derivI.elemSize1());
-				int stepI = (int)(I.step/I.elemSize1());
-				int stepJ = (int)(J.step/J.elemSize1());
-				acctype iA11 = 0, iA12 = 0, iA22 = 0;
-				float A11, A12, A22;
-
-				// extract the patch from the first image, compute covariation cv::Matrix of derivatives
-				int x, y;
-				for( y = 0; y < winSize.height; y++ )
-				{
-					const uchar* src = I.ptr() + (y + iprevPt.y)*stepI + iprevPt.x*cn;
-					const short* dsrc = derivI.ptr<short>() + (y + iprevPt.y)*dstep + iprevPt.x*cn2;
-
-					short* Iptr = IWinBuf.ptr<short>(y);
-					short* dIptr = derivIWinBuf.ptr<short>(y);
+					else
+						nextPt = nextPts[ptidx]*2.f;
+					nextPts[ptidx] = nextPt;
 
-					x = 0;
+					cv::Point2i iprevPt, inextPt;
+					prevPt -= halfWin;
+					iprevPt.x = cvFloor(prevPt.x);
+					iprevPt.y = cvFloor(prevPt.y);
 
-					for( ; x < winSize.width*cn; x++, dsrc += 2, dIptr += 2 )
+					if( iprevPt.x < -winSize.width || iprevPt.x >= derivI.cols ||
+						iprevPt.y < -winSize.height || iprevPt.y >= derivI.rows )
 					{
-						int ival = CV_DESCALE(src[x]*iw00 + src[x+cn]*iw01 +
-											  src[x+stepI]*iw10 + src[x+stepI+cn]*iw11, W_BITS1-5);
-						int ixval = CV_DESCALE(dsrc[0]*iw00 + dsrc[cn2]*iw01 +
-											   dsrc[dstep]*iw10 + dsrc[dstep+cn2]*iw11, W_BITS1);
-						int iyval = CV_DESCALE(dsrc[1]*iw00 + dsrc[cn2+1]*iw01 + dsrc[dstep+1]*iw10 +
-											   dsrc[dstep+cn2+1]*iw11, W_BITS1);
-
-						Iptr[x] = (short)ival;
-						dIptr[0] = (short)ixval;
-						dIptr[1] = (short)iyval;
-
-						iA11 += (itemtype)(ixval*ixval);
-						iA12 += (itemtype)(ixval*iyval);
-						iA22 += (itemtype)(iyval*iyval);
+						if( level == 0 )
+						{
+							if( status )
+								status[ptidx] = false;
+							if( err )
+								err[ptidx] = 0;
+						}
+						continue;
 					}
-				}
 
-				A11 = iA11*FLT_SCALE;
-				A12 = iA12*FLT_SCALE;
-				A22 = iA22*FLT_SCALE;
+					float a = prevPt.x - iprevPt.x;
+					float b = prevPt.y - iprevPt.y;
+					const int W_BITS = 14, W_BITS1 = 14;
+					const float FLT_SCALE = 1.f/(1 << 20);
+					int iw00 = cvRound((1.f - a)*(1.f - b)*(1 << W_BITS));
+					int iw01 = cvRound(a*(1.f - b)*(1 << W_BITS));
+					int iw10 = cvRound((1.f - a)*b*(1 << W_BITS));
+					int iw11 = (1 << W_BITS) - iw00 - iw01 - iw10;
+
+					int dstep = (int)(derivI.step/derivI.elemSize1());
+					int stepI = (int)(I.step/I.elemSize1());
+					int stepJ = (int)(J.step/J.elemSize1());
+					acctype iA11 = 0, iA12 = 0, iA22 = 0;
+					float A11, A12, A22;
+
+					// extract the patch from the first image, compute covariation cv::Matrix of derivatives
+					int x, y;
+					for( y = 0; y < winSize.height; y++ )
+					{
+						const uchar* src = I.ptr() + (y + iprevPt.y)*stepI + iprevPt.x*cn;
+						const short* dsrc = derivI.ptr<short>() + (y + iprevPt.y)*dstep + iprevPt.x*cn2;
 
-				float D = A11*A22 - A12*A12;
-				float minEig = (A22 + A11 - std::sqrt((A11-A22)*(A11-A22) +
-								4.f*A12*A12))/(2*winSize.width*winSize.height);
+						short* Iptr = IWinBuf.ptr<short>(y);
+						short* dIptr = derivIWinBuf.ptr<short>(y);
 
-				if( err && (flags & cv::OPTFLOW_LK_GET_MIN_EIGENVALS) != 0 )
-					err[ptidx] = (float)minEig;
+						x = 0;
 
-				if( minEig < minEigThreshold || D < FLT_EPSILON )
-				{
-					if( level == 0 && status )
-						status[ptidx] = false;
-					continue;
-				}
+						for( ; x < winSize.width*cn; x++, dsrc += 2, dIptr += 2 )
+						{
+							int ival = CV_DESCALE(src[x]*iw00 + src[x+cn]*iw01 +
+												  src[x+stepI]*iw10 + src[x+stepI+cn]*iw11, W_BITS1-5);
+							int ixval = CV_DESCALE(dsrc[0]*iw00 + dsrc[cn2]*iw01 +
+												   dsrc[dstep]*iw10 + dsrc[dstep+cn2]*iw11, W_BITS1);
+							int iyval = CV_DESCALE(dsrc[1]*iw00 + dsrc[cn2+1]*iw01 + dsrc[dstep+1]*iw10 +
+												   dsrc[dstep+cn2+1]*iw11, W_BITS1);
+
+							Iptr[x] = (short)ival;
+							dIptr[0] = (short)ixval;
+							dIptr[1] = (short)iyval;
+
+							iA11 += (itemtype)(ixval*ixval);
+							iA12 += (itemtype)(ixval*iyval);
+							iA22 += (itemtype)(iyval*iyval);
+						}
+					}
 
-				D = 1.f/D;
+					A11 = iA11*FLT_SCALE;
+					A12 = iA12*FLT_SCALE;
+					A22 = iA22*FLT_SCALE;
 
-				nextPt -= halfWin;
-				cv::Point2f prevDelta;
+					float D = A11*A22 - A12*A12;
+					float minEig = (A22 + A11 - std::sqrt((A11-A22)*(A11-A22) +
+									4.f*A12*A12))/(2*winSize.width*winSize.height);
 
-				for( j = 0; j < criteria.maxCount; j++ )
-				{
-					inextPt.x = cvFloor(nextPt.x);
-					inextPt.y = cvFloor(nextPt.y);
+					if( err && (flags & cv::OPTFLOW_LK_GET_MIN_EIGENVALS) != 0 )
+						err[ptidx] = (float)minEig;
 
-					if( inextPt.x < -winSize.width || inextPt.x >= J.cols ||
-					   inextPt.y < -winSize.height || inextPt.y >= J.rows )
+					if( minEig < minEigThreshold || D < FLT_EPSILON )
 					{
 						if( level == 0 && status )
 							status[ptidx] = false;
-						break;
+						continue;
 					}
 
-					a = nextPt.x - inextPt.x;
-					b = nextPt.y - inextPt.y;
-					iw00 = cvRound((1.f - a)*(1.f - b)*(1 << W_BITS));
-					iw01 = cvRound(a*(1.f - b)*(1 << W_BITS));
-					iw10 = cvRound((1.f - a)*b*(1 << W_BITS));
-					iw11 = (1 << W_BITS) - iw00 - iw01 - iw10;
-					acctype ib1 = 0, ib2 = 0;
-					float b1, b2;
+					D = 1.f/D;
 
-					for( y = 0; y < winSize.height; y++ )
-					{
-						const uchar* Jptr = J.ptr() + (y + inextPt.y)*stepJ + inextPt.x*cn;
-						const short* Iptr = IWinBuf.ptr<short>(y);
-						const short* dIptr = derivIWinBuf.ptr<short>(y);
+					nextPt -= halfWin;
+					cv::Point2f prevDelta;
 
-						x = 0;
+					for( int j = 0; j < criteria.maxCount; j++ )
+					{
+						inextPt.x = cvFloor(nextPt.x);
+						inextPt.y = cvFloor(nextPt.y);
 
-						for( ; x < winSize.width*cn; x++, dIptr += 2 )
+						if( inextPt.x < -winSize.width || inextPt.x >= J.cols ||
+						   inextPt.y < -winSize.height || inextPt.y >= J.rows )
 						{
-							int diff = CV_DESCALE(Jptr[x]*iw00 + Jptr[x+cn]*iw01 +
-												  Jptr[x+stepJ]*iw10 + Jptr[x+stepJ+cn]*iw11,
-												  W_BITS1-5) - Iptr[x];
-							ib1 += (itemtype)(diff*dIptr[0]);
-							ib2 += (itemtype)(diff*dIptr[1]);
+							if( level == 0 && status )
+								status[ptidx] = false;
+							break;
 						}
-					}
 
-					b1 = ib1*FLT_SCALE;
-					b2 = ib2*FLT_SCALE;
+						a = nextPt.x - inextPt.x;
+						b = nextPt.y - inextPt.y;
+						iw00 = cvRound((1.f - a)*(1.f - b)*(1 << W_BITS));
+						iw01 = cvRound(a*(1.f - b)*(1 << W_BITS));
+						iw10 = cvRound((1.f - a)*b*(1 << W_BITS));
+						iw11 = (1 << W_BITS) - iw00 - iw01 - iw10;
+						acctype ib1 = 0, ib2 = 0;
+						float b1, b2;
+#if CV_SSE2
+						// same vectorized mismatch accumulation as cv::calcOpticalFlowPyrLK()
+						const __m128i qdelta = _mm_set1_epi32(1 << (W_BITS1-5-1));
+						const __m128i z = _mm_setzero_si128();
+						__m128i qw0 = _mm_set1_epi32(iw00 + (iw01 << 16));
+						__m128i qw1 = _mm_set1_epi32(iw10 + (iw11 << 16));
+						__m128 qb0 = _mm_setzero_ps(), qb1 = _mm_setzero_ps();
+#endif
 
-					cv::Point2f delta( (float)((A12*b2 - A22*b1) * D),
-								  0);//(float)((A12*b1 - A11*b2) * D)); // MODIFICATION
-					//delta = -delta;
+						for( y = 0; y < winSize.height; y++ )
+						{
+							const uchar* Jptr = J.ptr() + (y + inextPt.y)*stepJ + inextPt.x*cn;
+							const short* Iptr = IWinBuf.ptr<short>(y);
+							const short* dIptr = derivIWinBuf.ptr<short>(y);
 
-					nextPt += delta;
-					nextPts[ptidx] = nextPt + halfWin;
+							x = 0;
 
-					if( delta.ddot(delta) <= criteria.epsilon )
-						break;
+#if CV_SSE2
+							for( ; x <= winSize.width*cn - 8; x += 8, dIptr += 8*2 )
+							{
+								__m128i diff0 = _mm_loadu_si128((const __m128i*)(Iptr + x)), diff1;
+								__m128i v00 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(Jptr + x)), z);
+								__m128i v01 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(Jptr + x + cn)), z);
+								__m128i v10 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(Jptr + x + stepJ)), z);
+								__m128i v11 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(Jptr + x + stepJ + cn)), z);
+
+								__m128i t0 = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(v00, v01), qw0),
+														   _mm_madd_epi16(_mm_unpacklo_epi16(v10, v11), qw1));
+								__m128i t1 = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(v00, v01), qw0),
+														   _mm_madd_epi16(_mm_unpackhi_epi16(v10, v11), qw1));
+								t0 = _mm_srai_epi32(_mm_add_epi32(t0, qdelta), W_BITS1-5);
+								t1 = _mm_srai_epi32(_mm_add_epi32(t1, qdelta), W_BITS1-5);
+								diff0 = _mm_subs_epi16(_mm_packs_epi32(t0, t1), diff0);
+								diff1 = _mm_unpackhi_epi16(diff0, diff0);
+								diff0 = _mm_unpacklo_epi16(diff0, diff0); // It0 It0 It1 It1 ...
+								v00 = _mm_loadu_si128((const __m128i*)(dIptr)); // Ix0 Iy0 Ix1 Iy1 ...
+								v01 = _mm_loadu_si128((const __m128i*)(dIptr + 8));
+								v10 = _mm_mullo_epi16(v00, diff0);
+								v11 = _mm_mulhi_epi16(v00, diff0);
+								v00 = _mm_unpacklo_epi16(v10, v11);
+								v10 = _mm_unpackhi_epi16(v10, v11);
+								qb0 = _mm_add_ps(qb0, _mm_cvtepi32_ps(v00));
+								qb1 = _mm_add_ps(qb1, _mm_cvtepi32_ps(v10));
+								v10 = _mm_mullo_epi16(v01, diff1);
+								v11 = _mm_mulhi_epi16(v01, diff1);
+								v00 = _mm_unpacklo_epi16(v10, v11);
+								v10 = _mm_unpackhi_epi16(v10, v11);
+								qb0 = _mm_add_ps(qb0, _mm_cvtepi32_ps(v00));
+								qb1 = _mm_add_ps(qb1, _mm_cvtepi32_ps(v10));
+							}
+#endif
 
-					if( j > 0 && std::abs(delta.x + prevDelta.x) < 0.01 &&
-					   std::abs(delta.y + prevDelta.y) < 0.01 )
-					{
-						nextPts[ptidx] -= delta*0.5f;
-						break;
-					}
-					prevDelta = delta;
-				}
+							for( ; x < winSize.width*cn; x++, dIptr += 2 )
+							{
+								int diff = CV_DESCALE(Jptr[x]*iw00 + Jptr[x+cn]*iw01 +
+													  Jptr[x+stepJ]*iw10 + Jptr[x+stepJ+cn]*iw11,
+													  W_BITS1-5) - Iptr[x];
+								ib1 += (itemtype)(diff*dIptr[0]);
+								ib2 += (itemtype)(diff*dIptr[1]);
+							}
+						}
 
-				if( status[ptidx] && err && level == 0 && (flags & cv::OPTFLOW_LK_GET_MIN_EIGENVALS) == 0 )
-				{
-					cv::Point2f nextPoint = nextPts[ptidx] - halfWin;
-					cv::Point inextPoint;
+#if CV_SSE2
+						float CV_DECL_ALIGNED(16) bbuf[4];
+						_mm_store_ps(bbuf, _mm_add_ps(qb0, qb1));
+						ib1 += bbuf[0] + bbuf[2];
+						ib2 += bbuf[1] + bbuf[3];
+#endif
 
-					inextPoint.x = cvFloor(nextPoint.x);
-					inextPoint.y = cvFloor(nextPoint.y);
+						b1 = ib1*FLT_SCALE;
+						b2 = ib2*FLT_SCALE;
 
-					if( inextPoint.x < -winSize.width || inextPoint.x >= J.cols ||
-						inextPoint.y < -winSize.height || inextPoint.y >= J.rows )
-					{
-						if( status )
-							status[ptidx] = false;
-						continue;
-					}
+						cv::Point2f delta( (float)((A12*b2 - A22*b1) * D),
+									  0);//(float)((A12*b1 - A11*b2) * D)); // MODIFICATION
+						//delta = -delta;
 
-					float aa = nextPoint.x - inextPoint.x;
-					float bb = nextPoint.y - inextPoint.y;
-					iw00 = cvRound((1.f - aa)*(1.f - bb)*(1 << W_BITS));
-					iw01 = cvRound(aa*(1.f - bb)*(1 << W_BITS));
-					iw10 = cvRound((1.f - aa)*bb*(1 << W_BITS));
-					iw11 = (1 << W_BITS) - iw00 - iw01 - iw10;
-					float errval = 0.f;
+						nextPt += delta;
+						nextPts[ptidx] = nextPt + halfWin;
 
-					for( y = 0; y < winSize.height; y++ )
+						if( delta.ddot(delta) <= criteria.epsilon )
+							break;
+
+						if( j > 0 && std::abs(delta.x + prevDelta.x) < 0.01 &&
+						   std::abs(delta.y + prevDelta.y) < 0.01 )
+						{
+							nextPts[ptidx] -= delta*0.5f;
+							break;
+						}
+						prevDelta = delta;
+					}
+
+					if( status[ptidx] && err && level == 0 && (flags & cv::OPTFLOW_LK_GET_MIN_EIGENVALS) == 0 )
 					{
-						const uchar* Jptr = J.ptr() + (y + inextPoint.y)*stepJ + inextPoint.x*cn;
-						const short* Iptr = IWinBuf.ptr<short>(y);
+						cv::Point2f nextPoint = nextPts[ptidx] - halfWin;
+						cv::Point inextPoint;
+
+						inextPoint.x = cvFloor(nextPoint.x);
+						inextPoint.y = cvFloor(nextPoint.y);
+
+						if( inextPoint.x < -winSize.width || inextPoint.x >= J.cols ||
+							inextPoint.y < -winSize.height || inextPoint.y >= J.rows )
+						{
+							if( status )
+								status[ptidx] = false;
+							continue;
+						}
+
+						float aa = nextPoint.x - inextPoint.x;
+						float bb = nextPoint.y - inextPoint.y;
+						iw00 = cvRound((1.f - aa)*(1.f - bb)*(1 << W_BITS));
+						iw01 = cvRound(aa*(1.f - bb)*(1 << W_BITS));
+						iw10 = cvRound((1.f - aa)*bb*(1 << W_BITS));
+						iw11 = (1 << W_BITS) - iw00 - iw01 - iw10;
+						float errval = 0.f;
 
-						for( x = 0; x < winSize.width*cn; x++ )
+						for( y = 0; y < winSize.height; y++ )
 						{
-							int diff = CV_DESCALE(Jptr[x]*iw00 + Jptr[x+cn]*iw01 +
-												  Jptr[x+stepJ]*iw10 + Jptr[x+stepJ+cn]*iw11,
-												  W_BITS1-5) - Iptr[x];
-							errval += std::abs((float)diff);
+							const uchar* Jptr = J.ptr() + (y + inextPoint.y)*stepJ + inextPoint.x*cn;
+							const short* Iptr = IWinBuf.ptr<short>(y);
+
+							for( x = 0; x < winSize.width*cn; x++ )
+							{
+								int diff = CV_DESCALE(Jptr[x]*iw00 + Jptr[x+cn]*iw01 +
+													  Jptr[x+stepJ]*iw10 + Jptr[x+stepJ+cn]*iw11,
+													  W_BITS1-5) - Iptr[x];
+								errval += std::abs((float)diff);
+							}
 						}
+						err[ptidx] = errval * 1.f/(32*winSize.width*cn*winSize.height);
 					}
-					err[ptidx] = errval * 1.f/(32*winSize.width*cn*winSize.height);
 				}
 			}
         }
@@ -1270,12 +1333,117 @@ cv::Mat interpolate(const cv::Mat & image, int factor, float depthErrorRatio)
 	return out;
 }
 
+template<typename T> static inline float depthValueToMeters(T value);
+template<> inline float depthValueToMeters<unsigned short>(unsigned short value) {return float(value)*0.001f;}
+template<> inline float depthValueToMeters<float>(float value) {return value;}
+template<typename T> static inline T depthValueFromMeters(float z);
+template<> inline unsigned short depthValueFromMeters<unsigned short>(float z) {return z * 1000;} // mm
+template<> inline float depthValueFromMeters<float>(float z) {return z;}
+
+// Depths are compared as unsigned integers in the shared z-buffer: millimeters,
+// or the bits of the float (the order of positive floats is the same as their bits).
+template<typename T> static inline unsigned int depthKey(T value);
+template<> inline unsigned int depthKey<unsigned short>(unsigned short value) {return value;}
+template<> inline unsigned int depthKey<float>(float value) {unsigned int key; memcpy(&key, &value, sizeof(key)); return key;}
+template<typename T> static inline T depthFromKey(unsigned int key);
+template<> inline unsigned short depthFromKey<unsigned short>(unsigned int key) {return (unsigned short)key;}
+template<> inline float depthFromKey<float>(unsigned int key) {float value; memcpy(&value, &key, sizeof(value)); return value;}
+
+static inline void atomicMin(volatile unsigned int * address, unsigned int value)
+{
+	unsigned int current = *address;
+	while(value < current)
+	{
+		unsigned int previous = uAtomicCompareExchange(address, value, current);
+		if(previous == current)
+		{
+			break;
+		}
+		current = previous;
+	}
+}
+
+// Z-buffer version of registerDepth(): the rows are projected by blocks in a single
+// shared z-buffer, keeping the closest depth with an atomic min. Blocks are distributed
+// round-robin, so the threads project neighbor bands at the same time and their
+// writes stay in the same region of the buffer (collisions are rare, as a depth
+// pixel projects close to its own position).
+template<typename T>
+static void registerDepthZBuffer(
+		const cv::Mat & depth,
+		float fx, float fy, float cx, float cy,
+		float rfx, float rfy, float rcx, float rcy,
+		const Eigen::Affine3f & proj,
+		cv::Mat & registered)
+{
+	const unsigned int empty = std::numeric_limits<unsigned int>::max();
+	const int cols = depth.cols;
+	const int rows = depth.rows;
+	const int blockRows = 16;
+
+	std::vector<float> rayX(cols);
+	for(int x=0; x<cols; ++x)
+	{
+		rayX[x] = float(x) - cx;
+	}
+
+	std::vector<unsigned int> zBuffer(rows*cols, empty);
+	volatile unsigned int * zBufferData = &zBuffer[0];
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static, blockRows)
+#endif
+	for(int y=0; y<rows; ++y)
+	{
+		Eigen::Vector4f P4,P3;
+		P4[3] = 1;
+		const T * row = depth.ptr<T>(y);
+		float rayY = float(y) - cy;
+		for(int x=0; x<cols; ++x)
+		{
+			float dz = depthValueToMeters<T>(row[x]);
+			P4[0] = rayX[x] * dz / fx;
+			P4[1] = rayY * dz / fy;
+			P4[2] = dz;
+
+			P3 = proj * P4;
+			float z = P3[2];
+			float invZ = 1.0f/z;
+			int dx = (rfx*P3[0])*invZ + rcx;
+			int dy = (rfy*P3[1])*invZ + rcy;
+			T zReg = depthValueFromMeters<T>(z);
+
+			if(dz > 0.0f && z > 0.0f && zReg > 0 &&
+				(unsigned int)dx < (unsigned int)cols &&
+				(unsigned int)dy < (unsigned int)rows)
+			{
+				atomicMin(zBufferData + dy*cols+dx, depthKey<T>(zReg));
+			}
+		}
+	}
+
+	registered = cv::Mat(rows, cols, depth.type());
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static, blockRows)
+#endif
+	for(int y=0; y<rows; ++y)
+	{
+		T * out = registered.ptr<T>(y);
+		const unsigned int * in = &zBuffer[y*cols];
+		for(int x=0; x<cols; ++x)
+		{
+			out[x] = in[x] == empty?0:depthFromKey<T>(in[x]);
+		}
+	}
+}
+
 // Registration Depth to RGB (return registered depth image)
 cv::Mat registerDepth(
 		const cv::Mat & depth,
 		const cv::Mat & depthK,
 		const cv::Mat & colorK,
-		const rtabmap::Transform & transform)
+		const rtabmap::Transform & transform,
+		bool parallel)
 {
 	UASSERT(!transform.isNull());
 	UASSERT(!depth.empty());
@@ -1294,9 +1462,23 @@ cv::Mat registerDepth(
 	float rcy = colorK.at<double>(1,2);
 
 	Eigen::Affine3f proj = transform.toEigen3f();
+	cv::Mat registered;
+	if(parallel)
+	{
+		if(depth.type() == CV_16UC1)
+		{
+			registerDepthZBuffer<unsigned short>(depth, fx, fy, cx, cy, rfx, rfy, rcx, rcy, proj, registered);
+		}
+		else
+		{
+			registerDepthZBuffer<float>(depth, fx, fy, cx, cy, rfx, rfy, rcx, rcy, proj, registered);
+		}
+		return registered;
+	}
+
 	Eigen::Vector4f P4,P3;
 	P4[3] = 1;
-	cv::Mat registered = cv::Mat::zeros(depth.rows, depth.cols, depth.type());
+	registered = cv::Mat::zeros(depth.rows, depth.cols, depth.type());
 
 	bool depthInMM = depth.type() == CV_16UC1;
 	for(int y=0; y<depth.rows; ++y)
@@ -1344,11 +1526,134 @@ cv::Mat registerDepth(
 	return registered;
 }
 
-cv::Mat fillDepthHoles(const cv::Mat & registeredDepth, int maximumHoleSize, float errorRatio)
+// Fill holes starting on row y of fillDepthHoles(). As the holes are filled only from
+// their first left or top pixel, each pixel is written at most once in horizontal and
+// at most once in vertical, so rows can be processed independently.
+static void fillDepthHolesRow(
+		const cv::Mat & registeredDepth,
+		int y,
+		int maximumHoleSize,
+		float errorRatio,
+		unsigned short * horizontalFill,
+		cv::Mat & verticalFill)
+{
+	const unsigned short * row = registeredDepth.ptr<unsigned short>(y);
+	const unsigned short * rowDown = registeredDepth.ptr<unsigned short>(y+1);
+	for(int x=0; x<registeredDepth.cols-2; ++x)
+	{
+		float a = row[x];
+		float bRight = row[x+1];
+		float bDown = rowDown[x];
+
+		if(a > 0.0f && (bRight == 0.0f || bDown == 0.0f))
+		{
+			bool horizontalSet = bRight != 0.0f;
+			bool verticalSet = bDown != 0.0f;
+			int stepX = 0;
+			for(int h=1; h<=maximumHoleSize && (!horizontalSet || !verticalSet); ++h)
+			{
+				// horizontal
+				if(!horizontalSet)
+				{
+					if(x+1+h >= registeredDepth.cols)
+					{
+						horizontalSet = true;
+					}
+					else
+					{
+						float c = row[x+1+h];
+						if(c != 0)
+						{
+							float depthError = errorRatio*float(a+c)/2.0f;
+							if(fabs(a-c) <= depthError)
+							{
+								//linear interpolation
+								float slope = (c-a)/float(h+1);
+								for(int z=x+1; z<x+1+h; ++z)
+								{
+									horizontalFill[z] = (unsigned short)(a+(slope*float(z-x)));
+								}
+							}
+							horizontalSet = true;
+							stepX = h;
+						}
+					}
+				}
+
+				// vertical
+				if(!verticalSet)
+				{
+					if(y+1+h >= registeredDepth.rows)
+					{
+						verticalSet = true;
+					}
+					else
+					{
+						float c = registeredDepth.at<unsigned short>(y+1+h, x);
+						if(c != 0)
+						{
+							float depthError = errorRatio*float(a+c)/2.0f;
+							if(fabs(a-c) <= depthError)
+							{
+								//linear interpolation
+								float slope = (c-a)/float(h+1);
+								for(int z=y+1; z<y+1+h; ++z)
+								{
+									verticalFill.at<unsigned short>(z, x) = (unsigned short)(a+(slope*float(z-y)));
+								}
+							}
+							verticalSet = true;
+						}
+					}
+				}
+			}
+			x+=stepX;
+		}
+	}
+}
+
+cv::Mat fillDepthHoles(const cv::Mat & registeredDepth, int maximumHoleSize, float errorRatio, bool parallel)
 {
 	UASSERT(registeredDepth.type() == CV_16UC1);
 	UASSERT(maximumHoleSize > 0);
 	cv::Mat output = registeredDepth.clone();
+	if(parallel)
+	{
+		cv::Mat horizontalFill = cv::Mat::zeros(registeredDepth.size(), CV_16UC1);
+		cv::Mat verticalFill = cv::Mat::zeros(registeredDepth.size(), CV_16UC1);
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for(int y=0; y<registeredDepth.rows-2; ++y)
+		{
+			fillDepthHolesRow(registeredDepth, y, maximumHoleSize, errorRatio, horizontalFill.ptr<unsigned short>(y), verticalFill);
+		}
+
+		// Merge in the same order than the serial version: vertical fills are
+		// done from rows above, so they are averaged with horizontal fills.
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for(int y=0; y<output.rows; ++y)
+		{
+			unsigned short * out = output.ptr<unsigned short>(y);
+			const unsigned short * h = horizontalFill.ptr<unsigned short>(y);
+			const unsigned short * v = verticalFill.ptr<unsigned short>(y);
+			for(int x=0; x<output.cols; ++x)
+			{
+				if(v[x] && h[x])
+				{
+					out[x] = (v[x] + h[x])/2;
+				}
+				else if(v[x] || h[x])
+				{
+					out[x] = v[x] | h[x];
+				}
+			}
+		}
+		return output;
+	}
+
 	for(int y=0; y<registeredDepth.rows-2; ++y)
 	{
 		for(int x=0; x<registeredDepth.cols-2; ++x)
@@ -1452,106 +1757,166 @@ cv::Mat fillDepthHoles(const cv::Mat & registeredDepth, int maximumHoleSize, flo
 	return output;
 }
 
-void fillRegisteredDepthHoles(cv::Mat & registeredDepth, bool vertical, bool horizontal, bool fillDoubleHoles)
+// Fill pixel (x,y) of fillRegisteredDepthHoles(), returns the number of
+// following pixels of the column to skip.
+static int fillRegisteredDepthHole(cv::Mat & registeredDepth, int x, int y, bool vertical, bool horizontal, bool fillDoubleHoles)
 {
-	UASSERT(registeredDepth.type() == CV_16UC1);
-	int margin = fillDoubleHoles?2:1;
-	for(int x=1; x<registeredDepth.cols-margin; ++x)
+	int skip = 0;
+	unsigned short & b = registeredDepth.at<unsigned short>(y, x);
+	bool set = false;
+	if(vertical)
 	{
-		for(int y=1; y<registeredDepth.rows-margin; ++y)
+		const unsigned short & a = registeredDepth.at<unsigned short>(y-1, x);
+		unsigned short & c = registeredDepth.at<unsigned short>(y+1, x);
+		if(a && c)
 		{
-			unsigned short & b = registeredDepth.at<unsigned short>(y, x);
-			bool set = false;
-			if(vertical)
+			unsigned short error = 0.01*((a+c)/2);
+			if(((b == 0 && a && c) || (b > a+error && b > c+error)) &&
+				(a>c?a-c<=error:c-a<=error))
 			{
-				const unsigned short & a = registeredDepth.at<unsigned short>(y-1, x);
-				unsigned short & c = registeredDepth.at<unsigned short>(y+1, x);
-				if(a && c)
+				b = (a+c)/2;
+				set = true;
+				if(!horizontal)
 				{
-					unsigned short error = 0.01*((a+c)/2);
-					if(((b == 0 && a && c) || (b > a+error && b > c+error)) &&
-						(a>c?a-c<=error:c-a<=error))
-					{
-						b = (a+c)/2;
-						set = true;
-						if(!horizontal)
-						{
-							++y;
-						}
-					}
+					skip = 1;
 				}
-				if(!set && fillDoubleHoles)
+			}
+		}
+		if(!set && fillDoubleHoles)
+		{
+			const unsigned short & d = registeredDepth.at<unsigned short>(y+2, x);
+			if(a && d && (b==0 || c==0))
+			{
+				unsigned short error = 0.01*((a+d)/2);
+				if(((b == 0 && a && d) || (b > a+error && b > d+error)) &&
+				   ((c == 0 && a && d) || (c > a+error && c > d+error)) &&
+					(a>d?a-d<=error:d-a<=error))
 				{
-					const unsigned short & d = registeredDepth.at<unsigned short>(y+2, x);
-					if(a && d && (b==0 || c==0))
+					if(a>d)
 					{
-						unsigned short error = 0.01*((a+d)/2);
-						if(((b == 0 && a && d) || (b > a+error && b > d+error)) &&
-						   ((c == 0 && a && d) || (c > a+error && c > d+error)) &&
-							(a>d?a-d<=error:d-a<=error))
-						{
-							if(a>d)
-							{
-								unsigned short tmp = (a-d)/4;
-								b = d + tmp;
-								c = d + 3*tmp;
-							}
-							else
-							{
-								unsigned short tmp = (d-a)/4;
-								b = a + tmp;
-								c = a + 3*tmp;
-							}
-							set = true;
-							if(!horizontal)
-							{
-								y+=2;
-							}
-						}
+						unsigned short tmp = (a-d)/4;
+						b = d + tmp;
+						c = d + 3*tmp;
+					}
+					else
+					{
+						unsigned short tmp = (d-a)/4;
+						b = a + tmp;
+						c = a + 3*tmp;
+					}
+					set = true;
+					if(!horizontal)
+					{
+						skip = 2;
 					}
 				}
 			}
-			if(!set && horizontal)
+		}
+	}
+	if(!set && horizontal)
+	{
+		const unsigned short & a = registeredDepth.at<unsigned short>(y, x-1);
+		unsigned short & c = registeredDepth.at<unsigned short>(y, x+1);
+		if(a && c)
+		{
+			unsigned short error = 0.01*((a+c)/2);
+			if(((b == 0 && a && c) || (b > a+error && b > c+error)) &&
+				(a>c?a-c<=error:c-a<=error))
+			{
+				b = (a+c)/2;
+				set = true;
+			}
+		}
+		if(!set && fillDoubleHoles)
+		{
+			const unsigned short & d = registeredDepth.at<unsigned short>(y, x+2);
+			if(a && d && (b==0 || c==0))
 			{
-				const unsigned short & a = registeredDepth.at<unsigned short>(y, x-1);
-				unsigned short & c = registeredDepth.at<unsigned short>(y, x+1);
-				if(a && c)
+				unsigned short error = 0.01*((a+d)/2);
+				if(((b == 0 && a && d) || (b > a+error && b > d+error)) &&
+				   ((c == 0 && a && d) || (c > a+error && c > d+error)) &&
+					(a>d?a-d<=error:d-a<=error))
 				{
-					unsigned short error = 0.01*((a+c)/2);
-					if(((b == 0 && a && c) || (b > a+error && b > c+error)) &&
-						(a>c?a-c<=error:c-a<=error))
+					if(a>d)
+					{
+						unsigned short tmp = (a-d)/4;
+						b = d + tmp;
+						c = d + 3*tmp;
+					}
+					else
 					{
-						b = (a+c)/2;
-						set = true;
+						unsigned short tmp = (d-a)/4;
+						b = a + tmp;
+						c = a + 3*tmp;
 					}
 				}
-				if(!set && fillDoubleHoles)
+			}
+		}
+	}
+	return skip;
+}
+
+void fillRegisteredDepthHoles(cv::Mat & registeredDepth, bool vertical, bool horizontal, bool fillDoubleHoles, bool parallel)
+{
+	UASSERT(registeredDepth.type() == CV_16UC1);
+	int margin = fillDoubleHoles?2:1;
+	if(parallel && vertical != horizontal)
+	{
+		if(vertical)
+		{
+			// Columns are independent: process them by blocks, row by row
+			// inside a block to stay in cache.
+			const int blockSize = 32;
+			int blocks = (registeredDepth.cols-margin-1 + blockSize-1)/blockSize;
+#ifdef _OPENMP
+			#pragma omp parallel for schedule(static)
+#endif
+			for(int i=0; i<blocks; ++i)
+			{
+				int xStart = 1+i*blockSize;
+				int xEnd = std::min(xStart+blockSize, registeredDepth.cols-margin);
+				int skip[blockSize] = {0};
+				for(int y=1; y<registeredDepth.rows-margin; ++y)
 				{
-					const unsigned short & d = registeredDepth.at<unsigned short>(y, x+2);
-					if(a && d && (b==0 || c==0))
+					for(int x=xStart; x<xEnd; ++x)
 					{
-						unsigned short error = 0.01*((a+d)/2);
-						if(((b == 0 && a && d) || (b > a+error && b > d+error)) &&
-						   ((c == 0 && a && d) || (c > a+error && c > d+error)) &&
-							(a>d?a-d<=error:d-a<=error))
+						if(skip[x-xStart])
 						{
-							if(a>d)
-							{
-								unsigned short tmp = (a-d)/4;
-								b = d + tmp;
-								c = d + 3*tmp;
-							}
-							else
-							{
-								unsigned short tmp = (d-a)/4;
-								b = a + tmp;
-								c = a + 3*tmp;
-							}
+							--skip[x-xStart];
+						}
+						else
+						{
+							skip[x-xStart] = fillRegisteredDepthHole(registeredDepth, x, y, vertical, horizontal, fillDoubleHoles);
 						}
 					}
 				}
 			}
 		}
+		else
+		{
+			// Rows are independent
+#ifdef _OPENMP
+			#pragma omp parallel for schedule(static)
+#endif
+			for(int y=1; y<registeredDepth.rows-margin; ++y)
+			{
+				for(int x=1; x<registeredDepth.cols-margin; ++x)
+				{
+					fillRegisteredDepthHole(registeredDepth, x, y, vertical, horizontal, fillDoubleHoles);
+				}
+			}
+		}
+		return;
+	}
+
+	// When both directions are filled, a pixel depends on its left and top
+	// neighbors already filled: keep the serial order.
+	for(int x=1; x<registeredDepth.cols-margin; ++x)
+	{
+		for(int y=1; y<registeredDepth.rows-margin; ++y)
+		{
+			y += fillRegisteredDepthHole(registeredDepth, x, y, vertical, horizontal, fillDoubleHoles);
+		}
 	}
 }
 
@@ -39,6 +39,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pcl/common/transforms.h>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#if CV_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace rtabmap
 {
 
@@ -239,6 +243,55 @@ pcl::PointXYZ projectDepthTo3D(
 	return pt;
 }
 
+// Depth row in meters, invalid values set to 0 (same values as util2d::getDepth() without smoothing)
+static void depthRowToMeters(const cv::Mat & depth, int row, float * out)
+{
+	if(depth.type() == CV_32FC1)
+	{
+		// non-finite depths (NaN, +inf) are invalid
+		const float * in = depth.ptr<float>(row);
+		for(int i=0; i<depth.cols; ++i)
+		{
+			out[i] = uIsFinite(in[i])?in[i]:0.0f;
+		}
+		return;
+	}
+
+	const unsigned short * in = depth.ptr<unsigned short>(row);
+	int i=0;
+#if CV_SSE2
+	const __m128 scale = _mm_set1_ps(0.001f);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i maxValue = _mm_set1_epi16(-1);
+	for(; i<=depth.cols-8; i+=8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(in+i));
+		__m128i invalid = _mm_or_si128(_mm_cmpeq_epi16(v, zero), _mm_cmpeq_epi16(v, maxValue));
+		__m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), scale);
+		__m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)), scale);
+		lo = _mm_andnot_ps(_mm_castsi128_ps(_mm_unpacklo_epi16(invalid, invalid)), lo);
+		hi = _mm_andnot_ps(_mm_castsi128_ps(_mm_unpackhi_epi16(invalid, invalid)), hi);
+		_mm_storeu_ps(out+i, lo);
+		_mm_storeu_ps(out+i+4, hi);
+	}
+#endif
+	for(; i<depth.cols; ++i)
+	{
+		out[i] = in[i] > 0 && in[i] < std::numeric_limits<unsigned short>::max()?float(in[i])*0.001f:0.0f;
+	}
+}
+
+// Pixel index in depth image of a (possibly scaled) coordinate, -1 if outside (same rounding as util2d::getDepth())
+static int depthPixelIndex(float x, int size)
+{
+	int u = int(x+0.5f);
+	if(u == size && x<float(size))
+	{
+		u = size - 1;
+	}
+	return u>=0 && u<size?u:-1;
+}
+
 pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFromDepth(
 		const cv::Mat & imageDepth,
 		float cx, float cy,
@@ -262,38 +315,67 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFromDepth(
 	cloud->width  = imageDepth.cols/decimation;
 	cloud->is_dense = false;
 	cloud->resize(cloud->height * cloud->width);
-	if(validIndices)
+
+	// Ray look-up table: same arithmetic as projectDepthTo3D(), so that the points are bit-identical
+	cx = cx > 0.0f ? cx : float(imageDepth.cols/2) - 0.5f;
+	cy = cy > 0.0f ? cy : float(imageDepth.rows/2) - 0.5f;
+	std::vector<float> rayX(cloud->width);
+	for(unsigned int i=0; i<cloud->width; ++i)
 	{
-		validIndices->resize(cloud->size());
+		rayX[i] = float(i*decimation) - cx;
 	}
 
-	int oi = 0;
-	for(int h = 0; h < imageDepth.rows; h+=decimation)
+	std::vector<unsigned char> valid(validIndices?cloud->size():0);
+	const float bad_point = std::numeric_limits<float>::quiet_NaN();
+	int rows = (int)cloud->height;
+#ifdef _OPENMP
+	#pragma omp parallel
+#endif
 	{
-		for(int w = 0; w < imageDepth.cols; w+=decimation)
+		std::vector<float> depthRow(imageDepth.cols);
+#ifdef _OPENMP
+		#pragma omp for
+#endif
+		for(int r = 0; r < rows; ++r)
 		{
-			pcl::PointXYZ & pt = cloud->at((h/decimation)*cloud->width + (w/decimation));
-
-			pcl::PointXYZ ptXYZ = projectDepthTo3D(imageDepth, w, h, cx, cy, fx, fy, false);
-			if(maxDepth<=0.0f || ptXYZ.z <= maxDepth)
+			int h = r*decimation;
+			depthRowToMeters(imageDepth, h, &depthRow[0]);
+			float rayY = float(h) - cy;
+			pcl::PointXYZ * pt = &cloud->at(r*cloud->width);
+			unsigned char * v = validIndices?&valid[r*cloud->width]:0;
+			for(unsigned int c = 0; c < cloud->width; ++c, ++pt)
 			{
-				pt.x = ptXYZ.x;
-				pt.y = ptXYZ.y;
-				pt.z = ptXYZ.z;
-				if(validIndices)
+				float depth = depthRow[c*decimation];
+				if(depth > 0.0f && (maxDepth<=0.0f || depth <= maxDepth))
 				{
-					validIndices->at(oi++) = (h/decimation)*cloud->width + (w/decimation);
+					pt->x = rayX[c] * depth / fx;
+					pt->y = rayY * depth / fy;
+					pt->z = depth;
+				}
+				else
+				{
+					pt->x = pt->y = pt->z = bad_point;
+				}
+				if(v)
+				{
+					// NaN points are kept as valid when maxDepth is not set (as before)
+					v[c] = maxDepth<=0.0f || (depth > 0.0f && depth <= maxDepth)?1:0;
 				}
-			}
-			else
-			{
-				pt.x = pt.y = pt.z = std::numeric_limits<float>::quiet_NaN();
 			}
 		}
 	}
 
 	if(validIndices)
 	{
+		validIndices->resize(cloud->size());
+		int oi = 0;
+		for(unsigned int i=0; i<valid.size(); ++i)
+		{
+			if(valid[i])
+			{
+				validIndices->at(oi++) = i;
+			}
+		}
 		validIndices->resize(oi);
 	}
 
@@ -340,10 +422,6 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDepthRGB(
 	cloud->width  = imageRgb.cols/decimation;
 	cloud->is_dense = false;
 	cloud->resize(cloud->height * cloud->width);
-	if(validIndices)
-	{
-		validIndices->resize(cloud->size());
-	}
 
 	float rgbToDepthFactorX = 1.0f/float((imageRgb.cols / imageDepth.cols));
 	float rgbToDepthFactorY = 1.0f/float((imageRgb.rows / imageDepth.rows));
@@ -360,42 +438,90 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDepthRGB(
 			rgbToDepthFactorY,
 			decimation);
 
-	int oi = 0;
-	for(int h = 0; h < imageRgb.rows && h/decimation < (int)cloud->height; h+=decimation)
+	// Ray and depth pixel look-up tables: same arithmetic as projectDepthTo3D(), so that the points are bit-identical
+	depthCx = depthCx > 0.0f ? depthCx : float(imageDepth.cols/2) - 0.5f;
+	depthCy = depthCy > 0.0f ? depthCy : float(imageDepth.rows/2) - 0.5f;
+	std::vector<float> rayX(cloud->width);
+	std::vector<int> depthU(cloud->width);
+	for(unsigned int i=0; i<cloud->width; ++i)
 	{
-		for(int w = 0; w < imageRgb.cols && w/decimation < (int)cloud->width; w+=decimation)
+		float x = float(i*decimation)*rgbToDepthFactorX;
+		rayX[i] = x - depthCx;
+		depthU[i] = depthPixelIndex(x, imageDepth.cols);
+	}
+
+	std::vector<unsigned char> valid(cloud->size());
+	const float bad_point = std::numeric_limits<float>::quiet_NaN();
+	int rows = (int)cloud->height;
+#ifdef _OPENMP
+	#pragma omp parallel
+#endif
+	{
+		std::vector<float> depthRow(imageDepth.cols);
+#ifdef _OPENMP
+		#pragma omp for
+#endif
+		for(int r = 0; r < rows; ++r)
 		{
-			pcl::PointXYZRGB & pt = cloud->at((h/decimation)*cloud->width + (w/decimation));
-			if(!mono)
+			int h = r*decimation;
+			float y = float(h)*rgbToDepthFactorY;
+			float rayY = y - depthCy;
+			int v = depthPixelIndex(y, imageDepth.rows);
+			if(v >= 0)
 			{
-				pt.b = imageRgb.at<cv::Vec3b>(h,w)[0];
-				pt.g = imageRgb.at<cv::Vec3b>(h,w)[1];
-				pt.r = imageRgb.at<cv::Vec3b>(h,w)[2];
+				depthRowToMeters(imageDepth, v, &depthRow[0]);
 			}
-			else
+			pcl::PointXYZRGB * pt = &cloud->at(r*cloud->width);
+			for(unsigned int c = 0; c < cloud->width; ++c, ++pt)
 			{
-				unsigned char v = imageRgb.at<unsigned char>(h,w);
-				pt.b = v;
-				pt.g = v;
-				pt.r = v;
-			}
+				int w = c*decimation;
+				if(!mono)
+				{
+					const cv::Vec3b & bgr = imageRgb.at<cv::Vec3b>(h,w);
+					pt->b = bgr[0];
+					pt->g = bgr[1];
+					pt->r = bgr[2];
+				}
+				else
+				{
+					unsigned char value = imageRgb.at<unsigned char>(h,w);
+					pt->b = value;
+					pt->g = value;
+					pt->r = value;
+				}
 
-			pcl::PointXYZ ptXYZ = projectDepthTo3D(imageDepth, w*rgbToDepthFactorX, h*rgbToDepthFactorY, depthCx, depthCy, depthFx, depthFy, false);
-			if(pcl::isFinite(ptXYZ) && (maxDepth<=0.0f || ptXYZ.z <= maxDepth))
-			{
-				pt.x = ptXYZ.x;
-				pt.y = ptXYZ.y;
-				pt.z = ptXYZ.z;
-				if(validIndices)
+				float depth = v>=0 && depthU[c]>=0?depthRow[depthU[c]]:0.0f;
+				bool ok = false;
+				if(depth > 0.0f)
 				{
-					validIndices->at(oi) = (h/decimation)*cloud->width + (w/decimation);
+					pt->x = rayX[c] * depth / depthFx;
+					pt->y = rayY * depth / depthFy;
+					pt->z = depth;
+					ok = pcl::isFinite(*pt) && (maxDepth<=0.0f || depth <= maxDepth);
 				}
-				++oi;
+				if(!ok)
+				{
+					pt->x = pt->y = pt->z = bad_point;
+				}
+				valid[r*cloud->width + c] = ok?1:0;
 			}
-			else
+		}
+	}
+
+	int oi = 0;
+	if(validIndices)
+	{
+		validIndices->resize(cloud->size());
+	}
+	for(unsigned int i=0; i<valid.size(); ++i)
+	{
+		if(valid[i])
+		{
+			if(validIndices)
 			{
-				pt.x = pt.y = pt.z = std::numeric_limits<float>::quiet_NaN();
+				validIndices->at(oi) = i;
 			}
+			++oi;
 		}
 	}
 	if(validIndices)
@@ -109,6 +109,108 @@ void occupancy2DFromLaserScan(
 	}
 }
 
+/**
+ * Filter a 2d occupancy grid (CV_8S, see create2DMapFromOccupancyLocalMaps()):
+ * fill small holes and remove empty cells on obstacle borders.
+ * @param map8S
+ * @param erode remove obstacles touching at least 3 empty cells but no unknown cells
+ */
+cv::Mat filter2DMap(const cv::Mat & map8S, bool erode)
+{
+	UASSERT(map8S.empty() || map8S.type() == CV_8S);
+	cv::Mat map = map8S;
+
+	// fill holes and remove empty from obstacle borders
+	cv::Mat updatedMap = map.clone();
+	std::list<std::pair<int, int> > obstacleIndices;
+	for(int i=2; i<map.rows-2; ++i)
+	{
+		for(int j=2; j<map.cols-2; ++j)
+		{
+			if(map.at<char>(i, j) == -1 &&
+				map.at<char>(i+1, j) != -1 &&
+				map.at<char>(i-1, j) != -1 &&
+				map.at<char>(i, j+1) != -1 &&
+				map.at<char>(i, j-1) != -1)
+			{
+				updatedMap.at<char>(i, j) = 0;
+			}
+			else if(map.at<char>(i, j) == 100)
+			{
+				// obstacle/empty/unknown -> remove empty
+				// unknown/empty/obstacle -> remove empty
+				if(map.at<char>(i-1, j) == 0 &&
+					map.at<char>(i-2, j) == -1)
+				{
+					updatedMap.at<char>(i-1, j) = -1;
+				}
+				else if(map.at<char>(i+1, j) == 0 &&
+						map.at<char>(i+2, j) == -1)
+				{
+					updatedMap.at<char>(i+1, j) = -1;
+				}
+				if(map.at<char>(i, j-1) == 0 &&
+					map.at<char>(i, j-2) == -1)
+				{
+					updatedMap.at<char>(i, j-1) = -1;
+				}
+				else if(map.at<char>(i, j+1) == 0 &&
+						map.at<char>(i, j+2) == -1)
+				{
+					updatedMap.at<char>(i, j+1) = -1;
+				}
+
+				if(erode)
+				{
+					obstacleIndices.push_back(std::make_pair(i, j));
+				}
+			}
+			else if(map.at<char>(i, j) == 0)
+			{
+				// obstacle/empty/obstacle -> remove empty
+				if(map.at<char>(i-1, j) == 100 &&
+					map.at<char>(i+1, j) == 100)
+				{
+					updatedMap.at<char>(i, j) = -1;
+				}
+				else if(map.at<char>(i, j-1) == 100 &&
+					map.at<char>(i, j+1) == 100)
+				{
+					updatedMap.at<char>(i, j) = -1;
+				}
+			}
+
+		}
+	}
+	map = updatedMap;
+
+	if(erode)
+	{
+		// remove obstacles which touch at least 3 empty cells but not unknown cells
+		cv::Mat erodedMap = map.clone();
+		for(std::list<std::pair<int,int> >::iterator iter = obstacleIndices.begin();
+			iter!= obstacleIndices.end();
+			++iter)
+		{
+			int i = iter->first;
+			int j = iter->second;
+			int touchEmpty = (map.at<char>(i+1, j) == 0?1:0) +
+				(map.at<char>(i-1, j) == 0?1:0) +
+				(map.at<char>(i, j+1) == 0?1:0) +
+				(map.at<char>(i, j-1) == 0?1:0);
+			if(touchEmpty>=3 && map.at<char>(i+1, j) != -1 &&
+				map.at<char>(i-1, j) != -1 &&
+				map.at<char>(i, j+1) != -1 &&
+				map.at<char>(i, j-1) != -1)
+			{
+				erodedMap.at<char>(i, j) = 0; // empty
+			}
+		}
+		map = erodedMap;
+	}
+	return map;
+}
+
 /**
  * Create 2d Occupancy grid (CV_8S) from 2d occupancy
  * -1 = unknown
@@ -284,94 +386,7 @@ cv::Mat create2DMapFromOccupancyLocalMaps(
 				//UDEBUG("empty=%d occupied=%d", empty, occupied);
 			}
 
-			// fill holes and remove empty from obstacle borders
-			cv::Mat updatedMap = map.clone();
-			std::list<std::pair<int, int> > obstacleIndices;
-			for(int i=2; i<map.rows-2; ++i)
-			{
-				for(int j=2; j<map.cols-2; ++j)
-				{
-					if(map.at<char>(i, j) == -1 &&
-						map.at<char>(i+1, j) != -1 &&
-						map.at<char>(i-1, j) != -1 &&
-						map.at<char>(i, j+1) != -1 &&
-						map.at<char>(i, j-1) != -1)
-					{
-						updatedMap.at<char>(i, j) = 0;
-					}
-					else if(map.at<char>(i, j) == 100)
-					{
-						// obstacle/empty/unknown -> remove empty
-						// unknown/empty/obstacle -> remove empty
-						if(map.at<char>(i-1, j) == 0 &&
-							map.at<char>(i-2, j) == -1)
-						{
-							updatedMap.at<char>(i-1, j) = -1;
-						}
-						else if(map.at<char>(i+1, j) == 0 &&
-								map.at<char>(i+2, j) == -1)
-						{
-							updatedMap.at<char>(i+1, j) = -1;
-						}
-						if(map.at<char>(i, j-1) == 0 &&
-							map.at<char>(i, j-2) == -1)
-						{
-							updatedMap.at<char>(i, j-1) = -1;
-						}
-						else if(map.at<char>(i, j+1) == 0 &&
-								map.at<char>(i, j+2) == -1)
-						{
-							updatedMap.at<char>(i, j+1) = -1;
-						}
-
-						if(erode)
-						{
-							obstacleIndices.push_back(std::make_pair(i, j));
-						}
-					}
-					else if(map.at<char>(i, j) == 0)
-					{
-						// obstacle/empty/obstacle -> remove empty
-						if(map.at<char>(i-1, j) == 100 &&
-							map.at<char>(i+1, j) == 100)
-						{
-							updatedMap.at<char>(i, j) = -1;
-						}
-						else if(map.at<char>(i, j-1) == 100 &&
-							map.at<char>(i, j+1) == 100)
-						{
-							updatedMap.at<char>(i, j) = -1;
-						}
-					}
-
-				}
-			}
-			map = updatedMap;
-
-			if(erode)
-			{
-				// remove obstacles which touch at least 3 empty cells but not unknown cells
-				cv::Mat erodedMap = map.clone();
-				for(std::list<std::pair<int,int> >::iterator iter = obstacleIndices.begin();
-					iter!= obstacleIndices.end();
-					++iter)
-				{
-					int i = iter->first;
-					int j = iter->second;
-					int touchEmpty = (map.at<char>(i+1, j) == 0?1:0) +
-						(map.at<char>(i-1, j) == 0?1:0) +
-						(map.at<char>(i, j+1) == 0?1:0) +
-						(map.at<char>(i, j-1) == 0?1:0);
-					if(touchEmpty>=3 && map.at<char>(i+1, j) != -1 &&
-						map.at<char>(i-1, j) != -1 &&
-						map.at<char>(i, j+1) != -1 &&
-						map.at<char>(i, j-1) != -1)
-					{
-						erodedMap.at<char>(i, j) = 0; // empty
-					}
-				}
-				map = erodedMap;
-			}
+			map = filter2DMap(map, erode);
 		}
 	}
 	UDEBUG("timer=%fs", timer.ticks());
@@ -238,13 +238,20 @@ void computeVarianceAndCorrespondences(
 		const pcl::PointCloud<pcl::PointNormal>::ConstPtr & cloudB,
 		double maxCorrespondenceDistance,
 		double & variance,
-		int & correspondencesOut)
+		int & correspondencesOut,
+		const pcl::search::KdTree<pcl::PointNormal>::Ptr & treeB)
 {
 	variance = 1;
 	correspondencesOut = 0;
 	pcl::registration::CorrespondenceEstimation<pcl::PointNormal, pcl::PointNormal>::Ptr est;
 	est.reset(new pcl::registration::CorrespondenceEstimation<pcl::PointNormal, pcl::PointNormal>);
 	est->setInputTarget(cloudB);
+#if PCL_VERSION_COMPARE(>=, 1, 7, 2)
+	if(treeB.get())
+	{
+		est->setSearchMethodTarget(treeB, true);
+	}
+#endif
 	est->setInputSource(cloudA);
 	pcl::Correspondences correspondences;
 	est->determineCorrespondences(correspondences, maxCorrespondenceDistance);
@@ -271,13 +278,20 @@ void computeVarianceAndCorrespondences(
 		const pcl::PointCloud<pcl::PointXYZ>::ConstPtr & cloudB,
 		double maxCorrespondenceDistance,
 		double & variance,
-		int & correspondencesOut)
+		int & correspondencesOut,
+		const pcl::search::KdTree<pcl::PointXYZ>::Ptr & treeB)
 {
 	variance = 1;
 	correspondencesOut = 0;
 	pcl::registration::CorrespondenceEstimation<pcl::PointXYZ, pcl::PointXYZ>::Ptr est;
 	est.reset(new pcl::registration::CorrespondenceEstimation<pcl::PointXYZ, pcl::PointXYZ>);
 	est->setInputTarget(cloudB);
+#if PCL_VERSION_COMPARE(>=, 1, 7, 2)
+	if(treeB.get())
+	{
+		est->setSearchMethodTarget(treeB, true);
+	}
+#endif
 	est->setInputSource(cloudA);
 	pcl::Correspondences correspondences;
 	est->determineCorrespondences(correspondences, maxCorrespondenceDistance);
@@ -307,12 +321,19 @@ Transform icp(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr & cloud_source,
 			  bool & hasConverged,
 			  pcl::PointCloud<pcl::PointXYZ> & cloud_source_registered,
 			  float epsilon,
-			  bool icp2D)
+			  bool icp2D,
+			  const pcl::search::KdTree<pcl::PointXYZ>::Ptr & treeTarget)
 {
 	pcl::IterativeClosestPoint<pcl::PointXYZ, pcl::PointXYZ> icp;
 	// Set the input source and target
 	icp.setInputTarget (cloud_target);
 	icp.setInputSource (cloud_source);
+#if PCL_VERSION_COMPARE(>=, 1, 7, 2)
+	if(treeTarget.get())
+	{
+		icp.setSearchMethodTarget(treeTarget, true);
+	}
+#endif
 
 	if(icp2D)
 	{
@@ -346,12 +367,19 @@ Transform icpPointToPlane(
 		bool & hasConverged,
 		pcl::PointCloud<pcl::PointNormal> & cloud_source_registered,
 		float epsilon,
-		bool icp2D)
+		bool icp2D,
+		const pcl::search::KdTree<pcl::PointNormal>::Ptr & treeTarget)
 {
 	pcl::IterativeClosestPoint<pcl::PointNormal, pcl::PointNormal> icp;
 	// Set the input source and target
 	icp.setInputTarget (cloud_target);
 	icp.setInputSource (cloud_source);
+#if PCL_VERSION_COMPARE(>=, 1, 7, 2)
+	if(treeTarget.get())
+	{
+		icp.setSearchMethodTarget(treeTarget, true);
+	}
+#endif
 
 	if(icp2D)
 	{
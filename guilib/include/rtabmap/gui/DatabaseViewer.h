@@ -77,6 +77,7 @@ private slots:
 	void writeSettings();
 	void configModified();
 	void openDatabase();
+	void openStatisticsLog();
 	void generateGraph();
 	void exportDatabase();
 	void extractImages();
@@ -37,6 +37,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/SensorData.h"
 #include "rtabmap/core/OdometryEvent.h"
 #include "rtabmap/core/CameraInfo.h"
+#include "rtabmap/core/OccupancyGridAssembler.h"
+#include "rtabmap/core/StatisticsAccumulator.h"
 #include "rtabmap/gui/PreferencesDialog.h"
 
 #include <pcl/point_cloud.h>
@@ -281,6 +283,7 @@ private:
 	std::map<int, Transform> _currentPosesMap; // <nodeId, pose>
 	std::map<int, Transform> _currentGTPosesMap; // <nodeId, pose>
 	std::multimap<int, Link> _currentLinksMap; // <nodeFromId, link>
+	StatisticsAccumulator _statsAccumulator;
 	std::map<int, int> _currentMapIds;   // <nodeId, mapId>
 	std::map<int, std::string> _currentLabels; // <nodeId, label>
 	std::map<int, std::pair<pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr, pcl::IndicesPtr> > _createdClouds;
@@ -289,6 +292,8 @@ private:
 	std::map<int, cv::Mat> _createdScans;
 	std::map<int, std::pair<cv::Mat, cv::Mat> > _projectionLocalMaps; // <ground, obstacles>
 	std::map<int, std::pair<cv::Mat, cv::Mat> > _gridLocalMaps; // <ground, obstacles>
+	OccupancyGridAssembler _occupancyGrid; // assembled from _gridLocalMaps or _projectionLocalMaps
+	bool _occupancyGridFrom3DCloud;
 
 	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr> _createdFeatures;
 
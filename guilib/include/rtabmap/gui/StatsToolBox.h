@@ -52,6 +52,8 @@ public:
 	void addValue(float x, float y);
 	void setValues(const std::vector<float> & x, const std::vector<float> & y);
 	QString value() const;
+	const std::vector<float> & x() const {return _x;}
+	const std::vector<float> & y() const {return _y;}
 
 public slots:
 	void updateMenu(const QMenu * menu);
@@ -74,6 +76,8 @@ private:
 	QLabel * _value;
 	QLabel * _unit;
 	QMenu * _menu;
+	std::vector<float> _x; // last values set, to initialize new curves
+	std::vector<float> _y;
 };
 
 
@@ -66,6 +66,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/RegistrationIcp.h"
 #include "rtabmap/gui/DataRecorder.h"
 #include "rtabmap/core/SensorData.h"
+#include "rtabmap/core/StatisticsLog.h"
 #include "ExportDialog.h"
 #include "rtabmap/gui/ProgressDialog.h"
 #include "ParametersToolBox.h"
@@ -112,6 +113,7 @@ DatabaseViewer::DatabaseViewer(const QString & ini, QWidget * parent) :
 	ui_->dockWidget_info->setVisible(false);
 	ui_->dockWidget_stereoView->setVisible(false);
 	ui_->dockWidget_view3d->setVisible(false);
+	ui_->dockWidget_statistics->setVisible(false);
 
 	ui_->constraintsViewer->setCameraLockZ(false);
 	ui_->constraintsViewer->setCameraFree();
@@ -142,6 +144,7 @@ DatabaseViewer::DatabaseViewer(const QString & ini, QWidget * parent) :
 	ui_->menuView->addAction(ui_->dockWidget_guiparameters->toggleViewAction());
 	ui_->menuView->addAction(ui_->dockWidget_coreparameters->toggleViewAction());
 	ui_->menuView->addAction(ui_->dockWidget_info->toggleViewAction());
+	ui_->menuView->addAction(ui_->dockWidget_statistics->toggleViewAction());
 	connect(ui_->dockWidget_graphView->toggleViewAction(), SIGNAL(triggered()), this, SLOT(updateGraphView()));
 
 	connect(ui_->parameters_toolbox, SIGNAL(parametersChanged(const QStringList &)), this, SLOT(notifyParametersChanged(const QStringList &)));
@@ -152,6 +155,7 @@ DatabaseViewer::DatabaseViewer(const QString & ini, QWidget * parent) :
 	ui_->actionSave_config->setShortcut(QKeySequence::Save);
 	connect(ui_->actionSave_config, SIGNAL(triggered()), this, SLOT(writeSettings()));
 	connect(ui_->actionOpen_database, SIGNAL(triggered()), this, SLOT(openDatabase()));
+	connect(ui_->actionOpen_statistics_log, SIGNAL(triggered()), this, SLOT(openStatisticsLog()));
 	connect(ui_->actionExport, SIGNAL(triggered()), this, SLOT(exportDatabase()));
 	connect(ui_->actionExtract_images, SIGNAL(triggered()), this, SLOT(extractImages()));
 	connect(ui_->actionGenerate_graph_dot, SIGNAL(triggered()), this, SLOT(generateGraph()));
@@ -296,6 +300,7 @@ DatabaseViewer::DatabaseViewer(const QString & ini, QWidget * parent) :
 	ui_->dockWidget_guiparameters->installEventFilter(this);
 	ui_->dockWidget_coreparameters->installEventFilter(this);
 	ui_->dockWidget_info->installEventFilter(this);
+	ui_->dockWidget_statistics->installEventFilter(this);
 }
 
 DatabaseViewer::~DatabaseViewer()
@@ -524,6 +529,37 @@ void DatabaseViewer::openDatabase()
 	}
 }
 
+void DatabaseViewer::openStatisticsLog()
+{
+	QString path = QFileDialog::getOpenFileName(this, tr("Select file"), pathDatabase_, tr("Statistics log (*.bin)"));
+	if(!path.isEmpty())
+	{
+		UTimer timer;
+		StatisticsLogReader reader;
+		if(reader.open(path.toStdString()))
+		{
+			// Curves are decimated (min/max per bucket), plotting millions of
+			// samples would create as many items in the figures
+			std::vector<float> x, y;
+			for(unsigned int i=0; i<reader.columns().size(); ++i)
+			{
+				reader.column(i, x, y, 4000);
+				if(y.size())
+				{
+					ui_->statsToolBox->updateStat(reader.columns()[i].c_str(), x, y);
+				}
+			}
+			ui_->dockWidget_statistics->setVisible(true);
+			UINFO("Loaded %d frames of %d statistics from \"%s\" (%fs)",
+					(int)reader.rows(), (int)reader.columns().size(), path.toStdString().c_str(), timer.ticks());
+		}
+		else
+		{
+			QMessageBox::warning(this, tr("Open statistics log"), tr("Failed to open \"%1\" (see the log for details).").arg(path));
+		}
+	}
+}
+
 bool DatabaseViewer::openDatabase(const QString & path)
 {
 	UDEBUG("Open database \"%s\"", path.toStdString().c_str());
@@ -143,6 +143,7 @@ MainWindow::MainWindow(PreferencesDialog * prefDialog, QWidget * parent) :
 	_odomImageDepthShow(false),
 	_savedMaximized(false),
 	_waypointsIndex(0),
+	_occupancyGridFrom3DCloud(false),
 	_odometryCorrection(Transform::getIdentity()),
 	_processingOdometry(false),
 	_oneSecondTimer(0),
@@ -1463,14 +1464,29 @@ void MainWindow::processStats(const rtabmap::Statistics & stat)
 		//======================
 		UTimer timerVis;
 
+		// reconstruct the full graph if only the changes are published (Rtabmap/PublishStatsDelta),
+		// full statistics are used directly. Once a delta has been received, keyframes
+		// are also fed to the accumulator as the next deltas are based on them.
+		bool useAccumulator = stat.isDelta() ||
+				_statsAccumulator.lastPublicationId() > 0 ||
+				_statsAccumulator.deltasMissed() > 0;
+		if(useAccumulator)
+		{
+			_statsAccumulator.update(stat);
+		}
+		bool graphValid = !useAccumulator || _statsAccumulator.isValid();
+		const std::map<int, Transform> & statPoses = useAccumulator?_statsAccumulator.poses():stat.poses();
+		const std::multimap<int, Link> & statConstraints = useAccumulator?_statsAccumulator.constraints():stat.constraints();
+		const std::map<int, Signature> & statSignatures = useAccumulator?_statsAccumulator.signatures():stat.getSignatures();
+
 		// update clouds
-		if(stat.poses().size())
+		if(graphValid && statPoses.size())
 		{
 			// update pose only if odometry is not received
 			std::map<int, int> mapIds;
 			std::map<int, Transform> groundTruth;
 			std::map<int, std::string> labels;
-			for(std::map<int, Signature>::const_iterator iter=stat.getSignatures().begin(); iter!=stat.getSignatures().end();++iter)
+			for(std::map<int, Signature>::const_iterator iter=statSignatures.begin(); iter!=statSignatures.end();++iter)
 			{
 				mapIds.insert(std::make_pair(iter->first, iter->second.mapId()));
 				if(!iter->second.getGroundTruthPose().isNull())
@@ -1483,14 +1499,14 @@ void MainWindow::processStats(const rtabmap::Statistics & stat)
 				}
 			}
 
-			std::map<int, Transform> poses = stat.poses();
+			std::map<int, Transform> poses = statPoses;
 			Transform groundTruthOffset = alignPosesToGroundTruth(poses, groundTruth);
 			UDEBUG("time= %d ms", time.restart());
 
 			updateMapCloud(
 					poses,
 					_odometryReceived||poses.size()==0?Transform():poses.rbegin()->second,
-					stat.constraints(),
+					statConstraints,
 					mapIds,
 					labels,
 					groundTruth);
@@ -1647,7 +1663,7 @@ void MainWindow::processStats(const rtabmap::Statistics & stat)
 			// update current goal id
 			if(stat.currentGoalId() > 0)
 			{
-				_ui->graphicsView_graphView->setCurrentGoalID(stat.currentGoalId(), uValue(stat.poses(), stat.currentGoalId(), Transform()));
+				_ui->graphicsView_graphView->setCurrentGoalID(stat.currentGoalId(), uValue(statPoses, stat.currentGoalId(), Transform()));
 			}
 		}
 
@@ -2016,13 +2032,17 @@ void MainWindow::updateMapCloud(
 	{
 		float xMin, yMin;
 		float resolution = _preferencesDialog->getGridMapResolution();
-		cv::Mat map8S = util3d::create2DMapFromOccupancyLocalMaps(
+		if(_occupancyGridFrom3DCloud != _preferencesDialog->isGridMapFrom3DCloud())
+		{
+			_occupancyGrid.clear();
+			_occupancyGridFrom3DCloud = _preferencesDialog->isGridMapFrom3DCloud();
+		}
+		// only new nodes and nodes moved by the last optimization are projected
+		_occupancyGrid.setCellSize(resolution);
+		_occupancyGrid.update(
 					poses,
-					_preferencesDialog->isGridMapFrom3DCloud()?_projectionLocalMaps:_gridLocalMaps,
-					resolution,
-					xMin, yMin,
-					0,
-					_preferencesDialog->isGridMapEroded());
+					_preferencesDialog->isGridMapFrom3DCloud()?_projectionLocalMaps:_gridLocalMaps);
+		cv::Mat map8S = _occupancyGrid.getMap(xMin, yMin, _preferencesDialog->isGridMapEroded());
 		if(!map8S.empty())
 		{
 			//convert to gray scaled map
@@ -4597,6 +4617,7 @@ void MainWindow::clearTheCache()
 	_createdScans.clear();
 	_gridLocalMaps.clear();
 	_projectionLocalMaps.clear();
+	_occupancyGrid.clear();
 	_createdFeatures.clear();
 	_ui->widget_cloudViewer->clear();
 	_ui->widget_cloudViewer->setBackgroundColor(_ui->widget_cloudViewer->getDefaultBackgroundColor());
@@ -4605,6 +4626,7 @@ void MainWindow::clearTheCache()
 	_currentPosesMap.clear();
 	_currentGTPosesMap.clear();
 	_currentLinksMap.clear();
+	_statsAccumulator.clear();
 	_currentMapIds.clear();
 	_currentLabels.clear();
 	_odometryCorrection = Transform::getIdentity();
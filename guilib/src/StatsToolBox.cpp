@@ -61,6 +61,8 @@ StatItem::StatItem(const QString & name, const std::vector<float> & x, const std
 	else if(y.size() > 1)
 	{
 		_value->setText("*");
+		_x = x;
+		_y = y;
 	}
 	_unit->setText(unit);
 	this->updateMenu(menu);
@@ -86,6 +88,8 @@ void StatItem::addValue(float x, float y)
 void StatItem::setValues(const std::vector<float> & x, const std::vector<float> & y)
 {
 	_value->setText("*");
+	_x = x;
+	_y = y;
 	emit valuesChanged(x,y);
 }
 
@@ -331,6 +335,10 @@ void StatsToolBox::plot(const StatItem * stat, const QString & plotName)
 			{
 				ULOGGER_WARN("Already added to the figure");
 			}
+			else if(stat->value().compare("*") == 0)
+			{
+				curve->setData(stat->x(), stat->y());
+			}
 			emit figuresSetupChanged();
 		}
 		else
@@ -381,6 +389,10 @@ void StatsToolBox::plot(const StatItem * stat, const QString & plotName)
 			ULOGGER_ERROR("Not supposed to be here !?!");
 			delete curve;
 		}
+		else if(stat->value().compare("*") == 0)
+		{
+			curve->setData(stat->x(), stat->y());
+		}
 		figure->show();
 		emit figuresSetupChanged();
 
@@ -0,0 +1,374 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <rtabmap/core/Rtabmap.h>
+#include <rtabmap/core/DBReader.h>
+#include <rtabmap/core/Odometry.h>
+#include <rtabmap/core/OdometryInfo.h>
+#include <rtabmap/core/Parameters.h>
+#include <rtabmap/core/util3d_registration.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UMath.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/utilite/UProcessInfo.h>
+#include <opencv2/core/core.hpp>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "BenchmarkUtil.h"
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("\nUsage:\n"
+			"rtabmap-benchmark [options] \"database.db\"\n"
+			"  Replays the database(s) through odometry and RTAB-Map, frame by frame\n"
+			"  without real-time constraints, then reports timing percentiles per stage,\n"
+			"  memory high-water mark, output database size and accuracy against the\n"
+			"  ground truth saved in the database (if any).\n"
+			"  Multiple databases can be replayed in a row with \"first.db;second.db\".\n"
+			"Options:\n"
+			"  -o \"results.json\"       Write results in JSON (default \"benchmark.json\").\n"
+			"  -output \"path.db\"       Output database (default \"benchmark.db\", overwritten).\n"
+			"  -db_odom                Use odometry poses saved in the database instead of\n"
+			"                          computing odometry.\n"
+			"  -start #                Skip the first # frames.\n"
+			"  -frames #               Process at most # frames.\n"
+			"%s\n"
+			"  Rtabmap/TimeThr and Rtabmap/MemoryThr are set to 0 by default so that results\n"
+			"  don't depend on the speed of the computer.\n",
+			Parameters::showUsage());
+	exit(1);
+}
+
+struct Accuracy
+{
+	Accuracy() : poses(0), ate(0), rpeTranslation(0), rpeRotation(0) {}
+	int poses;
+	float ate;            // RMSE of the absolute trajectory error (m), after rigid alignment
+	float rpeTranslation; // RMSE of the relative pose error between consecutive nodes (m)
+	float rpeRotation;    // RMSE of the relative pose error between consecutive nodes (deg)
+};
+
+Accuracy computeAccuracy(const std::map<int, Transform> & poses, const std::map<int, Transform> & groundTruth)
+{
+	Accuracy accuracy;
+	std::vector<Transform> estimated;
+	std::vector<Transform> expected;
+	pcl::PointCloud<pcl::PointXYZ> cloud1, cloud2;
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		std::map<int, Transform>::const_iterator jter = groundTruth.find(iter->first);
+		if(!iter->second.isNull() && jter!=groundTruth.end() && !jter->second.isNull())
+		{
+			estimated.push_back(iter->second);
+			expected.push_back(jter->second);
+			cloud1.push_back(pcl::PointXYZ(jter->second.x(), jter->second.y(), jter->second.z()));
+			cloud2.push_back(pcl::PointXYZ(iter->second.x(), iter->second.y(), iter->second.z()));
+		}
+	}
+	accuracy.poses = (int)estimated.size();
+	if(estimated.size() < 3)
+	{
+		return accuracy;
+	}
+
+	// Align the ground truth on the estimated poses
+	Transform t = util3d::transformFromXYZCorrespondencesSVD(cloud1, cloud2);
+	double sum = 0.0;
+	for(unsigned int i=0; i<estimated.size(); ++i)
+	{
+		sum += (t * expected[i]).getDistanceSquared(estimated[i]);
+	}
+	accuracy.ate = sqrt(sum/double(estimated.size()));
+
+	double sumTranslation = 0.0;
+	double sumRotation = 0.0;
+	for(unsigned int i=1; i<estimated.size(); ++i)
+	{
+		Transform error = (expected[i-1].inverse() * expected[i]).inverse() * (estimated[i-1].inverse() * estimated[i]);
+		float angle = Eigen::AngleAxisf(error.toEigen3f().rotation()).angle() * 180.0f / M_PI;
+		sumTranslation += error.getNormSquared();
+		sumRotation += angle*angle;
+	}
+	accuracy.rpeTranslation = sqrt(sumTranslation/double(estimated.size()-1));
+	accuracy.rpeRotation = sqrt(sumRotation/double(estimated.size()-1));
+	return accuracy;
+}
+
+void writeAccuracy(FILE * file, const char * name, const Accuracy & accuracy, bool last)
+{
+	fprintf(file, "    %s: {\"poses\": %d, \"ate_rmse_m\": %f, \"rpe_translation_rmse_m\": %f, \"rpe_rotation_rmse_deg\": %f}%s\n",
+			jsonString(name).c_str(), accuracy.poses, accuracy.ate, accuracy.rpeTranslation, accuracy.rpeRotation, last?"":",");
+}
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	ParametersMap parameters;
+	parameters.insert(ParametersPair(Parameters::kRtabmapWorkingDirectory(), "."));
+	parameters.insert(ParametersPair(Parameters::kRtabmapTimeThr(), "0"));
+	parameters.insert(ParametersPair(Parameters::kRtabmapMemoryThr(), "0"));
+	uInsert(parameters, Parameters::parseArguments(argc, argv));
+
+	if(argc < 2)
+	{
+		showUsage();
+	}
+
+	std::string path;
+	std::string outputJson = "benchmark.json";
+	std::string outputDb = "benchmark.db";
+	bool databaseOdometry = false;
+	int start = 0;
+	int maxFrames = 0;
+	for(int i=1; i<argc; ++i)
+	{
+		if(i == argc-1)
+		{
+			// The last must be the path
+			path = argv[i];
+			break;
+		}
+		if(strcmp(argv[i], "-o") == 0 && i+1<argc-1)
+		{
+			outputJson = argv[++i];
+		}
+		else if(strcmp(argv[i], "-output") == 0 && i+1<argc-1)
+		{
+			outputDb = argv[++i];
+		}
+		else if(strcmp(argv[i], "-db_odom") == 0)
+		{
+			databaseOdometry = true;
+		}
+		else if(strcmp(argv[i], "-start") == 0 && i+1<argc-1)
+		{
+			start = uStr2Int(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-frames") == 0 && i+1<argc-1)
+		{
+			maxFrames = uStr2Int(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+		{
+			showUsage();
+		}
+	}
+
+	std::list<std::string> inputs = uSplit(path, ';');
+	for(std::list<std::string>::iterator iter=inputs.begin(); iter!=inputs.end(); ++iter)
+	{
+		if(!UFile::exists(*iter))
+		{
+			printf("Database \"%s\" doesn't exist!\n", iter->c_str());
+			showUsage();
+		}
+	}
+	if(inputs.empty())
+	{
+		showUsage();
+	}
+
+	// Same random sequence on each run (RANSAC)
+	cv::theRNG().state = 0xffffffff;
+
+	// Frame rate 0: frames are read as fast as they are processed, none is skipped
+	DBReader reader(inputs, 0.0f, !databaseOdometry);
+	if(!reader.init(start))
+	{
+		printf("Failed to initialize the database reader!\n");
+		return 1;
+	}
+
+	Odometry * odometry = databaseOdometry?0:Odometry::create(parameters);
+
+	if(UFile::exists(outputDb))
+	{
+		UFile::erase(outputDb);
+	}
+	Rtabmap rtabmap;
+	rtabmap.init(parameters, outputDb);
+
+	printf("Benchmark: %s, odometry %s\n", path.c_str(), databaseOdometry?"from the database":"computed");
+
+	std::map<std::string, std::vector<float> > timings; // ms
+	long memoryPeak = UProcessInfo::getMemoryUsage();
+	int frames = 0;
+	int processed = 0;
+	int odometryLost = 0;
+	UTimer totalTimer;
+	UTimer timer;
+	OdometryEvent odomEvent = reader.getNextData();
+	timings["Benchmark/Read/ms"].push_back(timer.ticks()*1000.0f);
+	while(odomEvent.data().id() && (maxFrames <= 0 || frames < maxFrames))
+	{
+		SensorData & data = odomEvent.data();
+		Transform pose = odomEvent.pose();
+		cv::Mat covariance = odomEvent.covariance();
+		if(odometry)
+		{
+			OdometryInfo info;
+			timer.ticks();
+			pose = odometry->process(data, &info);
+			timings["Odometry/Total/ms"].push_back(timer.ticks()*1000.0f);
+			if(pose.isNull())
+			{
+				++odometryLost;
+			}
+			else
+			{
+				double variance = info.variance>0?info.variance:1;
+				covariance = cv::Mat::eye(6,6,CV_64FC1)*variance;
+			}
+		}
+
+		if(!pose.isNull())
+		{
+			timer.ticks();
+			if(rtabmap.process(data, pose, covariance))
+			{
+				timings["Rtabmap/Total/ms"].push_back(timer.ticks()*1000.0f);
+				++processed;
+
+				const Statistics & stats = rtabmap.getStatistics();
+				for(std::map<std::string, float>::const_iterator iter=stats.data().begin(); iter!=stats.data().end(); ++iter)
+				{
+					if(iter->first.size() > 3 && iter->first.compare(iter->first.size()-3, 3, "/ms") == 0)
+					{
+						timings[iter->first].push_back(iter->second);
+					}
+				}
+			}
+		}
+
+		long memory = UProcessInfo::getMemoryUsage();
+		if(memory > memoryPeak)
+		{
+			memoryPeak = memory;
+		}
+
+		++frames;
+		if(frames % 100 == 0)
+		{
+			printf("Processed %d frames (%.1f s)...\n", frames, totalTimer.elapsed());
+		}
+
+		timer.ticks();
+		odomEvent = reader.getNextData();
+		timings["Benchmark/Read/ms"].push_back(timer.ticks()*1000.0f);
+	}
+	double totalTime = totalTimer.elapsed();
+
+	// Final graphs
+	std::map<int, Transform> poses;
+	std::multimap<int, Link> constraints;
+	std::map<int, Signature> signatures;
+	rtabmap.getGraph(poses, constraints, true, true, &signatures);
+	std::map<int, Transform> odometryPoses;
+	std::map<int, Transform> groundTruth;
+	for(std::map<int, Signature>::iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
+	{
+		odometryPoses.insert(std::make_pair(iter->first, iter->second.getPose()));
+		if(!iter->second.getGroundTruthPose().isNull())
+		{
+			groundTruth.insert(std::make_pair(iter->first, iter->second.getGroundTruthPose()));
+		}
+	}
+	Accuracy odometryAccuracy = computeAccuracy(odometryPoses, groundTruth);
+	Accuracy mapAccuracy = computeAccuracy(poses, groundTruth);
+
+	rtabmap.close(true);
+	delete odometry;
+	long databaseSize = UFile::length(outputDb);
+
+	printf("\n%d frames (%d processed, %d odometry lost) in %.2f s, %d nodes in the map\n",
+			frames, processed, odometryLost, totalTime, (int)poses.size());
+	printf("Memory peak: %.1f MB, database: %.1f MB\n", double(memoryPeak)/1048576.0, double(databaseSize)/1048576.0);
+	if(groundTruth.size())
+	{
+		printf("Odometry: ATE=%.3f m RPE=%.3f m %.2f deg\n", odometryAccuracy.ate, odometryAccuracy.rpeTranslation, odometryAccuracy.rpeRotation);
+		printf("Map:      ATE=%.3f m RPE=%.3f m %.2f deg\n", mapAccuracy.ate, mapAccuracy.rpeTranslation, mapAccuracy.rpeRotation);
+	}
+	printf("%-40s %10s %10s %10s %10s %10s\n", "stage (ms)", "mean", "p50", "p90", "p99", "max");
+
+	FILE * file = 0;
+#ifdef _MSC_VER
+	fopen_s(&file, outputJson.c_str(), "w");
+#else
+	file = fopen(outputJson.c_str(), "w");
+#endif
+	if(!file)
+	{
+		printf("Cannot write \"%s\"!\n", outputJson.c_str());
+		return 1;
+	}
+	fprintf(file, "{\n");
+	fprintf(file, "  \"version\": %s,\n", jsonString(Parameters::getVersion()).c_str());
+	fprintf(file, "  \"input\": %s,\n", jsonString(path).c_str());
+	fprintf(file, "  \"odometry\": %s,\n", databaseOdometry?"\"database\"":"\"computed\"");
+	fprintf(file, "  \"parameters\": {");
+	for(ParametersMap::iterator iter=parameters.begin(); iter!=parameters.end(); ++iter)
+	{
+		fprintf(file, "%s\n    %s: %s", iter==parameters.begin()?"":",", jsonString(iter->first).c_str(), jsonString(iter->second).c_str());
+	}
+	fprintf(file, "\n  },\n");
+	fprintf(file, "  \"frames\": %d,\n", frames);
+	fprintf(file, "  \"processed\": %d,\n", processed);
+	fprintf(file, "  \"odometry_lost\": %d,\n", odometryLost);
+	fprintf(file, "  \"nodes\": %d,\n", (int)poses.size());
+	fprintf(file, "  \"total_time_s\": %f,\n", totalTime);
+	fprintf(file, "  \"memory_peak_bytes\": %ld,\n", memoryPeak);
+	fprintf(file, "  \"database_size_bytes\": %ld,\n", databaseSize);
+	fprintf(file, "  \"timing_ms\": {");
+	for(std::map<std::string, std::vector<float> >::iterator iter=timings.begin(); iter!=timings.end(); ++iter)
+	{
+		Percentiles p = percentiles(iter->second);
+		printf("%-40s %10.2f %10.2f %10.2f %10.2f %10.2f\n", iter->first.c_str(), p.mean, p.p50, p.p90, p.p99, p.max);
+		fprintf(file, "%s\n    %s: {\"count\": %d, \"mean\": %f, \"p50\": %f, \"p90\": %f, \"p99\": %f, \"max\": %f}",
+				iter==timings.begin()?"":",", jsonString(iter->first).c_str(), (int)iter->second.size(), p.mean, p.p50, p.p90, p.p99, p.max);
+	}
+	fprintf(file, "\n  },\n");
+	fprintf(file, "  \"accuracy\": {\n");
+	writeAccuracy(file, "odometry", odometryAccuracy, false);
+	writeAccuracy(file, "map", mapAccuracy, true);
+	fprintf(file, "  }\n");
+	fprintf(file, "}\n");
+	fclose(file);
+	printf("Results saved to \"%s\"\n", outputJson.c_str());
+
+	return 0;
+}
@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef BENCHMARKUTIL_H_
+#define BENCHMARKUTIL_H_
+
+// Helpers shared by the benchmark tools (rtabmap-benchmark and rtabmap-kernelBenchmark)
+
+#include <rtabmap/utilite/UMath.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Quoted JSON string
+inline std::string jsonString(const std::string & str)
+{
+	std::string out = "\"";
+	for(unsigned int i=0; i<str.size(); ++i)
+	{
+		if(str[i] == '"' || str[i] == '\\')
+		{
+			out += '\\';
+		}
+		out += str[i];
+	}
+	return out + "\"";
+}
+
+// Value at ratio p (0=min, 0.5=median, 1=max) of values sorted in increasing order
+template<class T>
+inline double sortedPercentile(const std::vector<T> & sorted, double p)
+{
+	if(sorted.empty())
+	{
+		return 0.0;
+	}
+	return sorted[std::min((size_t)(p*double(sorted.size())), sorted.size()-1)];
+}
+
+template<class T>
+inline double percentile(std::vector<T> values, double p)
+{
+	std::sort(values.begin(), values.end());
+	return sortedPercentile(values, p);
+}
+
+struct Percentiles
+{
+	double mean;
+	double min;
+	double p50;
+	double p90;
+	double p99;
+	double max;
+};
+
+template<class T>
+inline Percentiles percentiles(std::vector<T> values)
+{
+	Percentiles p = {0,0,0,0,0,0};
+	if(values.size())
+	{
+		std::sort(values.begin(), values.end());
+		p.mean = uMean(values);
+		p.min = values.front();
+		p.p50 = sortedPercentile(values, 0.5);
+		p.p90 = sortedPercentile(values, 0.9);
+		p.p99 = sortedPercentile(values, 0.99);
+		p.max = values.back();
+	}
+	return p;
+}
+
+#endif /* BENCHMARKUTIL_H_ */
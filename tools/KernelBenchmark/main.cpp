@@ -0,0 +1,2027 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <rtabmap/core/util2d.h>
+#include <rtabmap/core/Features2d.h>
+#include <rtabmap/core/Stereo.h>
+#include <rtabmap/core/SensorData.h>
+#include <rtabmap/core/ImagePyramidCache.h>
+#include <rtabmap/core/util3d.h>
+#include <rtabmap/core/util3d_mapping.h>
+#include <rtabmap/core/util3d_transforms.h>
+#include <rtabmap/core/OccupancyGridAssembler.h>
+#include <rtabmap/core/LogOddsGrid.h>
+#include <rtabmap/core/VoxelOccupancyMap.h>
+#include <rtabmap/core/Optimizer.h>
+#include <rtabmap/core/PoseSpatialIndex.h>
+#include <rtabmap/core/Graph.h>
+#include <rtabmap/core/RegistrationIcp.h>
+#include <rtabmap/core/Rtabmap.h>
+#include <rtabmap/core/VWDictionary.h>
+#include <rtabmap/core/Signature.h>
+#include <rtabmap/core/EpipolarGeometry.h>
+#include <rtabmap/core/util3d_filtering.h>
+#include <rtabmap/core/Compression.h>
+#include <rtabmap/core/BayesFilter.h>
+#include <rtabmap/core/Memory.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/utilite/UMath.h>
+#include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UThread.h>
+#include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UEventsManager.h>
+#include <rtabmap/utilite/UEventsHandler.h>
+#include <rtabmap/utilite/UEvent.h>
+#include <rtabmap/utilite/UMutex.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+#include <pcl/common/io.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <set>
+#include <limits>
+#include <fstream>
+#include <algorithm>
+#include "BenchmarkUtil.h"
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("\nUsage:\n"
+			"rtabmap-kernelBenchmark [options] [kernel1 kernel2 ...]\n"
+			"  Benchmark corelib kernels on synthetic data. If no kernel is set, all are run.\n"
+			"  Kernels:\n"
+			"    stereo          util2d::calcStereoCorrespondences() and calcOpticalFlowPyrLKStereo()\n"
+			"    features        Feature2D::generateKeypoints() without and with Kp/GridRows/GridCols\n"
+			"    pyramid         Stereo + frame-to-frame optical flow without and with ImagePyramidCache\n"
+			"    cloud           util3d::cloudFromDepth() and cloudFromDepthRGB() (compared to util3d::projectDepthTo3D())\n"
+			"                    (the exit code is 1 if the points differ)\n"
+			"    depth           util2d::registerDepth(), fillDepthHoles() and fillRegisteredDepthHoles(), serial vs parallel versions\n"
+			"                    (the exit code is 1 if the results differ)\n"
+			"    grid            OccupancyGridAssembler vs util3d::create2DMapFromOccupancyLocalMaps()\n"
+			"    logodds         LogOddsGrid ray casting throughput (rays/s) vs util3d::occupancy2DFromLaserScan()\n"
+			"    voxel           VoxelOccupancyMap insert/query throughput, re-integration and memory\n"
+			"    graph           Optimizer::optimize() vs optimizeHierarchical() on a synthetic multi-session graph\n"
+			"    spatial         PoseSpatialIndex vs kd-tree based graph::findNearestNode()/getNodesInRadius()/radiusPosesFiltering()\n"
+			"    path            graph::computePath() (A*) vs computePathBidirectional() on growing graphs\n"
+			"    scanmatch       RegistrationIcp without and with Icp/Correlative: success rate vs initial error (up to 2 m / 30 deg)\n"
+			"    logger          ULogger synchronous vs asynchronous (blocking or dropping): messages/s, caller latency and Rtabmap::process() time at debug level\n"
+			"    events          UEventsManager asynchronous posting and delivery throughput (4 producers, 3 handlers), with per-producer FIFO check\n"
+			"                    (the exit code is 1 if events are lost or out of order)\n"
+			"    dictionary      VWDictionary::findNN() and addNewWords() (float/kd-tree, binary/LSH)\n"
+			"    signature       Signature::compareTo()\n"
+			"    pairs           EpipolarGeometry::findPairs()\n"
+			"    voxelize        util3d::voxelize()\n"
+			"    compression     compressImage2()/uncompressImage() and compressData2()/uncompressData()\n"
+			"    bayes           BayesFilter::computePosterior() (new filter and update of the same filter)\n"
+			"  Options:\n"
+			"    -r #            Repetitions per measure (default 10).\n"
+			"    -t #            Threads used for the parallel measure (default 0=all).\n"
+			"    -v              Verbose (debug log).\n"
+			"    -j \"file.json\"  Write the timings of the cloud, depth, path, dictionary, signature,\n"
+			"                    pairs, voxelize, compression and bayes kernels in JSON, one result per line.\n"
+			"    -c \"file.json\"  Compare these timings with the results of a previous run.\n"
+			"    -threshold #    Median time ratio over which a case is reported as\n"
+			"                    a regression when comparing (default 1.1, the exit code is 2).\n");
+	exit(1);
+}
+
+int g_repetitions = 10;
+int g_threads = 0;
+int g_failures = 0; // correctness checks failed, the exit code is non-zero
+
+// Timings saved with -j and compared with -c
+struct Result
+{
+	std::string kernel;
+	std::string parameters;
+	int items;
+	Percentiles times; // ms
+};
+std::vector<Result> g_results;
+
+/**
+ * Samples are the times (ms) of each repetition, items the number of elements
+ * processed per repetition (descriptors, points, nodes...).
+ */
+const Result & addResult(const std::string & kernel, const std::string & parameters, const std::vector<double> & samples, int items)
+{
+	UASSERT(samples.size());
+	Result result;
+	result.kernel = kernel;
+	result.parameters = parameters;
+	result.items = items;
+	result.times = percentiles(samples);
+	g_results.push_back(result);
+	return g_results.back();
+}
+
+void printResultsHeader(const char * name)
+{
+	printf("\n[%s] %d repetitions\n", name, g_repetitions);
+	printf("%-28s %-34s %10s %10s %10s %12s\n", "kernel", "parameters", "min(ms)", "median(ms)", "max(ms)", "items/s");
+}
+
+// Add the result and print it under printResultsHeader()
+void record(const std::string & kernel, const std::string & parameters, const std::vector<double> & samples, int items)
+{
+	const Result & result = addResult(kernel, parameters, samples, items);
+	printf("%-28s %-34s %10.3f %10.3f %10.3f %12.0f\n",
+			kernel.c_str(), parameters.c_str(), result.times.min, result.times.p50, result.times.max,
+			result.times.p50>0.0?double(items)*1000.0/result.times.p50:0.0);
+}
+
+void setThreads(int threads)
+{
+#ifdef _OPENMP
+	omp_set_num_threads(threads>0?threads:omp_get_num_procs());
+#endif
+}
+
+int threadsUsed()
+{
+#ifdef _OPENMP
+	return g_threads>0?g_threads:omp_get_num_procs();
+#else
+	return 1;
+#endif
+}
+
+// Textured left image and right image shifted by a constant disparity
+void createStereoPair(const cv::Size & size, int disparity, cv::Mat & left, cv::Mat & right)
+{
+	cv::RNG rng(42);
+	cv::Mat noise(size, CV_8UC1);
+	rng.fill(noise, cv::RNG::UNIFORM, 0, 256);
+	cv::GaussianBlur(noise, left, cv::Size(5,5), 1.5);
+	cv::Mat warp = (cv::Mat_<double>(2,3) << 1, 0, -disparity, 0, 1, 0);
+	cv::warpAffine(left, right, warp, size, cv::INTER_LINEAR, cv::BORDER_REFLECT);
+}
+
+void benchmarkStereo()
+{
+	printf("\n[stereo] %d repetitions, serial vs %d thread(s)\n", g_repetitions, threadsUsed());
+	printf("%-10s %-6s %-8s %12s %12s %8s %12s\n", "size", "kpts", "method", "serial(ms)", "parallel(ms)", "speedup", "maxDiff(px)");
+	cv::Size sizes[2] = {cv::Size(640,480), cv::Size(1280,720)};
+	int keypoints[3] = {500, 1000, 2000};
+	for(int s=0; s<2; ++s)
+	{
+		cv::Mat left, right;
+		createStereoPair(sizes[s], 20, left, right);
+		for(int k=0; k<3; ++k)
+		{
+			std::vector<cv::Point2f> corners;
+			cv::goodFeaturesToTrack(left, corners, keypoints[k], 0.001, 3);
+
+			for(int method=0; method<2; ++method)
+			{
+				std::vector<cv::Point2f> rightCorners[2];
+				std::vector<unsigned char> status[2];
+				double times[2] = {0.0, 0.0};
+				for(int p=0; p<2; ++p)
+				{
+					setThreads(p==0?1:g_threads);
+					UTimer timer;
+					for(int r=0; r<g_repetitions; ++r)
+					{
+						if(method == 0)
+						{
+							rightCorners[p] = util2d::calcStereoCorrespondences(left, right, corners, status[p]);
+						}
+						else
+						{
+							std::vector<float> err;
+							util2d::calcOpticalFlowPyrLKStereo(left, right, corners, rightCorners[p], status[p], err);
+						}
+					}
+					times[p] = timer.ticks()*1000.0/double(g_repetitions);
+				}
+
+				float maxDiff = 0.0f;
+				for(unsigned int i=0; i<corners.size(); ++i)
+				{
+					if(status[0][i] && status[1][i])
+					{
+						float diff = fabs(rightCorners[0][i].x - rightCorners[1][i].x);
+						if(diff > maxDiff)
+						{
+							maxDiff = diff;
+						}
+					}
+				}
+				printf("%-10s %-6d %-8s %12.2f %12.2f %8.2f %12.5f\n",
+						uFormat("%dx%d", sizes[s].width, sizes[s].height).c_str(),
+						(int)corners.size(),
+						method==0?"SSD":"LK",
+						times[0],
+						times[1],
+						times[1]>0.0?times[0]/times[1]:0.0,
+						maxDiff);
+			}
+		}
+	}
+	setThreads(g_threads);
+}
+
+// Strongly textured on the left third, weakly textured elsewhere
+cv::Mat createUnevenlyTexturedImage(const cv::Size & size)
+{
+	cv::Mat image;
+	cv::Mat noise(size, CV_8UC1);
+	cv::RNG rng(42);
+	rng.fill(noise, cv::RNG::UNIFORM, 0, 256);
+	cv::GaussianBlur(noise, image, cv::Size(5,5), 1.5);
+	cv::Mat weak = image.colRange(size.width/3, size.width);
+	weak.convertTo(weak, CV_8UC1, 0.15, 100);
+	return image;
+}
+
+void benchmarkFeatures()
+{
+	printf("\n[features] %d repetitions, Kp/MaxFeatures=1000, %d thread(s)\n", g_repetitions, threadsUsed());
+	printf("%-12s %-6s %8s %8s %10s %10s\n", "detector", "grid", "time(ms)", "kpts", "coverage", "maxCell");
+	cv::Mat image = createUnevenlyTexturedImage(cv::Size(640,480));
+	Feature2D::Type types[4] = {Feature2D::kFeatureOrb, Feature2D::kFeatureFastBrief, Feature2D::kFeatureGfttBrief, Feature2D::kFeatureBrisk};
+	const char * names[4] = {"ORB", "FAST/BRIEF", "GFTT/BRIEF", "BRISK"};
+	int grids[3] = {1, 2, 4};
+	for(int t=0; t<4; ++t)
+	{
+		for(int g=0; g<3; ++g)
+		{
+			ParametersMap parameters;
+			parameters.insert(ParametersPair(Parameters::kKpMaxFeatures(), "1000"));
+			parameters.insert(ParametersPair(Parameters::kKpGridRows(), uNumber2Str(grids[g])));
+			parameters.insert(ParametersPair(Parameters::kKpGridCols(), uNumber2Str(grids[g])));
+			parameters.insert(ParametersPair(Parameters::kFASTGridRows(), "0"));
+			parameters.insert(ParametersPair(Parameters::kFASTGridCols(), "0"));
+			parameters.insert(ParametersPair(Parameters::kGFTTMinDistance(), "3"));
+			Feature2D * detector = Feature2D::create(types[t], parameters);
+
+			std::vector<cv::KeyPoint> keypoints;
+			UTimer timer;
+			for(int r=0; r<g_repetitions; ++r)
+			{
+				keypoints = detector->generateKeypoints(image);
+			}
+			double time = timer.ticks()*1000.0/double(g_repetitions);
+			delete detector;
+
+			// spatial distribution on a fixed 8x8 grid
+			std::vector<int> counts(64, 0);
+			for(unsigned int i=0; i<keypoints.size(); ++i)
+			{
+				int c = std::min(7, int(keypoints[i].pt.x*8.0f/float(image.cols)));
+				int r = std::min(7, int(keypoints[i].pt.y*8.0f/float(image.rows)));
+				++counts[r*8+c];
+			}
+			int nonEmpty = 0;
+			int maxCell = 0;
+			for(unsigned int i=0; i<counts.size(); ++i)
+			{
+				nonEmpty += counts[i]>0?1:0;
+				maxCell = counts[i]>maxCell?counts[i]:maxCell;
+			}
+			printf("%-12s %-6s %8.2f %8d %9.1f%% %9.1f%%\n",
+					names[t],
+					uFormat("%dx%d", grids[g], grids[g]).c_str(),
+					time,
+					(int)keypoints.size(),
+					float(nonEmpty)*100.0f/64.0f,
+					keypoints.size()?float(maxCell)*100.0f/float(keypoints.size()):0.0f);
+		}
+	}
+}
+
+// Simulate what a stereo optical flow odometry does for each frame:
+// stereo correspondences on the new frame, then tracking from the previous frame.
+void benchmarkPyramidCache()
+{
+	int frames = 30;
+	printf("\n[pyramid] %d frames 640x480, 1000 corners, %d thread(s)\n", frames, threadsUsed());
+	printf("%-10s %14s %10s %10s %16s\n", "mode", "time/frame(ms)", "builds", "hits", "allocations/frame");
+
+	std::vector<cv::Mat> lefts(frames), rights(frames);
+	std::vector<std::vector<cv::Point2f> > corners(frames);
+	cv::Mat left, right;
+	createStereoPair(cv::Size(640+frames*2, 480), 20, left, right);
+	for(int f=0; f<frames; ++f)
+	{
+		// camera moving 2 pixels to the right each frame
+		lefts[f] = left(cv::Rect(f*2, 0, 640, 480)).clone();
+		rights[f] = right(cv::Rect(f*2, 0, 640, 480)).clone();
+		cv::goodFeaturesToTrack(lefts[f], corners[f], 1000, 0.001, 3);
+	}
+
+	StereoOpticalFlow stereo;
+	cv::Size flowWinSize(16, 16);
+	int flowMaxLevel = 3;
+	for(int cached=0; cached<2; ++cached)
+	{
+		ImagePyramidCache::clearPool();
+		ImagePyramidCache::resetStatistics();
+		UTimer timer;
+		SensorData previous;
+		for(int f=0; f<frames; ++f)
+		{
+			SensorData data(lefts[f], rights[f], StereoCameraModel());
+			std::vector<unsigned char> status;
+			std::vector<cv::Point2f> rightCorners;
+			if(cached)
+			{
+				rightCorners = stereo.computeCorrespondences(data, corners[f], status);
+			}
+			else
+			{
+				rightCorners = stereo.computeCorrespondences(data.imageRaw(), data.rightRaw(), corners[f], status);
+			}
+
+			if(previous.isValid())
+			{
+				std::vector<cv::Point2f> nextCorners;
+				std::vector<float> err;
+				cv::calcOpticalFlowPyrLK(
+						cached?cv::_InputArray(previous.imagePyramid(flowWinSize, flowMaxLevel)):cv::_InputArray(previous.imageRaw()),
+						cached?cv::_InputArray(data.imagePyramid(flowWinSize, flowMaxLevel)):cv::_InputArray(data.imageRaw()),
+						corners[f-1],
+						nextCorners,
+						status,
+						err,
+						flowWinSize,
+						flowMaxLevel);
+			}
+			previous = data;
+		}
+		double time = timer.ticks()*1000.0/double(frames);
+		if(cached)
+		{
+			unsigned long builds, hits, allocations;
+			ImagePyramidCache::getStatistics(builds, hits, allocations);
+			printf("%-10s %14.2f %10lu %10lu %16.2f\n", "cached", time, builds, hits, double(allocations)/double(frames));
+		}
+		else
+		{
+			// 2 pyramids for stereo + 2 for tracking, all levels allocated by OpenCV
+			printf("%-10s %14.2f %10d %10d %16s\n", "rebuild", time, frames*2+(frames-1)*2, 0, "all");
+		}
+	}
+}
+
+// Depth ramp with some invalid pixels
+cv::Mat createDepthImage(const cv::Size & size, int type)
+{
+	cv::Mat depth(size, CV_32FC1);
+	cv::RNG rng(42);
+	for(int i=0; i<depth.rows; ++i)
+	{
+		for(int j=0; j<depth.cols; ++j)
+		{
+			depth.at<float>(i,j) = rng.uniform(0, 20) == 0?0.0f:0.5f + 4.0f*float(i+j)/float(depth.rows+depth.cols);
+		}
+	}
+	if(type == CV_16UC1)
+	{
+		depth.convertTo(depth, CV_16UC1, 1000.0);
+	}
+	return depth;
+}
+
+// Number of points not bit-identical to the projectDepthTo3D() reference
+int compareToReference(
+		const pcl::PointCloud<pcl::PointXYZ> & cloud,
+		const cv::Mat & depth,
+		int decimation,
+		float fx, float fy, float cx, float cy)
+{
+	int differences = 0;
+	for(int h=0; h<depth.rows; h+=decimation)
+	{
+		for(int w=0; w<depth.cols; w+=decimation)
+		{
+			pcl::PointXYZ ref = util3d::projectDepthTo3D(depth, w, h, cx, cy, fx, fy, false);
+			const pcl::PointXYZ & pt = cloud.at((h/decimation)*cloud.width + (w/decimation));
+			if(memcmp(ref.data, pt.data, 3*sizeof(float)) != 0)
+			{
+				++differences;
+			}
+		}
+	}
+	return differences;
+}
+
+void benchmarkCloud()
+{
+	printf("\n[cloud] %d repetitions, serial vs %d thread(s)\n", g_repetitions, threadsUsed());
+	printf("%-10s %-5s %-4s %-4s %12s %12s %8s %8s\n", "size", "depth", "rgb", "dec", "serial(ms)", "parallel(ms)", "speedup", "diffs");
+	cv::Size sizes[2] = {cv::Size(640,480), cv::Size(1280,720)};
+	int types[2] = {CV_16UC1, CV_32FC1};
+	int decimations[3] = {1, 2, 4};
+	float fx = 525.0f;
+	float fy = 525.0f;
+	for(int s=0; s<2; ++s)
+	{
+		float cx = float(sizes[s].width)/2.0f - 0.5f;
+		float cy = float(sizes[s].height)/2.0f - 0.5f;
+		cv::Mat rgb;
+		cv::Mat gray;
+		createStereoPair(sizes[s], 0, gray, rgb);
+		cv::cvtColor(gray, rgb, CV_GRAY2BGR);
+		for(int t=0; t<2; ++t)
+		{
+			cv::Mat depth = createDepthImage(sizes[s], types[t]);
+			if(types[t] == CV_32FC1)
+			{
+				// non-finite depths must give invalid points like projectDepthTo3D()
+				depth.at<float>(4,4) = std::numeric_limits<float>::infinity();
+				depth.at<float>(8,8) = std::numeric_limits<float>::quiet_NaN();
+			}
+			for(int withRgb=0; withRgb<2; ++withRgb)
+			{
+				for(int d=0; d<3; ++d)
+				{
+					double times[2] = {0.0, 0.0};
+					pcl::PointCloud<pcl::PointXYZ>::Ptr clouds[2];
+					pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudsRGB[2];
+					for(int p=0; p<2; ++p)
+					{
+						setThreads(p==0?1:g_threads);
+						std::vector<double> samples;
+						UTimer timer;
+						for(int r=0; r<g_repetitions; ++r)
+						{
+							if(withRgb)
+							{
+								cloudsRGB[p] = util3d::cloudFromDepthRGB(rgb, depth, cx, cy, fx, fy, decimations[d]);
+							}
+							else
+							{
+								clouds[p] = util3d::cloudFromDepth(depth, cx, cy, fx, fy, decimations[d]);
+							}
+							samples.push_back(timer.ticks()*1000.0);
+						}
+						times[p] = uMean(samples);
+						addResult(withRgb?"util3d::cloudFromDepthRGB":"util3d::cloudFromDepth",
+								uFormat("%dx%d %s decimation=%d threads=%d", sizes[s].width, sizes[s].height, types[t]==CV_16UC1?"16U":"32F", decimations[d], p==0?1:threadsUsed()),
+								samples,
+								(int)depth.total()/(decimations[d]*decimations[d]));
+						if(withRgb)
+						{
+							clouds[p].reset(new pcl::PointCloud<pcl::PointXYZ>);
+							pcl::copyPointCloud(*cloudsRGB[p], *clouds[p]);
+						}
+					}
+
+					int diffs = compareToReference(*clouds[0], depth, decimations[d], fx, fy, cx, cy) +
+							compareToReference(*clouds[1], depth, decimations[d], fx, fy, cx, cy);
+					printf("%-10s %-5s %-4s %-4d %12.2f %12.2f %8.2f %8d%s\n",
+							uFormat("%dx%d", sizes[s].width, sizes[s].height).c_str(),
+							types[t]==CV_16UC1?"16U":"32F",
+							withRgb?"yes":"no",
+							decimations[d],
+							times[0],
+							times[1],
+							times[1]>0.0?times[0]/times[1]:0.0,
+							diffs,
+							diffs?" FAILED":"");
+					if(diffs)
+					{
+						++g_failures;
+					}
+				}
+			}
+		}
+	}
+	setThreads(g_threads);
+}
+
+void benchmarkDepthRegistration()
+{
+	printf("\n[depth] %d repetitions, serial version vs parallel version with %d thread(s)\n", g_repetitions, threadsUsed());
+	printf("%-10s %-26s %12s %12s %8s %8s\n", "size", "function", "serial(ms)", "parallel(ms)", "speedup", "diffs");
+	cv::Size sizes[2] = {cv::Size(640,480), cv::Size(1280,720)};
+	for(int s=0; s<2; ++s)
+	{
+		cv::Mat depthK = (cv::Mat_<double>(3,3) <<
+				525.0*sizes[s].width/640, 0, sizes[s].width/2,
+				0, 525.0*sizes[s].width/640, sizes[s].height/2,
+				0, 0, 1);
+		cv::Mat colorK = depthK.clone();
+		colorK.at<double>(0,0) *= 1.05;
+		colorK.at<double>(1,1) *= 1.05;
+		Transform depthToColor(-0.025f, 0.0f, 0.0f, 0.0f, 0.0f, 0.01f);
+
+		cv::Mat depths[2] = {createDepthImage(sizes[s], CV_16UC1), createDepthImage(sizes[s], CV_32FC1)};
+		cv::Mat registered = util2d::registerDepth(depths[0], depthK, colorK, depthToColor, false);
+
+		for(int f=0; f<5; ++f)
+		{
+			std::string name;
+			cv::Mat results[2];
+			double times[2] = {0.0, 0.0};
+			for(int p=0; p<2; ++p)
+			{
+				setThreads(p==0?1:g_threads);
+				std::vector<double> samples;
+				UTimer timer;
+				for(int r=0; r<g_repetitions; ++r)
+				{
+					if(f < 2)
+					{
+						name = f==0?"registerDepth(16U)":"registerDepth(32F)";
+						results[p] = util2d::registerDepth(depths[f], depthK, colorK, depthToColor, p==1);
+					}
+					else if(f == 2)
+					{
+						name = "fillDepthHoles(3)";
+						results[p] = util2d::fillDepthHoles(registered, 3, 0.02f, p==1);
+					}
+					else
+					{
+						name = f==3?"fillRegisteredHoles(vert)":"fillRegisteredHoles(horz)";
+						results[p] = registered.clone();
+						util2d::fillRegisteredDepthHoles(results[p], f==3, f==4, true, p==1);
+					}
+					samples.push_back(timer.ticks()*1000.0);
+				}
+				times[p] = uMean(samples);
+				addResult("util2d::" + name,
+						uFormat("%dx%d threads=%d", sizes[s].width, sizes[s].height, p==0?1:threadsUsed()),
+						samples,
+						sizes[s].area());
+			}
+
+			// the parallel versions should give exactly the same result
+			cv::Mat diff;
+			cv::compare(results[0], results[1], diff, cv::CMP_NE);
+			int diffs = cv::countNonZero(diff);
+			printf("%-10s %-26s %12.2f %12.2f %8.2f %8d%s\n",
+					uFormat("%dx%d", sizes[s].width, sizes[s].height).c_str(),
+					name.c_str(),
+					times[0],
+					times[1],
+					times[1]>0.0?times[0]/times[1]:0.0,
+					diffs,
+					diffs?" FAILED":"");
+			if(diffs)
+			{
+				++g_failures;
+			}
+		}
+	}
+	setThreads(g_threads);
+}
+
+// Local map of a node looking at walls on both sides of a corridor
+std::pair<cv::Mat, cv::Mat> createLocalMap(cv::RNG & rng)
+{
+	cv::Mat ground(300, 1, CV_32FC2);
+	cv::Mat obstacles(60, 1, CV_32FC2);
+	for(int i=0; i<ground.rows; ++i)
+	{
+		ground.at<cv::Vec2f>(i) = cv::Vec2f(rng.uniform(0.0f, 3.0f), rng.uniform(-0.95f, 0.95f));
+	}
+	for(int i=0; i<obstacles.rows; ++i)
+	{
+		obstacles.at<cv::Vec2f>(i) = cv::Vec2f(rng.uniform(0.0f, 3.0f), i%2==0?-1.0f:1.0f);
+	}
+	return std::make_pair(ground, obstacles);
+}
+
+// Percentage of cells of the reference map with the same value in the other map
+float compareGrids(const cv::Mat & ref, float refXMin, float refYMin, const cv::Mat & map, float xMin, float yMin, float cellSize)
+{
+	int offsetX = int(floor((refXMin - xMin)/cellSize + 0.5f));
+	int offsetY = int(floor((refYMin - yMin)/cellSize + 0.5f));
+	int same = 0;
+	for(int i=0; i<ref.rows; ++i)
+	{
+		for(int j=0; j<ref.cols; ++j)
+		{
+			int y = i + offsetY;
+			int x = j + offsetX;
+			char value = y>=0 && y<map.rows && x>=0 && x<map.cols?map.at<char>(y, x):-1;
+			if(value == ref.at<char>(i,j))
+			{
+				++same;
+			}
+		}
+	}
+	return ref.total()?float(same)*100.0f/float(ref.total()):0.0f;
+}
+
+void benchmarkOccupancyGrid()
+{
+	printf("\n[grid] cell=0.05 m, new node = 1 node added, loop closure = 10%% of the nodes moved\n");
+	printf("%-7s %-14s %14s %14s %14s %10s\n", "nodes", "method", "full(ms)", "new node(ms)", "loop(ms)", "same(%)");
+	int sizes[3] = {1000, 5000, 20000};
+	float cellSize = 0.05f;
+	for(int s=0; s<3; ++s)
+	{
+		// square spiral trajectory
+		cv::RNG rng(42);
+		std::map<int, Transform> poses;
+		std::map<int, std::pair<cv::Mat, cv::Mat> > localMaps;
+		float x=0.0f, y=0.0f, theta=0.0f;
+		int segment = 20;
+		for(int i=1; i<=sizes[s]+1; ++i)
+		{
+			poses.insert(std::make_pair(i, Transform(x, y, theta)));
+			localMaps.insert(std::make_pair(i, createLocalMap(rng)));
+			if(i % segment == 0)
+			{
+				theta += CV_PI/2.0f;
+				segment += 4;
+			}
+			x += 0.1f*cos(theta);
+			y += 0.1f*sin(theta);
+		}
+		std::map<int, Transform> lastPose;
+		lastPose.insert(*poses.rbegin());
+		poses.erase(poses.rbegin()->first);
+
+		std::map<int, Transform> closedPoses = poses;
+		closedPoses.insert(lastPose.begin(), lastPose.end());
+		int moved = 0;
+		for(std::map<int, Transform>::reverse_iterator iter=closedPoses.rbegin(); moved<int(closedPoses.size())/10; ++iter, ++moved)
+		{
+			iter->second = Transform(0.2f, 0.1f, 0.02f) * iter->second;
+		}
+
+		// full rebuilds
+		float xMin, yMin;
+		double times[3];
+		UTimer timer;
+		cv::Mat ref = util3d::create2DMapFromOccupancyLocalMaps(poses, localMaps, cellSize, xMin, yMin);
+		times[0] = timer.ticks()*1000.0;
+		std::map<int, Transform> posesWithNew = poses;
+		posesWithNew.insert(lastPose.begin(), lastPose.end());
+		util3d::create2DMapFromOccupancyLocalMaps(posesWithNew, localMaps, cellSize, xMin, yMin);
+		times[1] = timer.ticks()*1000.0;
+		ref = util3d::create2DMapFromOccupancyLocalMaps(closedPoses, localMaps, cellSize, xMin, yMin);
+		times[2] = timer.ticks()*1000.0;
+		printf("%-7d %-14s %14.2f %14.2f %14.2f %10s\n", sizes[s], "rebuild", times[0], times[1], times[2], "-");
+
+		// incremental
+		OccupancyGridAssembler grid(cellSize);
+		float gridXMin, gridYMin;
+		timer.start();
+		grid.update(poses, localMaps);
+		grid.getMap(gridXMin, gridYMin);
+		times[0] = timer.ticks()*1000.0;
+		grid.update(posesWithNew, localMaps);
+		grid.getMap(gridXMin, gridYMin);
+		times[1] = timer.ticks()*1000.0;
+		grid.update(closedPoses, localMaps);
+		cv::Mat map = grid.getMap(gridXMin, gridYMin);
+		times[2] = timer.ticks()*1000.0;
+		printf("%-7d %-14s %14.2f %14.2f %14.2f %10.2f\n", sizes[s], "incremental", times[0], times[1], times[2],
+				compareGrids(ref, xMin, yMin, map, gridXMin, gridYMin, cellSize));
+	}
+}
+
+// 360 deg laser scan (CV_32FC2, in the scan frame) taken at (x,y,yaw) in a square room
+cv::Mat createRoomScan(int rays, float roomSize, float x, float y, float yaw)
+{
+	cv::Mat scan(1, rays, CV_32FC2);
+	float half = roomSize/2.0f;
+	for(int i=0; i<rays; ++i)
+	{
+		float a = float(i)*2.0f*CV_PI/float(rays);
+		float dx = cos(a+yaw);
+		float dy = sin(a+yaw);
+		float tx = dx>0.0f?(half-x)/dx:dx<0.0f?(-half-x)/dx:1e9f;
+		float ty = dy>0.0f?(half-y)/dy:dy<0.0f?(-half-y)/dy:1e9f;
+		float range = std::min(tx, ty);
+		scan.at<cv::Vec2f>(i) = cv::Vec2f(range*cos(a), range*sin(a));
+	}
+	return scan;
+}
+
+void benchmarkLogOddsGrid()
+{
+	int frames = 100;
+	int rays = 1080;
+	float roomSize = 20.0f;
+	float cellSize = 0.05f;
+	printf("\n[logodds] %d scans of %d rays in a %.0fx%.0f m room, cell=%.2f m, 1 vs %d thread(s)\n", frames, rays, roomSize, roomSize, cellSize, threadsUsed());
+	printf("%-28s %12s %12s %14s %14s\n", "method", "serial(ms)", "parallel(ms)", "serial(rays/s)", "parallel(rays/s)");
+
+	std::vector<cv::Mat> scans(frames);
+	std::vector<Transform> poses(frames);
+	for(int i=0; i<frames; ++i)
+	{
+		float t = float(i)/float(frames);
+		poses[i] = Transform(-5.0f + 10.0f*t, 2.0f*sin(t*CV_PI*2.0f), t*CV_PI);
+		scans[i] = createRoomScan(rays, roomSize, poses[i].x(), poses[i].y(), poses[i].theta());
+	}
+
+	for(int method=0; method<3; ++method)
+	{
+		double times[2] = {0.0, 0.0};
+		for(int p=0; p<2; ++p)
+		{
+			setThreads(p==0?1:g_threads);
+			LogOddsGrid grid(cellSize, method==1?CV_8SC1:CV_16SC1);
+			UTimer timer;
+			for(int i=0; i<frames; ++i)
+			{
+				if(method < 2)
+				{
+					grid.update(scans[i], poses[i]);
+				}
+				else
+				{
+					cv::Mat ground, obstacles;
+					util3d::occupancy2DFromLaserScan(scans[i], ground, obstacles, cellSize);
+				}
+			}
+			times[p] = timer.ticks()*1000.0;
+		}
+		printf("%-28s %12.2f %12.2f %14.0f %14.0f\n",
+				method==0?"LogOddsGrid (16 bits)":method==1?"LogOddsGrid (8 bits)":"occupancy2DFromLaserScan",
+				times[0],
+				times[1],
+				times[0]>0.0?double(frames*rays)/(times[0]/1000.0):0.0,
+				times[1]>0.0?double(frames*rays)/(times[1]/1000.0):0.0);
+	}
+	setThreads(g_threads);
+}
+
+// Cloud seen by a depth camera in a room (floor, ceiling and walls), in the node frame
+pcl::PointCloud<pcl::PointXYZ>::Ptr createRoomCloud(int points, float roomSize, const Transform & pose, cv::RNG & rng)
+{
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+	Transform inv = pose.inverse();
+	float half = roomSize/2.0f;
+	for(int i=0; i<points; ++i)
+	{
+		// ray in the field of view (60x45 deg)
+		float yaw = pose.theta() + rng.uniform(-0.52f, 0.52f);
+		float pitch = rng.uniform(-0.39f, 0.39f);
+		float dx = cos(pitch)*cos(yaw);
+		float dy = cos(pitch)*sin(yaw);
+		float dz = -sin(pitch);
+		float tx = dx>0.0f?(half-pose.x())/dx:dx<0.0f?(-half-pose.x())/dx:1e9f;
+		float ty = dy>0.0f?(half-pose.y())/dy:dy<0.0f?(-half-pose.y())/dy:1e9f;
+		float tz = dz<0.0f?(0.0f-pose.z())/dz:dz>0.0f?(2.5f-pose.z())/dz:1e9f;
+		float range = std::min(tx, std::min(ty, tz));
+		pcl::PointXYZ pt(pose.x()+range*dx, pose.y()+range*dy, pose.z()+range*dz);
+		cloud->push_back(util3d::transformPoint(pt, inv));
+	}
+	return cloud;
+}
+
+void benchmarkVoxelOccupancyMap()
+{
+	int nodes = 100;
+	int points = 5000;
+	float voxelSize = 0.05f;
+	printf("\n[voxel] %d nodes of %d points in a 10x10 m room, voxel=%.2f m, %d thread(s)\n", nodes, points, voxelSize, threadsUsed());
+
+	cv::RNG rng(42);
+	std::map<int, Transform> poses;
+	VoxelOccupancyMap map(voxelSize, 4.0f);
+	for(int i=1; i<=nodes; ++i)
+	{
+		float t = float(i)/float(nodes);
+		Transform pose(-3.0f + 6.0f*t, 2.0f*sin(t*CV_PI*2.0f), 1.0f, 0.0f, 0.0f, t*CV_PI*4.0f);
+		poses.insert(std::make_pair(i, pose));
+		map.addNode(i, createRoomCloud(points, 10.0f, pose, rng));
+	}
+
+	UTimer timer;
+	map.update(poses);
+	double time = timer.ticks();
+	printf("insert:        %8.2f ms, %8.0f points/s, %10d voxel updates, %5d blocks, %6ld KB\n",
+			time*1000.0, double(nodes*points)/time, map.getLastVoxelUpdates(), map.getBlocks(), map.getMemoryUsage()/1024);
+
+	// loop closure: the last 10% of the nodes moved
+	std::map<int, Transform> optimized = poses;
+	for(int i=nodes-nodes/10+1; i<=nodes; ++i)
+	{
+		optimized.at(i) = Transform(0.1f, 0.05f, 0.0f, 0.0f, 0.0f, 0.02f) * optimized.at(i);
+	}
+	timer.start();
+	map.update(optimized);
+	time = timer.ticks();
+	printf("re-integrate:  %8.2f ms, %8d nodes\n", time*1000.0, map.getLastIntegrated());
+
+	int queries = 1000000;
+	for(int level=0; level<=4; level+=2)
+	{
+		cv::RNG queryRng(1);
+		int known = 0;
+		timer.start();
+		for(int i=0; i<queries; ++i)
+		{
+			if(map.getOccupancy(queryRng.uniform(-5.0f, 5.0f), queryRng.uniform(-5.0f, 5.0f), queryRng.uniform(0.0f, 2.5f), level) >= 0.0f)
+			{
+				++known;
+			}
+		}
+		time = timer.ticks();
+		printf("query level %d: %8.2f ms, %8.0f queries/s, %.1f%% known\n", level, time*1000.0, double(queries)/time, float(known)*100.0f/float(queries));
+	}
+
+	float xMin, yMin;
+	timer.start();
+	cv::Mat grid = map.to2DMap(xMin, yMin, 0.1f, 2.0f);
+	time = timer.ticks();
+	printf("2D export:     %8.2f ms, %dx%d cells\n", time*1000.0, grid.cols, grid.rows);
+}
+
+// Root mean square translation error between two sets of poses
+float translationRMSE(const std::map<int, Transform> & poses, const std::map<int, Transform> & groundTruth)
+{
+	double sum = 0.0;
+	int count = 0;
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		std::map<int, Transform>::const_iterator jter = groundTruth.find(iter->first);
+		if(jter != groundTruth.end())
+		{
+			sum += iter->second.getDistanceSquared(jter->second);
+			++count;
+		}
+	}
+	return count?sqrt(sum/double(count)):0.0f;
+}
+
+void benchmarkHierarchicalOptimization()
+{
+	// Each session does two laps on a 10 m radius circle, with loop closures
+	// on its previous lap and with the first session.
+	int sessions = 4;
+	int nodesPerSession = 5000;
+	printf("\n[graph] %d sessions of %d nodes, %d thread(s)\n", sessions, nodesPerSession, threadsUsed());
+
+	cv::RNG rng(42);
+	std::map<int, Transform> groundTruth;
+	std::map<int, Transform> poses;
+	std::multimap<int, Link> links;
+	for(int s=0; s<sessions; ++s)
+	{
+		Transform odom;
+		for(int i=0; i<nodesPerSession; ++i)
+		{
+			int id = s*nodesPerSession + i + 1;
+			float angle = float(i)*CV_PI*4.0f/float(nodesPerSession);
+			groundTruth.insert(std::make_pair(id, Transform(10.0f*cos(angle), 10.0f*sin(angle), 0.0f, 0.0f, 0.0f, angle+CV_PI/2.0f)));
+			if(i == 0)
+			{
+				// new session: start with an arbitrary offset
+				odom = Transform(rng.uniform(-1.0f, 1.0f), rng.uniform(-1.0f, 1.0f), 0.0f, 0.0f, 0.0f, rng.uniform(-0.5f, 0.5f)) * groundTruth.at(id);
+			}
+			else
+			{
+				Transform t = groundTruth.at(id-1).inverse() * groundTruth.at(id);
+				Transform noise(rng.gaussian(0.01), rng.gaussian(0.01), 0.0f, 0.0f, 0.0f, rng.gaussian(0.002));
+				links.insert(std::make_pair(id-1, Link(id-1, id, Link::kNeighbor, t*noise, 0.0001, 0.0001)));
+				odom = odom * t * noise;
+			}
+			poses.insert(std::make_pair(id, odom));
+
+			if(i >= nodesPerSession/2 && i % 10 == 0)
+			{
+				int to = id - nodesPerSession/2;
+				links.insert(std::make_pair(id, Link(id, to, Link::kGlobalClosure, groundTruth.at(id).inverse()*groundTruth.at(to), 0.001, 0.001)));
+			}
+			if(s > 0 && i % 25 == 5)
+			{
+				int to = i + 1;
+				links.insert(std::make_pair(id, Link(id, to, Link::kGlobalClosure, groundTruth.at(id).inverse()*groundTruth.at(to), 0.001, 0.001)));
+			}
+		}
+	}
+
+	Optimizer * optimizer = Optimizer::create(ParametersMap());
+	printf("%-28s %12s %12s %14s\n", "method", "time (ms)", "RMSE (m)", "skeleton");
+	printf("%-28s %12s %12.3f %14s\n", "odometry", "-", translationRMSE(poses, groundTruth), "-");
+
+	UTimer timer;
+	std::map<int, Transform> batch = optimizer->optimize(1, poses, links);
+	double time = timer.ticks();
+	printf("%-28s %12.2f %12.3f %14d\n", "batch", time*1000.0, translationRMSE(batch, groundTruth), (int)poses.size());
+
+	int segmentSizes[3] = {10, 50, 200};
+	for(int i=0; i<3; ++i)
+	{
+		int skeletonSize = 0;
+		timer.start();
+		std::map<int, Transform> hierarchical = optimizer->optimizeHierarchical(1, poses, links, segmentSizes[i], 0, 0, &skeletonSize);
+		time = timer.ticks();
+		printf("%-28s %12.2f %12.3f %14d\n",
+				uFormat("hierarchical (segment=%d)", segmentSizes[i]).c_str(),
+				time*1000.0, translationRMSE(hierarchical, groundTruth), skeletonSize);
+	}
+	delete optimizer;
+}
+
+void benchmarkSpatialIndex()
+{
+	// random walk in a 200x200 m area, 10 m radius queries like RGBD/LocalRadius
+	int nodes = 20000;
+	int queries = 100;
+	float radius = 10.0f;
+	printf("\n[spatial] %d poses, %d queries (radius=%.0f m), %d repetitions\n", nodes, queries, radius, g_repetitions);
+
+	cv::RNG rng(42);
+	std::map<int, Transform> poses;
+	Transform pose = Transform::getIdentity();
+	for(int i=1; i<=nodes; ++i)
+	{
+		pose = pose * Transform(0.5f, 0.0f, 0.0f, 0.0f, 0.0f, rng.uniform(-0.3f, 0.3f));
+		if(fabs(pose.x()) > 100.0f || fabs(pose.y()) > 100.0f)
+		{
+			pose = Transform(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, rng.uniform(-3.14f, 3.14f));
+		}
+		poses.insert(std::make_pair(i, pose));
+	}
+
+	PoseSpatialIndex index(radius);
+	UTimer timer;
+	index.update(poses);
+	double buildTime = timer.ticks();
+
+	// map correction after a loop closure on the last 5% of the nodes
+	std::map<int, Transform> corrected = poses;
+	for(int i=nodes-nodes/20+1; i<=nodes; ++i)
+	{
+		corrected.at(i) = Transform(0.2f, 0.1f, 0.0f, 0.0f, 0.0f, 0.01f) * corrected.at(i);
+	}
+	timer.start();
+	index.update(corrected);
+	double updateTime = timer.ticks();
+	index.update(poses);
+	printf("index build:  %8.3f ms (%d cells), update %d moved: %8.3f ms\n", buildTime*1000.0, index.getCells(), nodes/20, updateTime*1000.0);
+
+	printf("%-28s %14s %14s\n", "query", "kd-tree (ms)", "index (ms)");
+	double times[2] = {0.0, 0.0};
+	int checksum[2] = {0, 0};
+	for(int r=0; r<g_repetitions; ++r)
+	{
+		cv::RNG queryRng(r);
+		for(int q=0; q<queries; ++q)
+		{
+			int id = queryRng.uniform(1, nodes+1);
+			timer.start();
+			checksum[0] += (int)graph::getNodesInRadius(id, poses, radius).size();
+			times[0] += timer.ticks();
+			checksum[1] += (int)graph::getNodesInRadius(id, index, radius).size();
+			times[1] += timer.ticks();
+		}
+	}
+	printf("%-28s %14.3f %14.3f %s\n", "getNodesInRadius", times[0]*1000.0/double(g_repetitions*queries), times[1]*1000.0/double(g_repetitions*queries), checksum[0]==checksum[1]?"":"(different results!)");
+
+	times[0] = times[1] = 0.0;
+	checksum[0] = checksum[1] = 0;
+	for(int r=0; r<g_repetitions; ++r)
+	{
+		cv::RNG queryRng(r);
+		for(int q=0; q<queries; ++q)
+		{
+			Transform target(queryRng.uniform(-100.0f, 100.0f), queryRng.uniform(-100.0f, 100.0f), 0.0f, 0.0f, 0.0f, 0.0f);
+			timer.start();
+			int a = graph::findNearestNode(poses, target);
+			times[0] += timer.ticks();
+			int b = graph::findNearestNode(index, target);
+			times[1] += timer.ticks();
+			checksum[0] += poses.at(a).getDistanceSquared(target) == poses.at(b).getDistanceSquared(target)?0:1;
+		}
+	}
+	printf("%-28s %14.3f %14.3f %s\n", "findNearestNode", times[0]*1000.0/double(g_repetitions*queries), times[1]*1000.0/double(g_repetitions*queries), checksum[0]==0?"":"(different results!)");
+
+	timer.start();
+	std::map<int, Transform> filtered = graph::radiusPosesFiltering(poses, 1.0f, 0.0f);
+	printf("%-28s %14s %14.3f (%d/%d poses kept)\n", "radiusPosesFiltering (1 m)", "-", timer.ticks()*1000.0, (int)filtered.size(), nodes);
+}
+
+float pathLength(const std::list<std::pair<int, Transform> > & path)
+{
+	float length = 0.0f;
+	for(std::list<std::pair<int, Transform> >::const_iterator iter=path.begin(); iter!=path.end() && iter!=--path.end(); ++iter)
+	{
+		std::list<std::pair<int, Transform> >::const_iterator next = iter;
+		++next;
+		length += iter->second.getDistance(next->second);
+	}
+	return length;
+}
+
+void benchmarkPathPlanning()
+{
+	// noisy grid-like graph (odometry rows + links between rows, like corridors revisited)
+	int queries = 20;
+	int sizes[] = {1000, 10000, 100000};
+	printf("\n[path] %d queries per graph size, %d repetitions\n", queries, g_repetitions);
+	printf("%-10s %18s %22s %18s\n", "nodes", "A* (ms)", "A* new costs (ms)", "bidirectional (ms)");
+	for(unsigned int s=0; s<sizeof(sizes)/sizeof(int); ++s)
+	{
+		int cols = (int)sqrt(double(sizes[s]));
+		cv::RNG rng(42);
+		std::map<int, Transform> poses;
+		std::multimap<int, int> links;
+		for(int i=0; i<sizes[s]; ++i)
+		{
+			int id = i+1;
+			poses.insert(std::make_pair(id, Transform(float(i%cols)+rng.uniform(-0.2f, 0.2f), float(i/cols)+rng.uniform(-0.2f, 0.2f), 0.0f, 0.0f, 0.0f, 0.0f)));
+			if(i%cols != 0)
+			{
+				links.insert(std::make_pair(id, id-1));
+				links.insert(std::make_pair(id-1, id));
+			}
+			if(i >= cols && rng.uniform(0.0f, 1.0f) < 0.3f)
+			{
+				links.insert(std::make_pair(id, id-cols));
+				links.insert(std::make_pair(id-cols, id));
+			}
+		}
+
+		std::vector<double> samples[3]; // ms per repetition
+		int different = 0;
+		UTimer timer;
+		for(int r=0; r<g_repetitions; ++r)
+		{
+			double times[3] = {0.0, 0.0, 0.0};
+			cv::RNG queryRng(r);
+			for(int q=0; q<queries; ++q)
+			{
+				int from = queryRng.uniform(1, sizes[s]+1);
+				int to = queryRng.uniform(1, sizes[s]+1);
+				timer.start();
+				std::list<std::pair<int, Transform> > a = graph::computePath(poses, links, from, to);
+				times[0] += timer.ticks();
+				std::list<std::pair<int, Transform> > b = graph::computePath(poses, links, from, to, true);
+				times[1] += timer.ticks();
+				std::list<std::pair<int, Transform> > c = graph::computePathBidirectional(poses, links, from, to);
+				times[2] += timer.ticks();
+				if(b.size() != c.size() && fabs(pathLength(b) - pathLength(c)) > 0.001f*pathLength(b))
+				{
+					++different;
+				}
+			}
+			for(int i=0; i<3; ++i)
+			{
+				samples[i].push_back(times[i]*1000.0);
+			}
+		}
+		std::string params = uFormat("nodes=%d x%d", sizes[s], queries);
+		addResult("graph::computePath", params, samples[0], queries);
+		addResult("graph::computePath", params + " new costs", samples[1], queries);
+		addResult("graph::computePathBidirectional", params, samples[2], queries);
+		printf("%-10d %18.3f %22.3f %18.3f %s\n", sizes[s],
+				uMean(samples[0])/double(queries),
+				uMean(samples[1])/double(queries),
+				uMean(samples[2])/double(queries),
+				different?uFormat("(%d paths with different cost!)", different).c_str():"");
+	}
+}
+
+// Non symmetric room with a few obstacles, ray casting on wall segments
+cv::Mat createClutteredRoomScan(int rays, float maxRange, const Transform & pose)
+{
+	static const float walls[][4] = {
+			{-8,-5, 12,-5}, {12,-5, 12,7}, {12,7, -8,7}, {-8,7, -8,-5}, // room
+			{2,-5, 2,1}, {5,3, 9,3}, {9,3, 9,5}, {-5,2, -3,2}, {-3,2, -3,4}, {-6,-3, -4,-2}}; // obstacles
+	std::vector<cv::Vec2f> points;
+	for(int i=0; i<rays; ++i)
+	{
+		float a = float(i)*2.0f*CV_PI/float(rays);
+		float dx = cos(a+pose.theta());
+		float dy = sin(a+pose.theta());
+		float range = maxRange;
+		for(unsigned int j=0; j<sizeof(walls)/sizeof(walls[0]); ++j)
+		{
+			float ex = walls[j][2]-walls[j][0];
+			float ey = walls[j][3]-walls[j][1];
+			float den = dx*ey - dy*ex;
+			if(fabs(den) > 1e-9f)
+			{
+				float t = ((walls[j][0]-pose.x())*ey - (walls[j][1]-pose.y())*ex)/den;
+				float u = ((walls[j][0]-pose.x())*dy - (walls[j][1]-pose.y())*dx)/den;
+				if(t > 0.0f && u >= 0.0f && u <= 1.0f && t < range)
+				{
+					range = t;
+				}
+			}
+		}
+		if(range < maxRange)
+		{
+			points.push_back(cv::Vec2f(range*cos(a), range*sin(a)));
+		}
+	}
+	return cv::Mat(points, true).reshape(2, 1);
+}
+
+void benchmarkScanMatching()
+{
+	int rays = 360;
+	float maxRange = 30.0f;
+	int trials = 5*g_repetitions;
+	float maxErrors[] = {0.25f, 0.5f, 1.0f, 2.0f}; // m, with proportional rotation error up to 30 deg
+	printf("\n[scanmatch] %d rays, %d trials per error, success = final error < 0.1 m and 2 deg\n", rays, trials);
+	printf("%-18s %14s %14s %18s %18s\n", "initial error", "ICP success", "ICP (ms)", "corr+ICP success", "corr+ICP (ms)");
+
+	ParametersMap parameters;
+	parameters.insert(ParametersPair(Parameters::kIcpMaxTranslation(), "0"));
+	parameters.insert(ParametersPair(Parameters::kIcpMaxRotation(), "0"));
+	parameters.insert(ParametersPair(Parameters::kIcpVoxelSize(), "0"));
+	parameters.insert(ParametersPair(Parameters::kIcpMaxCorrespondenceDistance(), "0.2"));
+	parameters.insert(ParametersPair(Parameters::kIcpIterations(), "50"));
+	RegistrationIcp icp(parameters);
+	parameters.insert(ParametersPair(Parameters::kIcpCorrelative(), "true"));
+	RegistrationIcp correlative(parameters);
+	RegistrationIcp * registrations[2] = {&icp, &correlative};
+
+	for(unsigned int e=0; e<sizeof(maxErrors)/sizeof(float); ++e)
+	{
+		cv::RNG rng(42);
+		int success[2] = {0, 0};
+		double times[2] = {0.0, 0.0};
+		for(int i=0; i<trials; ++i)
+		{
+			Transform from(rng.uniform(-3.0f, 3.0f), rng.uniform(-2.0f, 2.0f), rng.uniform(-3.14f, 3.14f));
+			Transform to = from * Transform(rng.uniform(-1.0f, 1.0f), rng.uniform(-1.0f, 1.0f), rng.uniform(-0.3f, 0.3f));
+			SensorData dataFrom;
+			SensorData dataTo;
+			dataFrom.setLaserScanRaw(createClutteredRoomScan(rays, maxRange, from), rays, maxRange);
+			dataTo.setLaserScanRaw(createClutteredRoomScan(rays, maxRange, to), rays, maxRange);
+			Transform groundTruth = from.inverse() * to;
+
+			// error of maxErrors[e] in a random direction, rotation error proportional
+			float angle = rng.uniform(0.0f, 2.0f*float(CV_PI));
+			float ratio = maxErrors[e]/maxErrors[sizeof(maxErrors)/sizeof(float)-1];
+			Transform error(maxErrors[e]*cos(angle), maxErrors[e]*sin(angle), (rng.uniform(0, 2)?1.0f:-1.0f)*ratio*30.0f*float(CV_PI)/180.0f);
+			Transform guess = error * groundTruth;
+
+			for(int r=0; r<2; ++r)
+			{
+				UTimer timer;
+				Transform t = registrations[r]->computeTransformation(dataFrom, dataTo, guess);
+				times[r] += timer.ticks();
+				if(!t.isNull())
+				{
+					Transform diff = groundTruth.inverse() * t;
+					if(diff.getNorm() < 0.1f && fabs(diff.theta()) < 2.0f*float(CV_PI)/180.0f)
+					{
+						++success[r];
+					}
+				}
+			}
+		}
+		printf("%-18s %13.0f%% %14.3f %17.0f%% %18.3f\n",
+				uFormat("%.2f m / %.0f deg", maxErrors[e], 30.0f*maxErrors[e]/maxErrors[sizeof(maxErrors)/sizeof(float)-1]).c_str(),
+				100.0f*float(success[0])/float(trials), times[0]*1000.0/double(trials),
+				100.0f*float(success[1])/float(trials), times[1]*1000.0/double(trials));
+	}
+}
+
+class LoggerBenchmarkThread : public UThread
+{
+public:
+	LoggerBenchmarkThread(int messages) : messages_(messages) {}
+	virtual ~LoggerBenchmarkThread() {this->join(true);}
+	const std::vector<double> & latencies() const {return latencies_;}
+
+private:
+	virtual void mainLoop()
+	{
+		latencies_.resize(messages_);
+		double ticksToUs = 1000000.0/cv::getTickFrequency();
+		for(int i=0; i<messages_; ++i)
+		{
+			int64 start = cv::getTickCount();
+			UDEBUG("Message %d from the benchmark (value=%f)", i, float(i)*0.5f);
+			latencies_[i] = double(cv::getTickCount()-start)*ticksToUs;
+		}
+		this->kill();
+	}
+
+private:
+	int messages_;
+	std::vector<double> latencies_;
+};
+
+void benchmarkLogger()
+{
+	const std::string logFile = "kernelBenchmark_log.txt";
+	const int messages = 20000;
+	printf("\n[logger] %d debug messages per thread written to \"%s\"\n", messages, logFile.c_str());
+	printf("%-6s %-8s %14s %14s %10s %10s %10s %8s\n", "mode", "threads", "caller(msg/s)", "written(msg/s)", "p50(us)", "p99(us)", "max(us)", "dropped");
+	int threads[3] = {1, 2, 4};
+	for(int t=0; t<3; ++t)
+	{
+		for(int mode=0; mode<3; ++mode)
+		{
+			ULogger::setType(ULogger::kTypeFile, logFile, false);
+			ULogger::setLevel(ULogger::kDebug);
+			ULogger::setAsynchronous(mode>0, mode==2);
+			unsigned long dropped = ULogger::droppedMessages();
+
+			std::vector<LoggerBenchmarkThread*> loggers;
+			for(int i=0; i<threads[t]; ++i)
+			{
+				loggers.push_back(new LoggerBenchmarkThread(messages));
+			}
+			UTimer timer;
+			for(int i=0; i<threads[t]; ++i)
+			{
+				loggers[i]->start();
+			}
+			std::vector<double> latencies;
+			for(int i=0; i<threads[t]; ++i)
+			{
+				loggers[i]->join();
+				latencies.insert(latencies.end(), loggers[i]->latencies().begin(), loggers[i]->latencies().end());
+				delete loggers[i];
+			}
+			double callerTime = timer.elapsed();
+			ULogger::flush();
+			double writtenTime = timer.elapsed();
+			ULogger::setAsynchronous(false);
+
+			double total = double(messages*threads[t]);
+			dropped = ULogger::droppedMessages()-dropped;
+			printf("%-6s %-8d %14.0f %14.0f %10.2f %10.2f %10.2f %8lu\n",
+					mode==0?"sync":mode==1?"async":"drop",
+					threads[t],
+					total/callerTime,
+					(total-double(dropped))/writtenTime,
+					percentile(latencies, 0.5),
+					percentile(latencies, 0.99),
+					percentile(latencies, 1.0),
+					dropped);
+		}
+	}
+
+	// Rtabmap::process() on a synthetic sequence, appearance-based only
+	int frames = g_repetitions*10;
+	printf("\n[logger] Rtabmap::process() time, %d frames, debug level\n", frames);
+	printf("%-8s %10s %10s %10s %10s\n", "mode", "mean(ms)", "p50(ms)", "p95(ms)", "max(ms)");
+	cv::Mat texture = createUnevenlyTexturedImage(cv::Size(640+frames*4, 480));
+	for(int mode=0; mode<3; ++mode)
+	{
+		ULogger::setType(mode==0?ULogger::kTypeNoLog:ULogger::kTypeFile, logFile, false);
+		ULogger::setLevel(mode==0?ULogger::kWarning:ULogger::kDebug);
+		ULogger::setAsynchronous(mode==2);
+
+		ParametersMap parameters;
+		parameters.insert(ParametersPair(Parameters::kRGBDEnabled(), "false"));
+		parameters.insert(ParametersPair(Parameters::kRtabmapWorkingDirectory(), "."));
+		Rtabmap rtabmap;
+		rtabmap.init(parameters);
+		std::vector<double> times;
+		for(int i=0; i<frames; ++i)
+		{
+			cv::Mat image = texture.colRange(i*4, i*4+640).clone();
+			UTimer timer;
+			rtabmap.process(image, i+1);
+			times.push_back(timer.elapsed()*1000.0);
+		}
+		rtabmap.close(false);
+		ULogger::setAsynchronous(false);
+
+		printf("%-8s %10.2f %10.2f %10.2f %10.2f\n",
+				mode==0?"no log":mode==1?"sync":"async",
+				uMean(times),
+				percentile(times, 0.5),
+				percentile(times, 0.95),
+				percentile(times, 1.0));
+	}
+
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+	UFile::erase(logFile);
+}
+
+class EventsBenchmarkEvent : public UEvent
+{
+public:
+	EventsBenchmarkEvent(int producer, int sequence) : UEvent(producer), sequence_(sequence) {}
+	virtual ~EventsBenchmarkEvent() {}
+	virtual std::string getClassName() const {return "EventsBenchmarkEvent";}
+	int sequence() const {return sequence_;}
+
+private:
+	int sequence_;
+};
+
+class EventsBenchmarkProducer : public UThread
+{
+public:
+	EventsBenchmarkProducer(int id, int events) : id_(id), events_(events), time_(0.0) {}
+	virtual ~EventsBenchmarkProducer() {this->join(true);}
+	double time() const {return time_;}
+
+private:
+	virtual void mainLoop()
+	{
+		UTimer timer;
+		for(int i=0; i<events_; ++i)
+		{
+			UEventsManager::post(new EventsBenchmarkEvent(id_, i));
+		}
+		time_ = timer.ticks();
+		this->kill();
+	}
+
+private:
+	int id_;
+	int events_;
+	double time_;
+};
+
+class EventsBenchmarkHandler : public UEventsHandler
+{
+public:
+	EventsBenchmarkHandler(int producers) :
+		received_(0),
+		outOfOrder_(0),
+		last_(producers, -1)
+	{
+		this->registerToEventsManager();
+	}
+	virtual ~EventsBenchmarkHandler() {this->unregisterFromEventsManager();}
+	int received() const
+	{
+		UScopeMutex lock(mutex_);
+		return received_;
+	}
+	int outOfOrder() const
+	{
+		UScopeMutex lock(mutex_);
+		return outOfOrder_;
+	}
+
+protected:
+	virtual void handleEvent(UEvent * event)
+	{
+		if(event->getClassName().compare("EventsBenchmarkEvent") == 0)
+		{
+			const EventsBenchmarkEvent * e = (const EventsBenchmarkEvent*)event;
+			UScopeMutex lock(mutex_);
+			// events of a producer should be received in the order they are posted
+			if(e->sequence() != last_[e->getCode()]+1)
+			{
+				++outOfOrder_;
+			}
+			last_[e->getCode()] = e->sequence();
+			++received_;
+		}
+	}
+
+private:
+	mutable UMutex mutex_;
+	int received_;
+	int outOfOrder_;
+	std::vector<int> last_;
+};
+
+void benchmarkEventsManager()
+{
+	const int producers = 4;
+	const int handlers = 3;
+	const int events = 65000; // per producer
+	printf("\n[events] %d producers x %d events, %d handlers (%d deliveries)\n", producers, events, handlers, producers*events*handlers);
+	printf("%-10s %12s %14s %12s %16s %8s %12s\n", "run", "post(s)", "posts/s", "deliver(s)", "deliveries/s", "lost", "outOfOrder");
+	for(int r=0; r<std::max(1, g_repetitions/5); ++r)
+	{
+		std::vector<EventsBenchmarkHandler*> receivers;
+		for(int i=0; i<handlers; ++i)
+		{
+			receivers.push_back(new EventsBenchmarkHandler(producers));
+		}
+		std::vector<EventsBenchmarkProducer*> senders;
+		for(int i=0; i<producers; ++i)
+		{
+			senders.push_back(new EventsBenchmarkProducer(i, events));
+		}
+
+		UTimer timer;
+		for(int i=0; i<producers; ++i)
+		{
+			senders[i]->start();
+		}
+		double postTime = 0.0;
+		for(int i=0; i<producers; ++i)
+		{
+			senders[i]->join();
+			postTime = std::max(postTime, senders[i]->time());
+			delete senders[i];
+		}
+
+		// wait for the delivery (up to 30 s)
+		int expected = producers*events;
+		int received = 0;
+		while(timer.elapsed() < 30.0)
+		{
+			received = 0;
+			for(int i=0; i<handlers; ++i)
+			{
+				received += receivers[i]->received();
+			}
+			if(received >= expected*handlers)
+			{
+				break;
+			}
+			uSleep(1);
+		}
+		double deliveryTime = timer.elapsed();
+
+		int lost = expected*handlers - received;
+		int outOfOrder = 0;
+		for(int i=0; i<handlers; ++i)
+		{
+			outOfOrder += receivers[i]->outOfOrder();
+			delete receivers[i];
+		}
+		bool failed = lost != 0 || outOfOrder != 0;
+		if(failed)
+		{
+			++g_failures;
+		}
+		printf("%-10d %12.3f %14.0f %12.3f %16.0f %8d %12d%s\n",
+				r+1,
+				postTime,
+				double(expected)/postTime,
+				deliveryTime,
+				double(expected*handlers)/deliveryTime,
+				lost,
+				outOfOrder,
+				failed?" FAILED":"");
+	}
+}
+
+// Distinct visual words: normalized float (SURF-like, 64) or binary (ORB-like, 32 bytes)
+cv::Mat createWords(int count, bool binary, cv::RNG & rng)
+{
+	cv::Mat words;
+	if(binary)
+	{
+		words = cv::Mat(count, 32, CV_8UC1);
+		rng.fill(words, cv::RNG::UNIFORM, 0, 256);
+	}
+	else
+	{
+		words = cv::Mat(count, 64, CV_32FC1);
+		rng.fill(words, cv::RNG::UNIFORM, 0.0f, 1.0f);
+		for(int i=0; i<count; ++i)
+		{
+			cv::normalize(words.row(i), words.row(i));
+		}
+	}
+	return words;
+}
+
+// Observations of random words with noise, like descriptors of features seen again
+cv::Mat createObservations(const cv::Mat & words, int count, cv::RNG & rng)
+{
+	cv::Mat descriptors(count, words.cols, words.type());
+	for(int i=0; i<count; ++i)
+	{
+		words.row(rng.uniform(0, words.rows)).copyTo(descriptors.row(i));
+		if(words.type() == CV_8UC1)
+		{
+			// flip ~10% of the bits
+			for(int b=0; b<26; ++b)
+			{
+				int bit = rng.uniform(0, words.cols*8);
+				descriptors.at<unsigned char>(i, bit/8) ^= (unsigned char)(1 << (bit%8));
+			}
+		}
+		else
+		{
+			cv::Mat noise(1, words.cols, CV_32FC1);
+			rng.fill(noise, cv::RNG::NORMAL, 0.0f, 0.02f);
+			descriptors.row(i) += noise;
+			cv::normalize(descriptors.row(i), descriptors.row(i));
+		}
+	}
+	return descriptors;
+}
+
+void benchmarkDictionary()
+{
+	printResultsHeader("dictionary");
+	int sizes[3] = {10000, 50000, 100000};
+	int queries = 500;
+	for(int binary=0; binary<2; ++binary)
+	{
+		for(int s=0; s<3; ++s)
+		{
+			cv::RNG rng(42);
+			cv::Mat words = createWords(sizes[s], binary==1, rng);
+			ParametersMap parameters;
+			parameters.insert(ParametersPair(Parameters::kKpNNStrategy(), binary?"2":"1"));
+			VWDictionary dictionary(parameters);
+			dictionary.addNewWords(words, 1);
+			dictionary.update();
+			std::string params = uFormat("%s words=%d", binary?"binary":"float", (int)dictionary.getVisualWords().size());
+
+			std::vector<double> samples;
+			for(int r=-1; r<g_repetitions; ++r)
+			{
+				cv::Mat descriptors = createObservations(words, queries, rng);
+				UTimer timer;
+				dictionary.findNN(descriptors);
+				if(r>=0) samples.push_back(timer.ticks()*1000.0);
+			}
+			record("VWDictionary::findNN", params, samples, queries);
+
+			samples.clear();
+			cv::Mat newWords = createWords(queries/2 * (g_repetitions+1), binary==1, rng);
+			for(int r=-1; r<g_repetitions; ++r)
+			{
+				// half seen words, half new words
+				cv::Mat descriptors;
+				cv::vconcat(createObservations(words, queries/2, rng), newWords.rowRange((r+1)*queries/2, (r+2)*queries/2), descriptors);
+				UTimer timer;
+				dictionary.addNewWords(descriptors, r+3);
+				dictionary.update();
+				if(r>=0) samples.push_back(timer.ticks()*1000.0);
+			}
+			record("VWDictionary::addNewWords", params, samples, queries);
+		}
+	}
+}
+
+// Signature words: ids of visual words with random keypoints, "overlap" of them
+// shared between the two signatures
+void createSignatureWords(int wordsCount, float overlap, cv::RNG & rng,
+		std::multimap<int, cv::KeyPoint> & wordsA,
+		std::multimap<int, cv::KeyPoint> & wordsB)
+{
+	int shared = int(float(wordsCount)*overlap);
+	int id = 1;
+	for(int i=0; i<wordsCount; ++i)
+	{
+		cv::KeyPoint kpt(rng.uniform(0.0f, 640.0f), rng.uniform(0.0f, 480.0f), 7.0f);
+		// ~5% of the words are seen twice in the same image
+		int wordId = rng.uniform(0.0f, 1.0f)<0.05f && id>1?id-1:id++;
+		wordsA.insert(std::make_pair(wordId, kpt));
+		wordsB.insert(std::make_pair(i<shared?wordId:wordId+10*wordsCount, kpt));
+	}
+}
+
+void benchmarkSignature()
+{
+	printResultsHeader("signature");
+	int sizes[4] = {200, 500, 1000, 2000};
+	int comparisons = 100;
+	for(int s=0; s<4; ++s)
+	{
+		cv::RNG rng(42);
+		std::multimap<int, cv::KeyPoint> wordsA, wordsB;
+		createSignatureWords(sizes[s], 0.5f, rng, wordsA, wordsB);
+		Signature a(1), b(2);
+		a.setWords(wordsA);
+		b.setWords(wordsB);
+		std::vector<double> samples;
+		float similarity = 0.0f;
+		for(int r=-1; r<g_repetitions; ++r)
+		{
+			UTimer timer;
+			for(int i=0; i<comparisons; ++i)
+			{
+				similarity += a.compareTo(b);
+			}
+			if(r>=0) samples.push_back(timer.ticks()*1000.0);
+		}
+		UASSERT(similarity > 0.0f);
+		record("Signature::compareTo", uFormat("words=%d x%d", sizes[s], comparisons), samples, comparisons);
+	}
+}
+
+void benchmarkPairs()
+{
+	printResultsHeader("pairs");
+	int sizes[4] = {200, 500, 1000, 2000};
+	for(int s=0; s<4; ++s)
+	{
+		cv::RNG rng(42);
+		std::multimap<int, cv::KeyPoint> wordsA, wordsB;
+		createSignatureWords(sizes[s], 0.5f, rng, wordsA, wordsB);
+		std::vector<double> samples;
+		for(int r=-1; r<g_repetitions; ++r)
+		{
+			std::list<std::pair<int, std::pair<cv::KeyPoint, cv::KeyPoint> > > pairs;
+			UTimer timer;
+			EpipolarGeometry::findPairs(wordsA, wordsB, pairs);
+			if(r>=0) samples.push_back(timer.ticks()*1000.0);
+		}
+		record("EpipolarGeometry::findPairs", uFormat("words=%d", sizes[s]), samples, sizes[s]);
+	}
+}
+
+void benchmarkVoxelize()
+{
+	printResultsHeader("voxelize");
+	int sizes[3] = {10000, 100000, 1000000};
+	float voxelSizes[2] = {0.01f, 0.05f};
+	for(int s=0; s<3; ++s)
+	{
+		cv::RNG rng(42);
+		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = createRoomCloud(sizes[s], 10.0f, Transform(0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f), rng);
+		for(int v=0; v<2; ++v)
+		{
+			std::vector<double> samples;
+			for(int r=-1; r<g_repetitions; ++r)
+			{
+				UTimer timer;
+				util3d::voxelize(cloud, voxelSizes[v]);
+				if(r>=0) samples.push_back(timer.ticks()*1000.0);
+			}
+			record("util3d::voxelize", uFormat("points=%d voxel=%.2f", (int)cloud->size(), voxelSizes[v]), samples, (int)cloud->size());
+		}
+	}
+}
+
+void benchmarkCompression()
+{
+	printResultsHeader("compression");
+	cv::Size sizes[3] = {cv::Size(320,240), cv::Size(640,480), cv::Size(1280,720)};
+	for(int s=0; s<3; ++s)
+	{
+		cv::Mat depth = createDepthImage(sizes[s], CV_16UC1);
+		cv::Mat gray, rgb;
+		createStereoPair(sizes[s], 0, gray, rgb);
+		cv::cvtColor(gray, rgb, CV_GRAY2BGR);
+
+		for(int i=0; i<2; ++i)
+		{
+			const cv::Mat & image = i==0?rgb:depth;
+			std::string format = i==0?".jpg":".png";
+			std::string params = uFormat("%dx%d %s", image.cols, image.rows, i==0?"rgb jpg":"depth png");
+			std::vector<double> compress, uncompress;
+			for(int r=-1; r<g_repetitions; ++r)
+			{
+				UTimer timer;
+				cv::Mat bytes = compressImage2(image, format);
+				double t = timer.ticks()*1000.0;
+				uncompressImage(bytes);
+				if(r>=0)
+				{
+					compress.push_back(t);
+					uncompress.push_back(timer.ticks()*1000.0);
+				}
+			}
+			record("compressImage2", params, compress, image.total());
+			record("uncompressImage", params, uncompress, image.total());
+		}
+	}
+
+	int points[3] = {10000, 100000, 1000000};
+	for(int s=0; s<3; ++s)
+	{
+		// laser scan like data: x,y,z
+		cv::RNG rng(42);
+		cv::Mat scan(1, points[s], CV_32FC3);
+		for(int i=0; i<points[s]; ++i)
+		{
+			float a = float(i)*2.0f*float(CV_PI)/float(points[s]);
+			float range = 5.0f + rng.gaussian(0.01);
+			scan.at<cv::Vec3f>(i) = cv::Vec3f(range*cos(a), range*sin(a), rng.uniform(-1.0f, 1.0f));
+		}
+		std::string params = uFormat("points=%d", points[s]);
+		std::vector<double> compress, uncompress;
+		for(int r=-1; r<g_repetitions; ++r)
+		{
+			UTimer timer;
+			cv::Mat bytes = compressData2(scan);
+			double t = timer.ticks()*1000.0;
+			uncompressData(bytes);
+			if(r>=0)
+			{
+				compress.push_back(t);
+				uncompress.push_back(timer.ticks()*1000.0);
+			}
+		}
+		record("compressData2", params, compress, points[s]);
+		record("uncompressData", params, uncompress, points[s]);
+	}
+}
+
+void benchmarkBayes()
+{
+	printResultsHeader("bayes");
+	int sizes[3] = {250, 1000, 2500};
+	int featuresPerNode = 50;
+	for(int s=0; s<3; ++s)
+	{
+		// Memory with a chain of nodes (neighbor links), features are given so
+		// that no image has to be processed
+		ParametersMap parameters;
+		parameters.insert(ParametersPair(Parameters::kMemUseOdomFeatures(), "true"));
+		parameters.insert(ParametersPair(Parameters::kMemRehearsalSimilarity(), "1.0"));
+		parameters.insert(ParametersPair(Parameters::kMemSTMSize(), "1"));
+		parameters.insert(ParametersPair(Parameters::kKpMaxFeatures(), uNumber2Str(featuresPerNode)));
+		Memory memory(parameters);
+		memory.init("", false, parameters);
+		cv::RNG rng(42);
+		cv::Mat words = createWords(sizes[s]*featuresPerNode/4, false, rng);
+		cv::Mat image(48, 64, CV_8UC1, cv::Scalar(128));
+		for(int i=0; i<sizes[s]; ++i)
+		{
+			std::vector<cv::KeyPoint> keypoints(featuresPerNode);
+			for(int k=0; k<featuresPerNode; ++k)
+			{
+				keypoints[k] = cv::KeyPoint(rng.uniform(0.0f, 64.0f), rng.uniform(0.0f, 48.0f), 7.0f, -1, float(featuresPerNode-k));
+			}
+			SensorData data(image, i+1);
+			data.setFeatures(keypoints, createObservations(words, featuresPerNode, rng));
+			memory.update(data);
+		}
+
+		std::map<int, float> likelihood;
+		for(std::map<int, double>::const_iterator iter=memory.getWorkingMem().begin(); iter!=memory.getWorkingMem().end(); ++iter)
+		{
+			likelihood.insert(std::make_pair(iter->first, rng.uniform(1.0f, 2.0f)));
+		}
+		std::string params = uFormat("nodes=%d", (int)likelihood.size());
+
+		std::vector<double> samples;
+		for(int r=-1; r<g_repetitions; ++r)
+		{
+			BayesFilter filter(parameters);
+			UTimer timer;
+			filter.computePosterior(&memory, likelihood);
+			if(r>=0) samples.push_back(timer.ticks()*1000.0);
+		}
+		record("BayesFilter::computePosterior", params + " new", samples, (int)likelihood.size());
+
+		samples.clear();
+		BayesFilter filter(parameters);
+		for(int r=-1; r<g_repetitions; ++r)
+		{
+			UTimer timer;
+			filter.computePosterior(&memory, likelihood);
+			if(r>=0) samples.push_back(timer.ticks()*1000.0);
+		}
+		record("BayesFilter::computePosterior", params + " update", samples, (int)likelihood.size());
+	}
+}
+
+std::string resultToJson(const Result & result)
+{
+	return uFormat("{\"kernel\": %s, \"parameters\": %s, \"items\": %d, \"min_ms\": %f, \"median_ms\": %f, \"mean_ms\": %f, \"max_ms\": %f}",
+			jsonString(result.kernel).c_str(), jsonString(result.parameters).c_str(), result.items,
+			result.times.min, result.times.p50, result.times.mean, result.times.max);
+}
+
+// Value of a field in a line written by resultToJson()
+std::string jsonField(const std::string & line, const std::string & name)
+{
+	std::string key = "\"" + name + "\": ";
+	size_t start = line.find(key);
+	if(start == std::string::npos)
+	{
+		return "";
+	}
+	start += key.size();
+	if(line[start] == '"')
+	{
+		size_t end = line.find("\", \"", start+1);
+		return end==std::string::npos?"":line.substr(start+1, end-start-1);
+	}
+	size_t end = line.find_first_of(",}", start);
+	return end==std::string::npos?"":line.substr(start, end-start);
+}
+
+void writeJson(const std::string & path, const std::set<std::string> & kernels)
+{
+	std::ofstream file(path.c_str());
+	if(!file.is_open())
+	{
+		printf("Cannot write \"%s\"!\n", path.c_str());
+		return;
+	}
+	file << "{\"version\": " << jsonString(Parameters::getVersion()) << ", \"repetitions\": " << g_repetitions << ", \"threads\": " << threadsUsed()
+		 << ", \"kernels\": " << jsonString(kernels.empty()?"all":uJoin(std::list<std::string>(kernels.begin(), kernels.end()), " ")) << ",\n";
+	file << "\"results\": [\n";
+	for(unsigned int i=0; i<g_results.size(); ++i)
+	{
+		file << resultToJson(g_results[i]) << (i+1<g_results.size()?",":"") << "\n";
+	}
+	file << "]}\n";
+	printf("\nResults saved to \"%s\"\n", path.c_str());
+}
+
+// Returns the number of regressions
+int compareJson(const std::string & path, float threshold)
+{
+	std::ifstream file(path.c_str());
+	if(!file.is_open())
+	{
+		printf("Cannot read \"%s\"!\n", path.c_str());
+		return 0;
+	}
+	std::map<std::string, double> previous;
+	std::string line;
+	while(std::getline(file, line))
+	{
+		std::string kernel = jsonField(line, "kernel");
+		if(!kernel.empty())
+		{
+			previous.insert(std::make_pair(kernel + " " + jsonField(line, "parameters"), uStr2Double(jsonField(line, "median_ms"))));
+		}
+	}
+
+	printf("\nComparison with \"%s\" (median times)\n", path.c_str());
+	printf("%-64s %12s %12s %8s\n", "case", "before(ms)", "after(ms)", "ratio");
+	int regressions = 0;
+	for(unsigned int i=0; i<g_results.size(); ++i)
+	{
+		std::string name = g_results[i].kernel + " " + g_results[i].parameters;
+		std::map<std::string, double>::iterator iter = previous.find(name);
+		if(iter != previous.end() && iter->second > 0.0)
+		{
+			double ratio = g_results[i].times.p50 / iter->second;
+			bool regression = ratio > threshold;
+			regressions += regression?1:0;
+			printf("%-64s %12.3f %12.3f %8.2f%s\n", name.c_str(), iter->second, g_results[i].times.p50, ratio, regression?" REGRESSION":"");
+		}
+		else
+		{
+			printf("%-64s %12s %12.3f %8s\n", name.c_str(), "-", g_results[i].times.p50, "new");
+		}
+	}
+	return regressions;
+}
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	std::set<std::string> kernels;
+	std::string jsonPath;
+	std::string comparedPath;
+	float threshold = 1.1f;
+	for(int i=1; i<argc; ++i)
+	{
+		if(strcmp(argv[i], "-r") == 0 && i+1<argc)
+		{
+			g_repetitions = uStr2Int(argv[++i]);
+			if(g_repetitions <= 0)
+			{
+				showUsage();
+			}
+		}
+		else if(strcmp(argv[i], "-t") == 0 && i+1<argc)
+		{
+			g_threads = uStr2Int(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-v") == 0)
+		{
+			ULogger::setLevel(ULogger::kDebug);
+		}
+		else if(strcmp(argv[i], "-j") == 0 && i+1<argc)
+		{
+			jsonPath = argv[++i];
+		}
+		else if(strcmp(argv[i], "-c") == 0 && i+1<argc)
+		{
+			comparedPath = argv[++i];
+		}
+		else if(strcmp(argv[i], "-threshold") == 0 && i+1<argc)
+		{
+			threshold = uStr2Float(argv[++i]);
+		}
+		else if(argv[i][0] == '-')
+		{
+			showUsage();
+		}
+		else
+		{
+			kernels.insert(argv[i]);
+		}
+	}
+
+	if(kernels.empty() || kernels.find("stereo") != kernels.end())
+	{
+		benchmarkStereo();
+	}
+	if(kernels.empty() || kernels.find("features") != kernels.end())
+	{
+		benchmarkFeatures();
+	}
+	if(kernels.empty() || kernels.find("pyramid") != kernels.end())
+	{
+		benchmarkPyramidCache();
+	}
+	if(kernels.empty() || kernels.find("cloud") != kernels.end())
+	{
+		benchmarkCloud();
+	}
+	if(kernels.empty() || kernels.find("depth") != kernels.end())
+	{
+		benchmarkDepthRegistration();
+	}
+	if(kernels.empty() || kernels.find("grid") != kernels.end())
+	{
+		benchmarkOccupancyGrid();
+	}
+	if(kernels.empty() || kernels.find("logodds") != kernels.end())
+	{
+		benchmarkLogOddsGrid();
+	}
+	if(kernels.empty() || kernels.find("voxel") != kernels.end())
+	{
+		benchmarkVoxelOccupancyMap();
+	}
+	if(kernels.empty() || kernels.find("graph") != kernels.end())
+	{
+		benchmarkHierarchicalOptimization();
+	}
+	if(kernels.empty() || kernels.find("spatial") != kernels.end())
+	{
+		benchmarkSpatialIndex();
+	}
+	if(kernels.empty() || kernels.find("path") != kernels.end())
+	{
+		benchmarkPathPlanning();
+	}
+	if(kernels.empty() || kernels.find("scanmatch") != kernels.end())
+	{
+		benchmarkScanMatching();
+	}
+	if(kernels.empty() || kernels.find("logger") != kernels.end())
+	{
+		benchmarkLogger();
+	}
+	if(kernels.empty() || kernels.find("events") != kernels.end())
+	{
+		benchmarkEventsManager();
+	}
+	if(kernels.empty() || kernels.find("dictionary") != kernels.end())
+	{
+		benchmarkDictionary();
+	}
+	if(kernels.empty() || kernels.find("signature") != kernels.end())
+	{
+		benchmarkSignature();
+	}
+	if(kernels.empty() || kernels.find("pairs") != kernels.end())
+	{
+		benchmarkPairs();
+	}
+	if(kernels.empty() || kernels.find("voxelize") != kernels.end())
+	{
+		benchmarkVoxelize();
+	}
+	if(kernels.empty() || kernels.find("compression") != kernels.end())
+	{
+		benchmarkCompression();
+	}
+	if(kernels.empty() || kernels.find("bayes") != kernels.end())
+	{
+		benchmarkBayes();
+	}
+
+	if(!jsonPath.empty())
+	{
+		writeJson(jsonPath, kernels);
+	}
+	int regressions = 0;
+	if(!comparedPath.empty())
+	{
+		regressions = compareJson(comparedPath, threshold);
+		printf("%d regression(s) (ratio > %.2f)\n", regressions, threshold);
+	}
+
+	if(g_failures)
+	{
+		printf("\n%d correctness check(s) FAILED\n", g_failures);
+		return 1;
+	}
+	return regressions>0?2:0;
+}
@@ -0,0 +1,166 @@
+/*
+*  utilite is a cross-platform library with
+*  useful utilities for fast and small developing.
+*  Copyright (C) 2010  Mathieu Labbe
+*
+*  utilite is free library: you can redistribute it and/or modify
+*  it under the terms of the GNU Lesser General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  utilite is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UATOMIC_H
+#define UATOMIC_H
+
+/** \file UAtomic.h
+    \brief Atomic operations on integers and pointers (full memory barrier)
+*/
+
+#ifdef _WIN32
+  #include "rtabmap/utilite/Win32/UWin32.h"
+#endif
+
+/**
+ * Atomically increment the value.
+ * @return the incremented value
+ */
+inline int uAtomicIncrement(volatile int * value)
+{
+#ifdef _WIN32
+	return InterlockedIncrement((LONG volatile *)value);
+#else
+	return __sync_add_and_fetch(value, 1);
+#endif
+}
+
+/**
+ * Atomically increment the value.
+ * @return the incremented value
+ */
+inline long uAtomicIncrement(volatile long * value)
+{
+#ifdef _WIN32
+	return InterlockedIncrement((LONG volatile *)value);
+#else
+	return __sync_add_and_fetch(value, 1);
+#endif
+}
+
+/**
+ * Atomically decrement the value.
+ * @return the decremented value
+ */
+inline int uAtomicDecrement(volatile int * value)
+{
+#ifdef _WIN32
+	return InterlockedDecrement((LONG volatile *)value);
+#else
+	return __sync_sub_and_fetch(value, 1);
+#endif
+}
+
+/**
+ * Atomically decrement the value.
+ * @return the decremented value
+ */
+inline long uAtomicDecrement(volatile long * value)
+{
+#ifdef _WIN32
+	return InterlockedDecrement((LONG volatile *)value);
+#else
+	return __sync_sub_and_fetch(value, 1);
+#endif
+}
+
+/**
+ * Atomically add increment to the 64 bits value.
+ * @return the new value
+ */
+inline long long uAtomicAdd(volatile long long * value, long long increment)
+{
+#ifdef _WIN32
+	return InterlockedExchangeAdd64((LONGLONG volatile *)value, increment) + increment;
+#else
+	return __sync_add_and_fetch(value, increment);
+#endif
+}
+
+/**
+ * Atomically read the value.
+ */
+inline long uAtomicLoad(volatile long * value)
+{
+#ifdef _WIN32
+	return InterlockedCompareExchange((LONG volatile *)value, 0, 0);
+#else
+	return __sync_add_and_fetch(value, 0);
+#endif
+}
+
+/**
+ * Atomically read the 64 bits value (a plain read
+ * can be torn on 32 bits platforms).
+ */
+inline long long uAtomicLoad(volatile long long * value)
+{
+#ifdef _WIN32
+	return InterlockedCompareExchange64((LONGLONG volatile *)value, 0, 0);
+#else
+	return __sync_add_and_fetch(value, 0);
+#endif
+}
+
+/**
+ * Atomically set the value to exchange if it is equal to comparand.
+ * @return the previous value, the exchange is done if it is equal to comparand
+ */
+inline unsigned int uAtomicCompareExchange(volatile unsigned int * value, unsigned int exchange, unsigned int comparand)
+{
+#ifdef _WIN32
+	return (unsigned int)InterlockedCompareExchange((LONG volatile *)value, (LONG)exchange, (LONG)comparand);
+#else
+	return __sync_val_compare_and_swap(value, comparand, exchange);
+#endif
+}
+
+/**
+ * Atomically exchange the pointer.
+ * @return the previous pointer
+ */
+template<typename T>
+inline T * uAtomicExchange(T * volatile * ptr, T * value)
+{
+#ifdef _WIN32
+	return (T*)InterlockedExchangePointer((PVOID volatile *)ptr, value);
+#else
+	T * old;
+	do
+	{
+		old = *ptr;
+	}
+	while(__sync_val_compare_and_swap(ptr, old, value) != old);
+	return old;
+#endif
+}
+
+/**
+ * Full memory barrier.
+ */
+inline void uMemoryBarrier()
+{
+#ifdef _WIN32
+	MemoryBarrier();
+#else
+	__sync_synchronize();
+#endif
+}
+
+#endif /* UATOMIC_H */
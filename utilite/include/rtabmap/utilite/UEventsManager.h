@@ -29,6 +29,9 @@
 
 #include <list>
 #include <map>
+#include <vector>
+#include <string>
+#include <typeinfo>
 
 // TODO Not implemented... for multithreading event handling
 class UEventDispatcher : public UThread
@@ -69,6 +72,33 @@ private:
  *  UEventsManager::post(new MyEvent()); // where MyEvent is an implemented UEvent
  * @endcode
  *
+ * Asynchronous events are pushed on a lock-free queue (multiple producers,
+ * single consumer: the UEventsManager's thread), so posting never blocks on
+ * the dispatching. Each event type gets an integer id (see getEventTypeId()),
+ * the routing table (handlers and pipes indexed by event type) is rebuilt
+ * only when handlers or pipes change. Events are then appended to
+ * the delivery queue of each receiving handler, in the order they are posted.
+ *
+ * Delivery order: each handler receives events in the order they are posted
+ * (FIFO per handler), but the events dispatched together are delivered handler
+ * by handler: a handler receives all its pending events before the next handler
+ * receives its own. Handlers should not rely on the interleaving of events
+ * between handlers (e.g., that handler A has received event 2 before handler B
+ * receives event 1).
+ *
+ * By default, handlers are called by the UEventsManager's thread, so a slow
+ * handler delays the events of all other handlers. A handler can have its own
+ * mailbox (see setMailbox()): its events are then delivered by the mailbox's thread.
+ * The mailbox has a capacity and a policy per event type (see MailboxPolicy) to
+ * decide which events are dropped when the handler cannot keep up. Use
+ * getMailboxStatistics() to monitor the queue depth and the events dropped.
+ *
+ * @code
+ *  UEventsManager::addHandler(&viewer);
+ *  UEventsManager::setMailbox(&viewer, 10, UEventsManager::kMailboxKeepAll);
+ *  UEventsManager::setMailboxPolicy(&viewer, "OdometryEvent", UEventsManager::kMailboxCoalesceLatest);
+ * @endcode
+ *
  * @see UEvent
  * @see UEventsHandler
  * @see post()
@@ -77,6 +107,32 @@ private:
  */
 class UTILITE_EXP UEventsManager : public UThread{
 
+public:
+    enum MailboxPolicy {
+    	kMailboxKeepAll,        /* Never dropped, the mailbox can grow over its capacity. */
+    	kMailboxDropOldest,     /* When the mailbox is full, the oldest droppable event is dropped. */
+    	kMailboxCoalesceLatest  /* Replaces the waiting event of the same type and sender, if any, otherwise like kMailboxDropOldest. */
+    };
+
+    class MailboxStatistics
+    {
+    public:
+    	MailboxStatistics() :
+    		capacity(0),
+    		depth(0),
+    		maxDepth(0),
+    		delivered(0),
+    		dropped(0),
+    		coalesced(0)
+    	{}
+    	unsigned int capacity;
+    	unsigned int depth;      /* Events waiting to be delivered. */
+    	unsigned int maxDepth;   /* Since the mailbox creation. */
+    	unsigned long delivered;
+    	unsigned long dropped;
+    	unsigned long coalesced;
+    };
+
 public:
 
     /**
@@ -122,6 +178,41 @@ public:
     static void removeAllPipes(const UEventsSender * sender);
     static void removeNullPipes(const UEventsSender * sender);
 
+    /**
+     * Integer id of an event type. Ids are given in order of
+     * first use and are valid until the application exits.
+     * @param eventName the event's class name (see UEvent::getClassName())
+     */
+    static int getEventTypeId(const std::string & eventName);
+
+    /**
+     * Deliver events of the handler by its own thread. The handler should
+     * already be added with addHandler(). If the handler has already a mailbox, its
+     * capacity and default policy are updated. Note that synchronous events
+     * are still handled in the sender thread.
+     *
+     * @param handler the handler.
+     * @param capacity maximum events waiting in the mailbox (for droppable events).
+     * @param defaultPolicy policy of event types not set with setMailboxPolicy().
+     */
+    static void setMailbox(UEventsHandler * handler, unsigned int capacity, MailboxPolicy defaultPolicy = kMailboxDropOldest);
+
+    /**
+     * Set the policy of an event type for the mailbox of the handler.
+     */
+    static void setMailboxPolicy(UEventsHandler * handler, const std::string & eventName, MailboxPolicy policy);
+
+    /**
+     * The handler will be called by the UEventsManager's thread again. Events
+     * waiting in the mailbox are dropped.
+     */
+    static void removeMailbox(UEventsHandler * handler);
+
+    /**
+     * @return false if the handler doesn't have a mailbox.
+     */
+    static bool getMailboxStatistics(const UEventsHandler * handler, MailboxStatistics & statistics);
+
 protected:
 
     /*
@@ -173,10 +264,38 @@ private:
     virtual void dispatchEvents();
 
     /*
-	 * This method dispatches an event to all handlers.
+	 * This method dispatches an event to all handlers (used for synchronous events).
 	 */
     virtual void dispatchEvent(UEvent * event, const UEventsSender * sender);
 
+    /*
+     * Lock-free queue of posted events (MPSC), see _postEvent() and dispatchEvents().
+     */
+    class EventNode;
+    void pushEvent(UEvent * event, const UEventsSender * sender);
+    void pushNode(EventNode * node);
+    EventNode * popNode();
+    static void releaseEvent(EventNode * node); // the event is deleted when not referenced anymore
+
+    class Mailbox;
+    void _setMailbox(UEventsHandler * handler, unsigned int capacity, MailboxPolicy defaultPolicy);
+    void _setMailboxPolicy(UEventsHandler * handler, const std::string & eventName, MailboxPolicy policy);
+    void _removeMailbox(UEventsHandler * handler);
+    bool _getMailboxStatistics(const UEventsHandler * handler, MailboxStatistics & statistics);
+    void stopMailbox(Mailbox * mailbox);
+
+    /*
+     * Event type id of an event, cached by its C++ type (dispatching thread only).
+     */
+    int eventTypeId(const UEvent * event);
+    int _getEventTypeId(const std::string & eventName);
+
+    /*
+     * Rebuild the routing table if handlers or pipes have changed.
+     */
+    void updateRoutes();
+    void routesChanged();
+
     /*
      * This method is used to add an events 
      * handler to the list of handlers.
@@ -239,15 +358,64 @@ private:
     	const std::string eventName_;
     };
 
+    class EventNode
+    {
+    public:
+    	EventNode(UEvent * event = 0, const UEventsSender * sender = 0) :
+    		next_(0),
+    		event_(event),
+    		sender_(sender),
+    		refs_(1)
+    	{}
+    	EventNode * volatile next_;
+    	UEvent * event_;
+    	const UEventsSender * sender_;
+    	volatile int refs_; // dispatching thread and mailboxes
+    };
+
+    class HandlerEntry
+    {
+    public:
+    	HandlerEntry(UEventsHandler * handler) :
+    		handler_(handler),
+    		alive_(1),
+    		mailbox_(0)
+    	{}
+    	UEventsHandler * handler_;
+    	volatile int alive_; // set to 0 when the handler is removed
+    	std::vector<EventNode*> queue_; // delivery queue (dispatching thread only)
+    	Mailbox * volatile mailbox_;
+    };
+
+    class TypeInfoLess
+    {
+    public:
+    	bool operator()(const std::type_info * a, const std::type_info * b) const {return a->before(*b) != 0;}
+    };
+
     static UEventsManager* instance_;            /* The EventsManager instance pointer. */
     static UDestroyer<UEventsManager> destroyer_; /* The EventsManager's destroyer. */
-    std::list<std::pair<UEvent*, const UEventsSender * > > events_; /* The events list. */
+    EventNode * volatile eventsHead_;            /* Last posted event (producers). */
+    EventNode * eventsTail_;                     /* Next event to dispatch (consumer). */
+    EventNode eventsStub_;
     std::list<UEventsHandler*> handlers_;      /* The handlers list. */
-    UMutex eventsMutex_;                         /* The mutex of the events list, */
+    std::map<UEventsHandler*, HandlerEntry*> handlerEntries_;
+    std::list<HandlerEntry*> removedEntries_;  /* Deleted by the dispatching thread. */
+    std::list<Mailbox*> removedMailboxes_;      /* Deleted by the dispatching thread. */
     UMutex handlersMutex_;                       /* The mutex of the handlers list. */
     USemaphore postEventSem_;                    /* Semaphore used to signal when an events is posted. */
     std::list<Pipe> pipes_;
     UMutex pipesMutex_;
+
+    std::map<std::string, int> typeIds_;
+    UMutex typeIdsMutex_;
+    std::map<const std::type_info*, int, TypeInfoLess> typeInfoIds_; /* dispatching thread only */
+
+    // Routing table, used only by the dispatching thread
+    volatile int routesVersion_;
+    int routesBuiltVersion_;
+    std::vector<HandlerEntry*> routeHandlers_;
+    std::vector<std::map<const UEventsSender*, std::vector<HandlerEntry*> > > routePipes_; /* indexed by event type id */
 };
 
 #endif // UEVENTSMANAGER_H
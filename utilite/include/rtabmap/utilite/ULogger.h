@@ -323,6 +323,47 @@ public:
     static void setBuffered(bool buffered);
     static bool isBuffered() {return buffered_;}
 
+    /**
+     * Set if messages are written asynchronously, default false. When true, the
+     * calling thread only formats the message in its own ring buffer (without
+     * locking), the prefix (level, time, where) is formatted and written with the
+     * message by a background thread. If the ring buffer of a thread is full, the
+     * thread waits for the writer, or the messages are dropped if dropWhenFull is
+     * true (the number of messages dropped is logged). Fatal messages and ULogEvent
+     * are still handled synchronously. The print options (time, where, thread id...)
+     * are applied when the messages are written.
+     * Call ULogger::flush() to write all messages already logged.
+     * Each logging thread has its own ring buffer of ringSize messages (~300 bytes
+     * each), the ring buffers of exited threads are reused by new threads and
+     * released when the asynchronous mode is disabled.
+     * @param asynchronous true to write messages in a background thread, otherwise set to false.
+     * @param dropWhenFull drop messages instead of waiting when a ring buffer is full.
+     * @param ringSize messages per thread (rounded up to a power of 2), used by the
+     *        ring buffers assigned to threads after this call.
+     */
+    static void setAsynchronous(bool asynchronous, bool dropWhenFull = false, unsigned int ringSize = 256);
+    static bool isAsynchronous() {return asynchronous_;}
+
+    /**
+     * Set the maximum messages logged per second from the same line of code
+     * (per thread), default 0 (no limit). Only used when the logger is asynchronous.
+     * The number of messages ignored is shown with the next message logged
+     * from the same line.
+     * @param messagesPerSecond maximum messages per second, 0 means no limit.
+     */
+    static void setRateLimit(int messagesPerSecond) {rateLimit_ = messagesPerSecond;}
+    static int rateLimit() {return rateLimit_;}
+
+    /**
+     * Total messages dropped because a ring buffer was full (asynchronous mode).
+     */
+    static unsigned long droppedMessages();
+
+    /**
+     * Total messages ignored by the rate limit (asynchronous mode).
+     */
+    static unsigned long suppressedMessages();
+
     /**
      * Set logger level: default kInfo. All messages over the severity set
      * are printed, other are ignored. The severity is from the lowest to
@@ -352,8 +393,10 @@ public:
     static void reset();
 
     /**
-	 * Flush buffered messages.
+	 * Flush buffered messages. In asynchronous mode, messages logged
+	 * before this call are written.
 	 * @see setBuffered()
+	 * @see setAsynchronous()
 	 */
 	static void flush();
 
@@ -447,6 +490,39 @@ private:
      */
     static ULogger* createInstance();
 
+    /*
+     * Level, thread id, time and where strings printed before the message.
+     */
+    static void getPrefix(ULogger::Level level,
+    		const char * file,
+    		int line,
+    		const char * function,
+    		unsigned long threadId,
+    		time_t seconds,
+    		int microseconds,
+    		std::string & levelStr,
+    		std::string & pidStr,
+    		std::string & timeStr,
+    		std::string & whereStr);
+
+    /*
+     * Asynchronous mode: push the message in the ring buffer of the calling thread.
+     */
+    static void writeAsync(ULogger::Level level,
+    		const char * file,
+    		int line,
+    		const char * function,
+    		const char* msg,
+    		va_list args);
+
+    /*
+     * Asynchronous mode: write the messages of all ring buffers, called
+     * by the writer thread and flush().
+     * @return the number of messages written
+     */
+    static int writeAsyncMessages();
+    friend class UAsyncLogWriter;
+
     /*
      * Write a message on the output with the format :
      * "A message". Inherited class
@@ -550,6 +626,24 @@ private:
 	static bool buffered_;
 
 	static std::string bufferedMsgs_;
+
+	/*
+	 * If messages are written by a background thread.
+	 * Default is false.
+	 */
+	static bool asynchronous_;
+
+	/*
+	 * If messages are dropped when a ring buffer is full in asynchronous mode.
+	 * Default is false.
+	 */
+	static bool asynchronousDrop_;
+
+	/*
+	 * Maximum messages per second per call site in asynchronous mode, 0 means no limit.
+	 * Default is 0.
+	 */
+	static int rateLimit_;
 };
 
 #endif // ULOGGER_H
@@ -113,6 +113,11 @@ public:
 
 				timeToWait.tv_sec = now.tv_sec + ms/1000;
 				timeToWait.tv_nsec = (now.tv_usec+1000UL*(ms%1000))*1000UL;
+				if(timeToWait.tv_nsec >= 1000000000L)
+				{
+					timeToWait.tv_sec += timeToWait.tv_nsec / 1000000000L;
+					timeToWait.tv_nsec %= 1000000000L;
+				}
 
 				rt = pthread_cond_timedwait(&_cond, &_waitMutex, &timeToWait);
 			}
@@ -20,11 +20,191 @@
 #include "rtabmap/utilite/UEventsManager.h"
 #include "rtabmap/utilite/UEvent.h"
 #include <list>
+#include <deque>
 #include "rtabmap/utilite/UStl.h"
+#include "rtabmap/utilite/UAtomic.h"
 
 UEventsManager* UEventsManager::instance_ = 0;
 UDestroyer<UEventsManager> UEventsManager::destroyer_;
 
+/*
+ * Events of a handler delivered by its own thread.
+ */
+class UEventsManager::Mailbox : public UThread
+{
+public:
+	Mailbox(UEventsHandler * handler, unsigned int capacity, MailboxPolicy defaultPolicy) :
+		handler_(handler),
+		capacity_(capacity),
+		defaultPolicy_(defaultPolicy),
+		deliveringThreadId_(0),
+		maxDepth_(0),
+		delivered_(0),
+		dropped_(0),
+		coalesced_(0)
+	{}
+	virtual ~Mailbox()
+	{
+		this->join(true);
+		for(std::deque<Item>::iterator iter=queue_.begin(); iter!=queue_.end(); ++iter)
+		{
+			UEventsManager::releaseEvent(iter->node);
+		}
+	}
+
+	void setCapacity(unsigned int capacity, MailboxPolicy defaultPolicy)
+	{
+		mutex_.lock();
+		capacity_ = capacity;
+		defaultPolicy_ = defaultPolicy;
+		mutex_.unlock();
+	}
+
+	void setPolicy(int type, MailboxPolicy policy)
+	{
+		mutex_.lock();
+		policies_[type] = policy;
+		mutex_.unlock();
+	}
+
+	bool isDeliveringThread() const
+	{
+		return deliveringThreadId_ == UThread::currentThreadId();
+	}
+
+	// Called by the dispatching thread, the mailbox takes a reference on the event
+	void push(EventNode * node, int type)
+	{
+		mutex_.lock();
+		if(this->isKilled())
+		{
+			mutex_.unlock();
+			UEventsManager::releaseEvent(node);
+			return;
+		}
+
+		std::map<int, MailboxPolicy>::iterator policyIter = policies_.find(type);
+		MailboxPolicy policy = policyIter!=policies_.end()?policyIter->second:defaultPolicy_;
+		if(policy == kMailboxCoalesceLatest)
+		{
+			for(std::deque<Item>::reverse_iterator iter=queue_.rbegin(); iter!=queue_.rend(); ++iter)
+			{
+				if(iter->type == type && iter->node->sender_ == node->sender_)
+				{
+					UEventsManager::releaseEvent(iter->node);
+					iter->node = node;
+					++coalesced_;
+					mutex_.unlock();
+					return;
+				}
+			}
+		}
+
+		if(queue_.size() >= capacity_)
+		{
+			std::deque<Item>::iterator iter = queue_.begin();
+			while(iter!=queue_.end() && iter->policy == kMailboxKeepAll)
+			{
+				++iter;
+			}
+			if(iter != queue_.end())
+			{
+				UEventsManager::releaseEvent(iter->node);
+				queue_.erase(iter);
+				++dropped_;
+			}
+			else if(policy != kMailboxKeepAll)
+			{
+				++dropped_;
+				mutex_.unlock();
+				UEventsManager::releaseEvent(node);
+				return;
+			}
+		}
+
+		queue_.push_back(Item(node, type, policy));
+		if(queue_.size() > maxDepth_)
+		{
+			maxDepth_ = (unsigned int)queue_.size();
+		}
+		mutex_.unlock();
+		sem_.release();
+	}
+
+	MailboxStatistics statistics() const
+	{
+		MailboxStatistics statistics;
+		mutex_.lock();
+		statistics.capacity = capacity_;
+		statistics.depth = (unsigned int)queue_.size();
+		statistics.maxDepth = maxDepth_;
+		statistics.delivered = delivered_;
+		statistics.dropped = dropped_;
+		statistics.coalesced = coalesced_;
+		mutex_.unlock();
+		return statistics;
+	}
+
+private:
+	virtual void mainLoopBegin()
+	{
+		deliveringThreadId_ = UThread::currentThreadId();
+	}
+
+	virtual void mainLoop()
+	{
+		sem_.acquire();
+		while(!this->isKilled())
+		{
+			mutex_.lock();
+			if(queue_.empty())
+			{
+				mutex_.unlock();
+				break;
+			}
+			Item item = queue_.front();
+			queue_.pop_front();
+			++delivered_;
+			mutex_.unlock();
+
+			// Don't process event if the handler is the same as the sender
+			if(handler_ != item.node->sender_)
+			{
+				handler_->handleEvent(item.node->event_);
+			}
+			UEventsManager::releaseEvent(item.node);
+		}
+	}
+
+	virtual void mainLoopKill()
+	{
+		sem_.release();
+	}
+
+private:
+	class Item
+	{
+	public:
+		Item(EventNode * n, int t, MailboxPolicy p) : node(n), type(t), policy(p) {}
+		EventNode * node;
+		int type;
+		MailboxPolicy policy;
+	};
+
+	UEventsHandler * handler_;
+	unsigned int capacity_;
+	MailboxPolicy defaultPolicy_;
+	std::map<int, MailboxPolicy> policies_;
+	volatile unsigned long deliveringThreadId_;
+	std::deque<Item> queue_;
+	UMutex mutex_;
+	USemaphore sem_;
+	unsigned int maxDepth_;
+	unsigned long delivered_;
+	unsigned long dropped_;
+	unsigned long coalesced_;
+};
+
 void UEventsManager::addHandler(UEventsHandler* handler)
 {
 	if(!handler)
@@ -122,6 +302,60 @@ void UEventsManager::removeNullPipes(const UEventsSender * sender)
 	}
 }
 
+int UEventsManager::getEventTypeId(const std::string & eventName)
+{
+	return UEventsManager::getInstance()->_getEventTypeId(eventName);
+}
+
+void UEventsManager::setMailbox(UEventsHandler * handler, unsigned int capacity, MailboxPolicy defaultPolicy)
+{
+	if(!handler || capacity == 0)
+	{
+		UERROR("Handler is null or capacity is 0!");
+		return;
+	}
+	else
+	{
+		UEventsManager::getInstance()->_setMailbox(handler, capacity, defaultPolicy);
+	}
+}
+
+void UEventsManager::setMailboxPolicy(UEventsHandler * handler, const std::string & eventName, MailboxPolicy policy)
+{
+	if(!handler)
+	{
+		UERROR("Handler is null!");
+		return;
+	}
+	else
+	{
+		UEventsManager::getInstance()->_setMailboxPolicy(handler, eventName, policy);
+	}
+}
+
+void UEventsManager::removeMailbox(UEventsHandler * handler)
+{
+	if(!handler)
+	{
+		UERROR("Handler is null!");
+		return;
+	}
+	else
+	{
+		UEventsManager::getInstance()->_removeMailbox(handler);
+	}
+}
+
+bool UEventsManager::getMailboxStatistics(const UEventsHandler * handler, MailboxStatistics & statistics)
+{
+	if(!handler)
+	{
+		UERROR("Handler is null!");
+		return false;
+	}
+	return UEventsManager::getInstance()->_getMailboxStatistics(handler, statistics);
+}
+
 UEventsManager* UEventsManager::getInstance()
 {
     if(!instance_)
@@ -133,7 +367,11 @@ UEventsManager* UEventsManager::getInstance()
     return instance_;
 }
 
-UEventsManager::UEventsManager()
+UEventsManager::UEventsManager() :
+	eventsHead_(&eventsStub_),
+	eventsTail_(&eventsStub_),
+	routesVersion_(1),
+	routesBuiltVersion_(0)
 {
 }
 
@@ -142,13 +380,29 @@ UEventsManager::~UEventsManager()
    	join(true);
 
     // Free memory
-    for(std::list<std::pair<UEvent*, const UEventsSender*> >::iterator it=events_.begin(); it!=events_.end(); ++it)
+    EventNode * node = 0;
+    while((node = popNode()) != 0)
     {
-        delete it->first;
+        releaseEvent(node);
     }
-    events_.clear();
 
     handlers_.clear();
+    for(std::map<UEventsHandler*, HandlerEntry*>::iterator iter=handlerEntries_.begin(); iter!=handlerEntries_.end(); ++iter)
+    {
+    	delete iter->second->mailbox_;
+    	delete iter->second;
+    }
+    handlerEntries_.clear();
+    for(std::list<HandlerEntry*>::iterator iter=removedEntries_.begin(); iter!=removedEntries_.end(); ++iter)
+    {
+    	delete *iter;
+    }
+    removedEntries_.clear();
+    for(std::list<Mailbox*>::iterator iter=removedMailboxes_.begin(); iter!=removedMailboxes_.end(); ++iter)
+    {
+    	delete *iter;
+    }
+    removedMailboxes_.clear();
 
     instance_ = 0;
 }
@@ -169,31 +423,329 @@ void UEventsManager::mainLoopKill()
 
 void UEventsManager::dispatchEvents()
 {
-    if(events_.size() == 0)
-    {
-        return;
-    }
+	// Take all events posted until now, other threads
+	// can post events while events are handled.
+	std::vector<EventNode*> events;
+	EventNode * node = 0;
+	while((node = popNode()) != 0)
+	{
+		events.push_back(node);
+	}
+	if(events.empty())
+	{
+		return;
+	}
 
-    std::list<std::pair<UEvent*, const UEventsSender*> >::iterator it;
-    std::list<std::pair<UEvent*, const UEventsSender*> > eventsBuf;
+	updateRoutes();
 
-    // Copy events in a buffer :
-    // Other threads can post events 
-    // while events are handled.
-    eventsMutex_.lock();
-    {
-        eventsBuf = events_;
-        events_.clear();
-    }
-    eventsMutex_.unlock();
+	// Route events to the mailbox or the delivery queue of their handlers
+	std::vector<HandlerEntry*> receivers;
+	for(unsigned int i=0; i<events.size(); ++i)
+	{
+		node = events[i];
+		int type = eventTypeId(node->event_);
+		const std::vector<HandlerEntry*> * handlers = &routeHandlers_;
+		if(node->sender_ && type < (int)routePipes_.size())
+		{
+			// Verify if there are pipes with the sender for his type of event
+			std::map<const UEventsSender*, std::vector<HandlerEntry*> >::const_iterator iter = routePipes_[type].find(node->sender_);
+			if(iter != routePipes_[type].end())
+			{
+				handlers = &iter->second;
+			}
+		}
+		for(unsigned int j=0; j<handlers->size(); ++j)
+		{
+			HandlerEntry * entry = handlers->at(j);
+			Mailbox * mailbox = entry->mailbox_;
+			if(mailbox)
+			{
+				uAtomicIncrement(&node->refs_);
+				mailbox->push(node, type);
+			}
+			else
+			{
+				if(entry->queue_.empty())
+				{
+					receivers.push_back(entry);
+				}
+				entry->queue_.push_back(node);
+			}
+		}
+	}
 
-	// Past events to handlers
-	for(it=eventsBuf.begin(); it!=eventsBuf.end(); ++it)
+	// Past events to handlers without mailbox
+	for(unsigned int i=0; i<receivers.size(); ++i)
 	{
-		dispatchEvent(it->first, it->second);
-		delete it->first;
+		HandlerEntry * entry = receivers[i];
+		for(unsigned int j=0; j<entry->queue_.size(); ++j)
+		{
+			// The handler may have been removed by a previous handleEvent() call or
+			// by another thread. Don't process event if the handler is the same as the sender.
+			if(entry->alive_ && entry->handler_ != entry->queue_[j]->sender_)
+			{
+				entry->handler_->handleEvent(entry->queue_[j]->event_);
+			}
+		}
+		entry->queue_.clear();
 	}
-    eventsBuf.clear();
+
+	for(unsigned int i=0; i<events.size(); ++i)
+	{
+		releaseEvent(events[i]);
+	}
+}
+
+void UEventsManager::releaseEvent(EventNode * node)
+{
+	if(uAtomicDecrement(&node->refs_) == 0)
+	{
+		delete node->event_;
+		delete node;
+	}
+}
+
+void UEventsManager::pushEvent(UEvent * event, const UEventsSender * sender)
+{
+	pushNode(new EventNode(event, sender));
+}
+
+void UEventsManager::pushNode(EventNode * node)
+{
+	node->next_ = 0;
+	EventNode * previous = uAtomicExchange(&eventsHead_, node);
+	// Between the exchange and this link, the consumer sees
+	// the queue empty from previous (see popEvent()).
+	previous->next_ = node;
+}
+
+UEventsManager::EventNode * UEventsManager::popNode()
+{
+	// Only called by the dispatching thread
+	EventNode * tail = eventsTail_;
+	EventNode * next = tail->next_;
+	if(tail == &eventsStub_)
+	{
+		if(next == 0)
+		{
+			return 0;
+		}
+		eventsTail_ = next;
+		tail = next;
+		next = next->next_;
+	}
+	if(next == 0)
+	{
+		if(tail != eventsHead_)
+		{
+			// A producer is pushing, its event will be
+			// dispatched on its semaphore release.
+			return 0;
+		}
+		// Put back the stub to be able to take the last node
+		pushNode(&eventsStub_);
+		next = tail->next_;
+		if(next == 0)
+		{
+			return 0;
+		}
+	}
+	uMemoryBarrier();
+	eventsTail_ = next;
+	return tail;
+}
+
+int UEventsManager::eventTypeId(const UEvent * event)
+{
+	// getClassName() returns the same name for all events of the same C++ type,
+	// cache its id to avoid string allocations and comparisons
+	const std::type_info * type = &typeid(*event);
+	std::map<const std::type_info*, int, TypeInfoLess>::iterator iter = typeInfoIds_.find(type);
+	if(iter != typeInfoIds_.end())
+	{
+		return iter->second;
+	}
+	int id = _getEventTypeId(event->getClassName());
+	typeInfoIds_.insert(std::make_pair(type, id));
+	return id;
+}
+
+int UEventsManager::_getEventTypeId(const std::string & eventName)
+{
+	typeIdsMutex_.lock();
+	int id;
+	std::map<std::string, int>::iterator iter = typeIds_.find(eventName);
+	if(iter != typeIds_.end())
+	{
+		id = iter->second;
+	}
+	else
+	{
+		id = (int)typeIds_.size();
+		typeIds_.insert(std::make_pair(eventName, id));
+	}
+	typeIdsMutex_.unlock();
+	return id;
+}
+
+void UEventsManager::routesChanged()
+{
+	uAtomicIncrement(&routesVersion_);
+}
+
+void UEventsManager::updateRoutes()
+{
+	uMemoryBarrier();
+	if(routesBuiltVersion_ == routesVersion_)
+	{
+		return;
+	}
+
+	pipesMutex_.lock();
+	handlersMutex_.lock();
+
+	routesBuiltVersion_ = routesVersion_;
+
+	routeHandlers_.clear();
+	for(std::list<UEventsHandler*>::iterator iter=handlers_.begin(); iter!=handlers_.end(); ++iter)
+	{
+		std::map<UEventsHandler*, HandlerEntry*>::iterator jter = handlerEntries_.find(*iter);
+		if(jter != handlerEntries_.end())
+		{
+			routeHandlers_.push_back(jter->second);
+		}
+	}
+
+	routePipes_.clear();
+	for(std::list<Pipe>::iterator iter=pipes_.begin(); iter!= pipes_.end(); ++iter)
+	{
+		int type = _getEventTypeId(iter->eventName_);
+		if(type >= (int)routePipes_.size())
+		{
+			routePipes_.resize(type+1);
+		}
+		// Pipes to removed handlers are kept: the events are not sent to all handlers
+		std::vector<HandlerEntry*> & receivers = routePipes_[type][iter->sender_];
+		if(iter->receiver_)
+		{
+			std::map<UEventsHandler*, HandlerEntry*>::iterator jter = handlerEntries_.find((UEventsHandler*)iter->receiver_);
+			if(jter != handlerEntries_.end())
+			{
+				receivers.push_back(jter->second);
+			}
+		}
+	}
+
+	// Not referenced anymore by the routing table
+	std::list<HandlerEntry*> removedEntries = removedEntries_;
+	std::list<Mailbox*> removedMailboxes = removedMailboxes_;
+	removedEntries_.clear();
+	removedMailboxes_.clear();
+
+	handlersMutex_.unlock();
+	pipesMutex_.unlock();
+
+	for(std::list<HandlerEntry*>::iterator iter=removedEntries.begin(); iter!=removedEntries.end(); ++iter)
+	{
+		delete *iter;
+	}
+	// outside the locks, a mailbox may still finish its last event
+	for(std::list<Mailbox*>::iterator iter=removedMailboxes.begin(); iter!=removedMailboxes.end(); ++iter)
+	{
+		delete *iter;
+	}
+}
+
+void UEventsManager::_setMailbox(UEventsHandler * handler, unsigned int capacity, MailboxPolicy defaultPolicy)
+{
+	handlersMutex_.lock();
+	std::map<UEventsHandler*, HandlerEntry*>::iterator iter = handlerEntries_.find(handler);
+	if(iter == handlerEntries_.end())
+	{
+		UERROR("Cannot set the mailbox because the handler %p is not yet "
+			   "added to UEventsManager's handlers list.", handler);
+	}
+	else if(iter->second->mailbox_)
+	{
+		iter->second->mailbox_->setCapacity(capacity, defaultPolicy);
+	}
+	else
+	{
+		Mailbox * mailbox = new Mailbox(handler, capacity, defaultPolicy);
+		mailbox->start();
+		uMemoryBarrier();
+		iter->second->mailbox_ = mailbox;
+	}
+	handlersMutex_.unlock();
+}
+
+void UEventsManager::_setMailboxPolicy(UEventsHandler * handler, const std::string & eventName, MailboxPolicy policy)
+{
+	int type = _getEventTypeId(eventName);
+	handlersMutex_.lock();
+	std::map<UEventsHandler*, HandlerEntry*>::iterator iter = handlerEntries_.find(handler);
+	if(iter == handlerEntries_.end() || iter->second->mailbox_ == 0)
+	{
+		UERROR("Handler %p doesn't have a mailbox, call setMailbox() first.", handler);
+	}
+	else
+	{
+		iter->second->mailbox_->setPolicy(type, policy);
+	}
+	handlersMutex_.unlock();
+}
+
+void UEventsManager::_removeMailbox(UEventsHandler * handler)
+{
+	Mailbox * mailbox = 0;
+	handlersMutex_.lock();
+	std::map<UEventsHandler*, HandlerEntry*>::iterator iter = handlerEntries_.find(handler);
+	if(iter != handlerEntries_.end())
+	{
+		mailbox = iter->second->mailbox_;
+		iter->second->mailbox_ = 0;
+	}
+	handlersMutex_.unlock();
+
+	if(mailbox)
+	{
+		stopMailbox(mailbox);
+	}
+}
+
+bool UEventsManager::_getMailboxStatistics(const UEventsHandler * handler, MailboxStatistics & statistics)
+{
+	bool found = false;
+	handlersMutex_.lock();
+	std::map<UEventsHandler*, HandlerEntry*>::iterator iter = handlerEntries_.find((UEventsHandler*)handler);
+	if(iter != handlerEntries_.end() && iter->second->mailbox_)
+	{
+		statistics = iter->second->mailbox_->statistics();
+		found = true;
+	}
+	handlersMutex_.unlock();
+	return found;
+}
+
+void UEventsManager::stopMailbox(Mailbox * mailbox)
+{
+	// Wait the event being handled, if any, as the handler may be deleted after
+	// removeHandler(). If we are in the handleEvent() of the mailbox, the
+	// thread will stop after it.
+	if(mailbox->isDeliveringThread())
+	{
+		mailbox->kill();
+	}
+	else
+	{
+		mailbox->join(true);
+	}
+
+	// The dispatching thread may still push events in it, delete it on the next update of the routes
+	handlersMutex_.lock();
+	removedMailboxes_.push_back(mailbox);
+	handlersMutex_.unlock();
+	routesChanged();
 }
 
 void UEventsManager::dispatchEvent(UEvent * event, const UEventsSender * sender)
@@ -255,6 +807,8 @@ void UEventsManager::_addHandler(UEventsHandler* handler)
         	if(!handlerFound)
         	{
         		handlers_.push_back(handler);
+        		handlerEntries_.insert(std::make_pair(handler, new HandlerEntry(handler)));
+        		routesChanged();
         	}
         }
         handlersMutex_.unlock();
@@ -265,6 +819,7 @@ void UEventsManager::_removeHandler(UEventsHandler* handler)
 {
     if(!this->isKilled())
     {
+        Mailbox * mailbox = 0;
         handlersMutex_.lock();
         {
             for (std::list<UEventsHandler*>::iterator it = handlers_.begin(); it!=handlers_.end(); ++it)
@@ -275,9 +830,26 @@ void UEventsManager::_removeHandler(UEventsHandler* handler)
                     break;
                 }
             }
+            std::map<UEventsHandler*, HandlerEntry*>::iterator iter = handlerEntries_.find(handler);
+            if(iter != handlerEntries_.end())
+            {
+            	// The entry may still be in the routing table, it is
+            	// deleted by the dispatching thread
+            	iter->second->alive_ = 0;
+            	mailbox = iter->second->mailbox_;
+            	iter->second->mailbox_ = 0;
+            	removedEntries_.push_back(iter->second);
+            	handlerEntries_.erase(iter);
+            	routesChanged();
+            }
         }
         handlersMutex_.unlock();
 
+        if(mailbox)
+        {
+        	stopMailbox(mailbox);
+        }
+
         pipesMutex_.lock();
         {
         	for(std::list<Pipe>::iterator iter=pipes_.begin(); iter!= pipes_.end(); ++iter)
@@ -287,6 +859,7 @@ void UEventsManager::_removeHandler(UEventsHandler* handler)
 					iter->receiver_ = 0; // set to null
 				}
 			}
+			routesChanged();
         }
         pipesMutex_.unlock();
     }
@@ -298,11 +871,7 @@ void UEventsManager::_postEvent(UEvent * event, bool async, const UEventsSender
     {
     	if(async)
     	{
-			eventsMutex_.lock();
-			{
-				events_.push_back(std::make_pair(event, sender));
-			}
-			eventsMutex_.unlock();
+			pushEvent(event, sender);
 
 			// Signal the EventsManager that an Event is added
 			postEventSem_.release();
@@ -389,6 +958,7 @@ void UEventsManager::_createPipe(
 		if(handlerFound)
 		{
 			pipes_.push_back(Pipe(sender, receiver, eventName));
+			routesChanged();
 		}
 		else
 		{
@@ -430,6 +1000,10 @@ void UEventsManager::_removePipe(
 		UWARN("Pipe between sender %p and receiver %p with event %s didn't exist.",
 				sender, receiver, eventName.c_str());
 	}
+	else
+	{
+		routesChanged();
+	}
 
 	pipesMutex_.unlock();
 }
@@ -448,6 +1022,7 @@ void UEventsManager::_removeAllPipes(const UEventsSender * sender)
 			++iter;
 		}
 	}
+	routesChanged();
 	pipesMutex_.unlock();
 }
 
@@ -465,5 +1040,6 @@ void UEventsManager::_removeNullPipes(const UEventsSender * sender)
 			++iter;
 		}
 	}
+	routesChanged();
 	pipesMutex_.unlock();
 }
@@ -22,12 +22,19 @@
 #include "rtabmap/utilite/UFile.h"
 #include "rtabmap/utilite/UStl.h"
 #include "rtabmap/utilite/UEventsManager.h"
+#include "rtabmap/utilite/UThread.h"
+#include "rtabmap/utilite/USemaphore.h"
+#include "rtabmap/utilite/UAtomic.h"
 #include <fstream>
 #include <string>
 #include <string.h>
+#include <list>
+#include <vector>
+#include <algorithm>
 
 #ifndef _WIN32
 #include <sys/time.h>
+#include <pthread.h>
 #endif
 
 #ifdef _WIN32
@@ -63,6 +70,337 @@ UMutex ULogger::loggerMutex_;
 const std::string ULogger::kDefaultLogFileName = "./ULog.txt";
 std::string ULogger::logFileName_;
 std::string ULogger::bufferedMsgs_;
+bool ULogger::asynchronous_ = false;
+bool ULogger::asynchronousDrop_ = false;
+int ULogger::rateLimit_ = 0;
+
+namespace {
+
+#ifdef _WIN32
+int uLevelColor(ULogger::Level level)
+#else
+const char * uLevelColor(ULogger::Level level)
+#endif
+{
+	switch(level)
+	{
+	case ULogger::kDebug:
+		return COLOR_GREEN;
+	case ULogger::kWarning:
+		return COLOR_YELLOW;
+	case ULogger::kError:
+	case ULogger::kFatal:
+		return COLOR_RED;
+	default:
+		return COLOR_NORMAL;
+	}
+}
+
+void uNowTime(time_t & seconds, int & microseconds)
+{
+#ifdef _WIN32
+	time(&seconds);
+	microseconds = 0;
+#else
+	struct timeval rawtime;
+	gettimeofday(&rawtime, NULL);
+	seconds = rawtime.tv_sec;
+	microseconds = rawtime.tv_usec;
+#endif
+}
+
+int uFormatTime(std::string &timeStr, time_t rawtime, int microseconds)
+{
+    struct tm timeinfo;
+    const int bufSize = 30;
+    char buf[bufSize] = {0};
+
+#if _MSC_VER
+    localtime_s (&timeinfo, &rawtime );
+    int result = sprintf_s(buf, bufSize, "%d-%s%d-%s%d %s%d:%s%d:%s%d",
+        timeinfo.tm_year+1900,
+        (timeinfo.tm_mon+1) < 10 ? "0":"", timeinfo.tm_mon+1,
+        (timeinfo.tm_mday) < 10 ? "0":"", timeinfo.tm_mday,
+        (timeinfo.tm_hour) < 10 ? "0":"", timeinfo.tm_hour,
+        (timeinfo.tm_min) < 10 ? "0":"", timeinfo.tm_min,
+        (timeinfo.tm_sec) < 10 ? "0":"", timeinfo.tm_sec);
+#elif WIN32
+    timeinfo = *localtime (&rawtime);
+    int result = snprintf(buf, bufSize, "%d-%s%d-%s%d %s%d:%s%d:%s%d",
+		timeinfo.tm_year+1900,
+		(timeinfo.tm_mon+1) < 10 ? "0":"", timeinfo.tm_mon+1,
+		(timeinfo.tm_mday) < 10 ? "0":"", timeinfo.tm_mday,
+		(timeinfo.tm_hour) < 10 ? "0":"", timeinfo.tm_hour,
+		(timeinfo.tm_min) < 10 ? "0":"", timeinfo.tm_min,
+		(timeinfo.tm_sec) < 10 ? "0":"", timeinfo.tm_sec);
+ #else
+    localtime_r (&rawtime, &timeinfo);
+	int result = snprintf(buf, bufSize, "%d-%s%d-%s%d %s%d:%s%d:%s%d.%s%d",
+		timeinfo.tm_year+1900,
+		(timeinfo.tm_mon+1) < 10 ? "0":"", timeinfo.tm_mon+1,
+		(timeinfo.tm_mday) < 10 ? "0":"", timeinfo.tm_mday,
+		(timeinfo.tm_hour) < 10 ? "0":"", timeinfo.tm_hour,
+		(timeinfo.tm_min) < 10 ? "0":"", timeinfo.tm_min,
+		(timeinfo.tm_sec) < 10 ? "0":"", timeinfo.tm_sec,
+	    (microseconds/1000) < 10 ? "00":(microseconds/1000) < 100?"0":"", int(microseconds/1000));
+#endif
+    if(result)
+    {
+        timeStr.append(buf);
+    }
+    return result;
+}
+
+//
+// Asynchronous mode
+//
+const unsigned int kDefaultRingSize = 256; // records per thread (~300 bytes each)
+const int kMessageSize = 256; // longer messages are allocated
+const unsigned int kCallSites = 64;
+const unsigned int kWriterPeriodMs = 10;
+
+volatile long g_droppedMessages = 0;
+volatile long g_suppressedMessages = 0;
+
+class ULogRecord
+{
+public:
+	ULogRecord() :
+		level(ULogger::kDebug),
+		file(0),
+		line(0),
+		function(0),
+		seconds(0),
+		microseconds(0),
+		suppressed(0),
+		longMessage(0)
+	{
+		message[0] = 0;
+	}
+	ULogger::Level level;
+	const char * file;
+	int line;
+	const char * function;
+	time_t seconds;
+	int microseconds;
+	unsigned int suppressed; // messages of this call site ignored by the rate limit
+	char message[kMessageSize];
+	std::string * longMessage;
+};
+
+// Records are pushed only by the owner thread (head_) and popped only by
+// the writer (tail_), so no lock is needed.
+class ULogRing
+{
+public:
+	ULogRing(unsigned int size) {reset(0, size);}
+	void reset(unsigned long threadId, unsigned int size)
+	{
+		head_ = 0;
+		tail_ = 0;
+		exited_ = false;
+		threadId_ = threadId;
+		memset(sites_, 0, sizeof(sites_));
+		if(records_.size() != size)
+		{
+			std::vector<ULogRecord>(size).swap(records_);
+		}
+		mask_ = size-1;
+	}
+	unsigned int size() const {return mask_+1;}
+
+	// Rate limit of a call site, only used by the owner thread.
+	bool accept(const char * file, int line, time_t second, int limit, unsigned int & suppressed)
+	{
+		CallSite & site = sites_[((size_t)file/sizeof(void*) + (size_t)line*31) % kCallSites];
+		if(site.file != file || site.line != line)
+		{
+			site.file = file;
+			site.line = line;
+			site.second = second;
+			site.count = 0;
+			site.suppressed = 0;
+		}
+		else if(site.second != second)
+		{
+			site.second = second;
+			site.count = 0;
+		}
+		if(site.count >= limit)
+		{
+			++site.suppressed;
+			return false;
+		}
+		++site.count;
+		suppressed = site.suppressed;
+		site.suppressed = 0;
+		return true;
+	}
+
+	volatile unsigned int head_;
+	volatile unsigned int tail_;
+	volatile bool exited_;
+	unsigned long threadId_;
+	std::vector<ULogRecord> records_; // power of 2
+	unsigned int mask_;
+
+private:
+	struct CallSite
+	{
+		const char * file;
+		int line;
+		time_t second;
+		int count;
+		unsigned int suppressed;
+	};
+	CallSite sites_[kCallSites];
+};
+
+#ifdef _WIN32
+VOID WINAPI uLogRingThreadExit(PVOID ring);
+#else
+void uLogRingThreadExit(void * ring);
+#endif
+
+// Ring buffers of the threads. When a thread exits, its
+// ring buffer is reused by a new thread once it has been written.
+class ULogRings
+{
+public:
+	ULogRings() :
+		ringSize_(kDefaultRingSize)
+	{
+#ifdef _WIN32
+		key_ = FlsAlloc(uLogRingThreadExit);
+#else
+		pthread_key_create(&key_, uLogRingThreadExit);
+#endif
+	}
+	~ULogRings()
+	{
+		for(std::list<ULogRing*>::iterator iter=active_.begin(); iter!=active_.end(); ++iter)
+		{
+			delete *iter;
+		}
+		for(std::list<ULogRing*>::iterator iter=free_.begin(); iter!=free_.end(); ++iter)
+		{
+			delete *iter;
+		}
+	}
+
+	ULogRing * current()
+	{
+#ifdef _WIN32
+		ULogRing * ring = (ULogRing *)FlsGetValue(key_);
+#else
+		ULogRing * ring = (ULogRing *)pthread_getspecific(key_);
+#endif
+		if(ring == 0)
+		{
+			mutex_.lock();
+			if(free_.size())
+			{
+				ring = free_.front();
+				free_.pop_front();
+			}
+			else
+			{
+				ring = new ULogRing(ringSize_);
+			}
+			ring->reset(UThread::currentThreadId(), ringSize_);
+			active_.push_back(ring);
+			mutex_.unlock();
+#ifdef _WIN32
+			FlsSetValue(key_, ring);
+#else
+			pthread_setspecific(key_, ring);
+#endif
+		}
+		return ring;
+	}
+
+	// Used by rings assigned to threads afterwards
+	void setRingSize(unsigned int size)
+	{
+		UScopeMutex lock(mutex_);
+		ringSize_ = size;
+	}
+
+	// Release the memory of the rings of exited threads
+	void releaseFree()
+	{
+		UScopeMutex lock(mutex_);
+		for(std::list<ULogRing*>::iterator iter=free_.begin(); iter!=free_.end(); ++iter)
+		{
+			delete *iter;
+		}
+		free_.clear();
+	}
+
+	// Only called by the writer
+	std::list<ULogRing*> active()
+	{
+		UScopeMutex lock(mutex_);
+		return active_;
+	}
+
+	// Only called by the writer
+	void recycle()
+	{
+		UScopeMutex lock(mutex_);
+		for(std::list<ULogRing*>::iterator iter=active_.begin(); iter!=active_.end();)
+		{
+			if((*iter)->exited_ && (*iter)->tail_ == (*iter)->head_)
+			{
+				free_.push_back(*iter);
+				iter = active_.erase(iter);
+			}
+			else
+			{
+				++iter;
+			}
+		}
+	}
+
+private:
+#ifdef _WIN32
+	DWORD key_;
+#else
+	pthread_key_t key_;
+#endif
+	UMutex mutex_;
+	unsigned int ringSize_;
+	std::list<ULogRing*> active_;
+	std::list<ULogRing*> free_;
+};
+
+#ifdef _WIN32
+VOID WINAPI uLogRingThreadExit(PVOID ring)
+#else
+void uLogRingThreadExit(void * ring)
+#endif
+{
+	if(ring)
+	{
+		uMemoryBarrier();
+		((ULogRing*)ring)->exited_ = true;
+	}
+}
+
+ULogRings g_rings;
+UMutex g_writerMutex;
+USemaphore g_writerSemaphore; // wake up the writer before a ring buffer is full
+UMutex g_asyncMutex;
+unsigned long g_droppedMessagesReported = 0; // only used by the writer
+
+bool uRecordTimeLess(const std::pair<ULogRecord*, unsigned long> & a, const std::pair<ULogRecord*, unsigned long> & b)
+{
+	return a.first->seconds < b.first->seconds ||
+			(a.first->seconds == b.first->seconds && a.first->microseconds < b.first->microseconds);
+}
+
+}
+
 
 /**
  * This class is used to write logs in the console. This class cannot
@@ -227,6 +565,8 @@ void ULogger::setBuffered(bool buffered)
 
 void ULogger::flush()
 {
+	writeAsyncMessages();
+
 	loggerMutex_.lock();
 	if(!instance_ || bufferedMsgs_.size()==0)
 	{
@@ -311,19 +651,43 @@ void ULogger::write(ULogger::Level level,
 		const char* msg,
 		...)
 {
-	loggerMutex_.lock();
-	if(type_ == kTypeNoLog && level < kFatal && level < eventLevel_)
+	if(level < level_ && level < eventLevel_)
 	{
-		loggerMutex_.unlock();
+		// Ignored, no need to lock
 		return;
 	}
 	if(strlen(msg) == 0 && !printWhere_ && level < kFatal)
 	{
-		loggerMutex_.unlock();
 		// No need to show an empty message if we don't print where.
 		return;
 	}
 
+	bool writtenAsync = false;
+	if(asynchronous_ && level < kFatal && level >= level_ && type_ != kTypeNoLog)
+	{
+		va_list args;
+		va_start(args, msg);
+		writeAsync(level, file, line, function, msg, args);
+		va_end(args);
+		if(level < eventLevel_)
+		{
+			return;
+		}
+		writtenAsync = true;
+	}
+	else if(asynchronous_ && level >= kFatal)
+	{
+		// write the messages logged before
+		writeAsyncMessages();
+	}
+
+	loggerMutex_.lock();
+	if(type_ == kTypeNoLog && level < kFatal && level < eventLevel_)
+	{
+		loggerMutex_.unlock();
+		return;
+	}
+
     if(level >= level_ || level >= eventLevel_)
     {
 #ifdef _WIN32
@@ -355,77 +719,15 @@ void ULogger::write(ULogger::Level level,
 			endline = "\r\n";
 		}
 
-		std::string time = "";
-		if(printTime_ || level == kFatal)
-		{
-			time.append("(");
-			getTime(time);
-			time.append(") ");
-		}
-
-		std::string levelStr = "";
-		if(printLevel_ || level == kFatal)
-		{
-			const int bufSize = 30;
-			char buf[bufSize] = {0};
-
-#ifdef _MSC_VER
-			sprintf_s(buf, bufSize, "[%s]", levelName_[level]);
-#else
-			snprintf(buf, bufSize, "[%s]", levelName_[level]);
-#endif
-			levelStr = buf;
-			levelStr.append(" ");
-		}
-
-		std::string pidStr;
-		if(printThreadID_)
-		{
-			pidStr = uFormat("{%lu} ", UThread::currentThreadId());
-		}
-
-		std::string whereStr = "";
-		if(printWhere_ || level == kFatal)
-		{
-			whereStr.append("");
-			//File
-			if(printWhereFullPath_)
-			{
-				whereStr.append(file);
-			}
-			else
-			{
-				std::string fileName = UFile::getName(file);
-				if(limitWhereLength_ && fileName.size() > 8)
-				{
-					fileName.erase(8);
-					fileName.append("~");
-				}
-				whereStr.append(fileName);
-			}
-
-			//Line
-			whereStr.append(":");
-			std::string lineStr = uNumber2Str(line);
-			whereStr.append(lineStr);
-
-			//Function
-			whereStr.append("::");
-			std::string funcStr = function;
-			if(!printWhereFullPath_ && limitWhereLength_ && funcStr.size() > 8)
-			{
-				funcStr.erase(8);
-				funcStr.append("~");
-			}
-			funcStr.append("()");
-			whereStr.append(funcStr);
-
-			whereStr.append(" ");
-		}
+		time_t seconds;
+		int microseconds;
+		uNowTime(seconds, microseconds);
+		std::string time, levelStr, pidStr, whereStr;
+		getPrefix(level, file, line, function, UThread::currentThreadId(), seconds, microseconds, levelStr, pidStr, time, whereStr);
 
 		va_list args;
 
-		if(type_ != kTypeNoLog)
+		if(type_ != kTypeNoLog && !writtenAsync)
 		{
 			va_start(args, msg);
 #ifdef _WIN32
@@ -532,50 +834,10 @@ void ULogger::write(ULogger::Level level,
 
 int ULogger::getTime(std::string &timeStr)
 {
-    struct tm timeinfo;
-    const int bufSize = 30;
-    char buf[bufSize] = {0};
-
-#if _MSC_VER
-    time_t rawtime;
-    time(&rawtime);
-    localtime_s (&timeinfo, &rawtime );
-    int result = sprintf_s(buf, bufSize, "%d-%s%d-%s%d %s%d:%s%d:%s%d",
-        timeinfo.tm_year+1900,
-        (timeinfo.tm_mon+1) < 10 ? "0":"", timeinfo.tm_mon+1,
-        (timeinfo.tm_mday) < 10 ? "0":"", timeinfo.tm_mday,
-        (timeinfo.tm_hour) < 10 ? "0":"", timeinfo.tm_hour,
-        (timeinfo.tm_min) < 10 ? "0":"", timeinfo.tm_min,
-        (timeinfo.tm_sec) < 10 ? "0":"", timeinfo.tm_sec);
-#elif WIN32
-    time_t rawtime;
-    time(&rawtime);
-    timeinfo = *localtime (&rawtime);
-    int result = snprintf(buf, bufSize, "%d-%s%d-%s%d %s%d:%s%d:%s%d",
-		timeinfo.tm_year+1900,
-		(timeinfo.tm_mon+1) < 10 ? "0":"", timeinfo.tm_mon+1,
-		(timeinfo.tm_mday) < 10 ? "0":"", timeinfo.tm_mday,
-		(timeinfo.tm_hour) < 10 ? "0":"", timeinfo.tm_hour,
-		(timeinfo.tm_min) < 10 ? "0":"", timeinfo.tm_min,
-		(timeinfo.tm_sec) < 10 ? "0":"", timeinfo.tm_sec);
- #else
-    struct timeval rawtime;
-    gettimeofday(&rawtime, NULL);
-    localtime_r (&rawtime.tv_sec, &timeinfo);
-	int result = snprintf(buf, bufSize, "%d-%s%d-%s%d %s%d:%s%d:%s%d.%s%d",
-		timeinfo.tm_year+1900,
-		(timeinfo.tm_mon+1) < 10 ? "0":"", timeinfo.tm_mon+1,
-		(timeinfo.tm_mday) < 10 ? "0":"", timeinfo.tm_mday,
-		(timeinfo.tm_hour) < 10 ? "0":"", timeinfo.tm_hour,
-		(timeinfo.tm_min) < 10 ? "0":"", timeinfo.tm_min,
-		(timeinfo.tm_sec) < 10 ? "0":"", timeinfo.tm_sec,
-	    (rawtime.tv_usec/1000) < 10 ? "00":(rawtime.tv_usec/1000) < 100?"0":"", int(rawtime.tv_usec/1000));
-#endif
-    if(result)
-    {
-        timeStr.append(buf);
-    }
-    return result;
+	time_t seconds;
+	int microseconds;
+	uNowTime(seconds, microseconds);
+	return uFormatTime(timeStr, seconds, microseconds);
 }
 
 ULogger* ULogger::getInstance()
@@ -607,3 +869,344 @@ ULogger::~ULogger()
     instance_ = 0;
     //printf("Logger is destroyed...\n\r");
 }
+
+void ULogger::getPrefix(ULogger::Level level,
+		const char * file,
+		int line,
+		const char * function,
+		unsigned long threadId,
+		time_t seconds,
+		int microseconds,
+		std::string & levelStr,
+		std::string & pidStr,
+		std::string & timeStr,
+		std::string & whereStr)
+{
+	if(printTime_ || level == kFatal)
+	{
+		timeStr.append("(");
+		uFormatTime(timeStr, seconds, microseconds);
+		timeStr.append(") ");
+	}
+
+	if(printLevel_ || level == kFatal)
+	{
+		const int bufSize = 30;
+		char buf[bufSize] = {0};
+
+#ifdef _MSC_VER
+		sprintf_s(buf, bufSize, "[%s]", levelName_[level]);
+#else
+		snprintf(buf, bufSize, "[%s]", levelName_[level]);
+#endif
+		levelStr = buf;
+		levelStr.append(" ");
+	}
+
+	if(printThreadID_)
+	{
+		pidStr = uFormat("{%lu} ", threadId);
+	}
+
+	if(printWhere_ || level == kFatal)
+	{
+		whereStr.append("");
+		//File
+		if(printWhereFullPath_)
+		{
+			whereStr.append(file);
+		}
+		else
+		{
+			std::string fileName = UFile::getName(file);
+			if(limitWhereLength_ && fileName.size() > 8)
+			{
+				fileName.erase(8);
+				fileName.append("~");
+			}
+			whereStr.append(fileName);
+		}
+
+		//Line
+		whereStr.append(":");
+		std::string lineStr = uNumber2Str(line);
+		whereStr.append(lineStr);
+
+		//Function
+		whereStr.append("::");
+		std::string funcStr = function;
+		if(!printWhereFullPath_ && limitWhereLength_ && funcStr.size() > 8)
+		{
+			funcStr.erase(8);
+			funcStr.append("~");
+		}
+		funcStr.append("()");
+		whereStr.append(funcStr);
+
+		whereStr.append(" ");
+	}
+}
+
+void ULogger::writeAsync(ULogger::Level level,
+		const char * file,
+		int line,
+		const char * function,
+		const char* msg,
+		va_list args)
+{
+	ULogRing * ring = g_rings.current();
+
+	time_t seconds;
+	int microseconds;
+	uNowTime(seconds, microseconds);
+
+	unsigned int suppressed = 0;
+	int rateLimit = rateLimit_;
+	if(rateLimit > 0 && !ring->accept(file, line, seconds, rateLimit, suppressed))
+	{
+		uAtomicIncrement(&g_suppressedMessages);
+		return;
+	}
+
+	unsigned int head = ring->head_;
+	while(head - ring->tail_ >= ring->size())
+	{
+		if(asynchronousDrop_)
+		{
+			uAtomicIncrement(&g_droppedMessages);
+			return;
+		}
+		// wait for the writer
+		g_writerSemaphore.release();
+		uSleep(1);
+	}
+
+	ULogRecord & record = ring->records_[head & ring->mask_];
+	record.level = level;
+	record.file = file;
+	record.line = line;
+	record.function = function;
+	record.seconds = seconds;
+	record.microseconds = microseconds;
+	record.suppressed = suppressed;
+
+	va_list argsTmp;
+#if defined(_WIN32) && !defined(__MINGW32__)
+	argsTmp = args;
+#else
+	va_copy(argsTmp, args);
+#endif
+#ifdef _MSC_VER
+	int needed = vsnprintf_s(record.message, kMessageSize, _TRUNCATE, msg, argsTmp);
+#else
+	int needed = vsnprintf(record.message, kMessageSize, msg, argsTmp);
+#endif
+	va_end(argsTmp);
+	if(needed < 0 || needed >= kMessageSize)
+	{
+		record.longMessage = new std::string(uFormatv(msg, args));
+	}
+
+	// the record must be written before being visible to the writer
+	uMemoryBarrier();
+	ring->head_ = head + 1;
+
+	if(head + 1 - ring->tail_ == ring->size()/2)
+	{
+		g_writerSemaphore.release();
+	}
+}
+
+int ULogger::writeAsyncMessages()
+{
+	UScopeMutex lockWriter(g_writerMutex);
+
+	std::list<ULogRing*> rings = g_rings.active();
+	std::vector<std::pair<ULogRing*, unsigned int> > heads;
+	std::vector<std::pair<ULogRecord*, unsigned long> > records; // <record, thread id>
+	for(std::list<ULogRing*>::iterator iter=rings.begin(); iter!=rings.end(); ++iter)
+	{
+		ULogRing * ring = *iter;
+		unsigned int head = ring->head_;
+		uMemoryBarrier();
+		if(head != ring->tail_)
+		{
+			for(unsigned int i=ring->tail_; i!=head; ++i)
+			{
+				records.push_back(std::make_pair(&ring->records_[i & ring->mask_], ring->threadId_));
+			}
+			heads.push_back(std::make_pair(ring, head));
+		}
+	}
+	if(heads.size() > 1)
+	{
+		// Messages of a same thread keep their order
+		std::stable_sort(records.begin(), records.end(), uRecordTimeLess);
+	}
+
+	loggerMutex_.lock();
+	if(instance_ && type_ != kTypeNoLog)
+	{
+		std::string endline = "";
+		if(printEndline_) {
+			endline = "\r\n";
+		}
+
+		unsigned long dropped = (unsigned long)g_droppedMessages;
+		if(dropped != g_droppedMessagesReported)
+		{
+			std::string msg = uFormat("[ WARN] ULogger: %lu messages dropped (ring buffer full)%s", dropped - g_droppedMessagesReported, endline.c_str());
+			if(buffered_)
+			{
+				bufferedMsgs_.append(msg);
+			}
+			else
+			{
+				instance_->_writeStr(msg.c_str());
+			}
+			g_droppedMessagesReported = dropped;
+		}
+
+		// Messages are written all at once, except on Windows
+		// where the console color is set for each message
+		std::string out;
+		bool colored = type_ == ULogger::kTypeConsole && printColored_;
+#ifdef _WIN32
+		HANDLE H = GetStdHandle(STD_OUTPUT_HANDLE);
+#endif
+		for(unsigned int i=0; i<records.size(); ++i)
+		{
+			const ULogRecord & record = *records[i].first;
+			std::string levelStr, pidStr, timeStr, whereStr;
+			getPrefix(record.level, record.file, record.line, record.function, records[i].second, record.seconds, record.microseconds, levelStr, pidStr, timeStr, whereStr);
+
+#ifndef _WIN32
+			if(colored)
+			{
+				out.append(uLevelColor(record.level));
+			}
+#endif
+			out.append(levelStr);
+			out.append(pidStr);
+			out.append(timeStr);
+			out.append(whereStr);
+			out.append(record.longMessage?record.longMessage->c_str():record.message);
+			if(record.suppressed)
+			{
+				out.append(uFormat(" (%u similar messages suppressed)", record.suppressed));
+			}
+#ifndef _WIN32
+			if(colored)
+			{
+				out.append(COLOR_NORMAL);
+			}
+#endif
+			out.append(endline);
+
+#ifdef _WIN32
+			if(colored && !buffered_)
+			{
+				SetConsoleTextAttribute(H,uLevelColor(record.level));
+				instance_->_writeStr(out.c_str());
+				SetConsoleTextAttribute(H,COLOR_NORMAL);
+				out.clear();
+			}
+#endif
+		}
+		if(buffered_)
+		{
+			bufferedMsgs_.append(out);
+		}
+		else if(!out.empty())
+		{
+			instance_->_writeStr(out.c_str());
+		}
+	}
+	loggerMutex_.unlock();
+
+	for(unsigned int i=0; i<records.size(); ++i)
+	{
+		delete records[i].first->longMessage;
+		records[i].first->longMessage = 0;
+	}
+	// records must be read before being reused by the producers
+	uMemoryBarrier();
+	for(unsigned int i=0; i<heads.size(); ++i)
+	{
+		heads[i].first->tail_ = heads[i].second;
+	}
+	g_rings.recycle();
+
+	return (int)records.size();
+}
+
+/**
+ * Background thread writing the messages of the asynchronous mode.
+ */
+class UAsyncLogWriter : public UThread
+{
+public:
+	virtual ~UAsyncLogWriter()
+	{
+		ULogger::asynchronous_ = false;
+		this->join(true);
+		ULogger::writeAsyncMessages();
+	}
+
+private:
+	virtual void mainLoop()
+	{
+		if(ULogger::writeAsyncMessages() == 0)
+		{
+			g_writerSemaphore.acquire(1, kWriterPeriodMs);
+		}
+	}
+	virtual void mainLoopKill()
+	{
+		g_writerSemaphore.release();
+	}
+};
+
+static UAsyncLogWriter * g_writer = 0;
+// Defined after the other static variables, so that it is
+// destroyed before them and remaining messages are written.
+static UDestroyer<UAsyncLogWriter> g_writerDestroyer;
+
+void ULogger::setAsynchronous(bool asynchronous, bool dropWhenFull, unsigned int ringSize)
+{
+	UScopeMutex lock(g_asyncMutex);
+	asynchronousDrop_ = dropWhenFull;
+	unsigned int size = 2;
+	while(size < ringSize)
+	{
+		size *= 2;
+	}
+	g_rings.setRingSize(size);
+	if(asynchronous && !asynchronous_)
+	{
+		if(g_writer == 0)
+		{
+			g_writer = new UAsyncLogWriter();
+			g_writerDestroyer.setDoomed(g_writer);
+		}
+		asynchronous_ = true;
+		g_writer->start();
+	}
+	else if(!asynchronous && asynchronous_)
+	{
+		asynchronous_ = false;
+		g_writer->join(true);
+		writeAsyncMessages();
+		g_rings.releaseFree();
+	}
+}
+
+unsigned long ULogger::droppedMessages()
+{
+	return g_droppedMessages;
+}
+
+unsigned long ULogger::suppressedMessages()
+{
+	return g_suppressedMessages;
+}